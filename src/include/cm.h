@@ -85,6 +85,11 @@ struct conn_state {
     } x;
     krb5_data callback_buffer;
     size_t server_index;
+    struct timeval send_time;   /* When the request was first sent */
+    int nsends;                 /* Number of times the request was sent */
+    unsigned int replied : 1;   /* Received a reply on this connection */
+    unsigned int reused : 1;    /* fd came from the context's TCP pool */
+    const krb5_data *message;   /* Request, for reconnecting if reused */
     struct conn_state *next;
 };
 
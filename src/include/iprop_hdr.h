@@ -29,6 +29,22 @@ extern "C" {
 #define KIPROP_SVC_NAME "kiprop"
 #define MAX_BACKOFF     300     /* Backoff for a maximum for 5 mts */
 
+/*
+ * Update notifications.  When a new serial number is committed, the master
+ * sends a datagram containing IPROP_NOTIFY_MAGIC and the new serial number
+ * (both 32-bit, network byte order) to the kprop UDP port of each slave
+ * which has recently asked for updates.  The slave ignores datagrams which
+ * don't come from the master's address, and treats the rest only as a hint
+ * to poll immediately, so a lost or forged notification costs at most one
+ * extra poll.
+ */
+#define IPROP_NOTIFY_MAGIC      0x6970726e      /* "iprn" */
+#define IPROP_NOTIFY_LEN        8
+#define IPROP_NOTIFY_INTERVAL   250     /* Master check interval, in ms */
+#define IPROP_NOTIFY_EXPIRE     86400   /* Forget silent slaves after 1 day */
+/* UDP port for notifications when krb5_prop is not registered for UDP. */
+#define IPROP_NOTIFY_PORT       754
+
 enum iprop_role {
     IPROP_NULL = 0,
     IPROP_MASTER = 1,
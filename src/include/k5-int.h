@@ -188,6 +188,9 @@ typedef INT64_TYPE krb5_int64;
 #define KRB5_CONF_ADMIN_SERVER                   "admin_server"
 #define KRB5_CONF_ALLOW_WEAK_CRYPTO              "allow_weak_crypto"
 #define KRB5_CONF_AP_REQ_CHECKSUM_TYPE           "ap_req_checksum_type"
+#define KRB5_CONF_ASYNC                          "async"
+#define KRB5_CONF_ASYNC_OVERFLOW                 "async_overflow"
+#define KRB5_CONF_ASYNC_QUEUE_SIZE               "async_queue_size"
 #define KRB5_CONF_AUTH_TO_LOCAL                  "auth_to_local"
 #define KRB5_CONF_AUTH_TO_LOCAL_NAMES            "auth_to_local_names"
 #define KRB5_CONF_CANONICALIZE                   "canonicalize"
@@ -228,7 +231,11 @@ typedef INT64_TYPE krb5_int64;
 #define KRB5_CONF_KDC                         "kdc"
 #define KRB5_CONF_KDCDEFAULTS                 "kdcdefaults"
 #define KRB5_CONF_KDC_PORTS                   "kdc_ports"
+#define KRB5_CONF_KDC_PREAUTH_THREADS         "kdc_preauth_threads"
+#define KRB5_CONF_KDC_STATS_FILE              "kdc_stats_file"
+#define KRB5_CONF_KDC_STATS_INTERVAL          "kdc_stats_interval"
 #define KRB5_CONF_KDC_TCP_PORTS               "kdc_tcp_ports"
+#define KRB5_CONF_KDC_TCP_REUSE               "kdc_tcp_reuse"
 #define KRB5_CONF_MAX_DGRAM_REPLY_SIZE        "kdc_max_dgram_reply_size"
 #define KRB5_CONF_KDC_DEFAULT_OPTIONS         "kdc_default_options"
 #define KRB5_CONF_KDC_TIMESYNC                "kdc_timesync"
@@ -657,12 +664,14 @@ krb5_encrypt_keyhelper(krb5_context context, krb5_key key,
  * End "los-proto.h"
  */
 
+struct k5_tcp_pool;             /* private, in sendto_kdc.c */
 typedef struct _krb5_os_context {
     krb5_magic              magic;
     krb5_int32              time_offset;
     krb5_int32              usec_offset;
     krb5_int32              os_flags;
     char *                  default_ccname;
+    struct k5_tcp_pool *    tcp_pool;
 } *krb5_os_context;
 
 /* Get the current time of day plus a specified offset. */
@@ -1511,6 +1520,42 @@ encode_krb5_tgs_rep(const krb5_kdc_rep *rep, krb5_data **code);
 krb5_error_code
 encode_krb5_ap_req(const krb5_ap_req *rep, krb5_data **code);
 
+/*
+  krb5_error_code encode_krb5_structure_buf(const krb5_structure *rep,
+  unsigned char *mem, size_t memlen, size_t *len_out);
+  modifies  *len_out, mem
+  effects   Places the length of the ASN.1 encoding of *rep in *len_out.
+  If mem is not NULL, stores the encoding in the first *len_out bytes
+  of mem, returning ASN1_OVERFLOW if memlen is too small.  Allocates
+  no memory.
+*/
+
+krb5_error_code
+encode_krb5_authenticator_buf(const krb5_authenticator *rep,
+                              unsigned char *mem, size_t memlen,
+                              size_t *len_out);
+
+krb5_error_code
+encode_krb5_enc_tkt_part_buf(const krb5_enc_tkt_part *rep, unsigned char *mem,
+                             size_t memlen, size_t *len_out);
+
+krb5_error_code
+encode_krb5_enc_kdc_rep_part_buf(const krb5_enc_kdc_rep_part *rep,
+                                 unsigned char *mem, size_t memlen,
+                                 size_t *len_out);
+
+krb5_error_code
+encode_krb5_as_rep_buf(const krb5_kdc_rep *rep, unsigned char *mem,
+                       size_t memlen, size_t *len_out);
+
+krb5_error_code
+encode_krb5_tgs_rep_buf(const krb5_kdc_rep *rep, unsigned char *mem,
+                        size_t memlen, size_t *len_out);
+
+krb5_error_code
+encode_krb5_ap_req_buf(const krb5_ap_req *rep, unsigned char *mem,
+                       size_t memlen, size_t *len_out);
+
 krb5_error_code
 encode_krb5_ap_rep(const krb5_ap_rep *rep, krb5_data **code);
 
@@ -1668,6 +1713,27 @@ decode_krb5_sam_response_2(const krb5_data *, krb5_sam_response_2 **);
   Returns asn1 and krb5 errors.
 */
 
+/*
+ * An arena holds the results of one or more arena decoders, which allocate
+ * every decoded object from a few large blocks instead of separately from the
+ * heap, and which leave byte strings (principal components, octet strings,
+ * ciphertexts and the like) pointing into the input encoding.  The input must
+ * therefore outlive the arena and must not be modified.  Objects from an
+ * arena must not be passed to the krb5_free_* functions; they are all
+ * released by k5_asn1_arena_free().
+ */
+typedef struct k5_asn1_arena_st k5_asn1_arena;
+
+krb5_error_code
+k5_asn1_arena_create(k5_asn1_arena **arena_out);
+
+/* Return len zero-filled bytes from arena, or NULL if out of memory. */
+void *
+k5_asn1_arena_alloc(k5_asn1_arena *arena, size_t len);
+
+void
+k5_asn1_arena_free(k5_asn1_arena *arena);
+
 krb5_error_code
 decode_krb5_authenticator(const krb5_data *code, krb5_authenticator **rep);
 
@@ -1811,6 +1877,23 @@ krb5_error_code
 krb5int_ldap_decode_sequence_of_keys(const krb5_data *in,
                                      ldap_seqof_key_data **rep);
 
+/* Arena decoders; see k5_asn1_arena above. */
+krb5_error_code
+decode_krb5_ap_req_arena(k5_asn1_arena *arena, const krb5_data *code,
+                         krb5_ap_req **rep);
+
+krb5_error_code
+decode_krb5_as_req_arena(k5_asn1_arena *arena, const krb5_data *code,
+                         krb5_kdc_req **rep);
+
+krb5_error_code
+decode_krb5_tgs_req_arena(k5_asn1_arena *arena, const krb5_data *code,
+                          krb5_kdc_req **rep);
+
+krb5_error_code
+decode_krb5_fast_req_arena(k5_asn1_arena *arena, const krb5_data *code,
+                           krb5_fast_req **rep);
+
 /*************************************************************************
  * End of prototypes for krb5_decode.c
  *************************************************************************/
@@ -1827,6 +1910,23 @@ krb5int_ldap_decode_sequence_of_keys(const krb5_data *in,
 krb5_error_code
 krb5_encrypt_tkt_part(krb5_context, const krb5_keyblock *, krb5_ticket *);
 
+krb5_error_code
+krb5_encrypt_tkt_part_k(krb5_context, krb5_key, krb5_ticket *);
+
+krb5_error_code
+krb5_decrypt_tkt_part_k(krb5_context, krb5_key, krb5_ticket *);
+
+krb5_error_code
+krb5_auth_con_setuseruserkey_k(krb5_context, krb5_auth_context, krb5_key);
+
+krb5_error_code
+krb5_pac_verify_k(krb5_context, const krb5_pac, krb5_timestamp,
+                  krb5_const_principal, krb5_key, krb5_key);
+
+krb5_error_code
+krb5_pac_sign_k(krb5_context, krb5_pac, krb5_timestamp, krb5_const_principal,
+                krb5_key, krb5_key, krb5_data *);
+
 krb5_error_code
 krb5_encode_kdc_rep(krb5_context, krb5_msgtype, const krb5_enc_kdc_rep_part *,
                     int using_subkey, const krb5_keyblock *, krb5_kdc_rep *,
@@ -1943,7 +2043,7 @@ struct srv_dns_entry {
 
 #ifdef KRB5_DNS_LOOKUP
 krb5_error_code
-krb5int_make_srv_query_realm(const krb5_data *realm,
+krb5int_make_srv_query_realm(krb5_context context, const krb5_data *realm,
                              const char *service,
                              const char *protocol,
                              struct srv_dns_entry **answers);
@@ -2607,4 +2707,72 @@ void krb5int_init_trace(krb5_context context);
 void krb5int_trace(krb5_context context, const char *fmt, ...);
 #endif
 
+/* Write the binary trace rings to the binary trace file, if any. */
+krb5_error_code krb5int_trace_snapshot(void);
+
+/* Convert binary trace snapshots read from in to text lines on out. */
+krb5_error_code krb5int_trace_decode(krb5_context context, FILE *in,
+                                     FILE *out);
+
+/*
+ * Operation counters and latency histograms, enabled by the KRB5_METRICS
+ * environment variable; see lib/krb5/os/metrics.c.  Measure an operation
+ * like so:
+ *
+ *     krb5_ui_8 start = k5_metric_start();
+ *     ret = do_operation();
+ *     k5_metric_end(K5_METRIC_OPERATION, start, ret);
+ */
+typedef enum {
+    K5_METRIC_SENDTO_KDC,
+    K5_METRIC_CC_STORE,
+    K5_METRIC_CC_RETRIEVE,
+    K5_METRIC_KT_GET_ENTRY,
+    K5_METRIC_RC_STORE,
+    K5_METRIC_LDAP_POOL_WAIT,
+    K5_METRIC_LDAP_SEARCH,
+    K5_METRIC_MAX
+} k5_metric_t;
+
+extern int krb5int_metrics_enabled;
+void krb5int_init_metrics(void);
+krb5_ui_8 krb5int_metric_now(void);
+void krb5int_metric_record(k5_metric_t metric, krb5_ui_8 start,
+                           krb5_error_code ret);
+#define k5_metric_start()                                       \
+    (krb5int_metrics_enabled ? krb5int_metric_now() : 0)
+#define k5_metric_end(metric, start, ret)                               \
+    do {                                                                \
+        if ((start) != 0)                                               \
+            krb5int_metric_record(metric, start, ret);                  \
+    } while (0)
+
+/*
+ * A latency histogram.  Bucket i counts durations below 2^i microseconds; the
+ * last bucket counts everything longer.  Callers provide any locking.
+ */
+#define K5_LATENCY_BUCKETS 24
+struct k5_latency {
+    unsigned long count;
+    unsigned long errors;
+    krb5_ui_8 total_us;
+    krb5_ui_8 max_us;
+    unsigned long buckets[K5_LATENCY_BUCKETS];
+};
+
+/* Count a duration of us microseconds in lat, as a failure if ret is
+ * nonzero. */
+void krb5int_latency_add(struct k5_latency *lat, krb5_ui_8 us,
+                         krb5_error_code ret);
+
+/* Append a line describing lat to buf, beginning with name. */
+void krb5int_latency_format(struct k5buf *buf, const char *name,
+                            const struct k5_latency *lat);
+
+/* Write a snapshot if one was requested by signal since the last one. */
+void krb5int_snapshot_check(void);
+
+/* Append the metrics and binary trace rings to their files now. */
+krb5_error_code krb5int_snapshot_write(void);
+
 #endif /* _KRB5_INT_H */
@@ -74,6 +74,11 @@
  *   {etypes}      krb5_enctype *, display list of enctypes
  *   {ccache}      krb5_ccache, display type:name
  *   {creds}       krb5_creds *, display clientprinc -> serverprinc
+ *
+ * In binary mode (KRB5_TRACE=binary:path), arguments are recorded in a
+ * compact form and formatted only when a snapshot is decoded, using
+ * lib/krb5/os/t_trace.  A new specifier must therefore be supported by both
+ * the recorder and the decoder in trace.c.
  */
 
 #ifndef K5_TRACE_H
@@ -141,6 +146,12 @@
     TRACE(c, (c, "ccselect choosing default cache {ccache} for server " \
               "principal {princ}", cache, server))
 
+#define TRACE_DNS_SRV_CACHE_HIT(c, name, secs)                          \
+    TRACE(c, (c, "Using cached DNS SRV answer for {str} (expires in {int} " \
+              "seconds)", name, secs))
+#define TRACE_DNS_SRV_CACHE_MISS(c, name)                               \
+    TRACE(c, (c, "No cached DNS SRV answer for {str}, querying DNS", name))
+
 #define TRACE_FAST_ARMOR_CCACHE(c, ccache_name)                 \
     TRACE(c, (c, "FAST armor ccache: {str}", ccache_name))
 #define TRACE_FAST_ARMOR_CCACHE_KEY(c, keyblock)                        \
@@ -291,12 +302,18 @@
 #define TRACE_SENDTO_KDC(c, len, rlm, master, tcp)                      \
     TRACE(c, (c, "Sending request ({int} bytes) to {data}{str}{str}", len, \
               rlm, (master) ? " (master)" : "", (tcp) ? " (tcp only)" : ""))
+#define TRACE_SENDTO_KDC_BACKOFF(c, conn, failures, secs)               \
+    TRACE(c, (c, "No answer from {connstate} ({int} in a row), trying it " \
+              "last for {int} seconds", conn, failures, secs))
 #define TRACE_SENDTO_KDC_MASTER(c, master)                              \
     TRACE(c, (c, "Response was{str} from master KDC", (master) ? "" : " not"))
 #define TRACE_SENDTO_KDC_RESOLVING(c, hostname)         \
     TRACE(c, (c, "Resolving hostname {str}", hostname))
 #define TRACE_SENDTO_KDC_RESPONSE(c, conn)                      \
     TRACE(c, (c, "Received answer from {connstate}", conn))
+#define TRACE_SENDTO_KDC_RTT(c, conn, rtt, srtt)                        \
+    TRACE(c, (c, "Response time from {connstate} was {long}ms (average " \
+              "{long}ms)", conn, rtt, srtt))
 #define TRACE_SENDTO_KDC_TCP_CONNECT(c, conn)                           \
     TRACE(c, (c, "Initiating TCP connection to {connstate}", conn))
 #define TRACE_SENDTO_KDC_TCP_DISCONNECT(c, conn)                        \
@@ -309,6 +326,10 @@
     TRACE(c, (c, "TCP error receiving from {connstate}: {errno}", conn, err))
 #define TRACE_SENDTO_KDC_TCP_ERROR_SEND(c, conn, err)                   \
     TRACE(c, (c, "TCP error sending to {connstate}: {errno}", conn, err))
+#define TRACE_SENDTO_KDC_TCP_POOL(c, conn)                              \
+    TRACE(c, (c, "Keeping TCP connection to {connstate} for reuse", conn))
+#define TRACE_SENDTO_KDC_TCP_REUSE(c, conn)                             \
+    TRACE(c, (c, "Reusing TCP connection to {connstate}", conn))
 #define TRACE_SENDTO_KDC_TCP_SEND(c, conn)                      \
     TRACE(c, (c, "Sending TCP request to {connstate}", conn))
 #define TRACE_SENDTO_KDC_UDP_ERROR_RECV(c, conn, err)                   \
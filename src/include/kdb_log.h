@@ -24,10 +24,19 @@ extern "C" {
 #define INDEX(ulogaddr, i) ((unsigned long) ulogaddr + sizeof (kdb_hlog_t) + \
                             (i*ulog->kdb_block))
 
+/*
+ * The encoded updates are kept at their own length in a data area which
+ * follows the kdb_nslots index entries.
+ */
+#define ULOG_DATA(ulogaddr) ((unsigned long) ulogaddr + sizeof (kdb_hlog_t) + \
+                             ((ulogaddr)->kdb_nslots*(ulogaddr)->kdb_block))
+#define ENTRY_DATA(ulogaddr, indx_log) \
+    ((char *)ULOG_DATA(ulogaddr) + (indx_log)->kdb_entry_off)
+
 /*
  * Current DB version #
  */
-#define KDB_VERSION     1
+#define KDB_VERSION     2
 
 /*
  * DB log states
@@ -53,14 +62,14 @@ extern "C" {
 /*
  * Default ulog file attributes
  */
-#define MAX_ULOGENTRIES 2500
+#define MAX_ULOGENTRIES 65535
 #define DEF_ULOGENTRIES 1000
 #define ULOG_IDLE_TIME  10              /* in seconds */
 /*
- * Max size of update entry + update header
- * We make this large since resizing can be costly.
+ * The data area grows by at least this much at a time, until it holds
+ * a full ring of entries.
  */
-#define ULOG_BLOCK      2048            /* Default size of principal record */
+#define ULOG_GROW       65536
 
 #define MAXLOGLEN       0x10000000      /* 256 MB log file */
 
@@ -77,6 +86,9 @@ extern krb5_error_code ulog_delete_update(krb5_context context,
                                           kdb_incr_update_t *upd);
 extern krb5_error_code ulog_finish_update(krb5_context context,
                                           kdb_incr_update_t *upd);
+extern krb5_error_code ulog_begin_batch(krb5_context context);
+extern krb5_error_code ulog_end_batch(krb5_context context);
+extern void ulog_init_header(krb5_context context);
 extern krb5_error_code ulog_get_entries(krb5_context context, kdb_last_t last,
                                         kdb_incr_result_t *ulog_handle);
 
@@ -105,7 +117,10 @@ typedef struct kdb_hlog {
     kdb_sno_t       kdb_first_sno;  /* First serial # in the update log */
     kdb_sno_t       kdb_last_sno;   /* Last serial # in the update log */
     uint16_t        kdb_state;      /* State of update log */
-    uint16_t        kdb_block;      /* Block size of each element */
+    uint16_t        kdb_block;      /* Size of each index entry */
+    uint32_t        kdb_nslots;     /* # of index entries */
+    uint32_t        kdb_data_size;  /* Size of the entry data area */
+    uint32_t        kdb_data_next;  /* Data area offset of the next entry */
 } kdb_hlog_t;
 
 typedef struct kdb_ent_header {
@@ -114,7 +129,7 @@ typedef struct kdb_ent_header {
     kdbe_time_t     kdb_time;       /* Timestamp of update */
     bool_t          kdb_commit;     /* Is the entry committed or not */
     uint32_t        kdb_entry_size; /* Size of update entry */
-    uint8_t         entry_data[4];  /* Address of kdb_incr_update_t */
+    uint32_t        kdb_entry_off;  /* Data area offset of the entry */
 } kdb_ent_header_t;
 
 typedef struct _kdb_log_context {
@@ -122,6 +137,7 @@ typedef struct _kdb_log_context {
     kdb_hlog_t      *ulog;
     uint32_t        ulogentries;
     int             ulogfd;
+    krb5_boolean    batch;          /* Defer syncs to ulog_end_batch() */
 } kdb_log_context;
 
 #ifdef  __cplusplus
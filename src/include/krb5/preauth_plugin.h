@@ -355,6 +355,26 @@ typedef struct krb5_kdcpreauth_modreq_st *krb5_kdcpreauth_modreq;
  * header dependency for the moment). */
 struct verto_context;
 
+/*
+ * A function run by the offload callback.  The work function runs on a KDC
+ * helper thread, with a krb5 context belonging to that thread; the done
+ * function runs afterwards on the KDC's main thread.
+ */
+typedef void
+(*krb5_kdcpreauth_offload_fn)(krb5_context context, void *arg);
+
+/* Events for the watch_fd callback. */
+#define KRB5_KDCPREAUTH_FD_READ  0x1
+#define KRB5_KDCPREAUTH_FD_WRITE 0x2
+
+/*
+ * Called by the KDC when a descriptor passed to the watch_fd callback is
+ * ready, with ready set to 1, or when the watch times out, with ready set to
+ * 0.
+ */
+typedef void
+(*krb5_kdcpreauth_fd_fn)(krb5_context context, int fd, int ready, void *arg);
+
 /* Before using a callback after version 1, modules must check the vers
  * field of the callback structure. */
 typedef struct krb5_kdcpreauth_callbacks_st {
@@ -410,6 +430,36 @@ typedef struct krb5_kdcpreauth_callbacks_st {
                                        krb5_kdcpreauth_rock rock);
 
     /* End of version 1 kdcpreauth callbacks. */
+
+    /*
+     * Run work(context, arg) on a KDC helper thread, where it may block (for
+     * instance, waiting for an OTP or RADIUS server), and then done(context,
+     * arg) on the KDC's thread.  work must not use rock or any other callback,
+     * and should bound any waits with a timeout: at shutdown, the KDC cannot
+     * interrupt work, and waits only a few seconds for it to return.  done
+     * receives the context passed to this callback and would usually invoke
+     * the edata or verify respond function.  If the KDC has no helper threads,
+     * work and done run before this callback returns.  If an error is
+     * returned, neither function will be called.
+     */
+    krb5_error_code (*offload)(krb5_context context, krb5_kdcpreauth_rock rock,
+                               krb5_kdcpreauth_offload_fn work,
+                               krb5_kdcpreauth_offload_fn done, void *arg);
+
+    /*
+     * Call cb(context, fd, ready, arg) on the KDC's thread when fd is ready
+     * for any of events (KRB5_KDCPREAUTH_FD_READ and/or
+     * KRB5_KDCPREAUTH_FD_WRITE), or after timeout_ms milliseconds (if
+     * positive) if it does not become ready first.  cb is called exactly once;
+     * it may watch the descriptor again.  The module remains responsible for
+     * closing fd.  If an error is returned, cb will not be called.
+     */
+    krb5_error_code (*watch_fd)(krb5_context context,
+                                krb5_kdcpreauth_rock rock, int fd, int events,
+                                int timeout_ms, krb5_kdcpreauth_fd_fn cb,
+                                void *arg);
+
+    /* End of version 2 kdcpreauth callbacks. */
 } *krb5_kdcpreauth_callbacks;
 
 /* Optional: preauth plugin initialization function. */
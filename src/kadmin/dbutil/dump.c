@@ -2555,12 +2555,7 @@ load_db(argc, argv)
          *      no advantage in incr updates when entire db is replaced
          */
         if (!(flags & FLAG_UPDATE)) {
-            memset(log_ctx->ulog, 0, sizeof (kdb_hlog_t));
-
-            log_ctx->ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-            log_ctx->ulog->db_version_num = KDB_VERSION;
-            log_ctx->ulog->kdb_state = KDB_STABLE;
-            log_ctx->ulog->kdb_block = ULOG_BLOCK;
+            ulog_init_header(kcontext);
 
             log_ctx->iproprole = IPROP_NULL;
 
@@ -2598,6 +2593,13 @@ load_db(argc, argv)
         }
     }
 
+    /*
+     * An update load on the master logs every principal it loads, so
+     * sync the update log once for all of them.
+     */
+    if (log_ctx && log_ctx->iproprole == IPROP_MASTER)
+        (void) ulog_begin_batch(kcontext);
+
     if (restore_dump(progname, kcontext, (dumpfile) ? dumpfile : stdin_name,
                      f, flags, load)) {
         fprintf(stderr, restfail_fmt,
@@ -2605,6 +2607,13 @@ load_db(argc, argv)
         exit_status++;
     }
 
+    if (log_ctx && log_ctx->iproprole == IPROP_MASTER &&
+        (kret = ulog_end_batch(kcontext))) {
+        fprintf(stderr, _("%s: %s while syncing update log\n"),
+                progname, error_message(kret));
+        exit_status++;
+    }
+
     if (!(flags & FLAG_UPDATE) && load->create_kadm5 &&
         ((kret = kadm5_create_magic_princs(&global_params, kcontext)))) {
         /* error message printed by create_magic_princs */
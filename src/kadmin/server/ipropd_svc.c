@@ -43,6 +43,27 @@ static const char *client_addr(struct svc_req *svc) {
     return abuf;
 }
 
+/*
+ * Slaves which have recently asked for updates, and which are sent a
+ * datagram on their kprop port when a new serial number is committed.  The
+ * datagram is sent from the local address the slave connected to, which is
+ * the address it accepts notifications from.
+ */
+struct notify_slave {
+    struct sockaddr_storage	addr;
+    struct sockaddr_storage	laddr;
+    socklen_t		addrlen;
+    socklen_t		laddrlen;
+    time_t		last_seen;
+};
+
+static struct notify_slave *notify_slaves = NULL;
+static int num_notify_slaves = 0;
+static int notify_enabled = 0;
+static unsigned short notify_port;	/* network byte order */
+static kdb_log_context *notify_log_ctx = NULL;
+static kdb_sno_t notified_sno;
+
 static char *reply_ok_str	= "UPDATE_OK";
 static char *reply_err_str	= "UPDATE_ERROR";
 static char *reply_fr_str	= "UPDATE_FULL_RESYNC_NEEDED";
@@ -125,6 +146,168 @@ buf_to_string(gss_buffer_desc *b)
     return s;
 }
 
+/* Return true if the host parts of a and b are the same. */
+static int
+same_host(const struct sockaddr *a, const struct sockaddr *b)
+{
+    const struct sockaddr_in *a4, *b4;
+    const struct sockaddr_in6 *a6, *b6;
+
+    if (a->sa_family != b->sa_family)
+	return 0;
+    if (a->sa_family == AF_INET) {
+	a4 = (const struct sockaddr_in *)(const void *)a;
+	b4 = (const struct sockaddr_in *)(const void *)b;
+	return a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+    }
+    if (a->sa_family == AF_INET6) {
+	a6 = (const struct sockaddr_in6 *)(const void *)a;
+	b6 = (const struct sockaddr_in6 *)(const void *)b;
+	return IN6_ARE_ADDR_EQUAL(&a6->sin6_addr, &b6->sin6_addr);
+    }
+    return 0;
+}
+
+/* Remember the slave making rqstp so that it is told about future
+ * updates. */
+static void
+notify_register(struct svc_req *rqstp)
+{
+    SVCXPRT *xprt = rqstp->rq_xprt;
+    struct sockaddr *raddr = (struct sockaddr *)&xprt->xp_raddr;
+    struct sockaddr *laddr = (struct sockaddr *)&xprt->xp_laddr;
+    struct notify_slave *ns;
+    socklen_t len, llen;
+    int i;
+
+    if (!notify_enabled)
+	return;
+    if (raddr->sa_family != AF_INET && raddr->sa_family != AF_INET6)
+	return;
+    len = xprt->xp_addrlen;
+    llen = xprt->xp_laddrlen;
+    if (len <= 0 || (size_t)len > sizeof(ns->addr) ||
+	(size_t)llen > sizeof(ns->laddr))
+	return;
+
+    for (i = 0; i < num_notify_slaves; i++) {
+	ns = &notify_slaves[i];
+	if (same_host((struct sockaddr *)&ns->addr, raddr)) {
+	    memcpy(&ns->laddr, laddr, llen);
+	    ns->laddrlen = llen;
+	    ns->last_seen = time(NULL);
+	    return;
+	}
+    }
+
+    ns = realloc(notify_slaves, (num_notify_slaves + 1) * sizeof(*ns));
+    if (ns == NULL)
+	return;
+    notify_slaves = ns;
+    ns = &notify_slaves[num_notify_slaves++];
+    memset(ns, 0, sizeof(*ns));
+    memcpy(&ns->addr, raddr, len);
+    ns->addrlen = len;
+    memcpy(&ns->laddr, laddr, llen);
+    ns->laddrlen = llen;
+    ns->last_seen = time(NULL);
+    if (ns->addr.ss_family == AF_INET)
+	((struct sockaddr_in *)(void *)&ns->addr)->sin_port = notify_port;
+    else
+	((struct sockaddr_in6 *)(void *)&ns->addr)->sin6_port = notify_port;
+}
+
+/* Send a notification datagram to ns from the address it connected to. */
+static void
+notify_send(struct notify_slave *ns, const unsigned char *buf, size_t len)
+{
+    struct sockaddr_storage laddr;
+    int fd;
+
+    fd = socket(ns->addr.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0)
+	return;
+    if (ns->laddrlen > 0 && ns->laddr.ss_family == ns->addr.ss_family) {
+	/* Bind to the address only, letting the system pick a port. */
+	laddr = ns->laddr;
+	if (laddr.ss_family == AF_INET)
+	    ((struct sockaddr_in *)(void *)&laddr)->sin_port = 0;
+	else
+	    ((struct sockaddr_in6 *)(void *)&laddr)->sin6_port = 0;
+	(void) bind(fd, (struct sockaddr *)&laddr, ns->laddrlen);
+    }
+    (void) sendto(fd, buf, len, 0, (struct sockaddr *)&ns->addr,
+		  ns->addrlen);
+    close(fd);
+}
+
+/*
+ * Timer callback: if the update log has committed a new serial number since
+ * we last looked, send a notification to each known slave.  The log is
+ * mapped shared, so this also sees updates made by kadmin.local.
+ */
+static void
+notify_check(verto_ctx *ctx, verto_ev *ev)
+{
+    kdb_hlog_t *ulog = notify_log_ctx->ulog;
+    unsigned char buf[IPROP_NOTIFY_LEN];
+    time_t now;
+    int i;
+
+    if (ulog == NULL || ulog->kdb_state != KDB_STABLE ||
+	ulog->kdb_last_sno == notified_sno)
+	return;
+    notified_sno = ulog->kdb_last_sno;
+
+    store_32_be(IPROP_NOTIFY_MAGIC, buf);
+    store_32_be(notified_sno, buf + 4);
+
+    now = time(NULL);
+    for (i = 0; i < num_notify_slaves; ) {
+	if (now - notify_slaves[i].last_seen > IPROP_NOTIFY_EXPIRE) {
+	    notify_slaves[i] = notify_slaves[--num_notify_slaves];
+	    continue;
+	}
+	DPRINT(("notify_check: notifying slave %d of sno=%lu\n", i,
+		(unsigned long)notified_sno));
+	notify_send(&notify_slaves[i], buf, sizeof(buf));
+	i++;
+    }
+}
+
+/*
+ * Start watching the update log mapped in log_ctx for new serial numbers, so
+ * that slaves can be notified without waiting for their next poll.
+ */
+krb5_error_code
+iprop_notify_init(verto_ctx *ctx, kdb_log_context *log_ctx)
+{
+    struct servent *sp;
+    char *p;
+
+    /*
+     * Notifications go to the UDP port kpropd listens on.  krb5_prop is
+     * usually registered for TCP only, so fall back to IPROP_NOTIFY_PORT.
+     * KPROP_PORT overrides both, as it does for full resyncs.
+     */
+    if ((p = getenv("KPROP_PORT")) != NULL)
+	notify_port = htons(atoi(p));
+    else if ((sp = getservbyname("krb5_prop", "udp")) != NULL)
+	notify_port = sp->s_port;
+    else
+	notify_port = htons(IPROP_NOTIFY_PORT);
+
+    notify_log_ctx = log_ctx;
+    if (log_ctx->ulog != NULL)
+	notified_sno = log_ctx->ulog->kdb_last_sno;
+
+    if (verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, notify_check,
+			  IPROP_NOTIFY_INTERVAL) == NULL)
+	return ENOMEM;
+    notify_enabled = 1;
+    return 0;
+}
+
 kdb_incr_result_t *
 iprop_get_updates_1_svc(kdb_last_t *arg, struct svc_req *rqstp)
 {
@@ -185,6 +368,8 @@ iprop_get_updates_1_svc(kdb_last_t *arg, struct svc_req *rqstp)
 	goto out;
     }
 
+    notify_register(rqstp);
+
     kret = ulog_get_entries(handle->context, *arg, &ret);
 
     if (ret.ret == UPDATE_OK) {
@@ -65,6 +65,10 @@ void log_badauth(OM_uint32 major, OM_uint32 minor,
 void
 krb5_iprop_prog_1(struct svc_req *rqstp, SVCXPRT *transp);
 
+struct _kdb_log_context;
+krb5_error_code
+iprop_notify_init(verto_ctx *ctx, struct _kdb_log_context *log_ctx);
+
 kadm5_ret_t
 kiprop_get_adm_host_srv_name(krb5_context,
                              const char *,
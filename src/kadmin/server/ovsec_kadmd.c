@@ -35,6 +35,7 @@
 #include    <signal.h>
 #include    <syslog.h>
 #include    <sys/types.h>
+#include    <sys/wait.h>
 #ifdef _AIX
 #include    <sys/select.h>
 #endif
@@ -107,7 +108,7 @@ static void usage()
 {
     fprintf(stderr, _("Usage: kadmind [-x db_args]* [-r realm] [-m] [-nofork] "
                       "[-port port-number]\n"
-                      "\t\t[-P pid_file]\n"
+                      "\t\t[-P pid_file] [-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -202,6 +203,173 @@ static krb5_context context;
 static krb5_context hctx;
 
 int nofork = 0;
+static int workers = 0;
+static volatile int signal_received = 0;
+static volatile int sighup_received = 0;
+
+static krb5_sigtype
+on_monitor_signal(int signo)
+{
+    signal_received = signo;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+static krb5_sigtype
+on_monitor_sighup(int signo)
+{
+    sighup_received = 1;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+/*
+ * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
+ * are set to -1, and wait for them to exit (so that we know the ports are no
+ * longer in use).
+ */
+static void
+terminate_workers(pid_t *pids, int bound)
+{
+    int i, status, num_active = 0;
+    pid_t pid;
+
+    for (i = 0; i < bound; i++) {
+        if (pids[i] == -1)
+            continue;
+        kill(pids[i], SIGTERM);
+        num_active++;
+    }
+
+    while (num_active > 0) {
+        pid = wait(&status);
+        if (pid >= 0)
+            num_active--;
+    }
+}
+
+/*
+ * Create num worker processes and return successfully in each child.  The
+ * parent process acts as a supervisor and only returns from this function in
+ * error cases.  Each worker serves RPC and kpasswd requests from the shared
+ * listener sockets independently; the KDB and update log locks serialize
+ * modifications between workers, while read-only requests (get, list, and
+ * iprop update queries) proceed in parallel.
+ */
+static krb5_error_code
+create_workers(verto_ctx *ctx, int num)
+{
+    krb5_error_code ret;
+    int i, status;
+    pid_t pid, *pids;
+#ifdef POSIX_SIGNALS
+    struct sigaction s_action;
+#endif /* POSIX_SIGNALS */
+
+    /*
+     * Set up signal handlers which will forward to the children.  These
+     * handlers will be overridden in the child processes.
+     */
+#ifdef POSIX_SIGNALS
+    (void) sigemptyset(&s_action.sa_mask);
+    s_action.sa_flags = 0;
+    s_action.sa_handler = on_monitor_signal;
+    (void) sigaction(SIGINT, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGTERM, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGQUIT, &s_action, (struct sigaction *) NULL);
+    s_action.sa_handler = on_monitor_sighup;
+    (void) sigaction(SIGHUP, &s_action, (struct sigaction *) NULL);
+#else  /* POSIX_SIGNALS */
+    signal(SIGINT, on_monitor_signal);
+    signal(SIGTERM, on_monitor_signal);
+    signal(SIGQUIT, on_monitor_signal);
+    signal(SIGHUP, on_monitor_sighup);
+#endif /* POSIX_SIGNALS */
+
+    krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), num);
+    pids = calloc(num, sizeof(pid_t));
+    if (pids == NULL)
+        return ENOMEM;
+    for (i = 0; i < num; i++) {
+        pid = fork();
+        if (pid == 0) {
+            free(pids);
+            if (!verto_reinitialize(ctx)) {
+                krb5_klog_syslog(LOG_ERR,
+                                 _("Unable to reinitialize main loop"));
+                return ENOMEM;
+            }
+            ret = loop_setup_signals(ctx, global_server_handle, NULL);
+            if (ret) {
+                krb5_klog_syslog(LOG_ERR, _("Unable to initialize signal "
+                                            "handlers in pid %d"), pid);
+                return ret;
+            }
+
+            /* Avoid race condition */
+            if (signal_received)
+                exit(0);
+
+            /* Return control to main() in the new worker process. */
+            return 0;
+        }
+        if (pid == -1) {
+            /* Couldn't fork enough times. */
+            status = errno;
+            terminate_workers(pids, i);
+            free(pids);
+            return status;
+        }
+        pids[i] = pid;
+    }
+
+    /* We're going to use our own main loop here. */
+    loop_free(ctx);
+
+    /* Supervise the worker processes. */
+    while (!signal_received) {
+        /* Wait until a worker process exits or we get a signal. */
+        pid = wait(&status);
+        if (pid >= 0) {
+            krb5_klog_syslog(LOG_ERR, _("worker %ld exited with status %d"),
+                             (long) pid, status);
+
+            /* Remove the pid from the table. */
+            for (i = 0; i < num; i++) {
+                if (pids[i] == pid)
+                    pids[i] = -1;
+            }
+
+            /* When one worker process exits, terminate them all, so that
+             * kadmind crashes behave similarly with or without workers. */
+            break;
+        }
+
+        /* Propagate HUP signal to worker processes if we received one. */
+        if (sighup_received) {
+            sighup_received = 0;
+            for (i = 0; i < num; i++) {
+                if (pids[i] != -1)
+                    kill(pids[i], SIGHUP);
+            }
+        }
+    }
+    if (signal_received)
+        krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
+                         signal_received);
+
+    terminate_workers(pids, num);
+    free(pids);
+    exit(0);
+}
 
 int main(int argc, char *argv[])
 {
@@ -298,6 +466,13 @@ int main(int argc, char *argv[])
             pid_file = *argv;
         } else if (strcmp(*argv, "-W") == 0) {
             strong_random = 0;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--; argv++;
+            if (!argc)
+                usage();
+            workers = atoi(*argv);
+            if (workers <= 0)
+                usage();
         } else
             break;
         argc--; argv++;
@@ -367,7 +542,9 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    if ((ret = loop_setup_signals(ctx, global_server_handle, NULL))) {
+    /* With worker processes, signal handlers are set up in each worker. */
+    if (workers == 0 &&
+        (ret = loop_setup_signals(ctx, global_server_handle, NULL))) {
         const char *e_txt = krb5_get_error_message (context, ret);
         krb5_klog_syslog(LOG_ERR, _("%s: %s while initializing signal "
                                     "handlers, aborting"), whoami, e_txt);
@@ -392,7 +569,14 @@ int main(int argc, char *argv[])
             : 0)
 #endif
 #undef server_handle
-        || (ret = loop_setup_routing_socket(ctx, global_server_handle, whoami))
+        /*
+         * Worker processes can't re-open the listener sockets, so don't
+         * reconfigure the network in response to routing socket messages
+         * when using them.
+         */
+        || (workers == 0 &&
+            (ret = loop_setup_routing_socket(ctx, global_server_handle,
+                                             whoami)))
         || (ret = loop_setup_network(ctx, global_server_handle, whoami))) {
         const char *e_txt = krb5_get_error_message (context, ret);
         krb5_klog_syslog(LOG_ERR, _("%s: %s while initializing network, "
@@ -560,6 +744,12 @@ kterr:
             exit(1);
         }
 
+        if ((ret = iprop_notify_init(ctx, log_ctx)) != 0) {
+            /* Not fatal; slaves will still find updates by polling. */
+            krb5_klog_syslog(LOG_WARNING,
+                             _("%s while setting up iprop notifications"),
+                             error_message(ret));
+        }
 
         if (nofork)
             fprintf(stderr,
@@ -636,6 +826,21 @@ kterr:
 #endif
     }
 
+    if (workers > 0) {
+        ret = create_workers(ctx, workers);
+        if (ret) {
+            krb5_klog_syslog(LOG_ERR, _("%s while creating worker processes"),
+                             error_message(ret));
+            fprintf(stderr, _("%s: %s while creating worker processes\n"),
+                    whoami, error_message(ret));
+            svcauth_gssapi_unset_names();
+            kadm5_destroy(global_server_handle);
+            krb5_klog_close(context);
+            exit(1);
+        }
+        /* We get here only in a worker child process. */
+    }
+
     krb5_klog_syslog(LOG_INFO, _("starting"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), whoami);
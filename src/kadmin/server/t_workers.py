@@ -0,0 +1,62 @@
+#!/usr/bin/python
+from k5test import *
+import re, subprocess, time
+
+def run_kadmin(query):
+    return realm.run_as_master([kadmin, '-c', realm.ccache, '-q', query])
+
+# Start a kadmin process without waiting for it to finish.
+def start_kadmin(query):
+    return subprocess.Popen([kadmin, '-c', realm.ccache, '-q', query],
+                            stdin=open(os.devnull), stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, env=realm.env_master)
+
+# Run the queries in parallel kadmin processes, and return their outputs
+# after checking that each one succeeded.
+def run_parallel(queries):
+    procs = [(q, start_kadmin(q)) for q in queries]
+    outputs = []
+    for q, proc in procs:
+        out = proc.stdout.read()
+        output(out)
+        if proc.wait() != 0:
+            fail('kadmin -q "%s" failed' % q)
+        outputs.append(out)
+    return outputs
+
+# Return the set of kadmind pids which have logged an RPC request.
+def request_pids():
+    f = open(os.path.join(realm.testdir, 'kadmind5.log'))
+    log = f.read()
+    f.close()
+    return set(re.findall(r'kadmind\[(\d+)\]\(\w+\): Request: ', log))
+
+realm = K5Realm(start_kadmind=False, create_host=False, get_creds=False)
+realm.start_kadmind(['-w', '3'])
+realm.kinit(realm.admin_princ, password('admin'), flags=['-S', 'kadmin/admin'])
+
+# Issue modifications and then queries from concurrent kadmin processes.
+# Modifications are serialized by the database locks, but all of them
+# must still succeed.
+run_parallel(['addprinc -pw pw%d worker%d' % (i, i) for i in range(6)])
+outputs = run_parallel(['getprinc worker%d' % i for i in range(6)] +
+                       ['listprincs worker*'] * 2)
+for i in range(6):
+    if 'Principal: worker%d@' % i not in outputs[i]:
+        fail('getprinc worker%d' % i)
+    for out in outputs[6:]:
+        if ('worker%d@' % i) not in out:
+            fail('principal worker%d missing from listing' % i)
+
+# The workers race to accept connections, so check that more than one of
+# them handled requests, issuing more parallel queries if needed.  The log
+# may be written asynchronously, so give it a moment to catch up.
+for attempt in range(10):
+    if len(request_pids()) > 1:
+        break
+    run_parallel(['getprinc worker%d' % i for i in range(6)])
+    time.sleep(0.5)
+else:
+    fail('Requests were not handled by more than one worker process')
+
+success('kadmind worker processes')
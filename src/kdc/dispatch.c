@@ -41,6 +41,7 @@ struct dispatch_state {
     void *arg;
     krb5_data *request;
     int is_tcp;
+    struct kdc_timer timer;
 };
 
 static void
@@ -49,6 +50,7 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
 {
     loop_respond_fn oldrespond = state->respond;
     void *oldarg = state->arg;
+    struct kdc_timer timer;
 
     if (state->is_tcp == 0 && response &&
         response->length > (unsigned int)max_dgram_reply_size) {
@@ -61,8 +63,14 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
                              error_message(code));
     }
 
+    kdc_timer_mark(&state->timer, KDC_PHASE_OTHER);
+    timer = state->timer;
+    if (timer.errcode == 0)
+        timer.errcode = code;
     free(state);
     (*oldrespond)(oldarg, code, response);
+    kdc_timer_mark(&timer, KDC_PHASE_SEND);
+    kdc_stats_record(&timer);
 }
 
 static void
@@ -104,6 +112,8 @@ dispatch(void *cb, struct sockaddr *local_saddr,
     state->arg = arg;
     state->request = pkt;
     state->is_tcp = is_tcp;
+    kdc_timer_start(&state->timer, krb5_is_tgs_req(pkt) ? KDC_REQ_TGS :
+                    krb5_is_as_req(pkt) ? KDC_REQ_AS : KDC_REQ_OTHER);
 
     /* decode incoming packet, and dispatch */
 
@@ -156,10 +166,11 @@ dispatch(void *cb, struct sockaddr *local_saddr,
                                   KRB5_C_RANDSOURCE_TIMING, &data);
         last_usec = now_usec;
     }
+    kdc_timer_mark(&state->timer, KDC_PHASE_OTHER);
     /* try TGS_REQ first; they are more common! */
 
     if (krb5_is_tgs_req(pkt)) {
-        retval = process_tgs_req(pkt, from, &response);
+        retval = process_tgs_req(pkt, from, &state->timer, &response);
     } else if (krb5_is_as_req(pkt)) {
         if (!(retval = decode_krb5_as_req(pkt, &as_req))) {
             /*
@@ -168,8 +179,10 @@ dispatch(void *cb, struct sockaddr *local_saddr,
              * process_as_req frees the request if it is called
              */
             if (!(retval = setup_server_realm(as_req->server))) {
-                process_as_req(as_req, pkt, from, vctx, finish_dispatch_cache,
-                               state);
+                state->timer.realm = kdc_active_realm;
+                kdc_timer_mark(&state->timer, KDC_PHASE_DECODE);
+                process_as_req(as_req, pkt, from, &state->timer, vctx,
+                               finish_dispatch_cache, state);
                 return;
             }
             else
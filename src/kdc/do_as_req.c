@@ -106,6 +106,7 @@ struct as_req_state {
     krb5_enc_tkt_part enc_tkt_reply;
     krb5_enc_kdc_rep_part reply_encpart;
     krb5_ticket ticket_reply;
+    krb5_key ticket_key;
     krb5_keyblock server_keyblock;
     krb5_keyblock client_keyblock;
     krb5_db_entry *client;
@@ -126,6 +127,7 @@ struct as_req_state {
     char *sname, *cname;
     void *pa_context;
     const krb5_fulladdr *from;
+    struct kdc_timer *timer;
 
     krb5_error_code preauth_err;
 };
@@ -178,10 +180,14 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
      *
      *  server_keyblock is later used to generate auth data signatures
      */
-    if ((errcode = krb5_dbe_decrypt_key_data(kdc_context, NULL,
-                                             server_key,
-                                             &state->server_keyblock,
-                                             NULL))) {
+    if ((errcode = kdc_get_entry_key(state->server, server_key,
+                                     &state->ticket_key))) {
+        state->status = "DECRYPT_SERVER_KEY";
+        goto egress;
+    }
+    if ((errcode = krb5_copy_keyblock_contents(kdc_context,
+                                               &state->ticket_key->keyblock,
+                                               &state->server_keyblock))) {
         state->status = "DECRYPT_SERVER_KEY";
         goto egress;
     }
@@ -218,6 +224,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         goto egress;
     }
     state->client_keyblock.enctype = useenctype;
+    kdc_timer_mark(state->timer, KDC_PHASE_DB);
 
     /* Start assembling the response */
     state->reply.msg_type = KRB5_AS_REP;
@@ -253,6 +260,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         state->status = "KDC_RETURN_PADATA";
         goto egress;
     }
+    kdc_timer_mark(state->timer, KDC_PHASE_PREAUTH);
 
 #if APPLE_PKINIT
     asReqDebug("process_as_req reply realm %s name %s\n",
@@ -280,13 +288,15 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         state->status = "HANDLE_AUTHDATA";
         goto egress;
     }
+    kdc_timer_mark(state->timer, KDC_PHASE_AUTHDATA);
 
-    errcode = krb5_encrypt_tkt_part(kdc_context, &state->server_keyblock,
-                                    &state->ticket_reply);
+    errcode = krb5_encrypt_tkt_part_k(kdc_context, state->ticket_key,
+                                      &state->ticket_reply);
     if (errcode) {
         state->status = "ENCRYPTING_TICKET";
         goto egress;
     }
+    kdc_timer_mark(state->timer, KDC_PHASE_ENCRYPT);
     state->ticket_reply.enc_part.kvno = server_key->key_data_kvno;
     errcode = kdc_fast_response_handle_padata(state->rstate,
                                               state->request,
@@ -330,6 +340,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
     memset(state->reply.enc_part.ciphertext.data, 0,
            state->reply.enc_part.ciphertext.length);
     free(state->reply.enc_part.ciphertext.data);
+    kdc_timer_mark(state->timer, KDC_PHASE_ENCODE);
 
     log_as_req(state->from, state->request, &state->reply,
                state->client, state->cname, state->server,
@@ -339,6 +350,8 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
 egress:
     if (errcode != 0)
         assert (state->status != 0);
+    state->timer->errcode = errcode;
+    kdc_timer_mark(state->timer, KDC_PHASE_OTHER);
     free_padata_context(kdc_context, state->pa_context);
     if (as_encrypting_key)
         krb5_free_keyblock(kdc_context, as_encrypting_key);
@@ -369,12 +382,14 @@ egress:
             state->status = 0;
         }
     }
+    kdc_timer_mark(state->timer, KDC_PHASE_ENCODE);
 
     if (emsg)
         krb5_free_error_message(kdc_context, emsg);
     if (state->enc_tkt_reply.authorization_data != NULL)
         krb5_free_authdata(kdc_context,
                            state->enc_tkt_reply.authorization_data);
+    krb5_k_free_key(kdc_context, state->ticket_key);
     if (state->server_keyblock.contents != NULL)
         krb5_free_keyblock_contents(kdc_context, &state->server_keyblock);
     if (state->client_keyblock.contents != NULL)
@@ -413,6 +428,7 @@ finish_missing_required_preauth(void *arg)
 {
     struct as_req_state *state = (struct as_req_state *)arg;
 
+    kdc_timer_mark(state->timer, KDC_PHASE_PREAUTH);
     finish_process_as_req(state, state->preauth_err);
 }
 
@@ -422,6 +438,7 @@ finish_preauth(void *arg, krb5_error_code code)
     struct as_req_state *state = arg;
     krb5_error_code real_code = code;
 
+    kdc_timer_mark(state->timer, KDC_PHASE_PREAUTH);
     if (code) {
         if (vague_errors)
             code = KRB5KRB_ERR_GENERIC;
@@ -454,8 +471,8 @@ finish_preauth(void *arg, krb5_error_code code)
 /*ARGSUSED*/
 void
 process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
-               const krb5_fulladdr *from, verto_ctx *vctx,
-               loop_respond_fn respond, void *arg)
+               const krb5_fulladdr *from, struct kdc_timer *timer,
+               verto_ctx *vctx, loop_respond_fn respond, void *arg)
 {
     krb5_error_code errcode;
     krb5_timestamp rtime;
@@ -474,6 +491,7 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
     state->request = request;
     state->req_pkt = req_pkt;
     state->from = from;
+    state->timer = timer;
 
 #if APPLE_PKINIT
     asReqDebug("process_as_req top realm %s name %s\n",
@@ -539,6 +557,7 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         goto errout;
     }
     limit_string(state->sname);
+    kdc_timer_mark(state->timer, KDC_PHASE_DECODE);
 
     /*
      * We set KRB5_KDB_FLAG_CLIENT_REFERRALS_ONLY as a hint
@@ -611,6 +630,7 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         state->status = "LOOKING_UP_SERVER";
         goto errout;
     }
+    kdc_timer_mark(state->timer, KDC_PHASE_DB);
 
     if ((errcode = krb5_timeofday(kdc_context, &state->kdc_time))) {
         state->status = "TIMEOFDAY";
@@ -762,6 +782,8 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         setflag(state->client->attributes, KRB5_KDB_REQUIRES_PRE_AUTH);
     }
 
+    kdc_timer_mark(state->timer, KDC_PHASE_OTHER);
+
     /*
      * Check the preauthentication if it is there.
      */
@@ -69,7 +69,10 @@
 #include <ctype.h>
 
 static krb5_error_code
-find_alternate_tgs(krb5_kdc_req *,krb5_db_entry **);
+find_alternate_tgs(krb5_kdc_req *,krb5_db_entry **,krb5_principal *);
+
+static void
+free_request_attachments(krb5_kdc_req *);
 
 static krb5_error_code
 prepare_error_tgs(struct kdc_request_state *, krb5_kdc_req *,krb5_ticket *,int,
@@ -81,7 +84,7 @@ prep_reprocess_req(krb5_kdc_req *,krb5_principal *);
 /*ARGSUSED*/
 krb5_error_code
 process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
-                krb5_data **response)
+                struct kdc_timer *timer, krb5_data **response)
 {
     krb5_keyblock * subkey = 0;
     krb5_keyblock * tgskey = 0;
@@ -96,6 +99,7 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
     int newtransited = 0;
     krb5_error_code retval = 0;
     krb5_keyblock encrypting_key;
+    krb5_key ticket_key = NULL;
     krb5_timestamp kdc_time, authtime = 0;
     krb5_keyblock session_key;
     krb5_timestamp rtime;
@@ -118,9 +122,11 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
     krb5_boolean is_referral, db_ref_done = FALSE;
     const char *emsg = NULL;
     krb5_data *tgs_1 =NULL, *server_1 = NULL;
-    krb5_principal krbtgt_princ;
+    krb5_principal krbtgt_princ, tmpprinc;
+    krb5_principal server_copy = NULL; /* replacement for request->server */
     krb5_kvno ticket_kvno = 0;
     struct kdc_request_state *state = NULL;
+    k5_asn1_arena *arena = NULL;
     krb5_pa_data *pa_tgs_req; /*points into request*/
     krb5_data scratch;
     krb5_pa_data **e_data = NULL;
@@ -131,11 +137,21 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
 
     session_key.contents = NULL;
 
-    retval = decode_krb5_tgs_req(pkt, &request);
+    /*
+     * The request and everything decoded from it live in an arena which is
+     * released once the reply has been made.  Strings in the request point
+     * into pkt, which outlives this function.
+     */
+    retval = k5_asn1_arena_create(&arena);
     if (retval)
         return retval;
+    retval = decode_krb5_tgs_req_arena(arena, pkt, &request);
+    if (retval) {
+        k5_asn1_arena_free(arena);
+        return retval;
+    }
     if (request->msg_type != KRB5_TGS_REQ) {
-        krb5_free_kdc_req(kdc_context, request);
+        k5_asn1_arena_free(arena);
         return KRB5_BADMSGTYPE;
     }
 
@@ -143,11 +159,14 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
      * setup_server_realm() sets up the global realm-specific data pointer.
      */
     if ((retval = setup_server_realm(request->server))) {
-        krb5_free_kdc_req(kdc_context, request);
+        k5_asn1_arena_free(arena);
         return retval;
     }
-    errcode = kdc_process_tgs_req(request, from, pkt, &header_ticket,
+    timer->realm = kdc_active_realm;
+    kdc_timer_mark(timer, KDC_PHASE_DECODE);
+    errcode = kdc_process_tgs_req(request, arena, from, pkt, &header_ticket,
                                   &krbtgt, &tgskey, &subkey, &pa_tgs_req);
+    kdc_timer_mark(timer, KDC_PHASE_PREAUTH);
     if (header_ticket && header_ticket->enc_part2 &&
         (errcode2 = krb5_unparse_name(kdc_context,
                                       header_ticket->enc_part2->client,
@@ -173,6 +192,7 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
         status = "making state";
         goto cleanup;
     }
+    state->arena = arena;
     scratch.length = pa_tgs_req->length;
     scratch.data = (char *) pa_tgs_req->contents;
     errcode = kdc_find_fast(&request, &scratch, subkey,
@@ -181,6 +201,7 @@ process_tgs_req(krb5_data *pkt, const krb5_fulladdr *from,
         status = "kdc_find_fast";
         goto cleanup;
     }
+    kdc_timer_mark(timer, KDC_PHASE_DECODE);
 
     /*
      * Pointer to the encrypted part of the header ticket, which may be
@@ -236,10 +257,14 @@ tgt_again:
                     tgs_1 = krb5_princ_component(kdc_context, tgs_server, 1);
 
                     if (!tgs_1 || !data_eq(*server_1, *tgs_1)) {
-                        errcode = find_alternate_tgs(request, &server);
+                        errcode = find_alternate_tgs(request, &server,
+                                                     &tmpprinc);
                         firstpass = 0;
-                        if (errcode == 0)
+                        if (errcode == 0) {
+                            krb5_free_principal(kdc_context, server_copy);
+                            request->server = server_copy = tmpprinc;
                             goto tgt_again;
+                        }
                     }
                 }
                 status = "UNKNOWN_SERVER";
@@ -249,10 +274,11 @@ tgt_again:
             } else if ( db_ref_done == FALSE) {
                 retval = prep_reprocess_req(request, &krbtgt_princ);
                 if (!retval) {
-                    krb5_free_principal(kdc_context, request->server);
                     retval = krb5_copy_principal(kdc_context, krbtgt_princ,
-                                                 &(request->server));
+                                                 &tmpprinc);
                     if (!retval) {
+                        krb5_free_principal(kdc_context, server_copy);
+                        request->server = server_copy = tmpprinc;
                         db_ref_done = TRUE;
                         if (sname != NULL)
                             free(sname);
@@ -266,6 +292,7 @@ tgt_again:
         errcode = KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN;
         goto cleanup;
     }
+    kdc_timer_mark(timer, KDC_PHASE_DB);
 
     if ((errcode = krb5_timeofday(kdc_context, &kdc_time))) {
         status = "TIME_OF_DAY";
@@ -603,10 +630,16 @@ tgt_again:
         status = "UNPARSING S4U CLIENT";
         goto cleanup;
     }
+    kdc_timer_mark(timer, KDC_PHASE_OTHER);
 
     if (isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY)) {
         krb5_enc_tkt_part *t2enc = request->second_ticket[st_idx]->enc_part2;
         encrypting_key = *(t2enc->session);
+        if ((errcode = krb5_k_create_key(kdc_context, t2enc->session,
+                                         &ticket_key))) {
+            status = "CREATE_TICKET_KEY";
+            goto cleanup;
+        }
     } else {
         /*
          * Find the server key
@@ -622,11 +655,16 @@ tgt_again:
 
         /*
          * Convert server.key into a real key
-         * (it may be encrypted in the database)
+         * (it may be encrypted in the database, or cached if it is a krbtgt
+         * key)
          */
-        if ((errcode = krb5_dbe_decrypt_key_data(kdc_context, NULL,
-                                                 server_key, &encrypting_key,
-                                                 NULL))) {
+        if ((errcode = kdc_get_entry_key(server, server_key, &ticket_key))) {
+            status = "DECRYPT_SERVER_KEY";
+            goto cleanup;
+        }
+        if ((errcode = krb5_copy_keyblock_contents(kdc_context,
+                                                   &ticket_key->keyblock,
+                                                   &encrypting_key))) {
             status = "DECRYPT_SERVER_KEY";
             goto cleanup;
         }
@@ -671,6 +709,7 @@ tgt_again:
     enc_tkt_reply.session = &session_key;
     enc_tkt_reply.transited.tr_type = KRB5_DOMAIN_X500_COMPRESS;
     enc_tkt_reply.transited.tr_contents = empty_string; /* equivalent of "" */
+    kdc_timer_mark(timer, KDC_PHASE_DB);
 
     errcode = handle_authdata(kdc_context, c_flags, client, server, krbtgt,
                               subkey != NULL ? subkey :
@@ -689,6 +728,7 @@ tgt_again:
         status = "HANDLE_AUTHDATA";
         goto cleanup;
     }
+    kdc_timer_mark(timer, KDC_PHASE_AUTHDATA);
 
 
     /*
@@ -810,14 +850,15 @@ tgt_again:
         ticket_kvno = server_key->key_data_kvno;
     }
 
-    errcode = krb5_encrypt_tkt_part(kdc_context, &encrypting_key,
-                                    &ticket_reply);
+    kdc_timer_mark(timer, KDC_PHASE_OTHER);
+    errcode = krb5_encrypt_tkt_part_k(kdc_context, ticket_key, &ticket_reply);
     if (!isflagset(request->kdc_options, KDC_OPT_ENC_TKT_IN_SKEY))
         krb5_free_keyblock_contents(kdc_context, &encrypting_key);
     if (errcode) {
         status = "TKT_ENCRYPT";
         goto cleanup;
     }
+    kdc_timer_mark(timer, KDC_PHASE_ENCRYPT);
     ticket_reply.enc_part.kvno = ticket_kvno;
     /* Start assembling the response */
     reply.msg_type = KRB5_TGS_REP;
@@ -903,15 +944,18 @@ tgt_again:
     memset(reply.enc_part.ciphertext.data, 0,
            reply.enc_part.ciphertext.length);
     free(reply.enc_part.ciphertext.data);
+    kdc_timer_mark(timer, KDC_PHASE_ENCODE);
 
 cleanup:
     assert(status != NULL);
+    timer->errcode = errcode;
     if (reply_key)
         krb5_free_keyblock(kdc_context, reply_key);
     if (errcode)
         emsg = krb5_get_error_message (kdc_context, errcode);
     log_tgs_req(from, request, &reply, cname, sname, altcname, authtime,
                 c_flags, s4u_name, status, errcode, emsg);
+    kdc_timer_mark(timer, KDC_PHASE_OTHER);
     if (errcode) {
         krb5_free_error_message (kdc_context, emsg);
         emsg = NULL;
@@ -935,13 +979,16 @@ cleanup:
             status = 0;
         }
     }
+    kdc_timer_mark(timer, KDC_PHASE_ENCODE);
 
     if (header_ticket != NULL)
         krb5_free_ticket(kdc_context, header_ticket);
     if (request != NULL)
-        krb5_free_kdc_req(kdc_context, request);
+        free_request_attachments(request);
+    krb5_free_principal(kdc_context, server_copy);
     if (state)
         kdc_free_rstate(state);
+    k5_asn1_arena_free(arena);
     if (cname != NULL)
         free(cname);
     if (sname != NULL)
@@ -963,6 +1010,7 @@ cleanup:
         krb5_free_keyblock(kdc_context, subkey);
     if (tgskey != NULL)
         krb5_free_keyblock(kdc_context, tgskey);
+    krb5_k_free_key(kdc_context, ticket_key);
     if (reply.padata)
         krb5_free_pa_data(kdc_context, reply.padata);
     if (reply_encpart.enc_padata)
@@ -1047,7 +1095,8 @@ prepare_error_tgs (struct kdc_request_state *state,
  * some intermediate realm.
  */
 static krb5_error_code
-find_alternate_tgs(krb5_kdc_req *request, krb5_db_entry **server_ptr)
+find_alternate_tgs(krb5_kdc_req *request, krb5_db_entry **server_ptr,
+                   krb5_principal *princ_out)
 {
     krb5_error_code retval;
     krb5_principal *plist = NULL, *pl2, tmpprinc;
@@ -1055,6 +1104,7 @@ find_alternate_tgs(krb5_kdc_req *request, krb5_db_entry **server_ptr)
     krb5_db_entry *server = NULL;
 
     *server_ptr = NULL;
+    *princ_out = NULL;
 
     /*
      * Call to krb5_princ_component is normally not safe but is so
@@ -1093,9 +1143,8 @@ find_alternate_tgs(krb5_kdc_req *request, krb5_db_entry **server_ptr)
             goto cleanup;
         krb5_princ_set_realm(kdc_context, *pl2, &tmp);
 
-        krb5_free_principal(kdc_context, request->server);
-        request->server = tmpprinc;
-        log_tgs_alt_tgt(request->server);
+        log_tgs_alt_tgt(tmpprinc);
+        *princ_out = tmpprinc;
         *server_ptr = server;
         server = NULL;
         goto cleanup;
@@ -1108,6 +1157,24 @@ cleanup:
     return retval;
 }
 
+/*
+ * Free the objects which TGS processing attaches to the request: the
+ * decrypted parts of second tickets and the decoded unencrypted authorization
+ * data.  The rest of the request belongs to its arena.
+ */
+static void
+free_request_attachments(krb5_kdc_req *request)
+{
+    krb5_ticket **tkt;
+
+    for (tkt = request->second_ticket; tkt != NULL && *tkt != NULL; tkt++) {
+        krb5_free_enc_tkt_part(kdc_context, (*tkt)->enc_part2);
+        (*tkt)->enc_part2 = NULL;
+    }
+    krb5_free_authdata(kdc_context, request->unenc_authdata);
+    request->unenc_authdata = NULL;
+}
+
 static krb5_int32
 prep_reprocess_req(krb5_kdc_req *request, krb5_principal *krbtgt_princ)
 {
@@ -1141,7 +1208,7 @@ prep_reprocess_req(krb5_kdc_req *request, krb5_principal *krbtgt_princ)
             retval = ENOMEM;
             goto cleanup;
         }
-        strlcpy(comp1_str,comp1->data,comp1->length+1);
+        memcpy(comp1_str, comp1->data, comp1->length);
 
         if ((krb5_princ_type(kdc_context, request->server) == KRB5_NT_SRV_HST ||
              krb5_princ_type(kdc_context, request->server) == KRB5_NT_SRV_INST ||
@@ -1164,7 +1231,7 @@ prep_reprocess_req(krb5_kdc_req *request, krb5_principal *krbtgt_princ)
                 retval = ENOMEM;
                 goto cleanup;
             }
-            strlcpy(temp_buf, comp2->data,comp2->length+1);
+            memcpy(temp_buf, comp2->data, comp2->length);
             retval = krb5int_get_domain_realm_mapping(kdc_context, temp_buf, &realms);
             free(temp_buf);
             if (retval) {
@@ -70,6 +70,14 @@ typedef struct __kdc_realm_data {
     krb5_deltat         realm_maxrlife; /* Maximum renewable life for realm */
     krb5_boolean        realm_reject_bad_transit; /* Accept unverifiable transited_realm ? */
     krb5_boolean        realm_restrict_anon;  /* Anon to local TGT only */
+    /*
+     * Request latency statistics (see kdc_stats.c).
+     */
+    struct kdc_stats    *realm_stats;   /* Allocated on first request       */
+    /*
+     * Key objects for krbtgt principals (see kdc_keys.c).
+     */
+    struct tgs_key      *realm_tgs_keys;
 } kdc_realm_t;
 
 extern kdc_realm_t      **kdc_realmlist;
@@ -185,16 +185,28 @@ kdc_find_fast(krb5_kdc_req **requestptr,
         if (retval == 0) {
             krb5_data plaintext;
             plaintext.length = fast_armored_req->enc_part.ciphertext.length;
-            plaintext.data = malloc(plaintext.length);
+            /* If the outer request came from an arena, decode the inner one
+             * into it too, keeping the plaintext which it points into. */
+            if (state->arena != NULL) {
+                plaintext.data = k5_asn1_arena_alloc(state->arena,
+                                                     plaintext.length);
+            } else {
+                plaintext.data = malloc(plaintext.length);
+            }
             if (plaintext.data == NULL)
                 retval = ENOMEM;
-            retval = krb5_c_decrypt(kdc_context,
-                                    state->armor_key,
-                                    KRB5_KEYUSAGE_FAST_ENC, NULL,
-                                    &fast_armored_req->enc_part,
-                                    &plaintext);
-            if (retval == 0)
+            else
+                retval = krb5_c_decrypt(kdc_context,
+                                        state->armor_key,
+                                        KRB5_KEYUSAGE_FAST_ENC, NULL,
+                                        &fast_armored_req->enc_part,
+                                        &plaintext);
+            if (retval == 0 && state->arena != NULL) {
+                retval = decode_krb5_fast_req_arena(state->arena, &plaintext,
+                                                    &fast_req);
+            } else if (retval == 0) {
                 retval = decode_krb5_fast_req(&plaintext, &fast_req);
+            }
             if (retval == 0 && inner_body_out != NULL) {
                 retval = fetch_asn1_field((unsigned char *)plaintext.data,
                                           1, 2, &scratch);
@@ -203,7 +215,7 @@ kdc_find_fast(krb5_kdc_req **requestptr,
                                             &inner_body);
                 }
             }
-            if (plaintext.data)
+            if (state->arena == NULL)
                 free(plaintext.data);
         }
         cksum = &fast_armored_req->req_checksum;
@@ -234,7 +246,8 @@ kdc_find_fast(krb5_kdc_req **requestptr,
                                          KRB5_PADATA_FX_COOKIE);
         if (retval == 0) {
             state->fast_options = fast_req->fast_options;
-            krb5_free_kdc_req( kdc_context, request);
+            if (state->arena == NULL)
+                krb5_free_kdc_req( kdc_context, request);
             *requestptr = fast_req->req_body;
             fast_req->req_body = NULL;
         }
@@ -263,7 +276,7 @@ kdc_find_fast(krb5_kdc_req **requestptr,
         inner_body = NULL;
     }
     krb5_free_data(kdc_context, inner_body);
-    if (fast_req)
+    if (fast_req && state->arena == NULL)
         krb5_free_fast_req( kdc_context, fast_req);
     if (fast_armored_req)
         krb5_free_fast_armored_req(kdc_context, fast_armored_req);
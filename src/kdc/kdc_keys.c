@@ -0,0 +1,222 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/kdc_keys.c - Cached TGS key objects */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+
+/*
+ * Nearly every TGS request decrypts a ticket with a krbtgt key, and many
+ * issue a ticket encrypted in one.  Decrypting the key from the database and
+ * making a key object from it for each request repeats the master key
+ * decryption, the key derivations and the cipher's key setup every time.
+ * Instead, the KDC keeps the key objects it makes for krbtgt principals (local
+ * and cross-realm) in a list for each realm and gives each request a
+ * reference to one.  The local TGS key is loaded, and its ticket encryption
+ * keys derived, when the realm is set up, before any worker processes are
+ * forked.
+ *
+ * A cached key remembers the encrypted key data it came from, so a key which
+ * has been changed in the database without a kvno change is replaced.  Keys
+ * for old kvnos stay in the list, since tickets issued under them may still be
+ * presented, until they fall off the end of it.
+ */
+
+#include "k5-int.h"
+#include "kdc_util.h"
+#include "extern.h"
+
+#define MAX_TGS_KEYS 64
+
+struct tgs_key {
+    struct tgs_key *next;
+    krb5_principal princ;
+    krb5_int16 kvno;
+    krb5_data contents;         /* Encrypted key data from the database */
+    krb5_key key;
+};
+
+static void
+free_tgs_key(krb5_context context, struct tgs_key *tk)
+{
+    krb5_free_principal(context, tk->princ);
+    free(tk->contents.data);
+    krb5_k_free_key(context, tk->key);
+    free(tk);
+}
+
+static krb5_boolean
+key_data_matches(struct tgs_key *tk, krb5_key_data *kd)
+{
+    return tk->kvno == kd->key_data_kvno &&
+        tk->contents.length == (unsigned int)kd->key_data_length[0] &&
+        memcmp(tk->contents.data, kd->key_data_contents[0],
+               tk->contents.length) == 0;
+}
+
+/* Make a key object from kd, a key of entry, and add it to realm's list. */
+static krb5_error_code
+add_tgs_key(kdc_realm_t *realm, krb5_db_entry *entry, krb5_key_data *kd,
+            krb5_key *key_out)
+{
+    krb5_context context = realm->realm_context;
+    krb5_error_code ret;
+    krb5_keyblock keyblock;
+    struct tgs_key *tk, **tkp;
+    int count;
+
+    *key_out = NULL;
+    tk = k5alloc(sizeof(*tk), &ret);
+    if (tk == NULL)
+        return ret;
+    ret = krb5_copy_principal(context, entry->princ, &tk->princ);
+    if (ret)
+        goto cleanup;
+    tk->kvno = kd->key_data_kvno;
+    tk->contents.length = kd->key_data_length[0];
+    tk->contents.data = k5alloc(tk->contents.length, &ret);
+    if (tk->contents.data == NULL)
+        goto cleanup;
+    memcpy(tk->contents.data, kd->key_data_contents[0], tk->contents.length);
+    ret = krb5_dbe_decrypt_key_data(context, NULL, kd, &keyblock, NULL);
+    if (ret)
+        goto cleanup;
+    ret = krb5_k_create_key(context, &keyblock, &tk->key);
+    krb5_free_keyblock_contents(context, &keyblock);
+    if (ret)
+        goto cleanup;
+
+    /* Put the new key first and drop the last one if the list is full. */
+    tk->next = realm->realm_tgs_keys;
+    realm->realm_tgs_keys = tk;
+    for (count = 0, tkp = &realm->realm_tgs_keys; *tkp != NULL;
+         tkp = &(*tkp)->next, count++) {
+        if (count == MAX_TGS_KEYS) {
+            free_tgs_key(context, *tkp);
+            *tkp = NULL;
+            break;
+        }
+    }
+
+    krb5_k_reference_key(context, tk->key);
+    *key_out = tk->key;
+    return 0;
+
+cleanup:
+    free_tgs_key(context, tk);
+    return ret;
+}
+
+/* Get a key object for the key data kd from entry, using the active realm's
+ * cache if entry is a krbtgt principal. */
+krb5_error_code
+kdc_get_entry_key(krb5_db_entry *entry, krb5_key_data *kd, krb5_key *key_out)
+{
+    krb5_error_code ret;
+    krb5_keyblock keyblock;
+    struct tgs_key *tk, **tkp;
+
+    *key_out = NULL;
+    if (!krb5_is_tgs_principal(entry->princ)) {
+        ret = krb5_dbe_decrypt_key_data(kdc_context, NULL, kd, &keyblock,
+                                        NULL);
+        if (ret)
+            return ret;
+        ret = krb5_k_create_key(kdc_context, &keyblock, key_out);
+        krb5_free_keyblock_contents(kdc_context, &keyblock);
+        return ret;
+    }
+
+    for (tkp = &kdc_active_realm->realm_tgs_keys; *tkp != NULL;
+         tkp = &(*tkp)->next) {
+        tk = *tkp;
+        if (tk->kvno != kd->key_data_kvno ||
+            krb5_k_key_enctype(kdc_context, tk->key) != kd->key_data_type[0] ||
+            !krb5_principal_compare(kdc_context, tk->princ, entry->princ))
+            continue;
+        if (!key_data_matches(tk, kd)) {
+            /* The key changed without a kvno change; replace it. */
+            *tkp = tk->next;
+            free_tgs_key(kdc_context, tk);
+            break;
+        }
+        /* Move the entry to the front of the list. */
+        *tkp = tk->next;
+        tk->next = kdc_active_realm->realm_tgs_keys;
+        kdc_active_realm->realm_tgs_keys = tk;
+        krb5_k_reference_key(kdc_context, tk->key);
+        *key_out = tk->key;
+        return 0;
+    }
+
+    return add_tgs_key(kdc_active_realm, entry, kd, key_out);
+}
+
+/*
+ * Load the current key of realm's TGS principal into its cache, and compute
+ * the keys derived from it for ticket encryption by encrypting an empty
+ * message.  Failures are not fatal; the key will be loaded on first use.
+ */
+void
+kdc_load_tgs_keys(kdc_realm_t *realm)
+{
+    krb5_context context = realm->realm_context;
+    krb5_db_entry *entry = NULL;
+    krb5_key_data *kd;
+    krb5_key key = NULL;
+    krb5_data empty = empty_data();
+    krb5_enc_data enc;
+    size_t len;
+
+    memset(&enc, 0, sizeof(enc));
+    if (krb5_db_get_principal(context, realm->realm_tgsprinc, 0, &entry) != 0)
+        return;
+    if (krb5_dbe_find_enctype(context, entry, -1, -1, 0, &kd) != 0)
+        goto cleanup;
+    if (add_tgs_key(realm, entry, kd, &key) != 0)
+        goto cleanup;
+    if (krb5_c_encrypt_length(context, krb5_k_key_enctype(context, key), 0,
+                              &len) != 0 ||
+        alloc_data(&enc.ciphertext, len) != 0)
+        goto cleanup;
+    (void)krb5_k_encrypt(context, key, KRB5_KEYUSAGE_KDC_REP_TICKET, NULL,
+                         &empty, &enc);
+
+cleanup:
+    free(enc.ciphertext.data);
+    krb5_k_free_key(context, key);
+    krb5_db_free_principal(context, entry);
+}
+
+/* Free the keys cached for realm. */
+void
+kdc_free_tgs_keys(kdc_realm_t *realm)
+{
+    struct tgs_key *tk, *next;
+
+    for (tk = realm->realm_tgs_keys; tk != NULL; tk = next) {
+        next = tk->next;
+        free_tgs_key(realm->realm_context, tk);
+    }
+    realm->realm_tgs_keys = NULL;
+}
@@ -0,0 +1,390 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/kdc_offload.c - Helper threads for blocking preauth work */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * The KDC processes requests on a single thread, so a preauth module which
+ * waits on an external server (an OTP or RADIUS server, for instance) delays
+ * every other request behind it.  Modules can instead hand blocking work to
+ * the offload callback, which runs it on one of kdc_preauth_threads helper
+ * threads with a krb5 context belonging to that thread.  The job's done
+ * function then runs on the KDC's thread, from the event loop, which is woken
+ * through a pipe.
+ *
+ * The threads are started when the first job is submitted, so that they are
+ * created in the process which will use them if the KDC forks workers.  If
+ * the KDC is built without thread support, is configured with no helper
+ * threads, or cannot start them, jobs run synchronously.
+ *
+ * At shutdown, idle threads exit at once, but a thread cannot be interrupted
+ * while a work function runs.  The KDC waits up to OFFLOAD_SHUTDOWN_WAIT
+ * seconds for running work functions to return, and then exits without
+ * waiting for the rest.
+ */
+
+#include "k5-int.h"
+#include <syslog.h>
+#include "kdc_util.h"
+#include "extern.h"
+#include "adm_proto.h"
+
+#define DEFAULT_OFFLOAD_THREADS 4
+#define OFFLOAD_SHUTDOWN_WAIT 5
+
+static int pool_size = DEFAULT_OFFLOAD_THREADS;
+
+/* Run job synchronously, for when there are no helper threads. */
+static void
+run_inline(krb5_context context, kdc_offload_fn work, kdc_offload_fn done,
+           void *arg)
+{
+    work(context, arg);
+    done(context, arg);
+}
+
+#ifdef ENABLE_THREADS
+
+#include <pthread.h>
+
+struct offload_job {
+    struct offload_job *next;
+    krb5_context context;       /* Submitter's context, for done */
+    kdc_offload_fn work;
+    kdc_offload_fn done;
+    void *arg;
+};
+
+struct job_queue {
+    struct offload_job *head;
+    struct offload_job *tail;
+};
+
+/* pool_lock protects the queues, pool_busy, and pool_shutdown.  pool_cond
+ * signals new jobs or shutdown to workers; idle_cond signals the shutdown
+ * code that a worker has finished its job. */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static struct job_queue pending, finished;
+static int pool_busy;
+static int pool_shutdown;
+
+/* These are only used by the KDC's thread. */
+static int pool_nthreads;
+static pthread_t *pool_threads;
+static krb5_context *pool_contexts;
+static int wake_fds[2] = { -1, -1 };
+static verto_ev *wake_ev;
+
+static void
+enqueue(struct job_queue *q, struct offload_job *job)
+{
+    job->next = NULL;
+    if (q->tail == NULL)
+        q->head = job;
+    else
+        q->tail->next = job;
+    q->tail = job;
+}
+
+static struct offload_job *
+dequeue(struct job_queue *q)
+{
+    struct offload_job *job = q->head;
+
+    if (job != NULL) {
+        q->head = job->next;
+        if (q->head == NULL)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+/* Free the jobs in q without running them. */
+static void
+discard(struct job_queue *q)
+{
+    struct offload_job *job;
+
+    while ((job = dequeue(q)) != NULL)
+        free(job);
+}
+
+static void *
+worker(void *ptr)
+{
+    krb5_context context = ptr;
+    struct offload_job *job;
+    ssize_t st;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pending.head == NULL && !pool_shutdown)
+            pthread_cond_wait(&pool_cond, &pool_lock);
+        if (pool_shutdown)
+            break;
+        job = dequeue(&pending);
+        pool_busy++;
+        pthread_mutex_unlock(&pool_lock);
+
+        krb5_clear_error_message(context);
+        job->work(context, job->arg);
+
+        pthread_mutex_lock(&pool_lock);
+        pool_busy--;
+        if (pool_shutdown) {
+            /* The wakeup pipe may be closed; abandon the result. */
+            free(job);
+            pthread_cond_signal(&idle_cond);
+            break;
+        }
+        enqueue(&finished, job);
+        /* If the pipe is full, the KDC's thread has a wakeup pending. */
+        st = write(wake_fds[1], "", 1);
+        (void)st;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+/* Run the done functions of finished jobs, on the KDC's thread. */
+static void
+wake_cb(verto_ctx *vctx, verto_ev *ev)
+{
+    struct job_queue done;
+    struct offload_job *job;
+    char buf[64];
+
+    while (read(wake_fds[0], buf, sizeof(buf)) > 0);
+
+    pthread_mutex_lock(&pool_lock);
+    done = finished;
+    finished.head = finished.tail = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    while ((job = dequeue(&done)) != NULL) {
+        job->done(job->context, job->arg);
+        free(job);
+    }
+}
+
+static krb5_error_code
+make_wake_pipe(verto_ctx *vctx)
+{
+    int i, flags;
+
+    if (pipe(wake_fds) == -1)
+        return errno;
+    for (i = 0; i < 2; i++) {
+        flags = fcntl(wake_fds[i], F_GETFL);
+        if (flags == -1 ||
+            fcntl(wake_fds[i], F_SETFL, flags | O_NONBLOCK) == -1 ||
+            set_cloexec_fd(wake_fds[i]) != 0)
+            return errno;
+    }
+    wake_ev = verto_add_io(vctx, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ,
+                           wake_cb, wake_fds[0]);
+    return (wake_ev == NULL) ? ENOMEM : 0;
+}
+
+static void
+close_wake_pipe(void)
+{
+    if (wake_fds[0] != -1)
+        close(wake_fds[0]);
+    if (wake_fds[1] != -1)
+        close(wake_fds[1]);
+    wake_fds[0] = wake_fds[1] = -1;
+}
+
+static krb5_error_code
+start_pool(verto_ctx *vctx)
+{
+    krb5_error_code ret;
+    int i;
+
+    ret = make_wake_pipe(vctx);
+    if (ret)
+        goto error;
+
+    pool_threads = calloc(pool_size, sizeof(*pool_threads));
+    pool_contexts = calloc(pool_size, sizeof(*pool_contexts));
+    if (pool_threads == NULL || pool_contexts == NULL) {
+        ret = ENOMEM;
+        goto error;
+    }
+    for (i = 0; i < pool_size; i++) {
+        ret = krb5_init_context(&pool_contexts[i]);
+        if (ret)
+            break;
+        ret = pthread_create(&pool_threads[i], NULL, worker,
+                             pool_contexts[i]);
+        if (ret) {
+            krb5_free_context(pool_contexts[i]);
+            break;
+        }
+        pool_nthreads++;
+    }
+    if (pool_nthreads > 0)
+        return 0;
+
+error:
+    if (wake_ev != NULL)
+        verto_del(wake_ev);
+    wake_ev = NULL;
+    close_wake_pipe();
+    free(pool_threads);
+    free(pool_contexts);
+    pool_threads = NULL;
+    pool_contexts = NULL;
+    return ret;
+}
+
+/*
+ * Stop the helper threads.  Jobs which have not been delivered are abandoned,
+ * along with their arguments, as the KDC is shutting down.  The wakeup event
+ * is freed along with the KDC's event loop.  Return false if a work function
+ * was still running after OFFLOAD_SHUTDOWN_WAIT seconds, in which case its
+ * thread is left running and the caller must not free anything the work
+ * function might use, such as preauth module data.
+ */
+krb5_boolean
+kdc_offload_fini(void)
+{
+    struct timespec deadline;
+    int i, busy;
+
+    if (pool_nthreads == 0)
+        return TRUE;
+
+    deadline.tv_sec = time(NULL) + OFFLOAD_SHUTDOWN_WAIT;
+    deadline.tv_nsec = 0;
+    pthread_mutex_lock(&pool_lock);
+    pool_shutdown = 1;
+    pthread_cond_broadcast(&pool_cond);
+    while (pool_busy > 0) {
+        if (pthread_cond_timedwait(&idle_cond, &pool_lock, &deadline) ==
+            ETIMEDOUT)
+            break;
+    }
+    busy = pool_busy;
+    discard(&pending);
+    discard(&finished);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = 0; i < pool_nthreads; i++) {
+        if (busy > 0) {
+            /* We can't tell which threads are done, so leave them all
+             * along with their contexts. */
+            pthread_detach(pool_threads[i]);
+        } else {
+            pthread_join(pool_threads[i], NULL);
+            krb5_free_context(pool_contexts[i]);
+        }
+    }
+    if (busy > 0) {
+        krb5_klog_syslog(LOG_WARNING, _("%d preauth helper threads still "
+                                        "busy at shutdown"), busy);
+        /* Run any later jobs synchronously. */
+        pool_size = 0;
+    } else {
+        pool_shutdown = 0;
+    }
+    close_wake_pipe();
+    free(pool_threads);
+    free(pool_contexts);
+    pool_threads = NULL;
+    pool_contexts = NULL;
+    pool_nthreads = 0;
+    wake_ev = NULL;
+    return (busy == 0);
+}
+
+/*
+ * Arrange for work(arg) to run on a helper thread, followed by done(context,
+ * arg) on this thread once vctx (the KDC's event loop) notices.  If there are
+ * no helper threads, run both before returning.
+ */
+krb5_error_code
+kdc_offload_submit(krb5_context context, verto_ctx *vctx,
+                   kdc_offload_fn work, kdc_offload_fn done, void *arg)
+{
+    krb5_error_code ret;
+    struct offload_job *job;
+
+    if (pool_size > 0 && pool_nthreads == 0 && vctx != NULL) {
+        ret = start_pool(vctx);
+        if (ret) {
+            krb5_klog_syslog(LOG_ERR, _("cannot start preauth helper "
+                                        "threads: %s"), error_message(ret));
+            /* Don't try again for every request. */
+            pool_size = 0;
+        }
+    }
+    if (pool_nthreads == 0) {
+        run_inline(context, work, done, arg);
+        return 0;
+    }
+
+    job = malloc(sizeof(*job));
+    if (job == NULL)
+        return ENOMEM;
+    job->context = context;
+    job->work = work;
+    job->done = done;
+    job->arg = arg;
+
+    pthread_mutex_lock(&pool_lock);
+    enqueue(&pending, job);
+    pthread_cond_signal(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
+
+#else /* !ENABLE_THREADS */
+
+krb5_boolean
+kdc_offload_fini(void)
+{
+    return TRUE;
+}
+
+krb5_error_code
+kdc_offload_submit(krb5_context context, verto_ctx *vctx,
+                   kdc_offload_fn work, kdc_offload_fn done, void *arg)
+{
+    run_inline(context, work, done, arg);
+    return 0;
+}
+
+#endif /* !ENABLE_THREADS */
+
+/* Use nthreads helper threads, or none if nthreads is 0.  Call before the
+ * first job is submitted. */
+void
+kdc_offload_init(int nthreads)
+{
+    pool_size = (nthreads > 0) ? nthreads : 0;
+}
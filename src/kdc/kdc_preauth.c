@@ -580,8 +580,94 @@ event_context(krb5_context context, krb5_kdcpreauth_rock rock)
     return rock->vctx;
 }
 
+static krb5_error_code
+offload(krb5_context context, krb5_kdcpreauth_rock rock,
+        krb5_kdcpreauth_offload_fn work, krb5_kdcpreauth_offload_fn done,
+        void *arg)
+{
+    return kdc_offload_submit(context, rock->vctx, work, done, arg);
+}
+
+struct fd_watch {
+    krb5_context context;
+    int fd;
+    krb5_kdcpreauth_fd_fn cb;
+    void *arg;
+    verto_ev *io_ev;
+    verto_ev *timer_ev;
+};
+
+/* End a watch started by watch_fd and report the result to the module. */
+static void
+finish_watch(struct fd_watch *w, int ready)
+{
+    krb5_context context = w->context;
+    krb5_kdcpreauth_fd_fn cb = w->cb;
+    void *arg = w->arg;
+    int fd = w->fd;
+
+    verto_del(w->io_ev);
+    if (w->timer_ev != NULL)
+        verto_del(w->timer_ev);
+    free(w);
+    cb(context, fd, ready, arg);
+}
+
+static void
+watch_io_cb(verto_ctx *vctx, verto_ev *ev)
+{
+    finish_watch(verto_get_private(ev), 1);
+}
+
+static void
+watch_timeout_cb(verto_ctx *vctx, verto_ev *ev)
+{
+    finish_watch(verto_get_private(ev), 0);
+}
+
+static krb5_error_code
+watch_fd(krb5_context context, krb5_kdcpreauth_rock rock, int fd, int events,
+         int timeout_ms, krb5_kdcpreauth_fd_fn cb, void *arg)
+{
+    struct fd_watch *w;
+    verto_ev_flag flags = VERTO_EV_FLAG_NONE;
+
+    if (events & KRB5_KDCPREAUTH_FD_READ)
+        flags |= VERTO_EV_FLAG_IO_READ;
+    if (events & KRB5_KDCPREAUTH_FD_WRITE)
+        flags |= VERTO_EV_FLAG_IO_WRITE;
+    if (flags == VERTO_EV_FLAG_NONE || rock->vctx == NULL)
+        return EINVAL;
+
+    w = calloc(1, sizeof(*w));
+    if (w == NULL)
+        return ENOMEM;
+    w->context = context;
+    w->fd = fd;
+    w->cb = cb;
+    w->arg = arg;
+    w->io_ev = verto_add_io(rock->vctx, flags, watch_io_cb, fd);
+    if (w->io_ev == NULL)
+        goto oom;
+    verto_set_private(w->io_ev, w, NULL);
+    if (timeout_ms > 0) {
+        w->timer_ev = verto_add_timeout(rock->vctx, VERTO_EV_FLAG_NONE,
+                                        watch_timeout_cb, timeout_ms);
+        if (w->timer_ev == NULL)
+            goto oom;
+        verto_set_private(w->timer_ev, w, NULL);
+    }
+    return 0;
+
+oom:
+    if (w->io_ev != NULL)
+        verto_del(w->io_ev);
+    free(w);
+    return ENOMEM;
+}
+
 static struct krb5_kdcpreauth_callbacks_st callbacks = {
-    1,
+    2,
     max_time_skew,
     client_keys,
     free_keys,
@@ -590,7 +676,9 @@ static struct krb5_kdcpreauth_callbacks_st callbacks = {
     get_string,
     free_string,
     client_entry,
-    event_context
+    event_context,
+    offload,
+    watch_fd
 };
 
 static krb5_error_code
@@ -0,0 +1,208 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/kdc_stats.c - Request latency statistics for the KDC */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * If kdc_stats_file is set in [kdcdefaults], the KDC times each request from
+ * its arrival until the reply has been handed to the network layer, split
+ * into the phases listed in kdc_util.h.  The total and per-phase latencies
+ * are kept in histograms for each realm and request type, and appended to
+ * the stats file every kdc_stats_interval seconds and at shutdown.  Each
+ * worker process keeps and writes its own statistics.
+ *
+ * Requests which fail before their realm is known (for instance, because
+ * they cannot be decoded) are counted under the realm name "-".
+ */
+
+#include "k5-int.h"
+#include <syslog.h>
+#include "kdc_util.h"
+#include "extern.h"
+#include "adm_proto.h"
+
+#define DEFAULT_STATS_INTERVAL 60
+
+struct kdc_stats {
+    struct k5_latency total[KDC_REQ_TYPE_MAX];
+    struct k5_latency phase[KDC_REQ_TYPE_MAX][KDC_PHASE_MAX];
+};
+
+static const char *const req_type_names[KDC_REQ_TYPE_MAX] = {
+    "as", "tgs", "other"
+};
+
+static const char *const phase_names[KDC_PHASE_MAX] = {
+    "decode", "db", "preauth", "authdata", "encrypt", "encode", "send",
+    "other"
+};
+
+static char *stats_path;
+static struct kdc_stats unknown_realm_stats;
+
+void
+kdc_timer_start(struct kdc_timer *timer, enum kdc_req_type req_type)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->req_type = req_type;
+    if (stats_path != NULL)
+        timer->start = timer->last = krb5int_metric_now();
+}
+
+void
+kdc_timer_mark(struct kdc_timer *timer, enum kdc_phase phase)
+{
+    krb5_ui_8 now;
+
+    if (timer == NULL || timer->start == 0)
+        return;
+    now = krb5int_metric_now();
+    if (now > timer->last)
+        timer->phase_us[phase] += now - timer->last;
+    timer->last = now;
+    timer->phases_seen |= 1U << phase;
+}
+
+/* Add the latencies in timer to the statistics for its realm. */
+void
+kdc_stats_record(struct kdc_timer *timer)
+{
+    struct kdc_stats *stats = &unknown_realm_stats;
+    kdc_realm_t *realm = timer->realm;
+    int i, t = timer->req_type;
+
+    if (timer->start == 0)
+        return;
+    if (realm != NULL) {
+        if (realm->realm_stats == NULL)
+            realm->realm_stats = calloc(1, sizeof(*realm->realm_stats));
+        if (realm->realm_stats != NULL)
+            stats = realm->realm_stats;
+    }
+
+    krb5int_latency_add(&stats->total[t],
+                        (timer->last > timer->start) ?
+                        timer->last - timer->start : 0, timer->errcode);
+    for (i = 0; i < KDC_PHASE_MAX; i++) {
+        if (timer->phases_seen & (1U << i)) {
+            krb5int_latency_add(&stats->phase[t][i], timer->phase_us[i],
+                                timer->errcode);
+        }
+    }
+}
+
+static void
+format_stats(struct k5buf *buf, const char *realm,
+             const struct kdc_stats *stats)
+{
+    char name[256];
+    int t, i;
+
+    for (t = 0; t < KDC_REQ_TYPE_MAX; t++) {
+        if (stats->total[t].count == 0)
+            continue;
+        snprintf(name, sizeof(name), "%s %s total", realm, req_type_names[t]);
+        krb5int_latency_format(buf, name, &stats->total[t]);
+        for (i = 0; i < KDC_PHASE_MAX; i++) {
+            if (stats->phase[t][i].count == 0)
+                continue;
+            snprintf(name, sizeof(name), "%s %s %s", realm,
+                     req_type_names[t], phase_names[i]);
+            krb5int_latency_format(buf, name, &stats->phase[t][i]);
+        }
+    }
+}
+
+/* Append the current statistics to the stats file, if one is configured. */
+void
+kdc_stats_write(void)
+{
+    struct k5buf buf;
+    ssize_t len;
+    int fd, i;
+
+    if (stats_path == NULL)
+        return;
+
+    krb5int_buf_init_dynamic(&buf);
+    krb5int_buf_add_fmt(&buf, "# pid %lu time %lu\n",
+                        (unsigned long) getpid(), (unsigned long) time(NULL));
+    for (i = 0; i < kdc_numrealms; i++) {
+        if (kdc_realmlist[i]->realm_stats != NULL) {
+            format_stats(&buf, kdc_realmlist[i]->realm_name,
+                         kdc_realmlist[i]->realm_stats);
+        }
+    }
+    format_stats(&buf, "-", &unknown_realm_stats);
+    len = krb5int_buf_len(&buf);
+    if (len < 0) {
+        krb5_klog_syslog(LOG_ERR, _("out of memory writing KDC statistics"));
+        return;
+    }
+
+    fd = open(stats_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd == -1 || write(fd, krb5int_buf_data(&buf), len) != len) {
+        krb5_klog_syslog(LOG_ERR, _("cannot write KDC statistics to %s: %s"),
+                         stats_path, strerror(errno));
+    }
+    if (fd != -1)
+        close(fd);
+    krb5int_free_buf(&buf);
+}
+
+static void
+write_stats_cb(verto_ctx *ctx, verto_ev *ev)
+{
+    kdc_stats_write();
+}
+
+/*
+ * Start collecting statistics, to be appended to path every interval seconds
+ * (or a default interval if interval is not positive).  Call after worker
+ * processes have been created.
+ */
+krb5_error_code
+kdc_stats_setup(verto_ctx *ctx, const char *path, int interval)
+{
+    if (path == NULL)
+        return 0;
+    stats_path = strdup(path);
+    if (stats_path == NULL)
+        return ENOMEM;
+    if (interval <= 0)
+        interval = DEFAULT_STATS_INTERVAL;
+    if (verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, write_stats_cb,
+                          (time_t) interval * 1000) == NULL) {
+        free(stats_path);
+        stats_path = NULL;
+        return ENOMEM;
+    }
+    return 0;
+}
+
+void
+kdc_stats_free(struct kdc_stats *stats)
+{
+    free(stats);
+}
@@ -76,6 +76,8 @@ static krb5_error_code kdc_rd_ap_req(krb5_ap_req *apreq,
 static krb5_error_code find_server_key(krb5_db_entry *, krb5_enctype,
                                        krb5_kvno, krb5_keyblock **,
                                        krb5_kvno *);
+static krb5_error_code find_server_key_k(krb5_db_entry *, krb5_enctype,
+                                         krb5_kvno, krb5_key *, krb5_kvno *);
 
 /*
  * concatenate first two authdata arrays, returning an allocated replacement.
@@ -200,7 +202,8 @@ find_pa_data(krb5_pa_data **padata, krb5_preauthtype pa_type)
 }
 
 krb5_error_code
-kdc_process_tgs_req(krb5_kdc_req *request, const krb5_fulladdr *from,
+kdc_process_tgs_req(krb5_kdc_req *request, k5_asn1_arena *arena,
+                    const krb5_fulladdr *from,
                     krb5_data *pkt, krb5_ticket **ticket,
                     krb5_db_entry **krbtgt_ptr,
                     krb5_keyblock **tgskey,
@@ -228,7 +231,8 @@ kdc_process_tgs_req(krb5_kdc_req *request, const krb5_fulladdr *from,
 
     scratch1.length = tmppa->length;
     scratch1.data = (char *)tmppa->contents;
-    if ((retval = decode_krb5_ap_req(&scratch1, &apreq)))
+    /* The AP-REQ is decoded into the request arena alongside the request. */
+    if ((retval = decode_krb5_ap_req_arena(arena, &scratch1, &apreq)))
         return retval;
 
     if (isflagset(apreq->ap_options, AP_OPTS_USE_SESSION_KEY) ||
@@ -347,7 +351,9 @@ cleanup:
         krb5_free_keyblock(kdc_context, *tgskey);
         *tgskey = NULL;
     }
-    krb5_free_ap_req(kdc_context, apreq);
+    /* Only the decrypted ticket part was allocated outside the arena. */
+    krb5_free_enc_tkt_part(kdc_context, apreq->ticket->enc_part2);
+    apreq->ticket->enc_part2 = NULL;
     krb5_db_free_principal(kdc_context, krbtgt);
     return retval;
 }
@@ -373,6 +379,7 @@ kdc_rd_ap_req(krb5_ap_req *apreq, krb5_auth_context auth_context,
     krb5_enctype        search_enctype = apreq->ticket->enc_part.enctype;
     krb5_boolean        match_enctype = 1;
     krb5_kvno           kvno;
+    krb5_key            key = NULL;
     size_t              tries = 3;
 
     /*
@@ -395,16 +402,18 @@ kdc_rd_ap_req(krb5_ap_req *apreq, krb5_auth_context auth_context,
     *tgskey = NULL;
     kvno = apreq->ticket->enc_part.kvno;
     do {
-        krb5_free_keyblock(kdc_context, *tgskey);
-        retval = find_server_key(*server, search_enctype, kvno, tgskey, &kvno);
+        krb5_k_free_key(kdc_context, key);
+        key = NULL;
+        retval = find_server_key_k(*server, search_enctype, kvno, &key,
+                                   &kvno);
         if (retval)
             continue;
 
         /* Make the TGS key available to krb5_rd_req_decoded_anyflag() */
-        retval = krb5_auth_con_setuseruserkey(kdc_context, auth_context,
-                                              *tgskey);
+        retval = krb5_auth_con_setuseruserkey_k(kdc_context, auth_context,
+                                                key);
         if (retval)
-            return retval;
+            goto cleanup;
 
         retval = krb5_rd_req_decoded_anyflag(kdc_context, &auth_context, apreq,
                                              apreq->ticket->server,
@@ -413,6 +422,11 @@ kdc_rd_ap_req(krb5_ap_req *apreq, krb5_auth_context auth_context,
     } while (retval && apreq->ticket->enc_part.kvno == 0 && kvno-- > 1 &&
              --tries > 0);
 
+    if (!retval)
+        retval = krb5_k_key_keyblock(kdc_context, key, tgskey);
+
+cleanup:
+    krb5_k_free_key(kdc_context, key);
     return retval;
 }
 
@@ -482,10 +496,30 @@ static
 krb5_error_code
 find_server_key(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
                 krb5_keyblock **key_out, krb5_kvno *kvno_out)
+{
+    krb5_error_code       retval;
+    krb5_key              key;
+
+    *key_out = NULL;
+    retval = find_server_key_k(server, enctype, kvno, &key, kvno_out);
+    if (retval)
+        return retval;
+    retval = krb5_k_key_keyblock(kdc_context, key, key_out);
+    krb5_k_free_key(kdc_context, key);
+    return retval;
+}
+
+/* Like find_server_key, but return a key object, which may be shared with
+ * later requests (see kdc_keys.c). */
+static krb5_error_code
+find_server_key_k(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
+                  krb5_key *key_out, krb5_kvno *kvno_out)
 {
     krb5_error_code       retval;
     krb5_key_data       * server_key;
-    krb5_keyblock       * key;
+    krb5_key              key = NULL;
+    krb5_keyblock       * keyblock = NULL;
+    krb5_boolean          similar;
 
     *key_out = NULL;
     retval = krb5_dbe_find_enctype(kdc_context, server, enctype, -1,
@@ -494,15 +528,12 @@ find_server_key(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
         return retval;
     if (!server_key)
         return KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN;
-    if ((key = (krb5_keyblock *)malloc(sizeof *key)) == NULL)
-        return ENOMEM;
-    retval = krb5_dbe_decrypt_key_data(kdc_context, NULL, server_key,
-                                       key, NULL);
+    retval = kdc_get_entry_key(server, server_key, &key);
     if (retval)
-        goto errout;
-    if (enctype != -1) {
-        krb5_boolean similar;
-        retval = krb5_c_enctype_compare(kdc_context, enctype, key->enctype,
+        return retval;
+    if (enctype != -1 && enctype != krb5_k_key_enctype(kdc_context, key)) {
+        retval = krb5_c_enctype_compare(kdc_context, enctype,
+                                        krb5_k_key_enctype(kdc_context, key),
                                         &similar);
         if (retval)
             goto errout;
@@ -510,14 +541,24 @@ find_server_key(krb5_db_entry *server, krb5_enctype enctype, krb5_kvno kvno,
             retval = KRB5_KDB_NO_PERMITTED_KEY;
             goto errout;
         }
-        key->enctype = enctype;
+        /* Make a separate key object with the requested enctype. */
+        retval = krb5_k_key_keyblock(kdc_context, key, &keyblock);
+        if (retval)
+            goto errout;
+        keyblock->enctype = enctype;
+        krb5_k_free_key(kdc_context, key);
+        key = NULL;
+        retval = krb5_k_create_key(kdc_context, keyblock, &key);
+        if (retval)
+            goto errout;
     }
     *key_out = key;
     key = NULL;
     if (kvno_out)
         *kvno_out = server_key->key_data_kvno;
 errout:
-    krb5_free_keyblock(kdc_context, key);
+    krb5_k_free_key(kdc_context, key);
+    krb5_free_keyblock(kdc_context, keyblock);
     return retval;
 }
 
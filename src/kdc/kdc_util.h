@@ -59,6 +59,7 @@ krb5_error_code
 kdc_convert_key (krb5_keyblock *, krb5_keyblock *, int);
 krb5_error_code
 kdc_process_tgs_req (krb5_kdc_req *,
+                     k5_asn1_arena *,
                      const krb5_fulladdr *,
                      krb5_data *,
                      krb5_ticket **,
@@ -113,16 +114,100 @@ ktypes2str(char *s, size_t len, int nktypes, krb5_enctype *ktype);
 void
 rep_etypes2str(char *s, size_t len, krb5_kdc_rep *rep);
 
+/* kdc_stats.c */
+
+struct kdc_stats;
+
+/* Phases of request processing which are timed separately. */
+enum kdc_phase {
+    KDC_PHASE_DECODE,           /* Decoding the request, including FAST */
+    KDC_PHASE_DB,               /* Principal lookups and key decryption */
+    KDC_PHASE_PREAUTH,          /* Preauth or TGS authenticator checks */
+    KDC_PHASE_AUTHDATA,         /* Authorization data, including the PAC */
+    KDC_PHASE_ENCRYPT,          /* Encrypting the ticket */
+    KDC_PHASE_ENCODE,           /* Encoding the reply or error */
+    KDC_PHASE_SEND,             /* Handing the reply to the network layer */
+    KDC_PHASE_OTHER,            /* Policy checks, logging, and the rest */
+    KDC_PHASE_MAX
+};
+
+enum kdc_req_type {
+    KDC_REQ_AS,
+    KDC_REQ_TGS,
+    KDC_REQ_OTHER,
+    KDC_REQ_TYPE_MAX
+};
+
+/*
+ * Timing state for one request.  Each kdc_timer_mark() call charges the time
+ * elapsed since the previous mark to a phase, so a mark belongs at the end of
+ * each phase.  If statistics are not enabled, start is zero and marks do
+ * nothing.
+ */
+struct kdc_timer {
+    struct __kdc_realm_data *realm; /* NULL until the realm is known */
+    enum kdc_req_type req_type;
+    krb5_error_code errcode;    /* Error reported to the client, if any */
+    krb5_ui_8 start;
+    krb5_ui_8 last;
+    krb5_ui_8 phase_us[KDC_PHASE_MAX];
+    unsigned int phases_seen;
+};
+
+void
+kdc_timer_start(struct kdc_timer *timer, enum kdc_req_type req_type);
+
+void
+kdc_timer_mark(struct kdc_timer *timer, enum kdc_phase phase);
+
+void
+kdc_stats_record(struct kdc_timer *timer);
+
+krb5_error_code
+kdc_stats_setup(verto_ctx *ctx, const char *path, int interval);
+
+void
+kdc_stats_write(void);
+
+void
+kdc_stats_free(struct kdc_stats *stats);
+
+/* kdc_offload.c */
+typedef void (*kdc_offload_fn)(krb5_context context, void *arg);
+
+void
+kdc_offload_init(int nthreads);
+
+krb5_boolean
+kdc_offload_fini(void);
+
+krb5_error_code
+kdc_offload_submit(krb5_context context, verto_ctx *vctx,
+                   kdc_offload_fn work, kdc_offload_fn done, void *arg);
+
+/* kdc_keys.c */
+struct tgs_key;
+
+krb5_error_code
+kdc_get_entry_key(krb5_db_entry *entry, krb5_key_data *kd, krb5_key *key_out);
+
+void
+kdc_load_tgs_keys(struct __kdc_realm_data *realm);
+
+void
+kdc_free_tgs_keys(struct __kdc_realm_data *realm);
+
 /* do_as_req.c */
 void
 process_as_req (krb5_kdc_req *, krb5_data *,
-                const krb5_fulladdr *,
+                const krb5_fulladdr *, struct kdc_timer *,
                 verto_ctx *, loop_respond_fn, void *);
 
 /* do_tgs_req.c */
 krb5_error_code
 process_tgs_req (krb5_data *,
                  const krb5_fulladdr *,
+                 struct kdc_timer *,
                  krb5_data ** );
 /* dispatch.c */
 void
@@ -338,6 +423,7 @@ struct kdc_request_state {
     krb5_pa_data *cookie;
     krb5_int32 fast_options;
     krb5_int32 fast_internal_flags;
+    k5_asn1_arena *arena;       /* Owns the request if set (not freed here) */
 };
 
 krb5_error_code kdc_make_rstate(struct kdc_request_state **out);
@@ -88,6 +88,9 @@ static int nofork = 0;
 static int workers = 0;
 static int time_offset = 0;
 static const char *pid_file = NULL;
+static char *stats_file = NULL;
+static krb5_int32 stats_interval = 0;
+static krb5_int32 preauth_threads;
 static int rkey_init_done = 0;
 static volatile int signal_received = 0;
 static volatile int sighup_received = 0;
@@ -172,7 +175,9 @@ finish_realm(kdc_realm_t *rdp)
         free(rdp->realm_host_based_services);
     if (rdp->realm_no_host_referral)
         free(rdp->realm_no_host_referral);
+    kdc_stats_free(rdp->realm_stats);
     if (rdp->realm_context) {
+        kdc_free_tgs_keys(rdp);
         if (rdp->realm_mprinc)
             krb5_free_principal(rdp->realm_context, rdp->realm_mprinc);
         if (rdp->realm_mkey.length && rdp->realm_mkey.contents) {
@@ -452,6 +457,8 @@ init_realm(kdc_realm_t *rdp, char *realm, char *def_mpname,
         goto whoops;
     }
 
+    kdc_load_tgs_keys(rdp);
+
     if (!rkey_init_done) {
         krb5_data seed;
         /*
@@ -704,6 +711,16 @@ initialize_realms(krb5_context kcontext, int argc, char **argv)
         hierarchy[1] = KRB5_CONF_RESTRICT_ANONYMOUS_TO_TGT;
         if (krb5_aprof_get_boolean(aprof, hierarchy, TRUE, &def_restrict_anon))
             def_restrict_anon = FALSE;
+        hierarchy[1] = KRB5_CONF_KDC_STATS_FILE;
+        if (stats_file == NULL &&
+            krb5_aprof_get_string(aprof, hierarchy, TRUE, &stats_file))
+            stats_file = NULL;
+        hierarchy[1] = KRB5_CONF_KDC_STATS_INTERVAL;
+        if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &stats_interval))
+            stats_interval = 0;
+        hierarchy[1] = KRB5_CONF_KDC_PREAUTH_THREADS;
+        if (!krb5_aprof_get_int32(aprof, hierarchy, TRUE, &preauth_threads))
+            kdc_offload_init(preauth_threads);
         hierarchy[1] = KRB5_CONF_NO_HOST_REFERRAL;
         if (krb5_aprof_get_string_all(aprof, hierarchy, &no_refrls))
             no_refrls = 0;
@@ -1104,14 +1121,24 @@ int main(int argc, char **argv)
         /* We get here only in a worker child process; re-initialize realms. */
         initialize_realms(kcontext, argc, argv);
     }
+    retval = kdc_stats_setup(ctx, stats_file, stats_interval);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing statistics"));
+        finish_realms();
+        return 1;
+    }
     krb5_klog_syslog(LOG_INFO, _("commencing operation"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), kdc_progname);
 
     verto_run(ctx);
     loop_free(ctx);
+    kdc_stats_write();
     krb5_klog_syslog(LOG_INFO, _("shutting down"));
-    unload_preauth_plugins(kcontext);
+    /* Leave the preauth modules loaded if a helper thread may still be
+     * using one. */
+    if (kdc_offload_fini())
+        unload_preauth_plugins(kcontext);
     unload_authdata_plugins(kcontext);
     krb5_klog_close(kdc_context);
     finish_realms();
@@ -1120,6 +1147,7 @@ int main(int argc, char **argv)
 #ifndef NOCACHE
     kdc_free_lookaside(kcontext);
 #endif
+    free(stats_file);
     krb5_free_context(kcontext);
     return errout;
 }
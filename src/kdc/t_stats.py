@@ -0,0 +1,25 @@
+#!/usr/bin/python
+from k5test import *
+import os
+
+conf = {'all': {'kdcdefaults': {'kdc_stats_file': '$testdir/kdcstats',
+                                'kdc_stats_interval': '3600'}}}
+realm = K5Realm(kdc_conf=conf, start_kadmind=False, create_host=False)
+realm.run_as_client([kvno, realm.user_princ])
+realm.stop_kdc()
+
+# The KDC appends its statistics to the file when it shuts down.
+statsfile = os.path.join(realm.testdir, 'kdcstats')
+f = open(statsfile)
+stats = f.read()
+f.close()
+for prefix in ('KRBTEST.COM as total count 1 errors 0 ',
+               'KRBTEST.COM as db count 1 ',
+               'KRBTEST.COM as encrypt count 1 ',
+               'KRBTEST.COM tgs total count 1 errors 0 ',
+               'KRBTEST.COM tgs authdata count 1 ',
+               'KRBTEST.COM tgs send count 1 '):
+    if ('\n' + prefix) not in stats:
+        fail('Expected KDC statistics line not found: ' + prefix)
+
+success('KDC latency statistics')
@@ -541,6 +541,7 @@ static void process_packet(verto_ctx *ctx, verto_ev *ev);
 static void accept_tcp_connection(verto_ctx *ctx, verto_ev *ev);
 static void process_tcp_connection_read(verto_ctx *ctx, verto_ev *ev);
 static void process_tcp_connection_write(verto_ctx *ctx, verto_ev *ev);
+static krb5_boolean await_next_tcp_request(verto_ctx *ctx, verto_ev *ev);
 static void accept_rpc_connection(verto_ctx *ctx, verto_ev *ev);
 static void process_rpc_connection(verto_ctx *ctx, verto_ev *ev);
 
@@ -1889,6 +1890,7 @@ process_tcp_connection_read(verto_ctx *ctx, verto_ev *ev)
         state = prepare_for_dispatch(ctx, ev);
         if (!state)
             goto kill_tcp_connection;
+        conn->start_time = time(0);
 
         state->request.length = conn->msglen;
         state->request.data = conn->buffer + 4;
@@ -1940,14 +1942,53 @@ process_tcp_connection_write(verto_ctx *ctx, verto_ev *ev)
          * is ready for more writing. */
         if (conn->sgnum > 0)
             return;
+
+        /* Finished sending.  If we sent a FIELD_TOOLONG error in reply to a
+         * length we couldn't accept, RFC 4120 says we have to close the TCP
+         * stream.  Otherwise, go back to reading so that the client can
+         * send further requests on this connection. */
+        if (conn->offset == conn->msglen + 4 &&
+            await_next_tcp_request(ctx, ev))
+            return;
     }
 
-    /* Finished sending.  We should go back to reading, though if we
-     * sent a FIELD_TOOLONG error in reply to a length with the high
-     * bit set, RFC 4120 says we have to close the TCP stream. */
     verto_del(ev);
 }
 
+/*
+ * Replace the write event ev with a read event for the same connection, so
+ * that a client may send several requests over one TCP connection.  Requests
+ * are answered in the order they arrive; data from a request sent before the
+ * previous reply was written stays buffered in the socket until we get back
+ * to reading.  Idle connections are reclaimed by
+ * kill_lru_tcp_or_rpc_connection() like any other.
+ */
+static krb5_boolean
+await_next_tcp_request(verto_ctx *ctx, verto_ev *ev)
+{
+    struct connection *conn = verto_get_private(ev);
+    int sock = verto_get_fd(ev);
+    verto_ev *newev;
+
+    newev = make_event(ctx, VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST,
+                       process_tcp_connection_read, sock, conn, 1);
+    if (newev == NULL)
+        return FALSE;
+
+    /* Detach the connection from the write event and delete it. */
+    verto_set_private(ev, NULL, NULL);
+    remove_event_from_set(ev);
+    verto_del(ev);
+
+    krb5_free_data(get_context(conn->handle), conn->response);
+    conn->response = NULL;
+    conn->offset = 0;
+    conn->msglen = 0;
+    SG_SET(&conn->sgbuf[0], conn->lenbuf, 4);
+    SG_SET(&conn->sgbuf[1], 0, 0);
+    return TRUE;
+}
+
 void
 loop_free(verto_ctx *ctx)
 {
@@ -21,13 +21,6 @@ typedef struct {
     ArcfourContext ctx;
 } ArcFourCipherState;
 
-/* gets the next byte from the PRNG */
-#if ((__GNUC__ >= 2) )
-static __inline__ unsigned int k5_arcfour_byte(ArcfourContext *);
-#else
-static unsigned int k5_arcfour_byte(ArcfourContext *);
-#endif /* gcc inlines*/
-
 /* Initializes the context and sets the key. */
 static krb5_error_code k5_arcfour_init(ArcfourContext *ctx, const unsigned char *key,
                                        unsigned int keylen);
@@ -36,31 +29,25 @@ static krb5_error_code k5_arcfour_init(ArcfourContext *ctx, const unsigned char
 static void k5_arcfour_crypt(ArcfourContext *ctx, unsigned char *dest,
                              const unsigned char *src, unsigned int len);
 
-static inline unsigned int k5_arcfour_byte(ArcfourContext * ctx)
-{
-    unsigned int x;
-    unsigned int y;
-    unsigned int sx, sy;
-    unsigned char *state;
-
-    state = ctx->state;
-    x = (ctx->x + 1) & 0xff;
-    sx = state[x];
-    y = (sx + ctx->y) & 0xff;
-    sy = state[y];
-    ctx->x = x;
-    ctx->y = y;
-    state[y] = sx;
-    state[x] = sy;
-    return state[(sx + sy) & 0xff];
-}
-
+/* Keep the stream indices in locals and store them back once, rather
+ * than updating the context for every byte. */
 static void k5_arcfour_crypt(ArcfourContext *ctx, unsigned char *dest,
                              const unsigned char *src, unsigned int len)
 {
-    unsigned int i;
-    for (i = 0; i < len; i++)
-        dest[i] = src[i] ^ k5_arcfour_byte(ctx);
+    unsigned char *state = ctx->state;
+    unsigned int i, x = ctx->x, y = ctx->y, sx, sy;
+
+    for (i = 0; i < len; i++) {
+        x = (x + 1) & 0xff;
+        sx = state[x];
+        y = (y + sx) & 0xff;
+        sy = state[y];
+        state[y] = sx;
+        state[x] = sy;
+        dest[i] = src[i] ^ state[(sx + sy) & 0xff];
+    }
+    ctx->x = x;
+    ctx->y = y;
 }
 
 
@@ -102,7 +89,7 @@ static krb5_error_code
 k5_arcfour_docrypt(krb5_key key, const krb5_data *state, krb5_crypto_iov *data,
                    size_t num_data)
 {
-    ArcfourContext *arcfour_ctx = NULL;
+    ArcfourContext *arcfour_ctx = NULL, local_ctx;
     ArcFourCipherState *cipher_state = NULL;
     krb5_error_code ret;
     size_t i;
@@ -124,16 +111,11 @@ k5_arcfour_docrypt(krb5_key key, const krb5_data *state, krb5_crypto_iov *data,
             cipher_state->initialized = 1;
         }
     } else {
-        arcfour_ctx = (ArcfourContext *)malloc(sizeof(ArcfourContext));
-        if (arcfour_ctx == NULL)
-            return ENOMEM;
-
+        arcfour_ctx = &local_ctx;
         ret = k5_arcfour_init(arcfour_ctx, key->keyblock.contents,
                               key->keyblock.length);
-        if (ret != 0) {
-            free(arcfour_ctx);
+        if (ret != 0)
             return ret;
-        }
     }
 
     for (i = 0; i < num_data; i++) {
@@ -144,10 +126,8 @@ k5_arcfour_docrypt(krb5_key key, const krb5_data *state, krb5_crypto_iov *data,
                              (const unsigned char *)iov->data.data, iov->data.length);
     }
 
-    if (state == NULL) {
-        memset(arcfour_ctx, 0, sizeof(ArcfourContext));
-        free(arcfour_ctx);
-    }
+    if (state == NULL)
+        zap(&local_ctx, sizeof(local_ctx));
 
     return 0;
 }
@@ -50,8 +50,8 @@ static const unsigned char PADDING[64] = {
 };
 
 /* F, G and H are basic MD4 functions: selection, majority, parity */
-#define F(x, y, z) (((x) & (y)) | ((~x) & (z)))
-#define G(x, y, z) (((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 
 /* ROTATE_LEFT rotates x left n bits */
@@ -89,11 +89,10 @@ void
 krb5int_MD4Update (krb5_MD4_CTX *mdContext, const unsigned char *inBuf, unsigned int inLen)
 {
     krb5_ui_4 in[16];
-    int mdi;
-    unsigned int i, ii;
+    unsigned int mdi, n, i, ii;
 
     /* compute number of bytes mod 64 */
-    mdi = (int)((mdContext->i[0] >> 3) & 0x3F);
+    mdi = (unsigned int)((mdContext->i[0] >> 3) & 0x3F);
 
     /* update number of bits */
     if ((mdContext->i[0] + ((krb5_ui_4)inLen << 3)) < mdContext->i[0])
@@ -101,19 +100,30 @@ krb5int_MD4Update (krb5_MD4_CTX *mdContext, const unsigned char *inBuf, unsigned
     mdContext->i[0] += ((krb5_ui_4)inLen << 3);
     mdContext->i[1] += ((krb5_ui_4)inLen >> 29);
 
-    while (inLen--) {
-        /* add new character to buffer, increment mdi */
-        mdContext->in[mdi++] = *inBuf++;
-
-        /* transform if necessary */
-        if (mdi == 0x40) {
-            for (i = 0, ii = 0; i < 16; i++, ii += 4) {
-                in[i] = load_32_le(mdContext->in+ii);
-            }
-            Transform (mdContext->buf, in);
-            mdi = 0;
-        }
+    /* Complete a block left partially filled by a previous call. */
+    if (mdi > 0) {
+        n = (inLen < 64 - mdi) ? inLen : 64 - mdi;
+        memcpy(mdContext->in + mdi, inBuf, n);
+        inBuf += n;
+        inLen -= n;
+        if (mdi + n < 64)
+            return;
+        for (i = 0, ii = 0; i < 16; i++, ii += 4)
+            in[i] = load_32_le(mdContext->in+ii);
+        Transform (mdContext->buf, in);
     }
+
+    /* Transform whole blocks directly from the input buffer. */
+    while (inLen >= 64) {
+        for (i = 0, ii = 0; i < 16; i++, ii += 4)
+            in[i] = load_32_le(inBuf+ii);
+        Transform (mdContext->buf, in);
+        inBuf += 64;
+        inLen -= 64;
+    }
+
+    /* Save any leftover bytes for the next call. */
+    memcpy(mdContext->in, inBuf, inLen);
 }
 
 void
@@ -62,9 +62,10 @@ static const unsigned char PADDING[64] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 
-/* F, G, H and I are basic MD5 functions */
-#define F(x, y, z) (((x) & (y)) | ((~x) & (z)))
-#define G(x, y, z) (((x) & (z)) | ((y) & (~z)))
+/* F, G, H and I are basic MD5 functions.  F and G are written as
+   selections with one fewer operation than the textbook forms. */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
@@ -126,11 +127,10 @@ void
 krb5int_MD5Update (krb5_MD5_CTX *mdContext, const unsigned char *inBuf, unsigned int inLen)
 {
     krb5_ui_4 in[16];
-    int mdi;
-    unsigned int i, ii;
+    unsigned int mdi, n, i, ii;
 
     /* compute number of bytes mod 64 */
-    mdi = (int)((mdContext->i[0] >> 3) & 0x3F);
+    mdi = (unsigned int)((mdContext->i[0] >> 3) & 0x3F);
 
     /* update number of bits */
     if ((mdContext->i[0] + ((krb5_ui_4)inLen << 3)) < mdContext->i[0])
@@ -138,18 +138,30 @@ krb5int_MD5Update (krb5_MD5_CTX *mdContext, const unsigned char *inBuf, unsigned
     mdContext->i[0] += ((krb5_ui_4)inLen << 3);
     mdContext->i[1] += ((krb5_ui_4)inLen >> 29);
 
-    while (inLen--) {
-        /* add new character to buffer, increment mdi */
-        mdContext->in[mdi++] = *inBuf++;
-
-        /* transform if necessary */
-        if (mdi == 0x40) {
-            for (i = 0, ii = 0; i < 16; i++, ii += 4)
-                in[i] = load_32_le(mdContext->in+ii);
-            Transform (mdContext->buf, in);
-            mdi = 0;
-        }
+    /* Complete a block left partially filled by a previous call. */
+    if (mdi > 0) {
+        n = (inLen < 64 - mdi) ? inLen : 64 - mdi;
+        memcpy(mdContext->in + mdi, inBuf, n);
+        inBuf += n;
+        inLen -= n;
+        if (mdi + n < 64)
+            return;
+        for (i = 0, ii = 0; i < 16; i++, ii += 4)
+            in[i] = load_32_le(mdContext->in+ii);
+        Transform (mdContext->buf, in);
     }
+
+    /* Transform whole blocks directly from the input buffer. */
+    while (inLen >= 64) {
+        for (i = 0, ii = 0; i < 16; i++, ii += 4)
+            in[i] = load_32_le(inBuf+ii);
+        Transform (mdContext->buf, in);
+        inBuf += 64;
+        inLen -= 64;
+    }
+
+    /* Save any leftover bytes for the next call. */
+    memcpy(mdContext->in, inBuf, inLen);
 }
 
 /* The routine krb5int_MD5Final terminates the message-digest computation and
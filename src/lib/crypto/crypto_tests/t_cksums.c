@@ -175,6 +175,7 @@ main(int argc, char **argv)
     krb5_keyblock kb, *kbp;
     krb5_data plain;
     krb5_checksum cksum;
+    krb5_crypto_iov iov[2];
     krb5_boolean verbose = FALSE;
     int status = 0;
 
@@ -214,6 +215,19 @@ main(int argc, char **argv)
             if (!verbose)
                 break;
         }
+
+        /* Check that the IOV interface produces the same checksum. */
+        iov[0].flags = KRB5_CRYPTO_TYPE_DATA;
+        iov[0].data = plain;
+        iov[1].flags = KRB5_CRYPTO_TYPE_CHECKSUM;
+        assert(alloc_data(&iov[1].data, cksum.length) == 0);
+        assert(krb5_c_make_checksum_iov(context, test->sumtype, kbp,
+                                        test->usage, iov, 2) == 0);
+        if (memcmp(iov[1].data.data, cksum.contents, cksum.length) != 0) {
+            printf("iov test %d failed\n", (int)i);
+            status = 1;
+        }
+        free(iov[1].data.data);
         krb5_free_checksum_contents(context, &cksum);
     }
     return status;
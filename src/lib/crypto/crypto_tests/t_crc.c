@@ -127,7 +127,7 @@ timetest(unsigned int nblk, unsigned int blksiz)
     }
 
     times(&after);
-    printf("shift-8 implementation, %d blocks of %d bytes:\n",
+    printf("slicing-by-8 implementation, %d blocks of %d bytes:\n",
            nblk, blksiz);
     printf("\tu=%ld s=%ld cu=%ld cs=%ld\n",
            (long)(after.tms_utime - before.tms_utime),
@@ -158,9 +158,10 @@ static void gethexstr(char *data, size_t *outlen, unsigned char *outbuf,
     }
 }
 
-static void
+static int
 verify(void)
 {
+    int status = 0;
     unsigned int i;
     struct crc_trial trial;
     unsigned char buf[4];
@@ -191,7 +192,62 @@ verify(void)
         printf("%s: %s \"%s\" = 0x%08lx\n",
                (trial.sum == cksum) ? "OK" : "***BAD***",
                typestr, trial.data, cksum);
+        if (trial.sum != cksum)
+            status = 1;
+    }
+    return status;
+}
+
+/* Compute the CRC of data one bit at a time, for comparison. */
+static unsigned long
+slow_crc32(const unsigned char *data, size_t len, unsigned long c)
+{
+    int k;
+
+    while (len-- > 0) {
+        c ^= *data++;
+        for (k = 0; k < 8; k++)
+            c = (c >> 1) ^ ((c & 1) ? 0xedb88320UL : 0);
+    }
+    return c;
+}
+
+/* Check mit_crc32 against slow_crc32 at a range of lengths and alignments,
+ * and check that computing a CRC in two pieces gives the same result. */
+static int
+compare(void)
+{
+    unsigned char buf[1100];
+    size_t off, len, split;
+    unsigned long cksum, expected;
+
+    for (off = 0; off < sizeof(buf); off++)
+        buf[off] = (off * 131 + 7) & 0xff;
+
+    for (off = 0; off < 8; off++) {
+        for (len = 0; len <= 1024; len += (len < 100) ? 1 : 61) {
+            expected = slow_crc32(buf + off, len, 0);
+            cksum = 0;
+            mit_crc32(buf + off, len, &cksum);
+            if (cksum != expected) {
+                printf("***BAD***: offset %d length %d = 0x%08lx, "
+                       "expected 0x%08lx\n", (int)off, (int)len, cksum,
+                       expected);
+                return 1;
+            }
+            split = len / 3;
+            cksum = 0;
+            mit_crc32(buf + off, split, &cksum);
+            mit_crc32(buf + off + split, len - split, &cksum);
+            if (cksum != expected) {
+                printf("***BAD***: offset %d length %d split at %d\n",
+                       (int)off, (int)len, (int)split);
+                return 1;
+            }
+        }
     }
+    printf("OK: bitwise comparison\n");
+    return 0;
 }
 
 int
@@ -200,6 +256,7 @@ main(void)
 #if 0
     timetest(64*1024, 1024);
 #endif
-    verify();
+    if (verify() || compare())
+        exit(1);
     exit(0);
 }
@@ -0,0 +1,536 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/crypto_tests/t_cryptoperf.c - Crypto throughput benchmark */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program measures the throughput of each enctype and checksum type
+ * over a range of message sizes, using both the single-buffer and IOV
+ * interfaces, through both the krb5_c functions and the krb5_k functions
+ * (which cache derived keys).  Usage:
+ *
+ *     ./t_cryptoperf [-t msecs] [-s size] ... [type ...]
+ *
+ * Each measurement runs for at least msecs milliseconds (default 200).
+ * Each -s option adds a message size, replacing the default set.  If
+ * types are named, only those enctypes and checksum types are measured.
+ *
+ * Results are written to standard output as tab-separated lines:
+ *
+ *     backend op interface type size ops/s MB/s
+ *
+ * where backend is the crypto implementation the library was built with,
+ * op is one of encrypt, decrypt, checksum or verify, and interface is one
+ * of c, k, c-iov or k-iov.  Lines beginning with '#' are comments.
+ */
+
+#include "k5-int.h"
+
+#ifndef CRYPTO_IMPL
+#define CRYPTO_IMPL "unknown"
+#endif
+
+static krb5_enctype enctypes[] = {
+    ENCTYPE_DES_CBC_CRC,
+    ENCTYPE_DES_CBC_MD4,
+    ENCTYPE_DES_CBC_MD5,
+    ENCTYPE_DES3_CBC_SHA1,
+    ENCTYPE_ARCFOUR_HMAC,
+    ENCTYPE_ARCFOUR_HMAC_EXP,
+    ENCTYPE_AES128_CTS_HMAC_SHA1_96,
+    ENCTYPE_AES256_CTS_HMAC_SHA1_96,
+#ifdef CAMELLIA
+    ENCTYPE_CAMELLIA128_CTS_CMAC,
+    ENCTYPE_CAMELLIA256_CTS_CMAC,
+#endif
+    0
+};
+
+/* Checksum types, with the enctype of the key to use for keyed types. */
+static struct {
+    const char *name;
+    krb5_cksumtype cksumtype;
+    krb5_enctype enctype;
+} cksumtypes[] = {
+    { "crc32", CKSUMTYPE_CRC32, 0 },
+    { "md4", CKSUMTYPE_RSA_MD4, 0 },
+    { "md5", CKSUMTYPE_RSA_MD5, 0 },
+    { "sha", CKSUMTYPE_NIST_SHA, 0 },
+    { "md4-des", CKSUMTYPE_RSA_MD4_DES, ENCTYPE_DES_CBC_CRC },
+    { "md5-des", CKSUMTYPE_RSA_MD5_DES, ENCTYPE_DES_CBC_CRC },
+    { "des-cbc", CKSUMTYPE_DESCBC, ENCTYPE_DES_CBC_CRC },
+    { "hmac-sha1-des3", CKSUMTYPE_HMAC_SHA1_DES3, ENCTYPE_DES3_CBC_SHA1 },
+    { "hmac-md5-rc4", CKSUMTYPE_HMAC_MD5_ARCFOUR, ENCTYPE_ARCFOUR_HMAC },
+    { "md5-hmac-rc4", CKSUMTYPE_MD5_HMAC_ARCFOUR, ENCTYPE_ARCFOUR_HMAC },
+    { "hmac-sha1-96-aes128", CKSUMTYPE_HMAC_SHA1_96_AES128,
+      ENCTYPE_AES128_CTS_HMAC_SHA1_96 },
+    { "hmac-sha1-96-aes256", CKSUMTYPE_HMAC_SHA1_96_AES256,
+      ENCTYPE_AES256_CTS_HMAC_SHA1_96 },
+#ifdef CAMELLIA
+    { "cmac-camellia128", CKSUMTYPE_CMAC_CAMELLIA128,
+      ENCTYPE_CAMELLIA128_CTS_CMAC },
+    { "cmac-camellia256", CKSUMTYPE_CMAC_CAMELLIA256,
+      ENCTYPE_CAMELLIA256_CTS_CMAC },
+#endif
+    { NULL }
+};
+
+static size_t default_sizes[] = { 16, 64, 256, 1024, 8192, 65536 };
+
+#define MAX_SIZES 32
+
+/* State for measuring one type at one message size. */
+struct bench {
+    krb5_keyblock *kb;
+    krb5_key key;
+    krb5_enctype enctype;
+    krb5_cksumtype cksumtype;
+
+    /* Single-buffer inputs and outputs. */
+    krb5_data plain;
+    krb5_data out;
+    krb5_enc_data cipher;
+    krb5_checksum sum;
+
+    /* IOV inputs and outputs.  Decryption works in place, so iovbuf is
+     * restored from saved before each decryption. */
+    krb5_crypto_iov iov[4];
+    size_t niov;
+    char *iovbuf;
+    char *saved;
+    size_t iovlen;
+};
+
+typedef krb5_error_code (*bench_fn)(struct bench *b);
+
+static krb5_context ctx;
+static double min_secs = 0.2;
+
+static void
+check(krb5_error_code code)
+{
+    if (code != 0) {
+        com_err("t_cryptoperf", code, NULL);
+        exit(1);
+    }
+}
+
+static krb5_error_code
+encrypt_c(struct bench *b)
+{
+    return krb5_c_encrypt(ctx, b->kb, 1, NULL, &b->plain, &b->cipher);
+}
+
+static krb5_error_code
+encrypt_k(struct bench *b)
+{
+    return krb5_k_encrypt(ctx, b->key, 1, NULL, &b->plain, &b->cipher);
+}
+
+static krb5_error_code
+decrypt_c(struct bench *b)
+{
+    b->out.length = b->cipher.ciphertext.length;
+    return krb5_c_decrypt(ctx, b->kb, 1, NULL, &b->cipher, &b->out);
+}
+
+static krb5_error_code
+decrypt_k(struct bench *b)
+{
+    b->out.length = b->cipher.ciphertext.length;
+    return krb5_k_decrypt(ctx, b->key, 1, NULL, &b->cipher, &b->out);
+}
+
+static krb5_error_code
+encrypt_c_iov(struct bench *b)
+{
+    return krb5_c_encrypt_iov(ctx, b->kb, 1, NULL, b->iov, b->niov);
+}
+
+static krb5_error_code
+encrypt_k_iov(struct bench *b)
+{
+    return krb5_k_encrypt_iov(ctx, b->key, 1, NULL, b->iov, b->niov);
+}
+
+static krb5_error_code
+restore_iov(struct bench *b)
+{
+    memcpy(b->iovbuf, b->saved, b->iovlen);
+    return 0;
+}
+
+static krb5_error_code
+decrypt_c_iov(struct bench *b)
+{
+    return krb5_c_decrypt_iov(ctx, b->kb, 1, NULL, b->iov, b->niov);
+}
+
+static krb5_error_code
+decrypt_k_iov(struct bench *b)
+{
+    return krb5_k_decrypt_iov(ctx, b->key, 1, NULL, b->iov, b->niov);
+}
+
+static krb5_error_code
+checksum_c(struct bench *b)
+{
+    krb5_checksum sum;
+    krb5_error_code ret;
+
+    ret = krb5_c_make_checksum(ctx, b->cksumtype, b->kb, 1, &b->plain, &sum);
+    if (ret == 0)
+        krb5_free_checksum_contents(ctx, &sum);
+    return ret;
+}
+
+static krb5_error_code
+checksum_k(struct bench *b)
+{
+    krb5_checksum sum;
+    krb5_error_code ret;
+
+    ret = krb5_k_make_checksum(ctx, b->cksumtype, b->key, 1, &b->plain, &sum);
+    if (ret == 0)
+        krb5_free_checksum_contents(ctx, &sum);
+    return ret;
+}
+
+static krb5_error_code
+verify_c(struct bench *b)
+{
+    krb5_error_code ret;
+    krb5_boolean valid;
+
+    ret = krb5_c_verify_checksum(ctx, b->kb, 1, &b->plain, &b->sum, &valid);
+    return (ret == 0 && !valid) ? KRB5KRB_AP_ERR_BAD_INTEGRITY : ret;
+}
+
+static krb5_error_code
+verify_k(struct bench *b)
+{
+    krb5_error_code ret;
+    krb5_boolean valid;
+
+    ret = krb5_k_verify_checksum(ctx, b->key, 1, &b->plain, &b->sum, &valid);
+    return (ret == 0 && !valid) ? KRB5KRB_AP_ERR_BAD_INTEGRITY : ret;
+}
+
+static krb5_error_code
+checksum_c_iov(struct bench *b)
+{
+    return krb5_c_make_checksum_iov(ctx, b->cksumtype, b->kb, 1, b->iov,
+                                    b->niov);
+}
+
+static krb5_error_code
+checksum_k_iov(struct bench *b)
+{
+    return krb5_k_make_checksum_iov(ctx, b->cksumtype, b->key, 1, b->iov,
+                                    b->niov);
+}
+
+static krb5_error_code
+verify_c_iov(struct bench *b)
+{
+    krb5_error_code ret;
+    krb5_boolean valid;
+
+    ret = krb5_c_verify_checksum_iov(ctx, b->cksumtype, b->kb, 1, b->iov,
+                                     b->niov, &valid);
+    return (ret == 0 && !valid) ? KRB5KRB_AP_ERR_BAD_INTEGRITY : ret;
+}
+
+static krb5_error_code
+verify_k_iov(struct bench *b)
+{
+    krb5_error_code ret;
+    krb5_boolean valid;
+
+    ret = krb5_k_verify_checksum_iov(ctx, b->cksumtype, b->key, 1, b->iov,
+                                     b->niov, &valid);
+    return (ret == 0 && !valid) ? KRB5KRB_AP_ERR_BAD_INTEGRITY : ret;
+}
+
+static double
+secs_since(struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) +
+        (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/*
+ * Run fn repeatedly for at least min_secs and report its rate.  If reset is
+ * not NULL, it is run before each call to fn to restore the inputs fn
+ * consumes; the time taken by the same number of resets alone is measured
+ * afterwards and subtracted, so that the rate reflects fn only.
+ */
+static void
+measure(struct bench *b, bench_fn fn, bench_fn reset, const char *op,
+        const char *intf, const char *type)
+{
+    struct timeval start;
+    double elapsed, rate;
+    long count = 0, n = 1, i;
+
+    /* Run once untimed, so that the krb5_k functions can cache keys. */
+    if (reset != NULL)
+        check(reset(b));
+    check(fn(b));
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+        for (i = 0; i < n; i++) {
+            if (reset != NULL)
+                check(reset(b));
+            check(fn(b));
+        }
+        count += n;
+        elapsed = secs_since(&start);
+        if (elapsed >= min_secs)
+            break;
+        n *= 2;
+    }
+
+    if (reset != NULL) {
+        gettimeofday(&start, NULL);
+        for (i = 0; i < count; i++)
+            check(reset(b));
+        elapsed -= secs_since(&start);
+        if (elapsed <= 0)
+            elapsed = 1e-6;
+    }
+
+    rate = count / elapsed;
+    printf("%s\t%s\t%s\t%s\t%lu\t%.0f\t%.2f\n", CRYPTO_IMPL, op, intf, type,
+           (unsigned long)b->plain.length, rate,
+           rate * b->plain.length / 1000000.0);
+    fflush(stdout);
+}
+
+/* Point the IOV array at consecutive regions of iovbuf, using the lengths
+ * already present in b->iov, and fill the data region with test bytes. */
+static void
+layout_iov(struct bench *b)
+{
+    size_t i, total = 0;
+    char *p;
+
+    for (i = 0; i < b->niov; i++)
+        total += b->iov[i].data.length;
+    b->iovlen = total;
+    b->iovbuf = calloc(1, total ? total : 1);
+    b->saved = calloc(1, total ? total : 1);
+    assert(b->iovbuf != NULL && b->saved != NULL);
+    for (i = 0, p = b->iovbuf; i < b->niov; p += b->iov[i++].data.length) {
+        b->iov[i].data.data = p;
+        if (b->iov[i].flags == KRB5_CRYPTO_TYPE_DATA)
+            memcpy(p, b->plain.data, b->plain.length);
+    }
+}
+
+static void
+free_bench(struct bench *b)
+{
+    krb5_free_keyblock(ctx, b->kb);
+    krb5_k_free_key(ctx, b->key);
+    free(b->plain.data);
+    free(b->out.data);
+    free(b->cipher.ciphertext.data);
+    krb5_free_checksum_contents(ctx, &b->sum);
+    free(b->iovbuf);
+    free(b->saved);
+    memset(b, 0, sizeof(*b));
+}
+
+/* Set up the key and plaintext for a measurement. */
+static void
+init_bench(struct bench *b, krb5_enctype enctype, size_t size)
+{
+    size_t i;
+
+    memset(b, 0, sizeof(*b));
+    b->enctype = enctype;
+    if (enctype != 0) {
+        b->kb = malloc(sizeof(*b->kb));
+        assert(b->kb != NULL);
+        check(krb5_c_make_random_key(ctx, enctype, b->kb));
+        check(krb5_k_create_key(ctx, b->kb, &b->key));
+    }
+    check(alloc_data(&b->plain, size));
+    for (i = 0; i < size; i++)
+        b->plain.data[i] = i & 0xff;
+}
+
+static void
+bench_enctype(krb5_enctype enctype, size_t size)
+{
+    struct bench b;
+    size_t len;
+    char name[64];
+
+    check(krb5_enctype_to_name(enctype, TRUE, name, sizeof(name)));
+    init_bench(&b, enctype, size);
+
+    check(krb5_c_encrypt_length(ctx, enctype, size, &len));
+    b.cipher.enctype = enctype;
+    check(alloc_data(&b.cipher.ciphertext, len));
+    check(alloc_data(&b.out, len));
+    measure(&b, encrypt_c, NULL, "encrypt", "c", name);
+    measure(&b, encrypt_k, NULL, "encrypt", "k", name);
+    measure(&b, decrypt_c, NULL, "decrypt", "c", name);
+    measure(&b, decrypt_k, NULL, "decrypt", "k", name);
+
+    b.niov = 4;
+    b.iov[0].flags = KRB5_CRYPTO_TYPE_HEADER;
+    b.iov[1].flags = KRB5_CRYPTO_TYPE_DATA;
+    b.iov[1].data.length = size;
+    b.iov[2].flags = KRB5_CRYPTO_TYPE_PADDING;
+    b.iov[3].flags = KRB5_CRYPTO_TYPE_TRAILER;
+    check(krb5_c_crypto_length_iov(ctx, enctype, b.iov, b.niov));
+    layout_iov(&b);
+    measure(&b, encrypt_c_iov, NULL, "encrypt", "c-iov", name);
+    measure(&b, encrypt_k_iov, NULL, "encrypt", "k-iov", name);
+    memcpy(b.saved, b.iovbuf, b.iovlen);
+    measure(&b, decrypt_c_iov, restore_iov, "decrypt", "c-iov", name);
+    measure(&b, decrypt_k_iov, restore_iov, "decrypt", "k-iov", name);
+
+    free_bench(&b);
+}
+
+static void
+bench_cksumtype(const char *name, krb5_cksumtype cksumtype,
+                krb5_enctype enctype, size_t size)
+{
+    struct bench b;
+    size_t len;
+
+    init_bench(&b, enctype, size);
+    b.cksumtype = cksumtype;
+
+    check(krb5_c_make_checksum(ctx, cksumtype, b.kb, 1, &b.plain, &b.sum));
+    measure(&b, checksum_c, NULL, "checksum", "c", name);
+    measure(&b, verify_c, NULL, "verify", "c", name);
+    if (b.key != NULL) {
+        measure(&b, checksum_k, NULL, "checksum", "k", name);
+        measure(&b, verify_k, NULL, "verify", "k", name);
+    }
+
+    check(krb5_c_checksum_length(ctx, cksumtype, &len));
+    b.niov = 2;
+    b.iov[0].flags = KRB5_CRYPTO_TYPE_DATA;
+    b.iov[0].data.length = size;
+    b.iov[1].flags = KRB5_CRYPTO_TYPE_CHECKSUM;
+    b.iov[1].data.length = len;
+    layout_iov(&b);
+    measure(&b, checksum_c_iov, NULL, "checksum", "c-iov", name);
+    measure(&b, verify_c_iov, NULL, "verify", "c-iov", name);
+    if (b.key != NULL) {
+        measure(&b, checksum_k_iov, NULL, "checksum", "k-iov", name);
+        measure(&b, verify_k_iov, NULL, "verify", "k-iov", name);
+    }
+
+    free_bench(&b);
+}
+
+/* Return true if no types were named or if name or type is among them. */
+static krb5_boolean
+selected(char **types, int ntypes, krb5_enctype enctype, const char *name)
+{
+    krb5_enctype e;
+    int i;
+
+    if (ntypes == 0)
+        return TRUE;
+    for (i = 0; i < ntypes; i++) {
+        if (name != NULL && strcmp(types[i], name) == 0)
+            return TRUE;
+        if (enctype != 0 && krb5_string_to_enctype(types[i], &e) == 0 &&
+            e == enctype)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: t_cryptoperf [-t msecs] [-s size] ... "
+            "[type ...]\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t sizes[MAX_SIZES], nsizes = 0, i, j;
+    krb5_data seed;
+
+    for (argv++, argc--; argc > 0 && **argv == '-'; argv++, argc--) {
+        if (strcmp(*argv, "-t") == 0 && argc > 1) {
+            min_secs = atoi(*++argv) / 1000.0;
+            argc--;
+        } else if (strcmp(*argv, "-s") == 0 && argc > 1) {
+            if (nsizes == MAX_SIZES)
+                usage();
+            sizes[nsizes++] = atoi(*++argv);
+            argc--;
+        } else {
+            usage();
+        }
+    }
+    if (nsizes == 0) {
+        nsizes = sizeof(default_sizes) / sizeof(*default_sizes);
+        memcpy(sizes, default_sizes, sizeof(default_sizes));
+    }
+
+    check(krb5_init_context(&ctx));
+    seed.data = "notrandom";
+    seed.length = 9;
+    check(krb5_c_random_seed(ctx, &seed));
+
+    printf("# backend\top\tinterface\ttype\tsize\tops/s\tMB/s\n");
+    for (i = 0; enctypes[i] != 0; i++) {
+        if (!krb5_c_valid_enctype(enctypes[i]) ||
+            !selected(argv, argc, enctypes[i], NULL))
+            continue;
+        for (j = 0; j < nsizes; j++)
+            bench_enctype(enctypes[i], sizes[j]);
+    }
+    for (i = 0; cksumtypes[i].name != NULL; i++) {
+        if (!krb5_c_valid_cksumtype(cksumtypes[i].cksumtype) ||
+            !selected(argv, argc, 0, cksumtypes[i].name))
+            continue;
+        for (j = 0; j < nsizes; j++) {
+            bench_cksumtype(cksumtypes[i].name, cksumtypes[i].cksumtype,
+                            cksumtypes[i].enctype, sizes[j]);
+        }
+    }
+
+    krb5_free_context(ctx);
+    return 0;
+}
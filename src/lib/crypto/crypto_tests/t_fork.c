@@ -62,8 +62,10 @@ main()
     krb5_key key_aes, key_rc4;
     krb5_data state_rc4, plain = string2data("plain"), decrypted;
     krb5_enc_data out_aes, out_rc4;
+    char rnd_buf[32], child_rnd_buf[32];
+    krb5_data rnd = make_data(rnd_buf, sizeof(rnd_buf));
     pid_t pid;
-    int status;
+    int status, fds[2];
 
     /* Seed the PRNG instead of creating a context, so we don't need
      * krb5.conf. */
@@ -81,9 +83,14 @@ main()
     t(krb5_k_encrypt(ctx, key_aes, 0, NULL, &plain, &out_aes));
     t(krb5_k_encrypt(ctx, key_rc4, 0, &state_rc4, &plain, &out_rc4));
 
-    /* Fork; continue in both parent and child. */
+    /* Fork; continue in both parent and child.  The child reports its first
+     * random output to the parent through a pipe. */
+    assert(pipe(fds) == 0);
     pid = fork();
     assert(pid >= 0);
+    t(krb5_c_random_make_octets(ctx, &rnd));
+    if (pid == 0)
+        assert(write(fds[1], rnd_buf, sizeof(rnd_buf)) == sizeof(rnd_buf));
 
     /* Decrypt the AES message with both key and keyblock. */
     t(alloc_data(&decrypted, plain.length));
@@ -108,6 +115,14 @@ main()
             fprintf(stderr, "Child failed with status %d\n", status);
             return 1;
         }
+
+        /* The parent and child PRNG streams must differ after the fork. */
+        assert(read(fds[0], child_rnd_buf, sizeof(child_rnd_buf)) ==
+               sizeof(child_rnd_buf));
+        if (memcmp(rnd_buf, child_rnd_buf, sizeof(rnd_buf)) == 0) {
+            fprintf(stderr, "Child produced the same random output\n");
+            return 1;
+        }
     }
 
     return 0;
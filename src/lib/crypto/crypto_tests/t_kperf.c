@@ -38,6 +38,17 @@
  * first available keyed checksum type for aes256-cts, using the
  * caching APIs ('k').  Run commands under "time" to measure how much
  * time is used by the operations.
+ *
+ * The legacy enctypes can be measured the same way, e.g.:
+ *
+ *     ./t_kperf ke rc4-hmac 1024 100000
+ *     ./t_kperf km des-cbc-crc 1024 100000
+ *
+ * The 'h' operation computes unkeyed checksums, with type naming a
+ * checksum type instead of an enctype:
+ *
+ *     ./t_kperf ch crc32 1024 100000
+ *     ./t_kperf ch md4 1024 100000
  */
 
 #include "k5-int.h"
@@ -57,16 +68,29 @@ main(int argc, char **argv)
     krb5_boolean val;
 
     if (argc != 5) {
-        fprintf(stderr, "Usage: t_kperf {c|k}{e|d|m|v} type size nblocks\n");
+        fprintf(stderr, "Usage: t_kperf {c|k}{e|d|m|v|h} type size "
+                "nblocks\n");
         exit(1);
     }
     intf = argv[1][0];
     assert(intf == 'c' || intf =='k');
     op = argv[1][1];
-    assert(krb5_string_to_enctype(argv[2], &enctype) == 0);
     blocksize = atoi(argv[3]);
     num_blocks = atoi(argv[4]);
 
+    if (op == 'h') {
+        assert(krb5_string_to_cksumtype(argv[2], &cktype) == 0);
+        block.length = blocksize;
+        block.data = calloc(1, blocksize);
+        for (i = 0; i < num_blocks; i++) {
+            krb5_c_make_checksum(NULL, cktype, NULL, 0, &block, &sum);
+            krb5_free_checksum_contents(NULL, &sum);
+        }
+        return 0;
+    }
+
+    assert(krb5_string_to_enctype(argv[2], &enctype) == 0);
+
     block.data = "notrandom";
     block.length = 9;
     krb5_c_random_seed(NULL, &block);
@@ -101,12 +101,17 @@
 #define SHA256_HASHSIZE (256/8)
 
 /* Genarator - block cipher in CTR mode */
-struct fortuna_state
+struct generator
 {
-    /* Generator state. */
     unsigned char counter[AES256_BLOCKSIZE];
     unsigned char key[AES256_KEYSIZE];
     aes_ctx ciph;
+};
+
+struct fortuna_state
+{
+    /* Generator state. */
+    struct generator gen;
 
     /* Accumulator state. */
     SHA256_CTX pool[NUM_POOLS];
@@ -161,83 +166,87 @@ init_state(struct fortuna_state *st)
         shad256_init(&st->pool[i]);
 }
 
-/* Increment st->counter using least significant byte first. */
+/* Increment g->counter using least significant byte first. */
 static void
-inc_counter(struct fortuna_state *st)
+inc_counter(struct generator *g)
 {
     UINT64_TYPE val;
 
-    val = load_64_le(st->counter) + 1;
-    store_64_le(val, st->counter);
+    val = load_64_le(g->counter) + 1;
+    store_64_le(val, g->counter);
     if (val == 0) {
-        val = load_64_le(st->counter + 8) + 1;
-        store_64_le(val, st->counter + 8);
+        val = load_64_le(g->counter + 8) + 1;
+        store_64_le(val, g->counter + 8);
     }
 }
 
-/* Encrypt and increment st->counter in the current cipher context. */
+/* Encrypt and increment g->counter in the current cipher context. */
 static void
-encrypt_counter(struct fortuna_state *st, unsigned char *dst)
+encrypt_counter(struct generator *g, unsigned char *dst)
 {
-    krb5int_aes_enc_blk(st->counter, dst, &st->ciph);
-    inc_counter(st);
+    krb5int_aes_enc_blk(g->counter, dst, &g->ciph);
+    inc_counter(g);
 }
 
 /* Reseed the generator based on hopefully non-guessable input. */
 static void
-generator_reseed(struct fortuna_state *st, const unsigned char *data,
-                 size_t len)
+generator_reseed(struct generator *g, const unsigned char *data, size_t len)
 {
     SHA256_CTX ctx;
 
     /* Calculate SHA[d]-256(key||s) and make that the new key.  Depend on the
      * SHA-256 hash size being the AES-256 key size. */
     shad256_init(&ctx);
-    shad256_update(&ctx, st->key, AES256_KEYSIZE);
+    shad256_update(&ctx, g->key, AES256_KEYSIZE);
     shad256_update(&ctx, data, len);
-    shad256_result(&ctx, st->key);
+    shad256_result(&ctx, g->key);
     zap(&ctx, sizeof(ctx));
-    krb5int_aes_enc_key(st->key, AES256_KEYSIZE, &st->ciph);
+    krb5int_aes_enc_key(g->key, AES256_KEYSIZE, &g->ciph);
 
     /* Increment counter. */
-    inc_counter(st);
+    inc_counter(g);
 }
 
 /* Generate two blocks in counter mode and replace the key with the result. */
 static void
-change_key(struct fortuna_state *st)
+change_key(struct generator *g)
 {
-    encrypt_counter(st, st->key);
-    encrypt_counter(st, st->key + AES256_BLOCKSIZE);
-    krb5int_aes_enc_key(st->key, AES256_KEYSIZE, &st->ciph);
+    encrypt_counter(g, g->key);
+    encrypt_counter(g, g->key + AES256_BLOCKSIZE);
+    krb5int_aes_enc_key(g->key, AES256_KEYSIZE, &g->ciph);
 }
 
 /* Output pseudo-random data from the generator. */
 static void
-generator_output(struct fortuna_state *st, unsigned char *dst, size_t len)
+generator_output(struct generator *g, unsigned char *dst, size_t len)
 {
     unsigned char result[AES256_BLOCKSIZE];
-    size_t n, count = 0;
+    size_t count = 0;
 
     while (len > 0) {
-        /* Produce bytes and copy the result into dst. */
-        encrypt_counter(st, result);
-        n = (len < AES256_BLOCKSIZE) ? len : AES256_BLOCKSIZE;
-        memcpy(dst, result, n);
-        dst += n;
-        len -= n;
+        /* Produce bytes directly into dst, or via result for a partial
+         * final block. */
+        if (len >= AES256_BLOCKSIZE) {
+            encrypt_counter(g, dst);
+            dst += AES256_BLOCKSIZE;
+            len -= AES256_BLOCKSIZE;
+        } else {
+            encrypt_counter(g, result);
+            memcpy(dst, result, len);
+            zap(result, sizeof(result));
+            len = 0;
+        }
 
         /* Each time we reach MAX_BYTES_PER_KEY bytes, change the key. */
         count += AES256_BLOCKSIZE;
         if (count >= MAX_BYTES_PER_KEY) {
-            change_key(st);
+            change_key(g);
             count = 0;
         }
     }
-    zap(result, sizeof(result));
 
     /* Change the key after each request. */
-    change_key(st);
+    change_key(g);
 }
 
 /* Reseed the generator using the accumulator pools. */
@@ -266,7 +275,7 @@ accumulator_reseed(struct fortuna_state *st)
         shad256_update(&ctx, hash_result, SHA256_HASHSIZE);
     }
     shad256_result(&ctx, hash_result);
-    generator_reseed(st, hash_result, SHA256_HASHSIZE);
+    generator_reseed(&st->gen, hash_result, SHA256_HASHSIZE);
     zap(hash_result, SHA256_HASHSIZE);
     zap(&ctx, sizeof(ctx));
 
@@ -301,6 +310,110 @@ accumulator_add_event(struct fortuna_state *st, const unsigned char *data,
     shad256_update(pool, data, len);
 }
 
+static k5_mutex_t fortuna_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct fortuna_state main_state;
+static krb5_boolean have_entropy = FALSE;
+
+/*
+ * Incremented each time main_state is reseeded from a trusted source, so that
+ * thread generators pick up the new seed.  Only changed under fortuna_lock.
+ * Where the compiler provides atomic operations, it is read without the lock.
+ */
+static unsigned int main_generation;
+
+#ifdef __ATOMIC_ACQUIRE
+
+static krb5_error_code
+load_generation(unsigned int *gen_out)
+{
+    *gen_out = __atomic_load_n(&main_generation, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+static void
+advance_generation(void)
+{
+    __atomic_fetch_add(&main_generation, 1, __ATOMIC_RELEASE);
+}
+
+#else /* !__ATOMIC_ACQUIRE */
+
+static krb5_error_code
+load_generation(unsigned int *gen_out)
+{
+    krb5_error_code ret;
+
+    ret = k5_mutex_lock(&fortuna_lock);
+    if (ret)
+        return ret;
+    *gen_out = main_generation;
+    k5_mutex_unlock(&fortuna_lock);
+    return 0;
+}
+
+static void
+advance_generation(void)
+{
+    main_generation++;
+}
+
+#endif /* !__ATOMIC_ACQUIRE */
+
+/* Reseed main_state from a trusted source, such as the OS or a trusted party,
+ * and make each thread generator rekey before its next output.  Call with
+ * fortuna_lock held. */
+static void
+trusted_reseed(const unsigned char *data, size_t len)
+{
+    generator_reseed(&main_state.gen, data, len);
+    have_entropy = TRUE;
+    advance_generation();
+}
+
+/*
+ * To avoid taking fortuna_lock for every request, each thread produces output
+ * from its own generator, keyed from main_state's output.  A thread generator
+ * is rekeyed after a fork, after main_state is reseeded from a trusted
+ * source, after THREAD_RESEED_BYTES bytes of output, and at most once a
+ * second otherwise, so that accumulator reseeds still reach it.
+ */
+struct thread_state {
+    struct generator gen;
+#ifdef _WIN32
+    DWORD pid;
+#else
+    pid_t pid;
+#endif
+    unsigned int generation;
+    time_t seed_time;
+    size_t bytes;
+};
+
+/* Rekey a thread generator after it has produced this many bytes. */
+#define THREAD_RESEED_BYTES (1 << 16)
+
+/* Set *stale_out to true if ts must be rekeyed before producing output in
+ * process pid at time now. */
+static krb5_error_code
+check_thread_state(struct thread_state *ts,
+#ifdef _WIN32
+                   DWORD pid,
+#else
+                   pid_t pid,
+#endif
+                   time_t now, krb5_boolean *stale_out)
+{
+    krb5_error_code ret;
+    unsigned int generation;
+
+    ret = load_generation(&generation);
+    if (ret)
+        return ret;
+    *stale_out = (ts->pid != pid || ts->generation != generation ||
+                  ts->bytes >= THREAD_RESEED_BYTES || ts->seed_time != now);
+    return 0;
+}
+
 /* Limit dependencies for test program. */
 #ifndef TEST
 
@@ -338,17 +451,20 @@ accumulator_output(struct fortuna_state *st, unsigned char *dst, size_t len)
     if (st->pool0_bytes >= MIN_POOL_LEN && enough_time_passed(st))
         accumulator_reseed(st);
 
-    generator_output(st, dst, len);
+    generator_output(&st->gen, dst, len);
 }
 
-static k5_mutex_t fortuna_lock = K5_MUTEX_PARTIAL_INITIALIZER;
-static struct fortuna_state main_state;
 #ifdef _WIN32
 static DWORD last_pid;
 #else
 static pid_t last_pid;
 #endif
-static krb5_boolean have_entropy = FALSE;
+
+static void
+free_thread_state(void *ptr)
+{
+    zapfree(ptr, sizeof(struct thread_state));
+}
 
 int
 k5_prng_init(void)
@@ -359,6 +475,11 @@ k5_prng_init(void)
     ret = k5_mutex_finish_init(&fortuna_lock);
     if (ret)
         return ret;
+    ret = k5_key_register(K5_KEY_PRNG_STATE, free_thread_state);
+    if (ret) {
+        k5_mutex_destroy(&fortuna_lock);
+        return ret;
+    }
 
     init_state(&main_state);
 #ifdef _WIN32
@@ -367,7 +488,7 @@ k5_prng_init(void)
     last_pid = getpid();
 #endif
     if (k5_get_os_entropy(osbuf, sizeof(osbuf))) {
-        generator_reseed(&main_state, osbuf, sizeof(osbuf));
+        generator_reseed(&main_state.gen, osbuf, sizeof(osbuf));
         have_entropy = TRUE;
     }
 
@@ -379,6 +500,7 @@ k5_prng_cleanup(void)
 {
     have_entropy = FALSE;
     zap(&main_state, sizeof(main_state));
+    k5_key_delete(K5_KEY_PRNG_STATE);
     k5_mutex_destroy(&fortuna_lock);
 }
 
@@ -398,9 +520,7 @@ krb5_c_random_add_entropy(krb5_context context, unsigned int randsource,
         randsource == KRB5_C_RANDSOURCE_TRUSTEDPARTY) {
         /* These sources contain enough entropy that we should use them
          * immediately, so that they benefit the next request. */
-        generator_reseed(&main_state, (unsigned char *)indata->data,
-                         indata->length);
-        have_entropy = TRUE;
+        trusted_reseed((unsigned char *)indata->data, indata->length);
     } else {
         /* Other sources should just go into the pools and be used according to
          * the accumulator logic. */
@@ -411,8 +531,9 @@ krb5_c_random_add_entropy(krb5_context context, unsigned int randsource,
     return 0;
 }
 
-krb5_error_code KRB5_CALLCONV
-krb5_c_random_make_octets(krb5_context context, krb5_data *outdata)
+/* Key ts->gen from the output of main_state. */
+static krb5_error_code
+seed_thread_state(struct thread_state *ts)
 {
     krb5_error_code ret;
 #ifdef _WIN32
@@ -420,7 +541,7 @@ krb5_c_random_make_octets(krb5_context context, krb5_data *outdata)
 #else
     pid_t pid = getpid();
 #endif
-    unsigned char pidbuf[4];
+    unsigned char seed[AES256_KEYSIZE], pidbuf[4];
 
     ret = k5_mutex_lock(&fortuna_lock);
     if (ret)
@@ -434,13 +555,60 @@ krb5_c_random_make_octets(krb5_context context, krb5_data *outdata)
     if (pid != last_pid) {
         /* We forked; make sure child's PRNG stream differs from parent's. */
         store_32_be(pid, pidbuf);
-        generator_reseed(&main_state, pidbuf, 4);
+        generator_reseed(&main_state.gen, pidbuf, 4);
         last_pid = pid;
     }
 
-    accumulator_output(&main_state, (unsigned char *)outdata->data,
-                       outdata->length);
+    accumulator_output(&main_state, seed, sizeof(seed));
+    ts->generation = main_generation;
     k5_mutex_unlock(&fortuna_lock);
+
+    generator_reseed(&ts->gen, seed, sizeof(seed));
+    zap(seed, sizeof(seed));
+    ts->pid = pid;
+    ts->seed_time = time(NULL);
+    ts->bytes = 0;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV
+krb5_c_random_make_octets(krb5_context context, krb5_data *outdata)
+{
+    krb5_error_code ret;
+#ifdef _WIN32
+    DWORD pid = GetCurrentProcessId();
+#else
+    pid_t pid = getpid();
+#endif
+    struct thread_state *ts;
+    krb5_boolean stale;
+
+    ret = krb5int_crypto_init();
+    if (ret)
+        return ret;
+    ts = k5_getspecific(K5_KEY_PRNG_STATE);
+    if (ts == NULL) {
+        ts = calloc(1, sizeof(*ts));
+        if (ts == NULL)
+            return ENOMEM;
+        ret = seed_thread_state(ts);
+        if (!ret)
+            ret = k5_setspecific(K5_KEY_PRNG_STATE, ts);
+        if (ret) {
+            free_thread_state(ts);
+            return ret;
+        }
+    } else {
+        ret = check_thread_state(ts, pid, time(NULL), &stale);
+        if (!ret && stale)
+            ret = seed_thread_state(ts);
+        if (ret)
+            return ret;
+    }
+
+    generator_output(&ts->gen, (unsigned char *)outdata->data,
+                     outdata->length);
+    ts->bytes += outdata->length;
     return 0;
 }
 
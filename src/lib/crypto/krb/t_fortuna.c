@@ -91,7 +91,7 @@ head_tail_test(struct fortuna_state *st)
 
     memset(buffer, 0, len);
 
-    generator_output(st, buffer, len);
+    generator_output(&st->gen, buffer, len);
     for (i = 0; i < len; i++) {
         c = buffer[i];
         for (bit = 0; bit < 8 && c; bit++) {
@@ -117,27 +117,29 @@ main(int argc, char **argv)
 {
     struct fortuna_state test_state;
     struct fortuna_state *st = &test_state;
+    struct thread_state ts;
     static unsigned char buf[2 * 1024 * 1024];
     unsigned int i;
+    krb5_boolean stale;
 
     /* Seed the generator with a known state. */
     init_state(&test_state);
-    generator_reseed(st, (unsigned char *)"test", 4);
+    generator_reseed(&st->gen, (unsigned char *)"test", 4);
 
     /* Generate two pieces of output; key should change for each request. */
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
 
     /* Generate a lot of output to test key changes during request. */
-    generator_output(st, buf, sizeof(buf));
+    generator_output(&st->gen, buf, sizeof(buf));
     display(buf, 32);
     display(buf + sizeof(buf) - 32, 32);
 
     /* Reseed the generator and generate more output. */
-    generator_reseed(st, (unsigned char *)"retest", 6);
-    generator_output(st, buf, 32);
+    generator_reseed(&st->gen, (unsigned char *)"retest", 6);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
 
     /* Add sample data to accumulator pools. */
@@ -150,21 +152,41 @@ main(int argc, char **argv)
 
     /* Exercise accumulator reseeds. */
     accumulator_reseed(st);
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
     accumulator_reseed(st);
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
     accumulator_reseed(st);
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
     for (i = 0; i < 1000; i++)
         accumulator_reseed(st);
     assert(st->reseed_count == 1003);
-    generator_output(st, buf, 32);
+    generator_output(&st->gen, buf, 32);
     display(buf, 32);
 
     head_tail_test(st);
+
+    /* A thread generator seeded just now is used as is, until a trusted
+     * reseed of the main generator requires it to be rekeyed. */
+    assert(k5_mutex_finish_init(&fortuna_lock) == 0);
+    init_state(&main_state);
+    memset(&ts, 0, sizeof(ts));
+#ifdef _WIN32
+    ts.pid = GetCurrentProcessId();
+#else
+    ts.pid = getpid();
+#endif
+    ts.seed_time = time(NULL);
+    assert(load_generation(&ts.generation) == 0);
+    assert(check_thread_state(&ts, ts.pid, ts.seed_time, &stale) == 0);
+    assert(!stale);
+    assert(k5_mutex_lock(&fortuna_lock) == 0);
+    trusted_reseed((unsigned char *)"trusted", 7);
+    k5_mutex_unlock(&fortuna_lock);
+    assert(check_thread_state(&ts, ts.pid, ts.seed_time, &stale) == 0);
+    assert(stale);
     return 0;
 }
 
@@ -482,6 +482,17 @@ kadm5_ret_t    kadm5_get_principals(void *server_handle,
                                     char *exp, char ***princs,
                                     int *count);
 
+/*
+ * Like kadm5_get_principals, but return at most max names (if max is
+ * positive) in sorted order, starting with the first name greater than
+ * start_after (if it is not NULL).  Pass the last name of one page as
+ * start_after to fetch the next page.
+ */
+kadm5_ret_t    kadm5_get_principals_page(void *server_handle,
+                                         char *exp, char *start_after,
+                                         int max, char ***princs,
+                                         int *count);
+
 kadm5_ret_t    kadm5_get_policies(void *server_handle,
                                   char *exp, char ***pols,
                                   int *count);
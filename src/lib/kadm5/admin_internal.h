@@ -66,6 +66,8 @@ kadm5_ret_t _kadm5_chpass_principal_util(void *server_handle,
                                          char *msg_ret,
                                          unsigned int msg_len);
 
+void        kadm5int_trim_names(char **names, int *count, int max);
+
 /* this is needed by the alt_prof code I stole.  The functions
    maybe shouldn't be named krb5_*, but they are. */
 
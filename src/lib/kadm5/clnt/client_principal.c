@@ -213,6 +213,30 @@ kadm5_get_principals(void *server_handle,
     return r->code;
 }
 
+/* The RPC protocol has no paging; fetch the whole list and page it here. */
+kadm5_ret_t
+kadm5_get_principals_page(void *server_handle, char *exp, char *start_after,
+                          int max, char ***princs, int *count)
+{
+    kadm5_ret_t ret;
+    char **names;
+    int i, n, nkept = 0;
+
+    ret = kadm5_get_principals(server_handle, exp, &names, &n);
+    if (ret)
+        return ret;
+    for (i = 0; i < n; i++) {
+        if (start_after != NULL && strcmp(names[i], start_after) <= 0)
+            free(names[i]);
+        else
+            names[nkept++] = names[i];
+    }
+    kadm5int_trim_names(names, &nkept, max);
+    *princs = names;
+    *count = nkept;
+    return KADM5_OK;
+}
+
 kadm5_ret_t
 kadm5_rename_principal(void *server_handle,
                        krb5_principal source, krb5_principal dest)
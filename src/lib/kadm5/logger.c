@@ -161,6 +161,336 @@ static struct log_entry def_log_entry;
                                  -1)
 #define DEVICE_CLOSE(d)         fclose(d)
 
+/*
+ * A formatted log message.  For messages from com_err, priority is the
+ * priority given in the format string or -1, and is combined with the
+ * facility and default severity of each syslog destination.
+ */
+struct log_msg {
+    int                 priority;
+    krb5_boolean        from_com_err;
+    size_t              syslog_off;     /* Offset of the text after the
+                                         * header, for syslog */
+    char                text[KRB5_KLOG_MAX_ERRMSG_SIZE];
+};
+
+static int
+format_msg(struct log_msg *msg, int priority, const char *format, ...)
+#if !defined(__cplusplus) && (__GNUC__ > 2)
+    __attribute__((__format__(__printf__, 3, 4)))
+#endif
+    ;
+
+/* Write msg to each log destination.  Flush file destinations if flush is
+ * true. */
+static void
+write_msg(const struct log_msg *msg, krb5_boolean flush)
+{
+    int lindex;
+    struct log_entry *le;
+#ifdef  HAVE_SYSLOG
+    int log_pri;
+#endif  /* HAVE_SYSLOG */
+
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        le = &log_control.log_entries[lindex];
+        switch (le->log_type) {
+        case K_LOG_FILE:
+        case K_LOG_STDERR:
+            /*
+             * Files/standard error.
+             */
+            if (fprintf(le->lfu_filep, "%s\n", msg->text) < 0) {
+                /* Attempt to report error */
+                fprintf(stderr, log_file_err, log_control.log_whoami,
+                        le->lfu_fname);
+            }
+            else if (flush) {
+                fflush(le->lfu_filep);
+            }
+            break;
+        case K_LOG_CONSOLE:
+        case K_LOG_DEVICE:
+            /*
+             * Devices (may need special handling)
+             */
+            if (DEVICE_PRINT(le->ldu_filep, msg->text) < 0) {
+                /* Attempt to report error */
+                fprintf(stderr, log_device_err, log_control.log_whoami,
+                        le->ldu_devname);
+            }
+            break;
+#ifdef  HAVE_SYSLOG
+        case K_LOG_SYSLOG:
+            /*
+             * System log.  For com_err messages, use the priority from the
+             * format string if there was one, otherwise the default.
+             */
+            log_pri = msg->priority;
+            if (msg->from_com_err && log_pri >= 0)
+                log_pri |= le->lsu_facility;
+            else if (msg->from_com_err)
+                log_pri = le->lsu_facility | le->lsu_severity;
+
+            /* Log the message with our header trimmed off */
+            syslog(log_pri, "%s", msg->text + msg->syslog_off);
+            break;
+#endif /* HAVE_SYSLOG */
+        default:
+            break;
+        }
+    }
+}
+
+#ifdef ENABLE_THREADS
+/*
+ * If async is set in the [logging] section, messages are copied into a
+ * bounded ring and written by a background thread, so that a slow log file
+ * or a backed-up syslog daemon does not stall request processing.  The
+ * writer takes every queued message at once and flushes file destinations
+ * once per batch.  If the ring is full, the message is dropped and counted
+ * (a notice is logged once there is room again), or, if async_overflow is
+ * "block", the caller waits for room.
+ *
+ * Callers hold the queue mutex only to copy a message into a slot; the
+ * writer holds it only to claim and release a batch, and writes the claimed
+ * slots without it.  Before a fork, the queue is drained so that no message
+ * is lost or written twice; the child starts its own writer when it next
+ * logs a message.
+ */
+#define DEFAULT_ASYNC_QUEUE_SIZE 512
+
+struct log_queue {
+    pthread_mutex_t     lock;
+    pthread_cond_t      nonempty;       /* Signalled when a message is
+                                         * queued or on shutdown */
+    pthread_cond_t      progress;       /* Signalled when a batch has been
+                                         * written */
+    struct log_msg      *slots;
+    unsigned long       size;
+    unsigned long       head;           /* Next message to write */
+    unsigned long       tail;           /* Next slot to fill */
+    unsigned long       dropped;        /* Messages dropped in total */
+    unsigned long       unreported;     /* Drops not yet noted in the log */
+    krb5_boolean        block;
+    krb5_boolean        busy;           /* Writer is writing a batch */
+    krb5_boolean        running;
+    krb5_boolean        shutdown;
+    pthread_t           thread;
+};
+
+static struct log_queue *log_queue;
+static krb5_boolean atfork_registered;
+
+static void *
+log_writer(void *arg)
+{
+    struct log_queue *q = arg;
+    unsigned long i, end;
+
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (q->head == q->tail && !q->shutdown)
+            pthread_cond_wait(&q->nonempty, &q->lock);
+        if (q->head == q->tail)
+            break;
+
+        /* Callers will not touch slots between head and tail until we
+         * advance head, so write them without the lock. */
+        end = q->tail;
+        q->busy = TRUE;
+        pthread_mutex_unlock(&q->lock);
+        for (i = q->head; i != end; i++)
+            write_msg(&q->slots[i % q->size], FALSE);
+        for (i = 0; i < (unsigned long) log_control.log_nentries; i++) {
+            if (log_control.log_entries[i].log_type == K_LOG_FILE ||
+                log_control.log_entries[i].log_type == K_LOG_STDERR)
+                fflush(log_control.log_entries[i].lfu_filep);
+        }
+        pthread_mutex_lock(&q->lock);
+        q->head = end;
+        q->busy = FALSE;
+        pthread_cond_broadcast(&q->progress);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+/* Lock the queue once the writer has written everything queued, so that the
+ * log destinations can be safely changed or the process can fork. */
+static void
+drain_and_lock(struct log_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->running && (q->busy || q->head != q->tail))
+        pthread_cond_wait(&q->progress, &q->lock);
+}
+
+static void
+atfork_prepare(void)
+{
+    if (log_queue != NULL)
+        drain_and_lock(log_queue);
+}
+
+static void
+atfork_parent(void)
+{
+    if (log_queue != NULL)
+        pthread_mutex_unlock(&log_queue->lock);
+}
+
+/* The writer thread does not exist in the child, and may have been waiting
+ * on a condition variable, so reinitialize the synchronization objects. */
+static void
+atfork_child(void)
+{
+    struct log_queue *q = log_queue;
+
+    if (q == NULL)
+        return;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->nonempty, NULL);
+    pthread_cond_init(&q->progress, NULL);
+    q->running = q->busy = FALSE;
+}
+
+/* Set up asynchronous logging if the [logging] section asks for it. */
+static void
+async_init(profile_t profile)
+{
+    struct log_queue *q;
+    int async, size;
+    char *overflow = NULL;
+
+    if (log_queue != NULL)
+        return;
+    if (profile_get_boolean(profile, KRB5_CONF_LOGGING, KRB5_CONF_ASYNC,
+                            NULL, 0, &async) != 0 || !async)
+        return;
+    if (profile_get_integer(profile, KRB5_CONF_LOGGING,
+                            KRB5_CONF_ASYNC_QUEUE_SIZE, NULL,
+                            DEFAULT_ASYNC_QUEUE_SIZE, &size) != 0 ||
+        size <= 0)
+        size = DEFAULT_ASYNC_QUEUE_SIZE;
+
+    q = calloc(1, sizeof(*q));
+    if (q == NULL)
+        return;
+    q->size = size;
+    q->slots = calloc(q->size, sizeof(*q->slots));
+    if (q->slots == NULL) {
+        free(q);
+        return;
+    }
+    if (profile_get_string(profile, KRB5_CONF_LOGGING,
+                           KRB5_CONF_ASYNC_OVERFLOW, NULL, "drop",
+                           &overflow) == 0 && overflow != NULL) {
+        q->block = (strcasecmp(overflow, "block") == 0);
+        profile_release_string(overflow);
+    }
+    if (!atfork_registered) {
+        if (pthread_atfork(atfork_prepare, atfork_parent, atfork_child)) {
+            free(q->slots);
+            free(q);
+            return;
+        }
+        atfork_registered = TRUE;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->nonempty, NULL);
+    pthread_cond_init(&q->progress, NULL);
+    log_queue = q;
+}
+
+/* Write any queued messages, stop the writer thread, and free the queue. */
+static void
+async_fini(void)
+{
+    struct log_queue *q = log_queue;
+
+    if (q == NULL)
+        return;
+    pthread_mutex_lock(&q->lock);
+    q->shutdown = TRUE;
+    pthread_cond_signal(&q->nonempty);
+    pthread_mutex_unlock(&q->lock);
+    if (q->running)
+        pthread_join(q->thread, NULL);
+    log_queue = NULL;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->nonempty);
+    pthread_cond_destroy(&q->progress);
+    free(q->slots);
+    free(q);
+}
+
+/* Copy msg into the next free slot of q, which must have one. */
+static void
+enqueue(struct log_queue *q, const struct log_msg *msg)
+{
+    struct log_msg *slot = &q->slots[q->tail % q->size];
+
+    slot->priority = msg->priority;
+    slot->from_com_err = msg->from_com_err;
+    slot->syslog_off = msg->syslog_off;
+    strlcpy(slot->text, msg->text, sizeof(slot->text));
+    q->tail++;
+}
+
+/* Queue msg for the writer thread, starting the thread if necessary.  Return
+ * false if the message must be written synchronously. */
+static krb5_boolean
+queue_msg(const struct log_msg *msg)
+{
+    struct log_queue *q = log_queue;
+    struct log_msg notice;
+
+    if (q == NULL)
+        return FALSE;
+    pthread_mutex_lock(&q->lock);
+    if (!q->running) {
+        q->shutdown = FALSE;
+        if (pthread_create(&q->thread, NULL, log_writer, q) != 0) {
+            pthread_mutex_unlock(&q->lock);
+            return FALSE;
+        }
+        q->running = TRUE;
+    }
+    while (q->block && q->tail - q->head >= q->size)
+        pthread_cond_wait(&q->progress, &q->lock);
+
+    if (q->unreported > 0 && q->tail - q->head < q->size - 1) {
+        if (format_msg(&notice, LOG_ERR,
+                       _("%lu log messages dropped (%lu total)"),
+                       q->unreported, q->dropped) == 0)
+            enqueue(q, &notice);
+        q->unreported = 0;
+    }
+    if (q->tail - q->head < q->size) {
+        enqueue(q, msg);
+        pthread_cond_signal(&q->nonempty);
+    } else {
+        q->dropped++;
+        q->unreported++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return TRUE;
+}
+#endif /* ENABLE_THREADS */
+
+/* Queue msg for the writer thread if logging is asynchronous, or else write
+ * it. */
+static void
+log_msg(const struct log_msg *msg)
+{
+#ifdef ENABLE_THREADS
+    if (queue_msg(msg))
+        return;
+#endif
+    write_msg(msg, TRUE);
+}
+
 
 /*
  * klog_com_err_proc()  - Handle com_err(3) messages as specified by the
@@ -178,34 +508,31 @@ klog_com_err_proc(const char *whoami, long int code, const char *format, va_list
 static void
 klog_com_err_proc(const char *whoami, long int code, const char *format, va_list ap)
 {
-    char        outbuf[KRB5_KLOG_MAX_ERRMSG_SIZE];
-    int         lindex;
+    struct log_msg msg;
+    char        *outbuf = msg.text;
     const char  *actual_format;
-#ifdef  HAVE_SYSLOG
     int         log_pri = -1;
-#endif  /* HAVE_SYSLOG */
     char        *cp;
-    char        *syslogp;
 
     if (whoami == NULL || format == NULL)
         return;
 
     /* Make the header */
-    snprintf(outbuf, sizeof(outbuf), "%s: ", whoami);
+    snprintf(outbuf, sizeof(msg.text), "%s: ", whoami);
     /*
      * Squirrel away address after header for syslog since syslog makes
      * a header
      */
-    syslogp = &outbuf[strlen(outbuf)];
+    msg.syslog_off = strlen(outbuf);
 
     /* If reporting an error message, separate it. */
     if (code) {
         const char *emsg;
-        outbuf[sizeof(outbuf) - 1] = '\0';
+        outbuf[sizeof(msg.text) - 1] = '\0';
 
         emsg = krb5_get_error_message (err_context, code);
-        strncat(outbuf, emsg, sizeof(outbuf) - 1 - strlen(outbuf));
-        strncat(outbuf, " - ", sizeof(outbuf) - 1 - strlen(outbuf));
+        strncat(outbuf, emsg, sizeof(msg.text) - 1 - strlen(outbuf));
+        strncat(outbuf, " - ", sizeof(msg.text) - 1 - strlen(outbuf));
         krb5_free_error_message(err_context, emsg);
     }
     cp = &outbuf[strlen(outbuf)];
@@ -267,66 +594,17 @@ klog_com_err_proc(const char *whoami, long int code, const char *format, va_list
 #endif  /* HAVE_SYSLOG */
 
     /* Now format the actual message */
-    vsnprintf(cp, sizeof(outbuf) - (cp - outbuf), actual_format, ap);
+    vsnprintf(cp, sizeof(msg.text) - (cp - outbuf), actual_format, ap);
 
     /*
      * Now that we have the message formatted, perform the output to each
      * logging specification.
      */
-    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
-        switch (log_control.log_entries[lindex].log_type) {
-        case K_LOG_FILE:
-        case K_LOG_STDERR:
-            /*
-             * Files/standard error.
-             */
-            if (fprintf(log_control.log_entries[lindex].lfu_filep, "%s\n",
-                        outbuf) < 0) {
-                /* Attempt to report error */
-                fprintf(stderr, log_file_err, whoami,
-                        log_control.log_entries[lindex].lfu_fname);
-            }
-            else {
-                fflush(log_control.log_entries[lindex].lfu_filep);
-            }
-            break;
-        case K_LOG_CONSOLE:
-        case K_LOG_DEVICE:
-            /*
-             * Devices (may need special handling)
-             */
-            if (DEVICE_PRINT(log_control.log_entries[lindex].ldu_filep,
-                             outbuf) < 0) {
-                /* Attempt to report error */
-                fprintf(stderr, log_device_err, whoami,
-                        log_control.log_entries[lindex].ldu_devname);
-            }
-            break;
-#ifdef  HAVE_SYSLOG
-        case K_LOG_SYSLOG:
-            /*
-             * System log.
-             */
-            /*
-             * If we have specified a priority through our hackery, then
-             * use it, otherwise use the default.
-             */
-            if (log_pri >= 0)
-                log_pri |= log_control.log_entries[lindex].lsu_facility;
-            else
-                log_pri = log_control.log_entries[lindex].lsu_facility |
-                    log_control.log_entries[lindex].lsu_severity;
-
-            /* Log the message with our header trimmed off */
-            syslog(log_pri, "%s", syslogp);
-            break;
-#endif /* HAVE_SYSLOG */
-        default:
-            break;
-        }
-    }
+    msg.priority = log_pri;
+    msg.from_com_err = TRUE;
+    log_msg(&msg);
 }
-
+
 /*
  * krb5_klog_init()     - Initialize logging.
  *
@@ -681,6 +959,9 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
             log_control.log_opened = 1;
         }
 #endif /* HAVE_OPENLOG */
+#ifdef ENABLE_THREADS
+        async_init(kcontext->profile);
+#endif
         if (do_com_err)
             (void) set_com_err_hook(klog_com_err_proc);
     }
@@ -695,6 +976,9 @@ krb5_klog_close(krb5_context kcontext)
 {
     int lindex;
     (void) reset_com_err_hook();
+#ifdef ENABLE_THREADS
+    async_fini();
+#endif
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         switch (log_control.log_entries[lindex].log_type) {
         case K_LOG_FILE:
@@ -794,23 +1078,20 @@ severity2string(int severity)
     return(ss);
 }
 
-/*
- * krb5_klog_syslog()   - Simulate the calling sequence of syslog(3), while
- *                        also performing the logging redirection as specified
- *                        by krb5_klog_init().
- */
+/* Format a syslog-esque message into msg. */
 static int
-klog_vsyslog(int priority, const char *format, va_list arglist)
+vformat_msg(struct log_msg *msg, int priority, const char *format,
+            va_list arglist)
 #if !defined(__cplusplus) && (__GNUC__ > 2)
-    __attribute__((__format__(__printf__, 2, 0)))
+    __attribute__((__format__(__printf__, 3, 0)))
 #endif
     ;
 
 static int
-klog_vsyslog(int priority, const char *format, va_list arglist)
+vformat_msg(struct log_msg *msg, int priority, const char *format,
+            va_list arglist)
 {
-    char        outbuf[KRB5_KLOG_MAX_ERRMSG_SIZE];
-    int         lindex;
+    char        *outbuf = msg->text;
     char        *syslogp;
     char        *cp;
     time_t      now;
@@ -833,7 +1114,8 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
     /*
      * Format the date: mon dd hh:mm:ss
      */
-    soff = strftime(outbuf, sizeof(outbuf), "%b %d %H:%M:%S", localtime(&now));
+    soff = strftime(outbuf, sizeof(msg->text), "%b %d %H:%M:%S",
+                    localtime(&now));
     if (soff > 0)
         cp += soff;
     else
@@ -849,18 +1131,57 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
     cp += 15;
 #endif  /* HAVE_STRFTIME */
 #ifdef VERBOSE_LOGS
-    snprintf(cp, sizeof(outbuf) - (cp-outbuf), " %s %s[%ld](%s): ",
+    snprintf(cp, sizeof(msg->text) - (cp-outbuf), " %s %s[%ld](%s): ",
              log_control.log_hostname ? log_control.log_hostname : "",
              log_control.log_whoami ? log_control.log_whoami : "",
              (long) getpid(),
              severity2string(priority));
 #else
-    snprintf(cp, sizeof(outbuf) - (cp-outbuf), " ");
+    snprintf(cp, sizeof(msg->text) - (cp-outbuf), " ");
 #endif
     syslogp = &outbuf[strlen(outbuf)];
 
     /* Now format the actual message */
-    vsnprintf(syslogp, sizeof(outbuf) - (syslogp - outbuf), format, arglist);
+    vsnprintf(syslogp, sizeof(msg->text) - (syslogp - outbuf), format,
+              arglist);
+
+    msg->priority = priority;
+    msg->from_com_err = FALSE;
+    msg->syslog_off = syslogp - outbuf;
+    return(0);
+}
+
+static int
+format_msg(struct log_msg *msg, int priority, const char *format, ...)
+{
+    int         retval;
+    va_list     pvar;
+
+    va_start(pvar, format);
+    retval = vformat_msg(msg, priority, format, pvar);
+    va_end(pvar);
+    return(retval);
+}
+
+/*
+ * krb5_klog_syslog()   - Simulate the calling sequence of syslog(3), while
+ *                        also performing the logging redirection as specified
+ *                        by krb5_klog_init().
+ */
+static int
+klog_vsyslog(int priority, const char *format, va_list arglist)
+#if !defined(__cplusplus) && (__GNUC__ > 2)
+    __attribute__((__format__(__printf__, 2, 0)))
+#endif
+    ;
+
+static int
+klog_vsyslog(int priority, const char *format, va_list arglist)
+{
+    struct log_msg msg;
+
+    if (vformat_msg(&msg, priority, format, arglist) != 0)
+        return(-1);
 
     /*
      * If the user did not use krb5_klog_init() instead of dropping
@@ -869,7 +1190,7 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
 #ifdef HAVE_SYSLOG
     if (log_control.log_nentries == 0) {
         /* Log the message with our header trimmed off */
-        syslog(priority, "%s", syslogp);
+        syslog(priority, "%s", msg.text + msg.syslog_off);
     }
 #endif
 
@@ -877,49 +1198,7 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
      * Now that we have the message formatted, perform the output to each
      * logging specification.
      */
-    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
-        switch (log_control.log_entries[lindex].log_type) {
-        case K_LOG_FILE:
-        case K_LOG_STDERR:
-            /*
-             * Files/standard error.
-             */
-            if (fprintf(log_control.log_entries[lindex].lfu_filep, "%s\n",
-                        outbuf) < 0) {
-                /* Attempt to report error */
-                fprintf(stderr, log_file_err, log_control.log_whoami,
-                        log_control.log_entries[lindex].lfu_fname);
-            }
-            else {
-                fflush(log_control.log_entries[lindex].lfu_filep);
-            }
-            break;
-        case K_LOG_CONSOLE:
-        case K_LOG_DEVICE:
-            /*
-             * Devices (may need special handling)
-             */
-            if (DEVICE_PRINT(log_control.log_entries[lindex].ldu_filep,
-                             outbuf) < 0) {
-                /* Attempt to report error */
-                fprintf(stderr, log_device_err, log_control.log_whoami,
-                        log_control.log_entries[lindex].ldu_devname);
-            }
-            break;
-#ifdef  HAVE_SYSLOG
-        case K_LOG_SYSLOG:
-            /*
-             * System log.
-             */
-
-            /* Log the message with our header trimmed off */
-            syslog(priority, "%s", syslogp);
-            break;
-#endif /* HAVE_SYSLOG */
-        default:
-            break;
-        }
-    }
+    log_msg(&msg);
     return(0);
 }
 
@@ -948,6 +1227,12 @@ krb5_klog_reopen(krb5_context kcontext)
     int lindex;
     FILE *f;
 
+#ifdef ENABLE_THREADS
+    /* Keep the writer thread away from the files while we reopen them. */
+    if (log_queue != NULL)
+        drain_and_lock(log_queue);
+#endif
+
     /*
      * Only logs which are actually files need to be closed
      * and reopened in response to a SIGHUP
@@ -970,4 +1255,8 @@ krb5_klog_reopen(krb5_context kcontext)
             }
         }
     }
+#ifdef ENABLE_THREADS
+    if (log_queue != NULL)
+        pthread_mutex_unlock(&log_queue->lock);
+#endif
 }
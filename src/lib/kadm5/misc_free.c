@@ -29,6 +29,23 @@ kadm5_free_name_list(void *server_handle, char **names, int count)
     return KADM5_OK;
 }
 
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+/* Sort names and free all but the first max of them (if max is positive). */
+void
+kadm5int_trim_names(char **names, int *count, int max)
+{
+    qsort(names, *count, sizeof(*names), compare_names);
+    if (max <= 0)
+        return;
+    while (*count > max)
+        free(names[--*count]);
+}
+
 /* XXX this ought to be in libkrb5.a, but isn't */
 kadm5_ret_t krb5_free_key_data_contents(context, key)
     krb5_context context;
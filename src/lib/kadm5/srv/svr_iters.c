@@ -34,6 +34,8 @@ struct iter_data {
     char **names;
     int n_names, sz_names;
     unsigned int malloc_failed;
+    char *start_after;
+    int max;
     char *exp;
 #ifdef SOLARIS_REGEXPS
     char *expbuf;
@@ -139,6 +141,9 @@ static void get_either_iter(struct iter_data *data, char *name)
 #ifdef BSD_REGEXPS
     match = (re_exec(name) != 0);
 #endif
+    if (match && data->start_after != NULL &&
+        strcmp(name, data->start_after) <= 0)
+        match = 0;
     if (match) {
         if (data->n_names == data->sz_names) {
             int new_sz = data->sz_names * 2;
@@ -154,6 +159,9 @@ static void get_either_iter(struct iter_data *data, char *name)
             }
         }
         data->names[data->n_names++] = name;
+        /* Keep memory bounded when only a page of results is wanted. */
+        if (data->max > 0 && data->n_names >= 2 * data->max)
+            kadm5int_trim_names(data->names, &data->n_names, data->max);
     } else
         free(name);
 }
@@ -177,9 +185,16 @@ static void get_princs_iter(void *data, krb5_principal princ)
     get_either_iter(data, name);
 }
 
+/*
+ * The glob is passed to the KDB module, which may use it to narrow the
+ * iteration (for example, to a key range sharing its literal prefix); every
+ * name returned is still checked against the full pattern here.
+ */
 static kadm5_ret_t kadm5_get_either(int princ,
                                     void *server_handle,
                                     char *exp,
+                                    char *start_after,
+                                    int max,
                                     char ***princs,
                                     int *count)
 {
@@ -222,6 +237,8 @@ static kadm5_ret_t kadm5_get_either(int princ,
     data.n_names = 0;
     data.sz_names = 10;
     data.malloc_failed = 0;
+    data.start_after = start_after;
+    data.max = max;
     data.names = malloc(sizeof(char *) * data.sz_names);
     if (data.names == NULL) {
         free(regexp);
@@ -248,6 +265,8 @@ static kadm5_ret_t kadm5_get_either(int princ,
         return ret;
     }
 
+    if (start_after != NULL || max > 0)
+        kadm5int_trim_names(data.names, &data.n_names, max);
     *princs = data.names;
     *count = data.n_names;
     return KADM5_OK;
@@ -258,7 +277,18 @@ kadm5_ret_t kadm5_get_principals(void *server_handle,
                                  char ***princs,
                                  int *count)
 {
-    return kadm5_get_either(1, server_handle, exp, princs, count);
+    return kadm5_get_either(1, server_handle, exp, NULL, 0, princs, count);
+}
+
+kadm5_ret_t kadm5_get_principals_page(void *server_handle,
+                                      char *exp,
+                                      char *start_after,
+                                      int max,
+                                      char ***princs,
+                                      int *count)
+{
+    return kadm5_get_either(1, server_handle, exp, start_after, max, princs,
+                            count);
 }
 
 kadm5_ret_t kadm5_get_policies(void *server_handle,
@@ -266,5 +296,5 @@ kadm5_ret_t kadm5_get_policies(void *server_handle,
                                char ***pols,
                                int *count)
 {
-    return kadm5_get_either(0, server_handle, exp, pols, count);
+    return kadm5_get_either(0, server_handle, exp, NULL, 0, pols, count);
 }
@@ -59,33 +59,45 @@ ulog_lock(krb5_context ctx, int mode)
 }
 
 /*
- * Sync update entry to disk.
+ * Sync len bytes of the mapped log, starting at addr, to disk.
  */
 static krb5_error_code
-ulog_sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
+ulog_sync_range(void *addr, ulong_t len)
 {
     ulong_t             start, end, size;
-    krb5_error_code     retval;
-
-    if (ulog == NULL)
-        return (KRB5_LOG_ERROR);
 
     if (!pagesize)
         pagesize = getpagesize();
 
-    start = ((ulong_t)upd) & (~(pagesize-1));
+    start = ((ulong_t)addr) & (~(pagesize-1));
 
-    end = (((ulong_t)upd) + ulog->kdb_block +
+    end = (((ulong_t)addr) + len +
            (pagesize-1)) & (~(pagesize-1));
 
     size = end - start;
-    if ((retval = msync((caddr_t)start, size, MS_SYNC))) {
-        return (retval);
-    }
+    if (msync((caddr_t)start, size, MS_SYNC))
+        return (errno);
 
     return (0);
 }
 
+/*
+ * Sync update entry, and the encoded update it refers to, to disk.
+ */
+static krb5_error_code
+ulog_sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
+{
+    krb5_error_code     retval;
+
+    if (ulog == NULL)
+        return (KRB5_LOG_ERROR);
+
+    if ((retval = ulog_sync_range(upd, ulog->kdb_block)))
+        return (retval);
+
+    return (ulog_sync_range(ENTRY_DATA(ulog, upd), upd->kdb_entry_size));
+}
+
 /*
  * Sync memory to disk for the update log header.
  */
@@ -106,51 +118,107 @@ ulog_sync_header(kdb_hlog_t *ulog)
 }
 
 /*
- * Resizes the array elements.  We reinitialize the update log rather than
- * unrolling the the log and copying it over to a temporary log for obvious
- * performance reasons.  Slaves will subsequently do a full resync, but
- * the need for resizing should be very small.
+ * Reinitialize the update log header, discarding all of the entries.  The
+ * index is sized for the number of entries the log was mapped with, and the
+ * data area starts out empty.  The caller syncs the header if needed.
  */
-static krb5_error_code
-ulog_resize(kdb_hlog_t *ulog, uint32_t ulogentries, int ulogfd, uint_t recsize)
+void
+ulog_init_header(krb5_context context)
 {
-    uint_t              new_block, new_size;
+    kdb_log_context     *log_ctx;
+    kdb_hlog_t          *ulog = NULL;
 
-    if (ulog == NULL)
-        return (KRB5_LOG_ERROR);
+    INIT_ULOG(context);
+
+    (void) memset(ulog, 0, sizeof (kdb_hlog_t));
+
+    ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
+    ulog->db_version_num = KDB_VERSION;
+    ulog->kdb_state = KDB_STABLE;
+    ulog->kdb_block = sizeof (kdb_ent_header_t);
+    ulog->kdb_nslots = log_ctx->ulogentries;
+}
+
+/*
+ * Return true if the encoded update of indx_log overlaps the data area
+ * offsets [start, end).
+ */
+static int
+ulog_overlaps(kdb_ent_header_t *indx_log, uint_t start, uint_t end)
+{
+    return (indx_log->kdb_entry_off < end &&
+            indx_log->kdb_entry_off + indx_log->kdb_entry_size > start);
+}
 
-    new_size = sizeof (kdb_hlog_t);
+/*
+ * Find room in the data area for an encoded update of size bytes, and return
+ * its offset in *off_out.  The data area is used as a ring: each update
+ * follows the previous one, or starts again at the beginning of the area if
+ * it does not fit before the end.  The oldest entries are discarded when
+ * their updates are in the way, or when every index entry is in use.  While
+ * there are unused index entries, the data area is grown instead of reused,
+ * so it settles at the size needed to hold a full ring of entries.
+ */
+static krb5_error_code
+ulog_reserve(kdb_hlog_t *ulog, int ulogfd, uint_t size, uint32_t *off_out)
+{
+    kdb_ent_header_t    *indx_log;
+    uint_t              base, off, skip_end, new_size;
 
-    new_block = (recsize / ULOG_BLOCK) + 1;
-    new_block *= ULOG_BLOCK;
+    base = sizeof (kdb_hlog_t) + ulog->kdb_nslots * ulog->kdb_block;
+    off = ulog->kdb_data_next;
+    skip_end = off;
 
-    new_size += ulogentries * new_block;
+    if (off + size > ulog->kdb_data_size) {
+        if ((ulog->kdb_num < ulog->kdb_nslots ||
+             size > ulog->kdb_data_size) &&
+            base + off + size <= MAXLOGLEN) {
+            /*
+             * Grow the data area, but not past MAXLOGLEN, which is as
+             * much as we map
+             */
+            new_size = ulog->kdb_data_size + ULOG_GROW;
+            if (new_size < off + size)
+                new_size = off + size;
+            if (base + new_size > MAXLOGLEN)
+                new_size = MAXLOGLEN - base;
 
-    if (new_size <= MAXLOGLEN) {
-        /*
-         * Reinit log with new block size
-         */
-        (void) memset(ulog, 0, sizeof (kdb_hlog_t));
+            if (extend_file_to(ulogfd, base + new_size) < 0)
+                return errno;
+            ulog->kdb_data_size = new_size;
+        } else if (size <= ulog->kdb_data_size) {
+            /*
+             * Wrap around, giving up the rest of the area
+             */
+            skip_end = ulog->kdb_data_size;
+            off = 0;
+        } else {
+            return (KRB5_LOG_ERROR);
+        }
+    }
 
-        ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-        ulog->db_version_num = KDB_VERSION;
-        ulog->kdb_state = KDB_STABLE;
-        ulog->kdb_block = new_block;
+    while (ulog->kdb_num > 0) {
+        indx_log = (kdb_ent_header_t *)
+            INDEX(ulog, (ulog->kdb_first_sno - 1) % ulog->kdb_nslots);
 
-        ulog_sync_header(ulog);
+        if (ulog->kdb_num < ulog->kdb_nslots &&
+            !ulog_overlaps(indx_log, ulog->kdb_data_next, skip_end) &&
+            !ulog_overlaps(indx_log, off, off + size))
+            break;
 
         /*
-         * Time to expand log considering new block size
-         */
-        if (extend_file_to(ulogfd, new_size) < 0)
-            return errno;
-    } else {
-        /*
-         * Can't map into file larger than MAXLOGLEN
+         * Discard the oldest entry
          */
-        return (KRB5_LOG_ERROR);
+        ulog->kdb_num--;
+        ulog->kdb_first_sno++;
+        if (ulog->kdb_num > 0) {
+            indx_log = (kdb_ent_header_t *)
+                INDEX(ulog, (ulog->kdb_first_sno - 1) % ulog->kdb_nslots);
+            ulog->kdb_first_time = indx_log->kdb_time;
+        }
     }
 
+    *off_out = off;
     return (0);
 }
 
@@ -158,7 +226,10 @@ ulog_resize(kdb_hlog_t *ulog, uint32_t ulogentries, int ulogfd, uint_t recsize)
  * Adds an entry to the update log.
  * The layout of the update log looks like:
  *
- * header log -> [ update header -> xdr(kdb_incr_update_t) ], ...
+ * header log -> [ update header ], ... -> [ xdr(kdb_incr_update_t) ], ...
+ *
+ * with kdb_nslots update headers, indexed by serial number, each referring
+ * to its encoded update in the data area.
  */
 krb5_error_code
 ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
@@ -167,17 +238,16 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     kdbe_time_t ktime;
     struct timeval      timestamp;
     kdb_ent_header_t *indx_log;
-    uint_t              i, recsize;
+    uint_t              i;
+    uint32_t            off = 0;
     ulong_t             upd_size;
     krb5_error_code     retval;
     kdb_sno_t   cur_sno;
     kdb_log_context     *log_ctx;
     kdb_hlog_t  *ulog = NULL;
-    uint32_t    ulogentries;
     int         ulogfd;
 
     INIT_ULOG(context);
-    ulogentries = log_ctx->ulogentries;
     ulogfd = log_ctx->ulogfd;
 
     if (upd == NULL)
@@ -189,14 +259,8 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
 
     upd_size = xdr_sizeof((xdrproc_t)xdr_kdb_incr_update_t, upd);
 
-    recsize = sizeof (kdb_ent_header_t) + upd_size;
-
-    if (recsize > ulog->kdb_block) {
-        if ((retval = ulog_resize(ulog, ulogentries, ulogfd, recsize))) {
-            /* Resize element array failed */
-            return (retval);
-        }
-    }
+    if ((retval = ulog_reserve(ulog, ulogfd, upd_size, &off)))
+        return (retval);
 
     cur_sno = ulog->kdb_last_sno;
 
@@ -214,7 +278,7 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
      */
     upd->kdb_entry_sno = cur_sno;
 
-    i = (cur_sno - 1) % ulogentries;
+    i = (cur_sno - 1) % ulog->kdb_nslots;
 
     indx_log = (kdb_ent_header_t *)INDEX(ulog, i);
 
@@ -222,41 +286,37 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
 
     indx_log->kdb_umagic = KDB_ULOG_MAGIC;
     indx_log->kdb_entry_size = upd_size;
+    indx_log->kdb_entry_off = off;
     indx_log->kdb_entry_sno = cur_sno;
     indx_log->kdb_time = upd->kdb_time = ktime;
     indx_log->kdb_commit = upd->kdb_commit = FALSE;
 
     ulog->kdb_state = KDB_UNSTABLE;
 
-    xdrmem_create(&xdrs, (char *)indx_log->entry_data,
+    xdrmem_create(&xdrs, ENTRY_DATA(ulog, indx_log),
                   indx_log->kdb_entry_size, XDR_ENCODE);
     if (!xdr_kdb_incr_update_t(&xdrs, upd))
         return (KRB5_LOG_CONV);
 
-    if ((retval = ulog_sync_update(ulog, indx_log)))
+    if (!log_ctx->batch && (retval = ulog_sync_update(ulog, indx_log)))
         return (retval);
 
-    if (ulog->kdb_num < ulogentries)
-        ulog->kdb_num++;
-
-    ulog->kdb_last_sno = cur_sno;
-    ulog->kdb_last_time = ktime;
+    ulog->kdb_data_next = off + upd_size;
 
     /*
-     * Since this is a circular array, once we circled, kdb_first_sno is
-     * always kdb_entry_sno + 1.
+     * ulog_reserve() discarded the oldest entries to make room, so the
+     * entries run from kdb_first_sno to this one.
      */
-    if (cur_sno > ulogentries) {
-        i = upd->kdb_entry_sno % ulogentries;
-        indx_log = (kdb_ent_header_t *)INDEX(ulog, i);
-        ulog->kdb_first_sno = indx_log->kdb_entry_sno;
-        ulog->kdb_first_time = indx_log->kdb_time;
-    } else if (cur_sno == 1) {
-        ulog->kdb_first_sno = 1;
-        ulog->kdb_first_time = indx_log->kdb_time;
+    if (ulog->kdb_num++ == 0) {
+        ulog->kdb_first_sno = cur_sno;
+        ulog->kdb_first_time = ktime;
     }
 
-    ulog_sync_header(ulog);
+    ulog->kdb_last_sno = cur_sno;
+    ulog->kdb_last_time = ktime;
+
+    if (!log_ctx->batch)
+        ulog_sync_header(ulog);
 
     return (0);
 }
@@ -273,12 +333,10 @@ ulog_finish_update(krb5_context context, kdb_incr_update_t *upd)
     uint_t              i;
     kdb_log_context     *log_ctx;
     kdb_hlog_t          *ulog = NULL;
-    uint32_t            ulogentries;
 
     INIT_ULOG(context);
-    ulogentries = log_ctx->ulogentries;
 
-    i = (upd->kdb_entry_sno - 1) % ulogentries;
+    i = (upd->kdb_entry_sno - 1) % ulog->kdb_nslots;
 
     indx_log = (kdb_ent_header_t *)INDEX(ulog, i);
 
@@ -286,7 +344,57 @@ ulog_finish_update(krb5_context context, kdb_incr_update_t *upd)
 
     ulog->kdb_state = KDB_STABLE;
 
-    if ((retval = ulog_sync_update(ulog, indx_log)))
+    if (log_ctx->batch)
+        return (0);
+
+    if ((retval = ulog_sync_range(indx_log, ulog->kdb_block)))
+        return (retval);
+
+    ulog_sync_header(ulog);
+
+    return (0);
+}
+
+/*
+ * Begin a batch of updates.  Until ulog_end_batch() is called,
+ * ulog_add_update() and ulog_finish_update() leave syncing the log to disk
+ * to ulog_end_batch(), so that a run of updates costs two msync calls instead
+ * of five per update.  Updates in a batch which has not ended can be lost if
+ * the system crashes, though not if only the process does.
+ */
+krb5_error_code
+ulog_begin_batch(krb5_context context)
+{
+    kdb_log_context     *log_ctx;
+    kdb_hlog_t          *ulog = NULL;
+
+    INIT_ULOG(context);
+
+    log_ctx->batch = TRUE;
+
+    return (0);
+}
+
+/*
+ * End a batch of updates, syncing the entries and then the header to disk.
+ */
+krb5_error_code
+ulog_end_batch(krb5_context context)
+{
+    krb5_error_code     retval;
+    kdb_log_context     *log_ctx;
+    kdb_hlog_t          *ulog = NULL;
+
+    INIT_ULOG(context);
+
+    if (!log_ctx->batch)
+        return (0);
+    log_ctx->batch = FALSE;
+
+    retval = ulog_sync_range(ulog, sizeof (kdb_hlog_t) +
+                             ulog->kdb_nslots * ulog->kdb_block +
+                             ulog->kdb_data_size);
+    if (retval)
         return (retval);
 
     ulog_sync_header(ulog);
@@ -449,7 +557,8 @@ ulog_check(krb5_context context, kdb_hlog_t *ulog, char **db_args)
     ulog->kdb_state = KDB_STABLE;
 
     for (i = 0; i < ulog->kdb_num; i++) {
-        indx_log = (kdb_ent_header_t *)INDEX(ulog, i);
+        indx_log = (kdb_ent_header_t *)
+            INDEX(ulog, (ulog->kdb_first_sno - 1 + i) % ulog->kdb_nslots);
 
         if (indx_log->kdb_umagic != KDB_ULOG_MAGIC) {
             /*
@@ -478,7 +587,7 @@ ulog_check(krb5_context context, kdb_hlog_t *ulog, char **db_args)
             }
 
             (void) memset(upd, 0, sizeof (kdb_incr_update_t));
-            xdrmem_create(&xdrs, (char *)indx_log->entry_data,
+            xdrmem_create(&xdrs, ENTRY_DATA(ulog, indx_log),
                           indx_log->kdb_entry_size, XDR_DECODE);
             if (!xdr_kdb_incr_update_t(&xdrs, upd)) {
                 retval = KRB5_LOG_CONV;
@@ -575,7 +684,7 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries,
         }
 
         if ((caller == FKADMIND) || (caller == FKCOMMAND))
-            ulog_filesize += ulogentries * ULOG_BLOCK;
+            ulog_filesize += ulogentries * sizeof (kdb_ent_header_t);
 
         if (extend_file_to(ulogfd, ulog_filesize) < 0)
             return errno;
@@ -625,17 +734,14 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries,
     log_ctx->ulogentries = ulogentries;
     log_ctx->ulogfd = ulogfd;
 
-    if (ulog->kdb_hmagic != KDB_ULOG_HDR_MAGIC) {
-        if (ulog->kdb_hmagic == 0) {
+    if (ulog->kdb_hmagic != KDB_ULOG_HDR_MAGIC ||
+        ulog->db_version_num != KDB_VERSION) {
+        if (ulog->kdb_hmagic == 0 || ulog->kdb_hmagic == KDB_ULOG_HDR_MAGIC) {
             /*
-             * New update log
+             * New update log, or one from before entries were stored
+             * apart from their updates, whose entries are discarded
              */
-            (void) memset(ulog, 0, sizeof (kdb_hlog_t));
-
-            ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-            ulog->db_version_num = KDB_VERSION;
-            ulog->kdb_state = KDB_STABLE;
-            ulog->kdb_block = ULOG_BLOCK;
+            ulog_init_header(context);
             if (!(caller == FKPROPLOG))
                 ulog_sync_header(ulog);
         } else {
@@ -677,38 +783,25 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries,
     }
 
     /*
-     * Reinit ulog if the log is being truncated or expanded after
-     * we have circled.
+     * Entries are indexed by serial number modulo the number of index
+     * entries, so reinit ulog if the log is being truncated or expanded.
      */
     retval = ulog_lock(context, KRB5_LOCKMODE_EXCLUSIVE);
     if (retval)
         return retval;
-    if (ulog->kdb_num != ulogentries) {
-        if ((ulog->kdb_num != 0) &&
-            ((ulog->kdb_last_sno > ulog->kdb_num) ||
-             (ulog->kdb_num > ulogentries))) {
-
-            (void) memset(ulog, 0, sizeof (kdb_hlog_t));
-
-            ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-            ulog->db_version_num = KDB_VERSION;
-            ulog->kdb_state = KDB_STABLE;
-            ulog->kdb_block = ULOG_BLOCK;
-
-            ulog_sync_header(ulog);
-        }
-
-        /*
-         * Expand ulog if we have specified a greater size
-         */
-        if (ulog->kdb_num < ulogentries) {
-            ulog_filesize += ulogentries * ulog->kdb_block;
+    if (ulog->kdb_nslots != ulogentries) {
+        ulog_init_header(context);
+        ulog_sync_header(ulog);
+    }
 
-            if (extend_file_to(ulogfd, ulog_filesize) < 0) {
-                ulog_lock(context, KRB5_LOCKMODE_UNLOCK);
-                return errno;
-            }
-        }
+    /*
+     * Make sure the file holds the index and the data area
+     */
+    ulog_filesize = sizeof (kdb_hlog_t) + ulogentries * ulog->kdb_block +
+        ulog->kdb_data_size;
+    if (extend_file_to(ulogfd, ulog_filesize) < 0) {
+        ulog_lock(context, KRB5_LOCKMODE_UNLOCK);
+        return errno;
     }
     ulog_lock(context, KRB5_LOCKMODE_UNLOCK);
 
@@ -750,10 +843,17 @@ ulog_get_entries(krb5_context context,          /* input - krb5 lib config */
         return (KRB5_LOG_CORRUPT);
     }
 
+    /*
+     * Writers hold the ulog lock exclusively from ulog_add_update() through
+     * ulog_finish_update(), so under our shared lock the log is only
+     * unstable if an update was interrupted.  Committed updates are handed
+     * out right away, so that slaves woken by an update notification get
+     * them; an interrupted one gets ULOG_IDLE_TIME to be recovered first.
+     */
     gettimeofday(&timestamp, NULL);
 
     tdiff = timestamp.tv_sec - ulog->kdb_last_time.seconds;
-    if (tdiff <= ULOG_IDLE_TIME) {
+    if (ulog->kdb_state != KDB_STABLE && tdiff <= ULOG_IDLE_TIME) {
         ulog_handle->ret = UPDATE_BUSY;
         (void) ulog_lock(context, KRB5_LOCKMODE_UNLOCK);
         return (0);
@@ -828,8 +928,7 @@ ulog_get_entries(krb5_context context,          /* input - krb5 lib config */
 
                 (void) memset(upd, 0,
                               sizeof (kdb_incr_update_t));
-                xdrmem_create(&xdrs,
-                              (char *)indx_log->entry_data,
+                xdrmem_create(&xdrs, ENTRY_DATA(ulog, indx_log),
                               indx_log->kdb_entry_size, XDR_DECODE);
                 if (!xdr_kdb_incr_update_t(&xdrs, upd)) {
                     (void) ulog_lock(context, KRB5_LOCKMODE_UNLOCK);
@@ -228,7 +228,8 @@ k5_asn1_decode_uint(const unsigned char *asn1, size_t len, asn1_uintmax *val)
 
 asn1_error_code
 k5_asn1_decode_bytestring(const unsigned char *asn1, size_t len,
-                          unsigned char **str_out, size_t *len_out)
+                          k5_asn1_arena *arena, unsigned char **str_out,
+                          size_t *len_out)
 {
     unsigned char *str;
 
@@ -236,6 +237,12 @@ k5_asn1_decode_bytestring(const unsigned char *asn1, size_t len,
     *len_out = 0;
     if (len == 0)
         return 0;
+    if (arena != NULL) {
+        /* Arena results may refer to the input encoding. */
+        *str_out = (unsigned char *)asn1;
+        *len_out = len;
+        return 0;
+    }
     str = malloc(len);
     if (str == NULL)
         return ENOMEM;
@@ -286,7 +293,8 @@ k5_asn1_decode_generaltime(const unsigned char *asn1, size_t len,
  */
 asn1_error_code
 k5_asn1_decode_bitstring(const unsigned char *asn1, size_t len,
-                         unsigned char **bits_out, size_t *len_out)
+                         k5_asn1_arena *arena, unsigned char **bits_out,
+                         size_t *len_out)
 {
     unsigned char unused, *bits;
 
@@ -299,7 +307,7 @@ k5_asn1_decode_bitstring(const unsigned char *asn1, size_t len,
     if (unused > 7)
         return ASN1_BAD_FORMAT;
 
-    bits = malloc(len);
+    bits = (arena != NULL) ? k5_asn1_arena_alloc(arena, len) : malloc(len);
     if (bits == NULL)
         return ENOMEM;
     memcpy(bits, asn1, len);
@@ -664,17 +672,22 @@ split_der(asn1buf *buf, unsigned char *const *der, size_t len,
 /*
  * Store the DER encoding given by t and asn1/len into the char * or
  * unsigned char * pointed to by val.  Set *count_out to the length of the
- * DER encoding.
+ * DER encoding.  If arena is set, the stored pointer refers to the input.
  */
 static asn1_error_code
-store_der(const taginfo *t, const unsigned char *asn1, size_t len, void *val,
-          size_t *count_out)
+store_der(const taginfo *t, const unsigned char *asn1, size_t len,
+          k5_asn1_arena *arena, void *val, size_t *count_out)
 {
     unsigned char *der;
     size_t der_len;
 
     *count_out = 0;
     der_len = t->tag_len + len + t->tag_end_len;
+    if (arena != NULL) {
+        *(const unsigned char **)val = asn1 - t->tag_len;
+        *count_out = der_len;
+        return 0;
+    }
     der = malloc(der_len);
     if (der == NULL)
         return ENOMEM;
@@ -1105,6 +1118,108 @@ free_sequence_of(const struct atype_info *eltinfo, void *val, size_t count)
     }
 }
 
+/**** Decoding arenas ****/
+
+/* Arena allocations are aligned for any of these types. */
+union arena_align {
+    void *p;
+    long l;
+    krb5_int64 i;
+    double d;
+};
+#define ARENA_ALIGN sizeof(union arena_align)
+
+/* Size of the data area of an ordinary arena block.  Larger allocations get a
+ * block of their own. */
+#define ARENA_BLOCK_SIZE 4096
+
+struct arena_block {
+    struct arena_block *next;
+    size_t size;                /* Size of data area */
+    size_t used;                /* Bytes of data area handed out */
+    union arena_align data[1];  /* Start of data area */
+};
+
+struct k5_asn1_arena_st {
+    struct arena_block *blocks; /* Block being allocated from comes first */
+};
+
+static struct arena_block *
+new_block(size_t size)
+{
+    struct arena_block *b;
+
+    /* calloc() so that allocations need not be cleared individually. */
+    b = calloc(1, offsetof(struct arena_block, data) + size);
+    if (b == NULL)
+        return NULL;
+    b->size = size;
+    return b;
+}
+
+krb5_error_code
+k5_asn1_arena_create(k5_asn1_arena **arena_out)
+{
+    k5_asn1_arena *arena;
+
+    *arena_out = NULL;
+    arena = malloc(sizeof(*arena));
+    if (arena == NULL)
+        return ENOMEM;
+    arena->blocks = new_block(ARENA_BLOCK_SIZE);
+    if (arena->blocks == NULL) {
+        free(arena);
+        return ENOMEM;
+    }
+    *arena_out = arena;
+    return 0;
+}
+
+void *
+k5_asn1_arena_alloc(k5_asn1_arena *arena, size_t len)
+{
+    struct arena_block *b = arena->blocks;
+    void *ptr;
+
+    if (len > SIZE_MAX - ARENA_ALIGN)
+        return NULL;
+    len = (len + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (len > b->size - b->used) {
+        if (len > ARENA_BLOCK_SIZE / 4) {
+            /* Give a large object its own block, behind the current one so
+             * that the space left in the current one is still used. */
+            b = new_block(len);
+            if (b == NULL)
+                return NULL;
+            b->next = arena->blocks->next;
+            arena->blocks->next = b;
+        } else {
+            b = new_block(ARENA_BLOCK_SIZE);
+            if (b == NULL)
+                return NULL;
+            b->next = arena->blocks;
+            arena->blocks = b;
+        }
+    }
+    ptr = (char *)b->data + b->used;
+    b->used += len;
+    return ptr;
+}
+
+void
+k5_asn1_arena_free(k5_asn1_arena *arena)
+{
+    struct arena_block *b, *next;
+
+    if (arena == NULL)
+        return;
+    for (b = arena->blocks; b != NULL; b = next) {
+        next = b->next;
+        free(b);
+    }
+    free(arena);
+}
+
 /**** Functions for decoding objects based on type info ****/
 
 /* Return nonzero if t is an expected tag for an ASN.1 object of type a. */
@@ -1189,23 +1304,34 @@ check_atype_tag(const struct atype_info *a, const taginfo *t)
 
 static asn1_error_code
 decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out);
+              const struct cntype_info *c, k5_asn1_arena *arena, void *val,
+              size_t *count_out);
 static asn1_error_code
 decode_atype_to_ptr(const taginfo *t, const unsigned char *asn1, size_t len,
-                    const struct atype_info *basetype, void **ptr_out);
+                    const struct atype_info *basetype, k5_asn1_arena *arena,
+                    void **ptr_out);
 static asn1_error_code
 decode_sequence(const unsigned char *asn1, size_t len,
-                const struct seq_info *seq, void *val);
+                const struct seq_info *seq, k5_asn1_arena *arena, void *val);
 static asn1_error_code
 decode_sequence_of(const unsigned char *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out);
+                   const struct atype_info *elemtype, int nullterm,
+                   k5_asn1_arena *arena, void **seq_out, size_t *count_out);
+
+/* Allocate len zero-filled bytes from arena, or from the heap if arena is
+ * NULL. */
+static void *
+decode_alloc(k5_asn1_arena *arena, size_t len)
+{
+    return (arena != NULL) ? k5_asn1_arena_alloc(arena, len) : calloc(len, 1);
+}
 
 /* Given the enclosing tag t, decode from asn1/len the contents of the ASN.1
  * type specified by a, placing the result into val (caller-allocated). */
 static asn1_error_code
 decode_atype(const taginfo *t, const unsigned char *asn1,
-             size_t len, const struct atype_info *a, void *val)
+             size_t len, const struct atype_info *a, k5_asn1_arena *arena,
+             void *val)
 {
     asn1_error_code ret;
 
@@ -1213,19 +1339,20 @@ decode_atype(const taginfo *t, const unsigned char *asn1,
     case atype_fn: {
         const struct fn_info *fn = a->tinfo;
         assert(fn->dec != NULL);
-        return fn->dec(t, asn1, len, val);
+        return fn->dec(t, asn1, len, arena, val);
     }
     case atype_sequence:
-        return decode_sequence(asn1, len, a->tinfo, val);
+        return decode_sequence(asn1, len, a->tinfo, arena, val);
     case atype_ptr: {
         const struct ptr_info *ptrinfo = a->tinfo;
         void *ptr = LOADPTR(val, ptrinfo);
         assert(ptrinfo->basetype != NULL);
         if (ptr != NULL) {
             /* Container was already allocated by a previous sequence field. */
-            return decode_atype(t, asn1, len, ptrinfo->basetype, ptr);
+            return decode_atype(t, asn1, len, ptrinfo->basetype, arena, ptr);
         } else {
-            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, &ptr);
+            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, arena,
+                                      &ptr);
             if (ret)
                 return ret;
             STOREPTR(ptr, ptrinfo, val);
@@ -1235,19 +1362,20 @@ decode_atype(const taginfo *t, const unsigned char *asn1,
     case atype_offset: {
         const struct offset_info *off = a->tinfo;
         assert(off->basetype != NULL);
-        return decode_atype(t, asn1, len, off->basetype,
+        return decode_atype(t, asn1, len, off->basetype, arena,
                             (char *)val + off->dataoff);
     }
     case atype_optional: {
         const struct optional_info *opt = a->tinfo;
-        return decode_atype(t, asn1, len, opt->basetype, val);
+        return decode_atype(t, asn1, len, opt->basetype, arena, val);
     }
     case atype_counted: {
         const struct counted_info *counted = a->tinfo;
         void *dataptr = (char *)val + counted->dataoff;
         size_t count;
         assert(counted->basetype != NULL);
-        ret = decode_cntype(t, asn1, len, counted->basetype, dataptr, &count);
+        ret = decode_cntype(t, asn1, len, counted->basetype, arena, dataptr,
+                            &count);
         if (ret)
             return ret;
         return store_count(count, counted, val);
@@ -1267,7 +1395,7 @@ decode_atype(const taginfo *t, const unsigned char *asn1,
             if (!check_atype_tag(tag->basetype, tp))
                 return ASN1_BAD_ID;
         }
-        return decode_atype(tp, asn1, len, tag->basetype, val);
+        return decode_atype(tp, asn1, len, tag->basetype, arena, val);
     }
     case atype_bool: {
         asn1_intmax intval;
@@ -1320,7 +1448,8 @@ decode_atype(const taginfo *t, const unsigned char *asn1,
  */
 static asn1_error_code
 decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out)
+              const struct cntype_info *c, k5_asn1_arena *arena, void *val,
+              size_t *count_out)
 {
     asn1_error_code ret;
 
@@ -1328,16 +1457,16 @@ decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
     case cntype_string: {
         const struct string_info *string = c->tinfo;
         assert(string->dec != NULL);
-        return string->dec(asn1, len, val, count_out);
+        return string->dec(asn1, len, arena, val, count_out);
     }
     case cntype_der:
-        return store_der(t, asn1, len, val, count_out);
+        return store_der(t, asn1, len, arena, val, count_out);
     case cntype_seqof: {
         const struct atype_info *a = c->tinfo;
         const struct ptr_info *ptrinfo = a->tinfo;
         void *seq;
         assert(a->type == atype_ptr);
-        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, &seq,
+        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, 0, arena, &seq,
                                  count_out);
         if (ret)
             return ret;
@@ -1349,7 +1478,8 @@ decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
         size_t i;
         for (i = 0; i < choice->n_options; i++) {
             if (check_atype_tag(choice->options[i], t)) {
-                ret = decode_atype(t, asn1, len, choice->options[i], val);
+                ret = decode_atype(t, asn1, len, choice->options[i], arena,
+                                   val);
                 if (ret)
                     return ret;
                 *count_out = i;
@@ -1369,29 +1499,10 @@ decode_cntype(const taginfo *t, const unsigned char *asn1, size_t len,
     return 0;
 }
 
-/* Add a null pointer to the end of a sequence.  ptr is consumed on success
- * (to be replaced by *ptr_out), left alone on failure. */
-static asn1_error_code
-null_terminate(const struct atype_info *eltinfo, void *ptr, size_t count,
-               void **ptr_out)
-{
-    const struct ptr_info *ptrinfo = eltinfo->tinfo;
-    void *endptr;
-
-    assert(eltinfo->type == atype_ptr);
-    ptr = realloc(ptr, (count + 1) * eltinfo->size);
-    if (ptr == NULL)
-        return ENOMEM;
-    endptr = (char *)ptr + count * eltinfo->size;
-    STOREPTR(NULL, ptrinfo, endptr);
-    *ptr_out = ptr;
-    return 0;
-}
-
 static asn1_error_code
 decode_atype_to_ptr(const taginfo *t, const unsigned char *asn1,
                     size_t len, const struct atype_info *a,
-                    void **ptr_out)
+                    k5_asn1_arena *arena, void **ptr_out)
 {
     asn1_error_code ret;
     void *ptr;
@@ -1401,24 +1512,20 @@ decode_atype_to_ptr(const taginfo *t, const unsigned char *asn1,
     switch (a->type) {
     case atype_nullterm_sequence_of:
     case atype_nonempty_nullterm_sequence_of:
-        ret = decode_sequence_of(asn1, len, a->tinfo, &ptr, &count);
+        ret = decode_sequence_of(asn1, len, a->tinfo, 1, arena, &ptr, &count);
         if (ret)
             return ret;
-        ret = null_terminate(a->tinfo, ptr, count, &ptr);
-        if (ret) {
-            free_sequence_of(a->tinfo, ptr, count);
-            return ret;
-        }
         /* Historically we do not enforce non-emptiness of sequences when
          * decoding, even when it is required by the ASN.1 type. */
         break;
     default:
-        ptr = calloc(a->size, 1);
+        ptr = decode_alloc(arena, a->size);
         if (ptr == NULL)
             return ENOMEM;
-        ret = decode_atype(t, asn1, len, a, ptr);
+        ret = decode_atype(t, asn1, len, a, arena, ptr);
         if (ret) {
-            free(ptr);
+            if (arena == NULL)
+                free(ptr);
             return ret;
         }
         break;
@@ -1470,7 +1577,7 @@ omit_atype(const struct atype_info *a, void *val)
 /* Decode an ASN.1 sequence into a C object. */
 static asn1_error_code
 decode_sequence(const unsigned char *asn1, size_t len,
-                const struct seq_info *seq, void *val)
+                const struct seq_info *seq, k5_asn1_arena *arena, void *val)
 {
     asn1_error_code ret;
     const unsigned char *contents;
@@ -1502,7 +1609,7 @@ decode_sequence(const unsigned char *asn1, size_t len,
          * changing this before making the encoder visible to plugins. */
         if (i == seq->n_fields)
             break;
-        ret = decode_atype(&t, contents, clen, seq->fields[i], val);
+        ret = decode_atype(&t, contents, clen, seq->fields[i], arena, val);
         if (ret)
             goto error;
     }
@@ -1516,6 +1623,9 @@ decode_sequence(const unsigned char *asn1, size_t len,
     return 0;
 
 error:
+    /* Arena objects are released with the arena. */
+    if (arena != NULL)
+        return ret;
     /* Free what we've decoded so far.  Free pointers in a second pass in
      * case multiple fields refer to the same pointer. */
     for (j = 0; j < i; j++)
@@ -1525,47 +1635,65 @@ error:
     return ret;
 }
 
+/*
+ * Decode an ASN.1 sequence-of into an array of C objects of type elemtype.
+ * If nullterm is set, elemtype must be a pointer type and the array is
+ * terminated with a null pointer.  The elements are counted before any are
+ * decoded so that the array can be allocated once at its final size.
+ */
 static asn1_error_code
 decode_sequence_of(const unsigned char *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out)
+                   const struct atype_info *elemtype, int nullterm,
+                   k5_asn1_arena *arena, void **seq_out, size_t *count_out)
 {
     asn1_error_code ret;
-    void *seq = NULL, *elem, *newseq;
-    const unsigned char *contents;
-    size_t clen, count = 0;
+    void *seq = NULL, *elem;
+    const unsigned char *contents, *p;
+    size_t clen, plen, nelems = 0, count = 0;
     taginfo t;
 
     *seq_out = NULL;
     *count_out = 0;
+    assert(elemtype->size != 0);
+    for (p = asn1, plen = len; plen > 0; nelems++) {
+        ret = get_tag(p, plen, &t, &contents, &clen, &p, &plen);
+        if (ret)
+            return ret;
+        if (!check_atype_tag(elemtype, &t))
+            return ASN1_BAD_ID;
+    }
+    if (nelems + nullterm == 0)
+        return 0;
+    if (nelems + nullterm > SIZE_MAX / elemtype->size)
+        return ENOMEM;
+    seq = decode_alloc(arena, (nelems + nullterm) * elemtype->size);
+    if (seq == NULL)
+        return ENOMEM;
     while (len > 0) {
         ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
         if (ret)
             goto error;
-        if (!check_atype_tag(elemtype, &t)) {
-            ret = ASN1_BAD_ID;
-            goto error;
-        }
-        newseq = realloc(seq, (count + 1) * elemtype->size);
-        if (newseq == NULL) {
-            ret = ENOMEM;
-            goto error;
-        }
-        seq = newseq;
         elem = (char *)seq + count * elemtype->size;
-        memset(elem, 0, elemtype->size);
-        ret = decode_atype(&t, contents, clen, elemtype, elem);
+        ret = decode_atype(&t, contents, clen, elemtype, arena, elem);
         if (ret)
             goto error;
         count++;
     }
+    if (nullterm) {
+        const struct ptr_info *ptrinfo = elemtype->tinfo;
+        assert(elemtype->type == atype_ptr);
+        elem = (char *)seq + count * elemtype->size;
+        STOREPTR(NULL, ptrinfo, elem);
+    }
     *seq_out = seq;
     *count_out = count;
     return 0;
 
 error:
-    free_sequence_of(elemtype, seq, count);
-    free(seq);
+    if (arena == NULL) {
+        free_sequence_of(elemtype, seq, count);
+        free(seq);
+    }
     return ret;
 }
 
@@ -1581,9 +1709,42 @@ k5_asn1_encode_atype(asn1buf *buf, const void *val, const struct atype_info *a,
 
 asn1_error_code
 k5_asn1_decode_atype(const taginfo *t, const unsigned char *asn1,
-                     size_t len, const struct atype_info *a, void *val)
+                     size_t len, k5_asn1_arena *arena,
+                     const struct atype_info *a, void *val)
 {
-    return decode_atype(t, asn1, len, a, val);
+    return decode_atype(t, asn1, len, a, arena, val);
+}
+
+/* Encode rep (with its tag) into buf, which must be initialized. */
+static asn1_error_code
+encode_rep(asn1buf *buf, const void *rep, const struct atype_info *a)
+{
+    size_t len;
+
+    if (rep == NULL)
+        return ASN1_MISSING_FIELD;
+    return encode_atype_and_tag(buf, rep, a, &len);
+}
+
+krb5_error_code
+k5_asn1_encode_buffer(const void *rep, const struct atype_info *a,
+                      unsigned char *mem, size_t memlen, size_t *len_out)
+{
+    asn1_error_code ret;
+    asn1buf buf;
+
+    *len_out = 0;
+    asn1buf_init_count(&buf);
+    ret = encode_rep(&buf, rep, a);
+    if (ret)
+        return ret;
+    *len_out = asn1buf_len(&buf);
+    if (mem == NULL)
+        return 0;
+    if (memlen < asn1buf_len(&buf))
+        return ASN1_OVERFLOW;
+    asn1buf_init_output(&buf, mem, *len_out);
+    return encode_rep(&buf, rep, a);
 }
 
 krb5_error_code
@@ -1592,31 +1753,37 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
 {
     size_t len;
     asn1_error_code ret;
-    asn1buf *buf = NULL;
     krb5_data *d;
 
     *code_out = NULL;
 
-    if (rep == NULL)
-        return ASN1_MISSING_FIELD;
-    ret = asn1buf_create(&buf);
+    ret = k5_asn1_encode_buffer(rep, a, NULL, 0, &len);
     if (ret)
         return ret;
-    ret = encode_atype_and_tag(buf, rep, a, &len);
-    if (ret)
-        goto cleanup;
-    ret = asn12krb5_buf(buf, &d);
-    if (ret)
-        goto cleanup;
+    d = malloc(sizeof(*d));
+    if (d == NULL)
+        return ENOMEM;
+    /* Allocate one extra byte so the result is null-terminated. */
+    d->data = malloc(len + 1);
+    if (d->data == NULL) {
+        free(d);
+        return ENOMEM;
+    }
+    ret = k5_asn1_encode_buffer(rep, a, (unsigned char *)d->data, len, &len);
+    if (ret) {
+        krb5_free_data(NULL, d);
+        return ret;
+    }
+    d->magic = KV5M_DATA;
+    d->length = len;
+    d->data[len] = '\0';
     *code_out = d;
-cleanup:
-    asn1buf_destroy(&buf);
-    return ret;
+    return 0;
 }
 
-asn1_error_code
-k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
-                    void **retrep)
+static asn1_error_code
+full_decode(const krb5_data *code, const struct atype_info *a,
+            k5_asn1_arena *arena, void **retrep)
 {
     asn1_error_code ret;
     const unsigned char *contents, *remainder;
@@ -1632,5 +1799,19 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
      * non-length-preserving enctypes, it will sometimes be nonzero). */
     if (!check_atype_tag(a, &t))
         return ASN1_BAD_ID;
-    return decode_atype_to_ptr(&t, contents, clen, a, retrep);
+    return decode_atype_to_ptr(&t, contents, clen, a, arena, retrep);
+}
+
+asn1_error_code
+k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
+                    void **retrep)
+{
+    return full_decode(code, a, NULL, retrep);
+}
+
+asn1_error_code
+k5_asn1_full_decode_arena(k5_asn1_arena *arena, const krb5_data *code,
+                          const struct atype_info *a, void **retrep)
+{
+    return full_decode(code, a, arena, retrep);
 }
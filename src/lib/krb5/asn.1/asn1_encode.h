@@ -61,7 +61,8 @@ asn1_error_code k5_asn1_encode_generaltime(asn1buf *buf, time_t val,
                                            size_t *len_out);
 
 /* These functions are referenced by encoder structures.  They handle the
- * decoding of primitive ASN.1 types. */
+ * decoding of primitive ASN.1 types.  If arena is not NULL, results are
+ * allocated from it (or point into asn1) instead of being malloc'd. */
 asn1_error_code k5_asn1_decode_bool(const unsigned char *asn1, size_t len,
                                     asn1_intmax *val);
 asn1_error_code k5_asn1_decode_int(const unsigned char *asn1, size_t len,
@@ -71,9 +72,11 @@ asn1_error_code k5_asn1_decode_uint(const unsigned char *asn1, size_t len,
 asn1_error_code k5_asn1_decode_generaltime(const unsigned char *asn1,
                                            size_t len, time_t *time_out);
 asn1_error_code k5_asn1_decode_bytestring(const unsigned char *asn1,
-                                          size_t len, unsigned char **str_out,
+                                          size_t len, k5_asn1_arena *arena,
+                                          unsigned char **str_out,
                                           size_t *len_out);
 asn1_error_code k5_asn1_decode_bitstring(const unsigned char *asn1, size_t len,
+                                         k5_asn1_arena *arena,
                                          unsigned char **bits_out,
                                          size_t *len_out);
 
@@ -154,7 +157,7 @@ struct atype_info {
 struct fn_info {
     asn1_error_code (*enc)(asn1buf *, const void *, taginfo *, size_t *);
     asn1_error_code (*dec)(const taginfo *, const unsigned char *, size_t,
-                           void *);
+                           k5_asn1_arena *, void *);
     int (*check_tag)(const taginfo *);
     void (*free)(void *);
 };
@@ -233,8 +236,8 @@ struct cntype_info {
 struct string_info {
     asn1_error_code (*enc)(asn1buf *, unsigned char *const *, size_t,
                            size_t *);
-    asn1_error_code (*dec)(const unsigned char *, size_t, unsigned char **,
-                           size_t *);
+    asn1_error_code (*dec)(const unsigned char *, size_t, k5_asn1_arena *,
+                           unsigned char **, size_t *);
     unsigned int tagval : 5;
 };
 
@@ -540,7 +543,18 @@ k5_asn1_encode_atype(asn1buf *buf, const void *val, const struct atype_info *a,
  * caller-allocated C object val.  Used only by kdc_req_body. */
 asn1_error_code
 k5_asn1_decode_atype(const taginfo *t, const unsigned char *asn1,
-                     size_t len, const struct atype_info *a, void *val);
+                     size_t len, k5_asn1_arena *arena,
+                     const struct atype_info *a, void *val);
+
+/*
+ * Encode rep as a completed encoding in the correct byte order, placing its
+ * length in *len_out.  If mem is NULL, only compute the length; otherwise
+ * store the encoding in the first *len_out bytes of mem, or return
+ * ASN1_OVERFLOW if memlen is too small.  No memory is allocated.
+ */
+krb5_error_code
+k5_asn1_encode_buffer(const void *rep, const struct atype_info *a,
+                      unsigned char *mem, size_t memlen, size_t *len_out);
 
 /* Returns a completed encoding, with tag and in the correct byte order, in an
  * allocated krb5_data. */
@@ -551,6 +565,12 @@ asn1_error_code
 k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
                     void **rep_out);
 
+/* Like k5_asn1_full_decode, but allocate the result from arena.  Byte strings
+ * in the result point into code, which must outlive the arena. */
+asn1_error_code
+k5_asn1_full_decode_arena(k5_asn1_arena *arena, const krb5_data *code,
+                          const struct atype_info *a, void **rep_out);
+
 #define MAKE_ENCODER(FNAME, DESC)                                       \
     krb5_error_code                                                     \
     FNAME(const aux_type_##DESC *rep, krb5_data **code_out)             \
@@ -559,6 +579,16 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
     }                                                                   \
     extern int dummy /* gobble semicolon */
 
+#define MAKE_BUFFER_ENCODER(FNAME, DESC)                                \
+    krb5_error_code                                                     \
+    FNAME(const aux_type_##DESC *rep, unsigned char *mem,               \
+          size_t memlen, size_t *len_out)                               \
+    {                                                                   \
+        return k5_asn1_encode_buffer(rep, &k5_atype_##DESC, mem,        \
+                                     memlen, len_out);                  \
+    }                                                                   \
+    extern int dummy /* gobble semicolon */
+
 #define MAKE_DECODER(FNAME, DESC)                                       \
     krb5_error_code                                                     \
     FNAME(const krb5_data *code, aux_type_##DESC **rep_out)             \
@@ -574,6 +604,23 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
     }                                                                   \
     extern int dummy /* gobble semicolon */
 
+#define MAKE_ARENA_DECODER(FNAME, DESC)                                 \
+    krb5_error_code                                                     \
+    FNAME(k5_asn1_arena *arena, const krb5_data *code,                  \
+          aux_type_##DESC **rep_out)                                    \
+    {                                                                   \
+        asn1_error_code ret;                                            \
+        void *rep;                                                      \
+        *rep_out = NULL;                                                \
+        ret = k5_asn1_full_decode_arena(arena, code, &k5_atype_##DESC,  \
+                                        &rep);                          \
+        if (ret)                                                        \
+            return ret;                                                 \
+        *rep_out = rep;                                                 \
+        return 0;                                                       \
+    }                                                                   \
+    extern int dummy /* gobble semicolon */
+
 #define MAKE_CODEC(TYPENAME, DESC)              \
     MAKE_ENCODER(encode_##TYPENAME, DESC);      \
     MAKE_DECODER(decode_##TYPENAME, DESC)
@@ -103,7 +103,8 @@ encode_seqno(asn1buf *buf, const void *p, taginfo *rettag, size_t *len_out)
     return k5_asn1_encode_uint(buf, val, len_out);
 }
 static asn1_error_code
-decode_seqno(const taginfo *t, const unsigned char *asn1, size_t len, void *p)
+decode_seqno(const taginfo *t, const unsigned char *asn1, size_t len,
+             k5_asn1_arena *arena, void *p)
 {
     asn1_error_code ret;
     asn1_intmax val;
@@ -140,7 +141,7 @@ encode_kerberos_time(asn1buf *buf, const void *p, taginfo *rettag,
 }
 static asn1_error_code
 decode_kerberos_time(const taginfo *t, const unsigned char *asn1, size_t len,
-                     void *p)
+                     k5_asn1_arena *arena, void *p)
 {
     asn1_error_code ret;
     time_t val;
@@ -215,20 +216,21 @@ encode_krb5_flags(asn1buf *buf, const void *p, taginfo *rettag,
 }
 static asn1_error_code
 decode_krb5_flags(const taginfo *t, const unsigned char *asn1, size_t len,
-                  void *val)
+                  k5_asn1_arena *arena, void *val)
 {
     asn1_error_code ret;
     size_t i, blen;
     krb5_flags f = 0;
     unsigned char *bits;
-    ret = k5_asn1_decode_bitstring(asn1, len, &bits, &blen);
+    ret = k5_asn1_decode_bitstring(asn1, len, arena, &bits, &blen);
     if (ret)
         return ret;
     /* Copy up to 32 bits into f, starting at the most significant byte. */
     for (i = 0; i < blen && i < 4; i++)
         f |= bits[i] << (8 * (3 - i));
     *(krb5_flags *)val = f;
-    free(bits);
+    if (arena == NULL)
+        free(bits);
     return 0;
 }
 static int
@@ -301,7 +303,7 @@ encode_lr_type(asn1buf *buf, const void *p, taginfo *rettag, size_t *len_out)
 }
 static asn1_error_code
 decode_lr_type(const taginfo *t, const unsigned char *asn1, size_t len,
-               void *p)
+               k5_asn1_arena *arena, void *p)
 {
     asn1_error_code ret;
     asn1_intmax val;
@@ -479,13 +481,14 @@ free_kdc_req_body(void *val)
 }
 static asn1_error_code
 decode_kdc_req_body(const taginfo *t, const unsigned char *asn1, size_t len,
-                    void *val)
+                    k5_asn1_arena *arena, void *val)
 {
     asn1_error_code ret;
     kdc_req_hack h;
     krb5_kdc_req *b = val;
     memset(&h, 0, sizeof(h));
-    ret = k5_asn1_decode_atype(t, asn1, len, &k5_atype_kdc_req_body_hack, &h);
+    ret = k5_asn1_decode_atype(t, asn1, len, arena,
+                               &k5_atype_kdc_req_body_hack, &h);
     if (ret)
         return ret;
     b->kdc_options = h.v.kdc_options;
@@ -500,7 +503,11 @@ decode_kdc_req_body(const taginfo *t, const unsigned char *asn1, size_t len,
     b->addresses = h.v.addresses;
     b->authorization_data = h.v.authorization_data;
     b->second_ticket = h.v.second_ticket;
-    if (b->client != NULL && b->server != NULL) {
+    if (b->client != NULL && b->server != NULL && arena != NULL) {
+        /* Arena objects are never freed individually, so share the realm. */
+        b->client->realm = h.server_realm;
+        b->server->realm = h.server_realm;
+    } else if (b->client != NULL && b->server != NULL) {
         ret = krb5int_copy_data_contents(NULL, &h.server_realm,
                                          &b->client->realm);
         if (ret) {
@@ -514,7 +521,7 @@ decode_kdc_req_body(const taginfo *t, const unsigned char *asn1, size_t len,
         b->client->realm = h.server_realm;
     else if (b->server != NULL)
         b->server->realm = h.server_realm;
-    else
+    else if (arena == NULL)
         free(h.server_realm.data);
     return 0;
 }
@@ -1139,6 +1146,15 @@ MAKE_CODEC(krb5_ticket, ticket);
 MAKE_CODEC(krb5_encryption_key, encryption_key);
 MAKE_CODEC(krb5_enc_tkt_part, enc_tkt_part);
 
+/* Encoders into caller-supplied memory for the types encoded most often,
+ * such as by the KDC for every reply.  See k5_asn1_encode_buffer(). */
+MAKE_BUFFER_ENCODER(encode_krb5_authenticator_buf, authenticator);
+MAKE_BUFFER_ENCODER(encode_krb5_enc_tkt_part_buf, enc_tkt_part);
+MAKE_BUFFER_ENCODER(encode_krb5_enc_kdc_rep_part_buf, enc_tgs_rep_part);
+MAKE_BUFFER_ENCODER(encode_krb5_as_rep_buf, as_rep);
+MAKE_BUFFER_ENCODER(encode_krb5_tgs_rep_buf, tgs_rep);
+MAKE_BUFFER_ENCODER(encode_krb5_ap_req_buf, ap_req);
+
 krb5_error_code KRB5_CALLCONV
 krb5_decode_ticket(const krb5_data *code, krb5_ticket **repptr)
 {
@@ -1184,6 +1200,9 @@ MAKE_ENCODER(encode_krb5_as_req, as_req_encode);
 MAKE_DECODER(decode_krb5_as_req, as_req);
 MAKE_ENCODER(encode_krb5_tgs_req, tgs_req_encode);
 MAKE_DECODER(decode_krb5_tgs_req, tgs_req);
+MAKE_ARENA_DECODER(decode_krb5_as_req_arena, as_req);
+MAKE_ARENA_DECODER(decode_krb5_tgs_req_arena, tgs_req);
+MAKE_ARENA_DECODER(decode_krb5_ap_req_arena, ap_req);
 MAKE_CODEC(krb5_kdc_req_body, kdc_req_body);
 MAKE_CODEC(krb5_safe, safe);
 
@@ -1281,6 +1300,7 @@ MAKE_CODEC(krb5_etype_list, etype_list);
 
 MAKE_CODEC(krb5_pa_fx_fast_request, pa_fx_fast_request);
 MAKE_CODEC(krb5_fast_req, fast_req);
+MAKE_ARENA_DECODER(decode_krb5_fast_req_arena, fast_req);
 MAKE_CODEC(krb5_pa_fx_fast_reply, pa_fx_fast_reply);
 MAKE_CODEC(krb5_fast_response, fast_response);
 
@@ -6,117 +6,67 @@
 #include "k5-int.h"
 #include "krbasn1.h"
 
-typedef struct code_buffer_rep {
-    char *base, *bound, *next;
-} asn1buf;
-
-
-/**************** Private Procedures ****************/
-
-#if (__GNUC__ >= 2) && !defined(CONFIG_SMALL)
-unsigned int asn1buf_free(const asn1buf *buf);
-/*
- * requires  *buf is allocated
- * effects   Returns the number of unused, allocated octets in *buf.
- */
-#define asn1buf_free(buf)                               \
-    (((buf) == NULL || (buf)->base == NULL)             \
-     ? 0U                                               \
-     : (unsigned int)((buf)->bound - (buf)->next + 1))
-
-
-asn1_error_code asn1buf_ensure_space(asn1buf *buf, const unsigned int amount);
-/*
- * requires  *buf is allocated
- * modifies  *buf
- * effects  If buf has less than amount octets of free space, then it is
- *          expanded to have at least amount octets of free space.
- *          Returns ENOMEM memory is exhausted.
- */
-#define asn1buf_ensure_space(buf,amount)                        \
-    ((asn1buf_free(buf) < (amount))                             \
-     ? (asn1buf_expand((buf), (amount)-asn1buf_free(buf)))      \
-     : 0)
-
-asn1_error_code asn1buf_expand(asn1buf *buf, unsigned int inc);
-/*
- * requires  *buf is allocated
- * modifies  *buf
- * effects   Expands *buf by allocating space for inc more octets.
- *            Returns ENOMEM if memory is exhausted.
- */
-#endif
-
-int asn1buf_len(const asn1buf *buf);
-/*
- * requires  *buf is allocated
- * effects   Returns the length of the encoding in *buf.
- */
-#define asn1buf_len(buf)        ((buf)->next - (buf)->base)
-
-/****** End of private procedures *****/
-
 /*
  * Overview
  *
- *  The coding buffer is an array of char (to match a krb5_data structure)
- *   with 3 reference pointers:
- *   1) base - The bottom of the octet array.  Used for memory management
- *             operations on the array (e.g. alloc, realloc, free).
- *   2) next - Points to the next available octet position in the array.
- *             During encoding, this is the next free position, and it
- *               advances as octets are added to the array.
- *             During decoding, this is the next unread position, and it
- *               advances as octets are read from the array.
- *   3) bound - Points to the top of the array. Used for bounds-checking.
+ *  DER must be encoded back to front, since the length of each value is
+ *  only known after its contents have been encoded.  Encoding is done in two
+ *  passes over the same code:
  *
- *  All pointers to encoding buffers should be initalized to NULL.
+ *  1) A counting buffer (created with asn1buf_init_count) records only the
+ *     number of octets which would be inserted.
+ *  2) An output buffer (created with asn1buf_init_output) is wrapped around
+ *     exactly that many octets of memory, and octets are stored downward
+ *     from its top, so that the encoding ends up in the correct order
+ *     starting at the bottom of the memory.
+ *
+ *  No memory is allocated by the buffer in either pass.  Encoding is
+ *  deterministic, so the second pass fills the memory exactly; an insertion
+ *  which would pass the bottom of the memory fails with ASN1_OVERFLOW.
  *
  * Operations
  *
- *  asn1buf_create
- *  asn1buf_wrap_data
- *  asn1buf_destroy
+ *  asn1buf_init_count
+ *  asn1buf_init_output
  *  asn1buf_insert_octet
- *  asn1buf_insert_charstring
- *  asn1buf_remove_octet
- *  asn1buf_remove_charstring
- *  asn1buf_unparse
- *  asn1buf_hex_unparse
- *  asn12krb5_buf
- *  asn1buf_remains
- *
- *  (asn1buf_size)
- *  (asn1buf_free)
- *  (asn1buf_ensure_space)
- *  (asn1buf_expand)
- *  (asn1buf_len)
+ *  asn1buf_insert_bytestring
+ *  asn1buf_len
  */
 
-asn1_error_code asn1buf_create(asn1buf **buf);
+typedef struct code_buffer_rep {
+    unsigned char *base;        /* Bottom of output memory, or NULL */
+    unsigned char *ptr;         /* Position of the last octet inserted */
+    size_t count;               /* Number of octets inserted */
+} asn1buf;
+
+void asn1buf_init_count(asn1buf *buf);
+/* effects   Initializes *buf to count the octets inserted into it. */
+
+void asn1buf_init_output(asn1buf *buf, void *mem, size_t len);
 /*
- * effects   Creates a new encoding buffer pointed to by *buf.
- *           Returns ENOMEM if the buffer can't be created.
+ * effects   Initializes *buf to store up to len octets into mem, ending at
+ *           the top of mem.
  */
 
-void asn1buf_destroy(asn1buf **buf);
-/* effects   Deallocates **buf, sets *buf to NULL. */
+size_t asn1buf_len(const asn1buf *buf);
+/* effects   Returns the number of octets inserted into *buf. */
+#define asn1buf_len(buf)        ((buf)->count)
 
 asn1_error_code asn1buf_insert_octet(asn1buf *buf, const int o);
 /*
- * requires  *buf is allocated
- * effects   Inserts o into the buffer *buf, expanding the buffer if
- *           necessary.  Returns ENOMEM memory is exhausted.
+ * requires  *buf is initialized
+ * effects   Inserts o in front of the octets already in *buf.  Returns
+ *           ASN1_OVERFLOW if an output buffer has no room for it.
  */
 #if ((__GNUC__ >= 2) && !defined(ASN1BUF_OMIT_INLINE_FUNCS)) && !defined(CONFIG_SMALL)
 extern __inline__ asn1_error_code asn1buf_insert_octet(asn1buf *buf, const int o)
 {
-    asn1_error_code retval;
-
-    retval = asn1buf_ensure_space(buf,1U);
-    if (retval) return retval;
-    *(buf->next) = (char)o;
-    (buf->next)++;
+    if (buf->base != NULL) {
+        if (buf->ptr == buf->base)
+            return ASN1_OVERFLOW;
+        *--buf->ptr = (unsigned char)o;
+    }
+    buf->count++;
     return 0;
 }
 #endif
@@ -127,19 +77,13 @@ asn1buf_insert_bytestring(
     const unsigned int len,
     const void *s);
 /*
- * requires  *buf is allocated
+ * requires  *buf is initialized
  * modifies  *buf
- * effects   Inserts the contents of s (an array of length len)
- *            into the buffer *buf, expanding the buffer if necessary.
- *           Returns ENOMEM if memory is exhausted.
+ * effects   Inserts the contents of s (an array of length len) in front of
+ *           the octets already in *buf.  Returns ASN1_OVERFLOW if an output
+ *           buffer has no room for them.
  */
 
 #define asn1buf_insert_octetstring asn1buf_insert_bytestring
 
-asn1_error_code asn12krb5_buf(const asn1buf *buf, krb5_data **code);
-/*
- * modifies  *code
- * effects   Instantiates **code with the krb5_data representation of **buf.
- */
-
 #endif
@@ -81,12 +81,14 @@ krb5_cc_store_cred(krb5_context context, krb5_ccache cache,
     krb5_error_code ret;
     krb5_ticket *tkt;
     krb5_principal s1, s2;
+    krb5_ui_8 start = k5_metric_start();
 
     /* remove any dups */
     krb5_cc_remove_cred(context, cache, KRB5_TC_MATCH_AUTHDATA, creds);
 
     TRACE_CC_STORE(context, cache, creds);
     ret = cache->ops->store(context, cache, creds);
+    k5_metric_end(K5_METRIC_CC_STORE, start, ret);
     if (ret) return ret;
 
     /*
@@ -117,8 +119,10 @@ krb5_cc_retrieve_cred(krb5_context context, krb5_ccache cache,
 {
     krb5_error_code ret;
     krb5_data tmprealm;
+    krb5_ui_8 start = k5_metric_start();
 
     ret = cache->ops->retrieve(context, cache, flags, mcreds, creds);
+    k5_metric_end(K5_METRIC_CC_RETRIEVE, start, ret);
     TRACE_CC_RETRIEVE(context, cache, mcreds, ret);
     if (ret != KRB5_CC_NOTFOUND)
         return ret;
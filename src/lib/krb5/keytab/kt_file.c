@@ -54,6 +54,7 @@
 #ifndef LEAN_CLIENT
 
 #include "k5-int.h"
+#include "kt-int.h"
 #include <stdio.h>
 
 /*
@@ -74,6 +75,33 @@
 /*
  * Types
  */
+/*
+ * To avoid reading and decoding the whole file for each lookup, get_entry
+ * keeps an index of the principal, kvno, and enctype of each entry, with the
+ * offset at which it can be read.  The index is rebuilt when the file's
+ * identity, size, or modification time changes, or when this handle
+ * modifies the file.  If an entry read through the index does not match the
+ * index, the index is discarded and the file is scanned.
+ */
+#define KTFILE_INDEX_BUCKETS 256
+
+struct ktfile_slot {
+    struct ktfile_slot *next;   /* Next slot in the bucket, in file order */
+    krb5_principal princ;
+    krb5_kvno vno;
+    krb5_enctype enctype;
+    long offset;
+};
+
+struct ktfile_index {
+    struct ktfile_slot *buckets[KTFILE_INDEX_BUCKETS];
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_frac;
+};
+
 typedef struct _krb5_ktfile_data {
     char *name;                 /* Name of the file */
     FILE *openf;                /* open file, if any. */
@@ -81,7 +109,8 @@ typedef struct _krb5_ktfile_data {
     int version;                /* Version number of keytab */
     unsigned int iter_count;    /* Number of active iterators */
     long start_offset;          /* Starting offset after version */
-    k5_mutex_t lock;            /* Protect openf, version */
+    k5_mutex_t lock;            /* Protect openf, version, index */
+    struct ktfile_index *index; /* Entry locations, if known */
 } krb5_ktfile_data;
 
 /*
@@ -228,6 +257,27 @@ cleanup:
 }
 
 
+/* Compare 8-bit kvnos, treating 0-127 as 256-383 if kvno_offset is 128. */
+#define M(VNO) (((VNO) - kvno_offset + 256) % 256)
+
+static void
+free_index(krb5_context context, struct ktfile_index *index)
+{
+    struct ktfile_slot *slot, *next;
+    int i;
+
+    if (index == NULL)
+        return;
+    for (i = 0; i < KTFILE_INDEX_BUCKETS; i++) {
+        for (slot = index->buckets[i]; slot != NULL; slot = next) {
+            next = slot->next;
+            krb5_free_principal(context, slot->princ);
+            free(slot);
+        }
+    }
+    free(index);
+}
+
 /*
  * "Close" a file-based keytab and invalidate the id.  This means
  * free memory hidden in the structures.
@@ -244,6 +294,7 @@ krb5_ktfile_close(krb5_context context, krb5_keytab id)
  */
 {
     free(KTFILENAME(id));
+    free_index(context, KTPRIVATE(id)->index);
     zap(KTFILEBUFP(id), BUFSIZ);
     k5_mutex_destroy(&((krb5_ktfile_data *)id->data)->lock);
     free(id->data);
@@ -252,45 +303,215 @@ krb5_ktfile_close(krb5_context context, krb5_keytab id)
     return (0);
 }
 
-/*
- * This is the get_entry routine for the file based keytab implementation.
- * It opens the keytab file, and either retrieves the entry or returns
- * an error.
- */
+/* Discard the index of id, if it has one. */
+static void
+invalidate_index(krb5_context context, krb5_keytab id)
+{
+    free_index(context, KTPRIVATE(id)->index);
+    KTPRIVATE(id)->index = NULL;
+}
 
-static krb5_error_code KRB5_CALLCONV
-krb5_ktfile_get_entry(krb5_context context, krb5_keytab id,
-                      krb5_const_principal principal, krb5_kvno kvno,
-                      krb5_enctype enctype, krb5_keytab_entry *entry)
+/* Fill in the fields of index which identify the file version it was built
+ * from. */
+static krb5_error_code
+stat_index(FILE *fp, struct ktfile_index *index)
 {
-    krb5_keytab_entry cur_entry, new_entry;
-    krb5_error_code kerror = 0;
-    int found_wrong_kvno = 0;
-    krb5_boolean similar;
-    int kvno_offset = 0;
-    int was_open;
-    char *princname;
+    struct stat st;
 
-    kerror = KTLOCK(id);
-    if (kerror)
-        return kerror;
+    if (fstat(fileno(fp), &st) != 0)
+        return errno;
+    index->dev = st.st_dev;
+    index->ino = st.st_ino;
+    index->size = st.st_size;
+    index->mtime = st.st_mtime;
+#if defined HAVE_STRUCT_STAT_ST_MTIMENSEC
+    index->mtime_frac = st.st_mtimensec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+    index->mtime_frac = st.st_mtimespec.tv_nsec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    index->mtime_frac = st.st_mtim.tv_nsec;
+#else
+    index->mtime_frac = 0;
+#endif
+    return 0;
+}
 
-    if (KTFILEP(id) != NULL) {
-        was_open = 1;
+/* Read every entry of the open keytab id, starting at the current position,
+ * into a new index. */
+static krb5_error_code
+build_index(krb5_context context, krb5_keytab id,
+            struct ktfile_index **index_out)
+{
+    krb5_error_code ret;
+    struct ktfile_index *index;
+    struct ktfile_slot *slot, *prev, *next;
+    krb5_keytab_entry ent;
+    unsigned int b;
+    long offset;
+    int i;
+
+    *index_out = NULL;
+    index = calloc(1, sizeof(*index));
+    if (index == NULL)
+        return ENOMEM;
+    ret = stat_index(KTFILEP(id), index);
+    if (ret)
+        goto cleanup;
 
-        if (fseek(KTFILEP(id), KTSTARTOFF(id), SEEK_SET) == -1) {
-            KTUNLOCK(id);
-            return errno;
+    for (;;) {
+        offset = ftell(KTFILEP(id));
+        ret = krb5_ktfileint_read_entry(context, id, &ent);
+        if (ret == KRB5_KT_END)
+            break;
+        if (ret)
+            goto cleanup;
+        slot = malloc(sizeof(*slot));
+        if (slot == NULL) {
+            krb5_kt_free_entry(context, &ent);
+            ret = ENOMEM;
+            goto cleanup;
         }
-    } else {
-        was_open = 0;
+        slot->princ = ent.principal;
+        slot->vno = ent.vno;
+        slot->enctype = ent.key.enctype;
+        slot->offset = offset;
+        ent.principal = NULL;
+        krb5_kt_free_entry(context, &ent);
+
+        b = krb5int_kt_princ_hash(slot->princ) % KTFILE_INDEX_BUCKETS;
+        slot->next = index->buckets[b];
+        index->buckets[b] = slot;
+    }
+
+    /* The buckets were built in reverse file order; put them in file order
+     * so that lookups prefer the same entries as a scan would. */
+    for (i = 0; i < KTFILE_INDEX_BUCKETS; i++) {
+        prev = NULL;
+        for (slot = index->buckets[i]; slot != NULL; slot = next) {
+            next = slot->next;
+            slot->next = prev;
+            prev = slot;
+        }
+        index->buckets[i] = prev;
+    }
 
-        /* Open the keyfile for reading */
-        if ((kerror = krb5_ktfileint_openr(context, id))) {
-            KTUNLOCK(id);
-            return(kerror);
+    *index_out = index;
+    index = NULL;
+    ret = 0;
+
+cleanup:
+    free_index(context, index);
+    return ret;
+}
+
+/* Make sure the index of the open keytab id matches the file, rebuilding it
+ * if necessary.  The file position is unspecified afterwards. */
+static krb5_error_code
+update_index(krb5_context context, krb5_keytab id)
+{
+    krb5_error_code ret;
+    struct ktfile_index *index = KTPRIVATE(id)->index, cur;
+
+    if (index != NULL) {
+        ret = stat_index(KTFILEP(id), &cur);
+        if (ret)
+            return ret;
+        if (cur.dev == index->dev && cur.ino == index->ino &&
+            cur.size == index->size && cur.mtime == index->mtime &&
+            cur.mtime_frac == index->mtime_frac)
+            return 0;
+        invalidate_index(context, id);
+    }
+
+    if (fseek(KTFILEP(id), KTSTARTOFF(id), SEEK_SET) == -1)
+        return errno;
+    return build_index(context, id, &KTPRIVATE(id)->index);
+}
+
+/*
+ * Find the entry for principal, kvno, and enctype using the index of the
+ * open keytab id, applying the same selection rules as scan_entries().  On
+ * success, return KRB5_KT_END with *entry set if a match was found.  Set
+ * *stale if the entry in the file does not match the index.
+ */
+static krb5_error_code
+lookup_index(krb5_context context, krb5_keytab id,
+             krb5_const_principal principal, krb5_kvno kvno,
+             krb5_enctype enctype, krb5_keytab_entry *entry,
+             int *found_wrong_kvno, krb5_boolean *stale)
+{
+    krb5_error_code ret;
+    struct ktfile_index *index = KTPRIVATE(id)->index;
+    struct ktfile_slot *slot, *match = NULL;
+    krb5_keytab_entry ent;
+    krb5_boolean similar;
+    unsigned int b;
+    int kvno_offset = 0;
+
+    *stale = FALSE;
+    b = krb5int_kt_princ_hash(principal) % KTFILE_INDEX_BUCKETS;
+    for (slot = index->buckets[b]; slot != NULL; slot = slot->next) {
+        if (!krb5_principal_compare(context, principal, slot->princ))
+            continue;
+        if (enctype != IGNORE_ENCTYPE) {
+            ret = krb5_c_enctype_compare(context, enctype, slot->enctype,
+                                         &similar);
+            if (ret)
+                return ret;
+            if (!similar)
+                continue;
         }
+        if (kvno == IGNORE_VNO) {
+            if (slot->vno > 240)
+                kvno_offset = 128;
+            if (match == NULL || M(slot->vno) > M(match->vno))
+                match = slot;
+        } else if (slot->vno == (kvno & 0xff)) {
+            match = slot;
+            break;
+        } else {
+            (*found_wrong_kvno)++;
+        }
+    }
+    if (match == NULL)
+        return KRB5_KT_END;
+
+    if (fseek(KTFILEP(id), match->offset, SEEK_SET) == -1 ||
+        krb5_ktfileint_read_entry(context, id, &ent) != 0) {
+        *stale = TRUE;
+        return 0;
     }
+    if (ent.vno != match->vno || ent.key.enctype != match->enctype ||
+        !krb5_principal_compare(context, ent.principal, match->princ)) {
+        krb5_kt_free_entry(context, &ent);
+        *stale = TRUE;
+        return 0;
+    }
+
+    /* Coerce the enctype of the output keyblock in case we got an inexact
+     * match on the enctype. */
+    if (enctype != IGNORE_ENCTYPE)
+        ent.key.enctype = enctype;
+    *entry = ent;
+    return KRB5_KT_END;
+}
+
+/*
+ * Read entries from the current position of the open keytab id until the end
+ * of the file, looking for principal, kvno, and enctype.  Return KRB5_KT_END
+ * when the end is reached, with *entry set to the best match if there was
+ * one.
+ */
+static krb5_error_code
+scan_entries(krb5_context context, krb5_keytab id,
+             krb5_const_principal principal, krb5_kvno kvno,
+             krb5_enctype enctype, krb5_keytab_entry *entry,
+             int *found_wrong_kvno)
+{
+    krb5_keytab_entry cur_entry, new_entry;
+    krb5_error_code kerror = 0;
+    krb5_boolean similar;
+    int kvno_offset = 0;
 
     /*
      * For efficiency and simplicity, we'll use a while true that
@@ -355,8 +576,6 @@ krb5_ktfile_get_entry(krb5_context context, krb5_keytab id,
                that all version numbers 0-127 refer to 256+N instead.
                Not perfect, but maybe good enough?  */
 
-#define M(VNO) (((VNO) - kvno_offset + 256) % 256)
-
             if (new_entry.vno > 240)
                 kvno_offset = 128;
             if (! cur_entry.principal ||
@@ -381,12 +600,72 @@ krb5_ktfile_get_entry(krb5_context context, krb5_keytab id,
                 cur_entry = new_entry;
                 break;
             } else {
-                found_wrong_kvno++;
+                (*found_wrong_kvno)++;
                 krb5_kt_free_entry(context, &new_entry);
             }
         }
     }
 
+    *entry = cur_entry;
+    return kerror;
+}
+
+/*
+ * This is the get_entry routine for the file based keytab implementation.
+ * It opens the keytab file, and either retrieves the entry or returns
+ * an error.
+ */
+
+static krb5_error_code KRB5_CALLCONV
+krb5_ktfile_get_entry(krb5_context context, krb5_keytab id,
+                      krb5_const_principal principal, krb5_kvno kvno,
+                      krb5_enctype enctype, krb5_keytab_entry *entry)
+{
+    krb5_keytab_entry cur_entry;
+    krb5_error_code kerror = 0;
+    int found_wrong_kvno = 0;
+    krb5_boolean stale;
+    int was_open;
+    char *princname;
+
+    kerror = KTLOCK(id);
+    if (kerror)
+        return kerror;
+
+    if (KTFILEP(id) != NULL) {
+        was_open = 1;
+    } else {
+        was_open = 0;
+
+        /* Open the keyfile for reading */
+        if ((kerror = krb5_ktfileint_openr(context, id))) {
+            KTUNLOCK(id);
+            return(kerror);
+        }
+    }
+
+    cur_entry.principal = 0;
+    cur_entry.vno = 0;
+    cur_entry.key.contents = 0;
+
+    /* Look up the entry through the index if we can, or else scan the
+     * file. */
+    kerror = update_index(context, id);
+    if (kerror == 0) {
+        kerror = lookup_index(context, id, principal, kvno, enctype,
+                              &cur_entry, &found_wrong_kvno, &stale);
+        if (kerror == 0 && stale)
+            invalidate_index(context, id);
+    }
+    if (kerror != KRB5_KT_END) {
+        found_wrong_kvno = 0;
+        if (fseek(KTFILEP(id), KTSTARTOFF(id), SEEK_SET) == -1)
+            kerror = errno;
+        else
+            kerror = scan_entries(context, id, principal, kvno, enctype,
+                                  &cur_entry, &found_wrong_kvno);
+    }
+
     if (kerror == KRB5_KT_END) {
         if (cur_entry.principal)
             kerror = 0;
@@ -827,6 +1106,7 @@ krb5_ktfile_add(krb5_context context, krb5_keytab id, krb5_keytab_entry *entry)
                                  "active"));
         return KRB5_KT_IOERR;   /* XXX */
     }
+    invalidate_index(context, id);
     if ((retval = krb5_ktfileint_openw(context, id))) {
         KTUNLOCK(id);
         return retval;
@@ -864,6 +1144,7 @@ krb5_ktfile_remove(krb5_context context, krb5_keytab id, krb5_keytab_entry *entr
         return KRB5_KT_IOERR;   /* XXX */
     }
 
+    invalidate_index(context, id);
     if ((kerror = krb5_ktfileint_openw(context, id))) {
         KTUNLOCK(id);
         return kerror;
@@ -55,18 +55,24 @@
  *} krb5_keytab_entry;
  */
 
-/* Individual key entries within a table, in a linked list */
+/* Individual key entries within a table, in a linked list.  Each entry is
+ * also linked into an index bucket chosen by a hash of its principal, so that
+ * get_entry need not look at the entries of other principals. */
 typedef struct _krb5_mkt_link {
     struct _krb5_mkt_link *next;
+    struct _krb5_mkt_link *hash_next;
     krb5_keytab_entry *entry;
 } krb5_mkt_link, *krb5_mkt_cursor;
 
+#define MKT_INDEX_BUCKETS 64
+
 /* Per-keytab data header */
 typedef struct _krb5_mkt_data {
     char               *name;           /* Name of the keytab */
     k5_mutex_t          lock;           /* Thread-safety - all but link */
     krb5_int32          refcount;
     krb5_mkt_cursor     link;
+    krb5_mkt_cursor     index[MKT_INDEX_BUCKETS];
 } krb5_mkt_data;
 
 /* List of memory key tables */
@@ -100,6 +106,9 @@ static k5_mutex_t krb5int_mkt_mutex = K5_MUTEX_PARTIAL_INITIALIZER;
 #define KTLINK(id) (((krb5_mkt_data *)(id)->data)->link)
 #define KTREFCNT(id) (((krb5_mkt_data *)(id)->data)->refcount)
 #define KTNAME(id) (((krb5_mkt_data *)(id)->data)->name)
+#define KTBUCKET(id, princ)                                             \
+    (&((krb5_mkt_data *)(id)->data)->index[krb5int_kt_princ_hash(princ) % \
+                                           MKT_INDEX_BUCKETS])
 
 extern const struct _krb5_kt_ops krb5_mkt_ops;
 
@@ -392,7 +401,8 @@ krb5_mkt_get_entry(krb5_context context, krb5_keytab id,
     if (err)
         return err;
 
-    for (cursor = KTLINK(id); cursor && cursor->entry; cursor = cursor->next) {
+    for (cursor = *KTBUCKET(id, principal); cursor && cursor->entry;
+         cursor = cursor->hash_next) {
         entry = cursor->entry;
 
         /* if the principal isn't the one requested, continue to the next. */
@@ -589,6 +599,8 @@ krb5_mkt_add(krb5_context context, krb5_keytab id, krb5_keytab_entry *entry)
         cursor->next = KTLINK(id);
         KTLINK(id) = cursor;
     }
+    cursor->hash_next = *KTBUCKET(id, entry->principal);
+    *KTBUCKET(id, entry->principal) = cursor;
 
 done:
     KTUNLOCK(id);
@@ -602,7 +614,7 @@ done:
 krb5_error_code KRB5_CALLCONV
 krb5_mkt_remove(krb5_context context, krb5_keytab id, krb5_keytab_entry *entry)
 {
-    krb5_mkt_cursor *pcursor, next;
+    krb5_mkt_cursor *pcursor, *pbucket, next;
     krb5_error_code err = 0;
 
     err = KTLOCK(id);
@@ -626,6 +638,10 @@ krb5_mkt_remove(krb5_context context, krb5_keytab id, krb5_keytab_entry *entry)
         goto done;
     }
 
+    for (pbucket = KTBUCKET(id, entry->principal); *pbucket != *pcursor;
+         pbucket = &(*pbucket)->hash_next);
+    *pbucket = (*pcursor)->hash_next;
+
     krb5_kt_free_entry(context, (*pcursor)->entry);
     free((*pcursor)->entry);
     next = (*pcursor)->next;
@@ -297,4 +297,24 @@ krb5_ser_keytab_init(krb5_context kcontext)
 {
     return(krb5_register_serializer(kcontext, &krb5_keytab_ser_entry));
 }
+
+/* Hash princ for the keytab indexes.  Principals which are equal according
+ * to krb5_principal_compare() hash to the same value. */
+unsigned int
+krb5int_kt_princ_hash(krb5_const_principal princ)
+{
+    unsigned int h = 2166136261U, j;
+    const krb5_data *d;
+    krb5_int32 i;
+
+    /* FNV-1a over the realm and components, mixing in each length so that
+     * different splits of the same bytes hash differently. */
+    for (i = -1; i < princ->length; i++) {
+        d = (i < 0) ? &princ->realm : &princ->data[i];
+        for (j = 0; j < d->length; j++)
+            h = (h ^ (unsigned char)d->data[j]) * 16777619U;
+        h = (h ^ d->length ^ 0x100) * 16777619U;
+    }
+    return h;
+}
 #endif /* LEAN_CLIENT */
@@ -58,6 +58,7 @@ krb5_kt_get_entry(krb5_context context, krb5_keytab keytab,
 {
     krb5_error_code err;
     krb5_principal_data princ_data;
+    krb5_ui_8 start = k5_metric_start();
 
     if (krb5_is_referral_realm(&principal->realm)) {
         char *realm;
@@ -71,6 +72,7 @@ krb5_kt_get_entry(krb5_context context, krb5_keytab keytab,
     }
     err = krb5_x((keytab)->ops->get,(context, keytab, principal, vno, enctype,
                                      entry));
+    k5_metric_end(K5_METRIC_KT_GET_ENTRY, start, err);
     TRACE_KT_GET_ENTRY(context, keytab, principal, vno, enctype, err);
     if (principal == &princ_data)
         krb5_free_default_realm(context, princ_data.realm.data);
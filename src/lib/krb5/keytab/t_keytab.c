@@ -420,6 +420,119 @@ do_test(krb5_context context, const char *prefix, krb5_boolean delete)
 
 }
 
+/* Add an entry for princname with the given kvno to kt. */
+static void
+add_index_entry(krb5_context context, krb5_keytab kt, const char *princname,
+                krb5_kvno vno)
+{
+    krb5_error_code kret;
+    krb5_keytab_entry kent;
+    krb5_octet keydata = vno + '0';
+
+    memset(&kent, 0, sizeof(kent));
+    kret = krb5_parse_name(context, princname, &kent.principal);
+    CHECK(kret, "parsing principal");
+    kent.vno = vno;
+    kent.key.enctype = 1;
+    kent.key.length = 1;
+    kent.key.contents = &keydata;
+    kret = krb5_kt_add_entry(context, kt, &kent);
+    CHECK(kret, "adding entry");
+    krb5_free_principal(context, kent.principal);
+}
+
+/* Check that the highest kvno for princname in kt is vno. */
+static void
+check_index_entry(krb5_context context, krb5_keytab kt, const char *princname,
+                  krb5_kvno vno)
+{
+    krb5_error_code kret;
+    krb5_keytab_entry kent;
+    krb5_principal princ;
+
+    kret = krb5_parse_name(context, princname, &princ);
+    CHECK(kret, "parsing principal");
+    kret = krb5_kt_get_entry(context, kt, princ, 0, 1, &kent);
+    CHECK(kret, "looking up principal");
+    if (!krb5_principal_compare(context, princ, kent.principal) ||
+        kent.vno != vno || kent.key.contents[0] != vno + '0') {
+        fprintf(stderr, "Indexed lookup of %s returned kvno %d, not %d\n",
+                princname, (int)kent.vno, (int)vno);
+        exit(1);
+    }
+    krb5_free_keytab_entry_contents(context, &kent);
+    krb5_free_principal(context, princ);
+}
+
+/* Check that lookups through one handle see changes made through another,
+ * after the first handle has indexed the keytab. */
+static void
+index_test(krb5_context context, const char *name)
+{
+    krb5_error_code kret;
+    krb5_keytab kt1, kt2;
+    krb5_keytab_entry kent;
+    char princname[64];
+    int i;
+
+    kret = krb5_kt_resolve(context, name, &kt1);
+    CHECK(kret, "resolve");
+    kret = krb5_kt_resolve(context, name, &kt2);
+    CHECK(kret, "resolve");
+
+    for (i = 0; i < 100; i++) {
+        snprintf(princname, sizeof(princname), "host/h%d@TEST.REALM", i);
+        add_index_entry(context, kt1, princname, 1);
+        add_index_entry(context, kt1, princname, 2);
+    }
+    for (i = 0; i < 100; i++) {
+        snprintf(princname, sizeof(princname), "host/h%d@TEST.REALM", i);
+        check_index_entry(context, kt2, princname, 2);
+    }
+
+    /* Add a newer key and check that kt2 finds it. */
+    add_index_entry(context, kt1, "host/h42@TEST.REALM", 3);
+    check_index_entry(context, kt2, "host/h42@TEST.REALM", 3);
+
+    /* Remove it again; for a file keytab this does not change the size. */
+    memset(&kent, 0, sizeof(kent));
+    kret = krb5_parse_name(context, "host/h42@TEST.REALM", &kent.principal);
+    CHECK(kret, "parsing principal");
+    kent.vno = 3;
+    kent.key.enctype = 1;
+    kret = krb5_kt_remove_entry(context, kt1, &kent);
+    CHECK(kret, "removing entry");
+    krb5_free_principal(context, kent.principal);
+    check_index_entry(context, kt2, "host/h42@TEST.REALM", 2);
+    check_index_entry(context, kt2, "host/h43@TEST.REALM", 2);
+
+    kret = krb5_kt_close(context, kt2);
+    CHECK(kret, "close");
+    kret = krb5_kt_close(context, kt1);
+    CHECK(kret, "close");
+}
+
+static void
+do_index_test(krb5_context context, const char *prefix)
+{
+    char *name, *filename;
+
+    if (asprintf(&filename, "/tmp/ktindex.%ld", (long) getpid()) < 0) {
+        perror("asprintf");
+        exit(1);
+    }
+    if (asprintf(&name, "%s%s", prefix, filename) < 0) {
+        perror("asprintf");
+        exit(1);
+    }
+    printf("Starting index test on %s\n", name);
+    index_test(context, name);
+    printf("Index test on %s passed\n", name);
+    unlink(filename);
+    free(filename);
+    free(name);
+}
+
 int
 main(void)
 {
@@ -443,6 +556,8 @@ main(void)
     test_misc(context);
     do_test(context, "WRFILE:", FALSE);
     do_test(context, "MEMORY:", TRUE);
+    do_index_test(context, "WRFILE:");
+    do_index_test(context, "MEMORY:");
 
     krb5_free_context(context);
     return 0;
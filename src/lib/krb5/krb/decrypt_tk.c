@@ -37,6 +37,22 @@
 
 krb5_error_code KRB5_CALLCONV
 krb5_decrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, register krb5_ticket *ticket)
+{
+    krb5_key key;
+    krb5_error_code retval;
+
+    retval = krb5_k_create_key(context, srv_key, &key);
+    if (retval)
+        return retval;
+    retval = krb5_decrypt_tkt_part_k(context, key, ticket);
+    krb5_k_free_key(context, key);
+    return retval;
+}
+
+/* As above, but using a key object, whose derived keys may be reused. */
+krb5_error_code
+krb5_decrypt_tkt_part_k(krb5_context context, krb5_key srv_key,
+                        krb5_ticket *ticket)
 {
     krb5_enc_tkt_part *dec_tkt_part;
     krb5_data scratch;
@@ -53,7 +69,7 @@ krb5_decrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, regist
         return(ENOMEM);
 
     /* call the encryption routine */
-    if ((retval = krb5_c_decrypt(context, srv_key,
+    if ((retval = krb5_k_decrypt(context, srv_key,
                                  KRB5_KEYUSAGE_KDC_REP_TICKET, 0,
                                  &ticket->enc_part, &scratch))) {
         free(scratch.data);
@@ -40,6 +40,22 @@
 
 krb5_error_code
 krb5_encrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, register krb5_ticket *dec_ticket)
+{
+    krb5_key key;
+    krb5_error_code retval;
+
+    retval = krb5_k_create_key(context, srv_key, &key);
+    if (retval)
+        return retval;
+    retval = krb5_encrypt_tkt_part_k(context, key, dec_ticket);
+    krb5_k_free_key(context, key);
+    return retval;
+}
+
+/* As above, but using a key object, whose derived keys may be reused. */
+krb5_error_code
+krb5_encrypt_tkt_part_k(krb5_context context, krb5_key srv_key,
+                        krb5_ticket *dec_ticket)
 {
     krb5_data *scratch;
     krb5_error_code retval;
@@ -54,9 +70,9 @@ krb5_encrypt_tkt_part(krb5_context context, const krb5_keyblock *srv_key, regist
         krb5_free_data(context, scratch); }
 
     /* call the encryption routine */
-    retval = krb5_encrypt_helper(context, srv_key,
-                                 KRB5_KEYUSAGE_KDC_REP_TICKET, scratch,
-                                 &dec_ticket->enc_part);
+    retval = krb5_encrypt_keyhelper(context, srv_key,
+                                    KRB5_KEYUSAGE_KDC_REP_TICKET, scratch,
+                                    &dec_ticket->enc_part);
 
     cleanup_scratch();
 
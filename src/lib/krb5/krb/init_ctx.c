@@ -192,10 +192,12 @@ krb5_init_context_profile(profile_t profile, krb5_flags flags,
         goto cleanup;
 
     ctx->trace_callback = NULL;
+    if (!ctx->profile_secure) {
 #ifndef DISABLE_TRACING
-    if (!ctx->profile_secure)
         krb5int_init_trace(ctx);
 #endif
+        krb5int_init_metrics();
+    }
 
     retval = get_boolean(ctx, KRB5_CONF_ALLOW_WEAK_CRYPTO, 0, &tmp);
     if (retval)
@@ -314,6 +316,143 @@ krb5_free_context(krb5_context ctx)
     free(ctx);
 }
 
+/*
+ * A context template holds a private context which is never modified after
+ * the template is created, so that any number of threads can create contexts
+ * from it at once.
+ */
+struct _krb5_context_template {
+    krb5_magic magic;
+    krb5_context proto;
+};
+
+/*
+ * Create a context with the configuration of src.  The profile data of src is
+ * shared rather than reread (see profile_copy()), and the steps of
+ * krb5_init_context_profile() with process-wide effect, such as library
+ * initialization and PRNG seeding, were already done when src was created.
+ * Plugin interfaces are configured lazily in the new context, since
+ * callers may register built-in modules before first use.
+ */
+static krb5_error_code
+clone_context(krb5_context src, krb5_context *ctx_out)
+{
+    krb5_error_code ret;
+    krb5_context ctx;
+
+    *ctx_out = NULL;
+    ctx = k5alloc(sizeof(*ctx), &ret);
+    if (ctx == NULL)
+        return ret;
+    ctx->magic = KV5M_CONTEXT;
+    ctx->profile_secure = src->profile_secure;
+
+    ret = krb5_os_init_context(ctx, src->profile, 0);
+    if (ret)
+        goto cleanup;
+    ctx->os_context.time_offset = src->os_context.time_offset;
+    ctx->os_context.usec_offset = src->os_context.usec_offset;
+    ctx->os_context.os_flags = src->os_context.os_flags;
+    if (src->os_context.default_ccname != NULL) {
+        ctx->os_context.default_ccname =
+            strdup(src->os_context.default_ccname);
+        if (ctx->os_context.default_ccname == NULL)
+            goto oom;
+    }
+
+    ctx->trace_callback = NULL;
+    if (!ctx->profile_secure) {
+#ifndef DISABLE_TRACING
+        krb5int_init_trace(ctx);
+#endif
+        krb5int_init_metrics();
+    }
+
+    ctx->allow_weak_crypto = src->allow_weak_crypto;
+    ctx->ignore_acceptor_hostname = src->ignore_acceptor_hostname;
+    ctx->clockskew = src->clockskew;
+    ctx->kdc_req_sumtype = src->kdc_req_sumtype;
+    ctx->default_ap_req_sumtype = src->default_ap_req_sumtype;
+    ctx->default_safe_sumtype = src->default_safe_sumtype;
+    ctx->kdc_default_options = src->kdc_default_options;
+    ctx->library_options = src->library_options;
+    ctx->fcc_default_format = src->fcc_default_format;
+    ctx->udp_pref_limit = src->udp_pref_limit;
+    ctx->use_conf_ktypes = src->use_conf_ktypes;
+#ifdef KRB5_DNS_LOOKUP
+    ctx->profile_in_memory = src->profile_in_memory;
+#endif
+
+    if (src->default_realm != NULL) {
+        ctx->default_realm = strdup(src->default_realm);
+        if (ctx->default_realm == NULL)
+            goto oom;
+    }
+    if (src->in_tkt_etypes != NULL) {
+        ret = krb5int_copy_etypes(src->in_tkt_etypes, &ctx->in_tkt_etypes);
+        if (ret)
+            goto cleanup;
+    }
+    if (src->tgs_etypes != NULL) {
+        ret = krb5int_copy_etypes(src->tgs_etypes, &ctx->tgs_etypes);
+        if (ret)
+            goto cleanup;
+    }
+    ctx->plugin_base_dir = strdup(src->plugin_base_dir);
+    if (ctx->plugin_base_dir == NULL)
+        goto oom;
+
+    *ctx_out = ctx;
+    return 0;
+
+oom:
+    ret = ENOMEM;
+cleanup:
+    krb5_free_context(ctx);
+    return ret;
+}
+
+krb5_error_code KRB5_CALLCONV
+krb5_create_context_template(krb5_context context,
+                             krb5_context_template *tmpl_out)
+{
+    krb5_error_code ret;
+    krb5_context_template tmpl;
+
+    *tmpl_out = NULL;
+    tmpl = k5alloc(sizeof(*tmpl), &ret);
+    if (tmpl == NULL)
+        return ret;
+    ret = clone_context(context, &tmpl->proto);
+    if (ret) {
+        free(tmpl);
+        return ret;
+    }
+    tmpl->magic = KV5M_CONTEXT;
+    *tmpl_out = tmpl;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV
+krb5_init_context_from_template(krb5_context_template tmpl,
+                                krb5_context *context_out)
+{
+    *context_out = NULL;
+    if (tmpl == NULL || tmpl->magic != KV5M_CONTEXT)
+        return EINVAL;
+    return clone_context(tmpl->proto, context_out);
+}
+
+void KRB5_CALLCONV
+krb5_free_context_template(krb5_context_template tmpl)
+{
+    if (tmpl == NULL)
+        return;
+    krb5_free_context(tmpl->proto);
+    tmpl->magic = 0;
+    free(tmpl);
+}
+
 /*
  * Set the desired default ktypes, making sure they are valid.
  */
@@ -473,18 +473,22 @@ k5_pac_validate_client(krb5_context context,
     return ret;
 }
 
+/*
+ * Find the checksum field of the signature buffer of the given type, as a
+ * range of offsets into the PAC data.
+ */
 static krb5_error_code
-k5_pac_zero_signature(krb5_context context,
-                      const krb5_pac pac,
-                      krb5_ui_4 type,
-                      krb5_data *data)
+k5_pac_locate_signature(krb5_context context,
+                        const krb5_pac pac,
+                        krb5_ui_4 type,
+                        size_t *start,
+                        size_t *end)
 {
     PAC_INFO_BUFFER *buffer = NULL;
     size_t i;
 
     assert(type == KRB5_PAC_SERVER_CHECKSUM ||
            type == KRB5_PAC_PRIVSVR_CHECKSUM);
-    assert(data->length >= pac->data.length);
 
     for (i = 0; i < pac->pac->cBuffers; i++) {
         if (pac->pac->Buffers[i].ulType == type) {
@@ -502,25 +506,24 @@ k5_pac_zero_signature(krb5_context context,
     if (buffer->cbBufferSize < PAC_SIGNATURE_DATA_LENGTH)
         return KRB5_BAD_MSIZE;
 
-    /* Zero out the data portion of the checksum only */
-    memset(data->data + buffer->Offset + PAC_SIGNATURE_DATA_LENGTH,
-           0,
-           buffer->cbBufferSize - PAC_SIGNATURE_DATA_LENGTH);
-
+    *start = buffer->Offset + PAC_SIGNATURE_DATA_LENGTH;
+    *end = buffer->Offset + buffer->cbBufferSize;
     return 0;
 }
 
 static krb5_error_code
 k5_pac_verify_server_checksum(krb5_context context,
                               const krb5_pac pac,
-                              const krb5_keyblock *server)
+                              krb5_key server)
 {
     krb5_error_code ret;
-    krb5_data pac_data; /* PAC with zeroed checksums */
-    krb5_checksum checksum;
     krb5_data checksum_data;
+    krb5_cksumtype cksumtype;
+    krb5_crypto_iov iov[6];
+    size_t start[2], end[2], tmp, zlen;
+    char *zeros = NULL;
     krb5_boolean valid;
-    krb5_octet *p;
+    int n = 0;
 
     ret = k5_pac_locate_buffer(context, pac, KRB5_PAC_SERVER_CHECKSUM,
                                &checksum_data);
@@ -530,44 +533,64 @@ k5_pac_verify_server_checksum(krb5_context context,
     if (checksum_data.length < PAC_SIGNATURE_DATA_LENGTH)
         return KRB5_BAD_MSIZE;
 
-    p = (krb5_octet *)checksum_data.data;
-    checksum.checksum_type = load_32_le(p);
-    checksum.length = checksum_data.length - PAC_SIGNATURE_DATA_LENGTH;
-    checksum.contents = p + PAC_SIGNATURE_DATA_LENGTH;
-    if (!krb5_c_is_keyed_cksum(checksum.checksum_type))
+    cksumtype = load_32_le(checksum_data.data);
+    if (!krb5_c_is_keyed_cksum(cksumtype))
         return KRB5KRB_AP_ERR_INAPP_CKSUM;
 
-    pac_data.length = pac->data.length;
-    pac_data.data = malloc(pac->data.length);
-    if (pac_data.data == NULL)
-        return ENOMEM;
-
-    memcpy(pac_data.data, pac->data.data, pac->data.length);
-
-    /* Zero out both checksum buffers */
-    ret = k5_pac_zero_signature(context, pac, KRB5_PAC_SERVER_CHECKSUM,
-                                &pac_data);
-    if (ret != 0) {
-        free(pac_data.data);
+    /*
+     * The checksum covers the whole PAC with both checksum fields zeroed.
+     * Rather than copying the PAC to zero them, checksum the PAC in pieces,
+     * substituting zeros for the checksum fields.
+     */
+    ret = k5_pac_locate_signature(context, pac, KRB5_PAC_SERVER_CHECKSUM,
+                                  &start[0], &end[0]);
+    if (ret != 0)
         return ret;
-    }
-
-    ret = k5_pac_zero_signature(context, pac, KRB5_PAC_PRIVSVR_CHECKSUM,
-                                &pac_data);
-    if (ret != 0) {
-        free(pac_data.data);
+    ret = k5_pac_locate_signature(context, pac, KRB5_PAC_PRIVSVR_CHECKSUM,
+                                  &start[1], &end[1]);
+    if (ret != 0)
         return ret;
+    if (start[1] < start[0]) {
+        tmp = start[0];
+        start[0] = start[1];
+        start[1] = tmp;
+        tmp = end[0];
+        end[0] = end[1];
+        end[1] = tmp;
     }
+    if (end[0] > start[1])
+        return ERANGE;
 
-    ret = krb5_c_verify_checksum(context, server,
-                                 KRB5_KEYUSAGE_APP_DATA_CKSUM,
-                                 &pac_data, &checksum, &valid);
+    zlen = (end[0] - start[0] > end[1] - start[1]) ?
+        end[0] - start[0] : end[1] - start[1];
+    zeros = k5alloc(zlen, &ret);
+    if (zeros == NULL && zlen > 0)
+        return ret;
 
-    free(pac_data.data);
+    iov[n].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[n++].data = make_data(pac->data.data, start[0]);
+    iov[n].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[n++].data = make_data(zeros, end[0] - start[0]);
+    iov[n].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[n++].data = make_data(pac->data.data + end[0], start[1] - end[0]);
+    iov[n].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[n++].data = make_data(zeros, end[1] - start[1]);
+    iov[n].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[n++].data = make_data(pac->data.data + end[1],
+                              pac->data.length - end[1]);
+    iov[n].flags = KRB5_CRYPTO_TYPE_CHECKSUM;
+    iov[n++].data = make_data(checksum_data.data + PAC_SIGNATURE_DATA_LENGTH,
+                              checksum_data.length -
+                              PAC_SIGNATURE_DATA_LENGTH);
+
+    ret = krb5_k_verify_checksum_iov(context, cksumtype, server,
+                                     KRB5_KEYUSAGE_APP_DATA_CKSUM, iov, n,
+                                     &valid);
+
+    free(zeros);
 
-    if (ret != 0) {
+    if (ret != 0)
         return ret;
-    }
 
     if (valid == FALSE)
         ret = KRB5KRB_AP_ERR_BAD_INTEGRITY;
@@ -578,7 +601,7 @@ k5_pac_verify_server_checksum(krb5_context context,
 static krb5_error_code
 k5_pac_verify_kdc_checksum(krb5_context context,
                            const krb5_pac pac,
-                           const krb5_keyblock *privsvr)
+                           krb5_key privsvr)
 {
     krb5_error_code ret;
     krb5_data server_checksum, privsvr_checksum;
@@ -612,7 +635,7 @@ k5_pac_verify_kdc_checksum(krb5_context context,
     server_checksum.data += PAC_SIGNATURE_DATA_LENGTH;
     server_checksum.length -= PAC_SIGNATURE_DATA_LENGTH;
 
-    ret = krb5_c_verify_checksum(context, privsvr,
+    ret = krb5_k_verify_checksum(context, privsvr,
                                  KRB5_KEYUSAGE_APP_DATA_CKSUM,
                                  &server_checksum, &checksum, &valid);
     if (ret != 0)
@@ -633,6 +656,42 @@ krb5_pac_verify(krb5_context context,
                 const krb5_keyblock *privsvr)
 {
     krb5_error_code ret;
+    krb5_key server_key = NULL, privsvr_key = NULL;
+
+    if (server != NULL) {
+        ret = krb5_k_create_key(context, server, &server_key);
+        if (ret != 0)
+            goto cleanup;
+    }
+
+    if (privsvr != NULL) {
+        ret = krb5_k_create_key(context, privsvr, &privsvr_key);
+        if (ret != 0)
+            goto cleanup;
+    }
+
+    ret = krb5_pac_verify_k(context, pac, authtime, principal, server_key,
+                            privsvr_key);
+
+cleanup:
+    krb5_k_free_key(context, server_key);
+    krb5_k_free_key(context, privsvr_key);
+    return ret;
+}
+
+/*
+ * As above, but using key objects, so that a caller verifying many PACs with
+ * the same keys (such as a KDC) can reuse their derived keys.
+ */
+krb5_error_code
+krb5_pac_verify_k(krb5_context context,
+                  const krb5_pac pac,
+                  krb5_timestamp authtime,
+                  krb5_const_principal principal,
+                  krb5_key server,
+                  krb5_key privsvr)
+{
+    krb5_error_code ret;
 
     if (server != NULL) {
         ret = k5_pac_verify_server_checksum(context, pac, server);
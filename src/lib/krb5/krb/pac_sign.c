@@ -94,14 +94,16 @@ static krb5_error_code
 k5_insert_checksum(krb5_context context,
                    krb5_pac pac,
                    krb5_ui_4 type,
-                   const krb5_keyblock *key,
+                   krb5_key key,
                    krb5_cksumtype *cksumtype)
 {
     krb5_error_code ret;
     size_t len;
     krb5_data cksumdata;
 
-    ret = krb5int_c_mandatory_cksumtype(context, key->enctype, cksumtype);
+    ret = krb5int_c_mandatory_cksumtype(context,
+                                        krb5_k_key_enctype(context, key),
+                                        cksumtype);
     if (ret != 0)
         return ret;
 
@@ -183,6 +185,35 @@ krb5_error_code KRB5_CALLCONV
 krb5_pac_sign(krb5_context context, krb5_pac pac, krb5_timestamp authtime,
               krb5_const_principal principal, const krb5_keyblock *server_key,
               const krb5_keyblock *privsvr_key, krb5_data *data)
+{
+    krb5_error_code ret;
+    krb5_key server = NULL, privsvr = NULL;
+
+    data->length = 0;
+    data->data = NULL;
+
+    ret = krb5_k_create_key(context, server_key, &server);
+    if (ret != 0)
+        goto cleanup;
+
+    ret = krb5_k_create_key(context, privsvr_key, &privsvr);
+    if (ret != 0)
+        goto cleanup;
+
+    ret = krb5_pac_sign_k(context, pac, authtime, principal, server, privsvr,
+                          data);
+
+cleanup:
+    krb5_k_free_key(context, server);
+    krb5_k_free_key(context, privsvr);
+    return ret;
+}
+
+/* As above, but using key objects, whose derived keys may be reused. */
+krb5_error_code
+krb5_pac_sign_k(krb5_context context, krb5_pac pac, krb5_timestamp authtime,
+                krb5_const_principal principal, krb5_key server_key,
+                krb5_key privsvr_key, krb5_data *data)
 {
     krb5_error_code ret;
     krb5_data server_cksum, privsvr_cksum;
@@ -229,7 +260,7 @@ krb5_pac_sign(krb5_context context, krb5_pac pac, krb5_timestamp authtime,
     iov[1].data.data = server_cksum.data + PAC_SIGNATURE_DATA_LENGTH;
     iov[1].data.length = server_cksum.length - PAC_SIGNATURE_DATA_LENGTH;
 
-    ret = krb5_c_make_checksum_iov(context, server_cksumtype,
+    ret = krb5_k_make_checksum_iov(context, server_cksumtype,
                                    server_key, KRB5_KEYUSAGE_APP_DATA_CKSUM,
                                    iov, sizeof(iov)/sizeof(iov[0]));
     if (ret != 0)
@@ -251,7 +282,7 @@ krb5_pac_sign(krb5_context context, krb5_pac pac, krb5_timestamp authtime,
     iov[1].data.data = privsvr_cksum.data + PAC_SIGNATURE_DATA_LENGTH;
     iov[1].data.length = privsvr_cksum.length - PAC_SIGNATURE_DATA_LENGTH;
 
-    ret = krb5_c_make_checksum_iov(context, privsvr_cksumtype,
+    ret = krb5_k_make_checksum_iov(context, privsvr_cksumtype,
                                    privsvr_key, KRB5_KEYUSAGE_APP_DATA_CKSUM,
                                    iov, sizeof(iov)/sizeof(iov[0]));
     if (ret != 0)
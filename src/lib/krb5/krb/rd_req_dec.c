@@ -184,6 +184,17 @@ decrypt_ticket(krb5_context context, const krb5_ap_req *req,
                              keyblock_out);
     }
 
+    /*
+     * The entry for the principal asserted by the client is the most likely
+     * to work, and the keytab can find it without decrypting anything, so
+     * try it first.  Fall back to trying every matching entry, in case the
+     * client used an alias of a principal in the keytab.
+     */
+    if (krb5_sname_match(context, server, req->ticket->server) &&
+        try_one_princ(context, req, req->ticket->server, keytab,
+                      keyblock_out) == 0)
+        return 0;
+
     ret = krb5_kt_start_seq_get(context, keytab, &cursor);
     if (ret)
         goto cleanup;
@@ -256,7 +267,7 @@ rd_req_decoded_opt(krb5_context context, krb5_auth_context *auth_context,
     int                   rfc4537_etypes_len = 0;
     krb5_enctype         *permitted_etypes = NULL;
     int                   permitted_etypes_len = 0;
-    krb5_keyblock         decrypt_key;
+    krb5_keyblock         decrypt_key, *keyblock;
 
     decrypt_key.enctype = ENCTYPE_NULL;
     decrypt_key.contents = NULL;
@@ -267,13 +278,17 @@ rd_req_decoded_opt(krb5_context context, krb5_auth_context *auth_context,
 
     /* decrypt the ticket */
     if ((*auth_context)->key) { /* User to User authentication */
-        if ((retval = krb5_decrypt_tkt_part(context,
-                                            &(*auth_context)->key->keyblock,
-                                            req->ticket)))
+        if ((retval = krb5_decrypt_tkt_part_k(context, (*auth_context)->key,
+                                              req->ticket)))
             goto cleanup;
         if (check_valid_flag) {
-            decrypt_key = (*auth_context)->key->keyblock;
-            (*auth_context)->key->keyblock.contents = NULL;
+            /* The key may be shared (see krb5_auth_con_setuseruserkey_k). */
+            retval = krb5_k_key_keyblock(context, (*auth_context)->key,
+                                         &keyblock);
+            if (retval)
+                goto cleanup;
+            decrypt_key = *keyblock;
+            free(keyblock);
         }
         krb5_k_free_key(context, (*auth_context)->key);
         (*auth_context)->key = NULL;
@@ -166,6 +166,53 @@ main(int argc, char **argv)
     if (ret)
         err(context, ret, "krb5_pac_verify 2");
 
+    /* sign and verify with key objects, and check that changes are noticed */
+    {
+        krb5_key member_key, kdc_key;
+        krb5_pac pac3;
+
+        ret = krb5_k_create_key(context, &member_keyblock, &member_key);
+        if (ret)
+            err(context, ret, "krb5_k_create_key");
+        ret = krb5_k_create_key(context, &kdc_keyblock, &kdc_key);
+        if (ret)
+            err(context, ret, "krb5_k_create_key");
+
+        ret = krb5_pac_verify_k(context, pac, authtime, p, member_key,
+                                kdc_key);
+        if (ret)
+            err(context, ret, "krb5_pac_verify_k");
+
+        ret = krb5_pac_sign_k(context, pac, authtime, p, member_key, kdc_key,
+                              &data);
+        if (ret)
+            err(context, ret, "krb5_pac_sign_k");
+
+        ret = krb5_pac_parse(context, data.data, data.length, &pac3);
+        if (ret)
+            err(context, ret, "krb5_pac_parse 5");
+        ret = krb5_pac_verify_k(context, pac3, authtime, p, member_key,
+                                kdc_key);
+        if (ret)
+            err(context, ret, "krb5_pac_verify_k 2");
+        krb5_pac_free(context, pac3);
+
+        /* Change a byte of the logon info buffer. */
+        data.data[0x48 + 16] ^= 1;
+        ret = krb5_pac_parse(context, data.data, data.length, &pac3);
+        if (ret)
+            err(context, ret, "krb5_pac_parse 6");
+        ret = krb5_pac_verify_k(context, pac3, authtime, p, member_key,
+                                kdc_key);
+        if (ret != KRB5KRB_AP_ERR_BAD_INTEGRITY)
+            err(context, ret, "krb5_pac_verify_k of modified PAC");
+        krb5_pac_free(context, pac3);
+
+        krb5_free_data_contents(context, &data);
+        krb5_k_free_key(context, member_key);
+        krb5_k_free_key(context, kdc_key);
+    }
+
     /* make a copy and try to reproduce it */
     {
         uint32_t *list;
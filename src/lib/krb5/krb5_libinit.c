@@ -57,6 +57,20 @@ int krb5int_lib_init(void)
     err = k5_mutex_finish_init(&krb5int_us_time_mutex);
     if (err)
         return err;
+    err = k5_mutex_finish_init(&krb5int_kdc_health_mutex);
+    if (err)
+        return err;
+    err = krb5int_trace_initialize();
+    if (err)
+        return err;
+    err = krb5int_metrics_initialize();
+    if (err)
+        return err;
+#ifdef KRB5_DNS_LOOKUP
+    err = krb5int_srv_cache_initialize();
+    if (err)
+        return err;
+#endif
 
     return 0;
 }
@@ -85,6 +99,12 @@ void krb5int_lib_fini(void)
 #endif
 
     k5_mutex_destroy(&krb5int_us_time_mutex);
+    k5_mutex_destroy(&krb5int_kdc_health_mutex);
+    krb5int_metrics_finalize();
+    krb5int_trace_finalize();
+#ifdef KRB5_DNS_LOOKUP
+    krb5int_srv_cache_finalize();
+#endif
 
     krb5int_cc_finalize();
 #ifndef LEAN_CLIENT
@@ -50,6 +50,8 @@ struct krb5int_dns_state {
     void *ansp;
     int anslen;
     int ansmax;
+    long min_ttl;
+    int no_records;
 #if HAVE_NS_INITPARSE
     int cur_ans;
     ns_msg msg;
@@ -78,7 +80,7 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
     struct __res_state statbuf;
 #endif
     struct krb5int_dns_state *ds;
-    int len, ret;
+    int len, ret, herr;
     size_t nextincr, maxincr;
     unsigned char *p;
 
@@ -92,6 +94,8 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
     ds->ansp = NULL;
     ds->anslen = 0;
     ds->ansmax = 0;
+    ds->min_ttl = -1;
+    ds->no_records = 0;
     nextincr = 2048;
     maxincr = INT_MAX;
 
@@ -122,10 +126,17 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
 #if USE_RES_NINIT
         len = res_nsearch(&statbuf, host, ds->nclass, ds->ntype,
                           ds->ansp, ds->ansmax);
+        herr = statbuf.res_h_errno;
 #else
         len = res_search(host, ds->nclass, ds->ntype,
                          ds->ansp, ds->ansmax);
+        herr = h_errno;
 #endif
+        if (len < 0) {
+            ds->no_records = (herr == HOST_NOT_FOUND || herr == NO_DATA);
+            ret = -1;
+            goto errout;
+        }
         if ((size_t) len > maxincr) {
             ret = -1;
             goto errout;
@@ -175,6 +186,7 @@ krb5int_dns_nextans(struct krb5int_dns_state *ds,
                     const unsigned char **pp, int *lenp)
 {
     int len;
+    long ttl;
     ns_rr rr;
 
     *pp = NULL;
@@ -188,6 +200,10 @@ krb5int_dns_nextans(struct krb5int_dns_state *ds,
             && ds->ntype == (int)ns_rr_type(rr)) {
             *pp = ns_rr_rdata(rr);
             *lenp = ns_rr_rdlen(rr);
+            /* RFC 2181 says to treat a TTL with the high bit set as zero. */
+            ttl = (ns_rr_ttl(rr) & 0x80000000UL) ? 0 : (long)ns_rr_ttl(rr);
+            if (ds->min_ttl < 0 || ttl < ds->min_ttl)
+                ds->min_ttl = ttl;
             return 0;
         }
     }
@@ -214,6 +230,27 @@ krb5int_dns_expand(struct krb5int_dns_state *ds, const unsigned char *p,
 #endif
 }
 
+/*
+ * krb5int_dns_min_ttl - smallest TTL of the answer records returned so
+ * far by krb5int_dns_nextans(), or -1 if none have been returned
+ */
+long
+krb5int_dns_min_ttl(struct krb5int_dns_state *ds)
+{
+    return ds->min_ttl;
+}
+
+/*
+ * krb5int_dns_no_records - true if krb5int_dns_init() failed because the
+ * name authoritatively has no records of the requested type (NXDOMAIN or
+ * NODATA), as opposed to a timeout or server failure which may not recur
+ */
+int
+krb5int_dns_no_records(struct krb5int_dns_state *ds)
+{
+    return ds->no_records;
+}
+
 /*
  * Free stuff.
  */
@@ -289,7 +326,8 @@ krb5int_dns_nextans(struct krb5int_dns_state *ds,
 {
     int len;
     unsigned char *p;
-    unsigned short ntype, nclass, rdlen;
+    unsigned short ntype, nclass, rdlen, ttl_hi, ttl_lo;
+    long ttl;
 #if !HAVE_DN_SKIPNAME
     char host[MAXDNAME];
 #endif
@@ -309,9 +347,12 @@ krb5int_dns_nextans(struct krb5int_dns_state *ds,
             return -1;
         p += len;
         SAFE_GETUINT16(ds->ansp, ds->anslen, p, 2, ntype, out);
-        /* Also skip 4 bytes of TTL */
-        SAFE_GETUINT16(ds->ansp, ds->anslen, p, 6, nclass, out);
+        SAFE_GETUINT16(ds->ansp, ds->anslen, p, 2, nclass, out);
+        SAFE_GETUINT16(ds->ansp, ds->anslen, p, 2, ttl_hi, out);
+        SAFE_GETUINT16(ds->ansp, ds->anslen, p, 2, ttl_lo, out);
         SAFE_GETUINT16(ds->ansp, ds->anslen, p, 2, rdlen, out);
+        /* RFC 2181 says to treat a TTL with the high bit set as zero. */
+        ttl = (ttl_hi & 0x8000) ? 0 : ((long)ttl_hi << 16) | ttl_lo;
 
         if (!INCR_OK(ds->ansp, ds->anslen, p, rdlen))
             return -1;
@@ -321,6 +362,8 @@ krb5int_dns_nextans(struct krb5int_dns_state *ds,
             *pp = p;
             *lenp = rdlen;
             ds->ptr = p + rdlen;
+            if (ds->min_ttl < 0 || ttl < ds->min_ttl)
+                ds->min_ttl = ttl;
             return 0;
         }
         p += rdlen;
@@ -153,6 +153,8 @@ int krb5int_dns_nextans(struct krb5int_dns_state *,
                         const unsigned char **, int *);
 int krb5int_dns_expand(struct krb5int_dns_state *,
                        const unsigned char *, char *, int);
+long krb5int_dns_min_ttl(struct krb5int_dns_state *);
+int krb5int_dns_no_records(struct krb5int_dns_state *);
 void krb5int_dns_fini(struct krb5int_dns_state *);
 
 #endif /* KRB5_DNS_LOOKUP */
@@ -28,6 +28,7 @@
 #ifdef KRB5_DNS_LOOKUP
 
 #include "dnsglue.h"
+#include "os-proto.h"
 
 /*
  * Lookup a KDC via DNS SRV records
@@ -45,73 +46,207 @@ krb5int_free_srv_dns_data (struct srv_dns_entry *p)
     }
 }
 
-/* Do DNS SRV query, return results in *answers.
+/*
+ * Process-wide cache of SRV answers, shared by all contexts so that programs
+ * which create many contexts don't repeat the same queries.  An answer is
+ * kept for the smallest TTL among its records, up to SRV_CACHE_MAX_TTL.  An
+ * authoritative answer that the name has no SRV records (NXDOMAIN or NODATA)
+ * is remembered for SRV_CACHE_NEGATIVE_TTL, since res_search() doesn't give
+ * us the SOA record from which RFC 2308 would derive a negative TTL.  Failed
+ * queries (timeouts and server failures) are not cached, so that a transient
+ * DNS problem doesn't hide the KDCs for long.
+ */
+#define SRV_CACHE_SIZE          32
+#define SRV_CACHE_MAX_TTL       3600    /* seconds */
+#define SRV_CACHE_NEGATIVE_TTL  60      /* seconds */
 
-   Make best effort to return all the data we can.  On memory or
-   decoding errors, just return what we've got.  Always return 0,
-   currently.  */
+struct srv_cache_entry {
+    char *name;                 /* Query name, or NULL if unused */
+    struct srv_dns_entry *answers;
+    time_t expires;
+    unsigned long last_used;    /* For replacement */
+};
 
-krb5_error_code
-krb5int_make_srv_query_realm(const krb5_data *realm,
-                             const char *service,
-                             const char *protocol,
-                             struct srv_dns_entry **answers)
+k5_mutex_t krb5int_srv_cache_mutex = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct srv_cache_entry srv_cache[SRV_CACHE_SIZE];
+static unsigned long srv_cache_clock;
+
+static krb5_error_code
+copy_srv_list(const struct srv_dns_entry *list, struct srv_dns_entry **out)
+{
+    struct srv_dns_entry *head = NULL, **tailp = &head, *entry;
+
+    *out = NULL;
+    for (; list != NULL; list = list->next) {
+        entry = malloc(sizeof(*entry));
+        if (entry == NULL)
+            goto oom;
+        *entry = *list;
+        entry->next = NULL;
+        entry->host = strdup(list->host);
+        if (entry->host == NULL) {
+            free(entry);
+            goto oom;
+        }
+        *tailp = entry;
+        tailp = &entry->next;
+    }
+    *out = head;
+    return 0;
+
+oom:
+    krb5int_free_srv_dns_data(head);
+    return ENOMEM;
+}
+
+static void
+clear_cache_entry(struct srv_cache_entry *ent)
+{
+    free(ent->name);
+    krb5int_free_srv_dns_data(ent->answers);
+    memset(ent, 0, sizeof(*ent));
+}
+
+/* If name has an unexpired cache entry, set *answers to a copy of its
+ * answers (which may be NULL for a negative entry) and return true. */
+static krb5_boolean
+srv_cache_lookup(krb5_context context, const char *name,
+                 struct srv_dns_entry **answers)
+{
+    struct srv_cache_entry *ent;
+    time_t now = time(NULL);
+    krb5_boolean found = FALSE;
+    int remaining = 0;
+    size_t i;
+
+    *answers = NULL;
+    if (k5_mutex_lock(&krb5int_srv_cache_mutex) != 0)
+        return FALSE;
+    for (i = 0; i < SRV_CACHE_SIZE; i++) {
+        ent = &srv_cache[i];
+        if (ent->name == NULL || strcmp(ent->name, name) != 0)
+            continue;
+        if (now >= ent->expires) {
+            clear_cache_entry(ent);
+        } else if (copy_srv_list(ent->answers, answers) == 0) {
+            ent->last_used = ++srv_cache_clock;
+            remaining = ent->expires - now;
+            found = TRUE;
+        }
+        break;
+    }
+    k5_mutex_unlock(&krb5int_srv_cache_mutex);
+
+    if (found)
+        TRACE_DNS_SRV_CACHE_HIT(context, name, remaining);
+    else
+        TRACE_DNS_SRV_CACHE_MISS(context, name);
+    return found;
+}
+
+/* Remember answers for name for ttl seconds, replacing the least recently
+ * used entry if the cache is full. */
+static void
+srv_cache_store(const char *name, const struct srv_dns_entry *answers,
+                long ttl)
+{
+    struct srv_cache_entry *ent, *victim = NULL;
+    struct srv_dns_entry *copy;
+    char *namecopy;
+    size_t i;
+
+    if (ttl <= 0)
+        return;
+    if (ttl > SRV_CACHE_MAX_TTL)
+        ttl = SRV_CACHE_MAX_TTL;
+    if (copy_srv_list(answers, &copy) != 0)
+        return;
+    namecopy = strdup(name);
+    if (namecopy == NULL)
+        goto cleanup;
+    if (k5_mutex_lock(&krb5int_srv_cache_mutex) != 0)
+        goto cleanup;
+    for (i = 0; i < SRV_CACHE_SIZE; i++) {
+        ent = &srv_cache[i];
+        if (ent->name != NULL && strcmp(ent->name, name) == 0) {
+            victim = ent;
+            break;
+        }
+        if (victim == NULL || ent->last_used < victim->last_used)
+            victim = ent;
+    }
+    clear_cache_entry(victim);
+    victim->name = namecopy;
+    victim->answers = copy;
+    victim->expires = time(NULL) + ttl;
+    victim->last_used = ++srv_cache_clock;
+    k5_mutex_unlock(&krb5int_srv_cache_mutex);
+    return;
+
+cleanup:
+    free(namecopy);
+    krb5int_free_srv_dns_data(copy);
+}
+
+int
+krb5int_srv_cache_initialize(void)
+{
+    return k5_mutex_finish_init(&krb5int_srv_cache_mutex);
+}
+
+void
+krb5int_srv_cache_finalize(void)
+{
+    size_t i;
+
+    for (i = 0; i < SRV_CACHE_SIZE; i++)
+        clear_cache_entry(&srv_cache[i]);
+    k5_mutex_destroy(&krb5int_srv_cache_mutex);
+}
+
+/* Do a DNS SRV query for qname, returning the answers sorted by priority in
+ * *answers.  Set *ttl_out to the number of seconds for which the result may
+ * be cached: the smallest TTL among the answers, SRV_CACHE_NEGATIVE_TTL if
+ * the name authoritatively has no SRV records, or -1 if the query failed or
+ * its answer could not be fully read.
+
+   Make best effort to return all the data we can.  On memory or
+   decoding errors, just return what we've got.  */
+static void
+query_srv(char *qname, struct srv_dns_entry **answers, long *ttl_out)
 {
     const unsigned char *p = NULL, *base = NULL;
     char host[MAXDNAME];
-    int size, ret, rdlen, nlen, len;
+    int size, ret, rdlen, nlen;
     unsigned short priority, weight, port;
     struct krb5int_dns_state *ds = NULL;
-    struct k5buf buf;
 
     struct srv_dns_entry *head = NULL;
     struct srv_dns_entry *srv = NULL, *entry = NULL;
 
-    /*
-     * First off, build a query of the form:
-     *
-     * service.protocol.realm
-     *
-     * which will most likely be something like:
-     *
-     * _kerberos._udp.REALM
-     *
-     */
-
-    if (memchr(realm->data, 0, realm->length))
-        return 0;
-    krb5int_buf_init_fixed(&buf, host, sizeof(host));
-    krb5int_buf_add_fmt(&buf, "%s.%s.", service, protocol);
-    krb5int_buf_add_len(&buf, realm->data, realm->length);
-
-    /* Realm names don't (normally) end with ".", but if the query
-       doesn't end with "." and doesn't get an answer as is, the
-       resolv code will try appending the local domain.  Since the
-       realm names are absolutes, let's stop that.
-
-       But only if a name has been specified.  If we are performing
-       a search on the prefix alone then the intention is to allow
-       the local domain or domain search lists to be expanded.  */
-
-    len = krb5int_buf_len(&buf);
-    if (len > 0 && host[len - 1] != '.')
-        krb5int_buf_add(&buf, ".");
-
-    if (krb5int_buf_data(&buf) == NULL)
-        return 0;
+    *ttl_out = -1;
 
 #ifdef TEST
-    fprintf (stderr, "sending DNS SRV query for %s\n", host);
+    fprintf (stderr, "sending DNS SRV query for %s\n", qname);
 #endif
 
-    size = krb5int_dns_init(&ds, host, C_IN, T_SRV);
-    if (size < 0)
+    size = krb5int_dns_init(&ds, qname, C_IN, T_SRV);
+    if (size < 0) {
+        if (ds != NULL && krb5int_dns_no_records(ds))
+            *ttl_out = SRV_CACHE_NEGATIVE_TTL;
         goto out;
+    }
 
     for (;;) {
         ret = krb5int_dns_nextans(ds, &base, &rdlen);
-        if (ret < 0 || base == NULL)
+        if (ret < 0)
+            goto out;
+        if (base == NULL) {
+            /* We have read the whole answer. */
+            *ttl_out = (head == NULL) ? SRV_CACHE_NEGATIVE_TTL :
+                krb5int_dns_min_ttl(ds);
             goto out;
+        }
 
         p = base;
 
@@ -177,6 +312,64 @@ out:
         ds = NULL;
     }
     *answers = head;
+}
+
+/* Do DNS SRV query, return results in *answers, using the cache if
+   possible.  Always return 0, currently.  */
+
+krb5_error_code
+krb5int_make_srv_query_realm(krb5_context context, const krb5_data *realm,
+                             const char *service,
+                             const char *protocol,
+                             struct srv_dns_entry **answers)
+{
+    char qname[MAXDNAME];
+    int len;
+    long ttl;
+    struct k5buf buf;
+    struct srv_dns_entry *head = NULL;
+
+    *answers = NULL;
+
+    /*
+     * First off, build a query of the form:
+     *
+     * service.protocol.realm
+     *
+     * which will most likely be something like:
+     *
+     * _kerberos._udp.REALM
+     *
+     */
+
+    if (memchr(realm->data, 0, realm->length))
+        return 0;
+    krb5int_buf_init_fixed(&buf, qname, sizeof(qname));
+    krb5int_buf_add_fmt(&buf, "%s.%s.", service, protocol);
+    krb5int_buf_add_len(&buf, realm->data, realm->length);
+
+    /* Realm names don't (normally) end with ".", but if the query
+       doesn't end with "." and doesn't get an answer as is, the
+       resolv code will try appending the local domain.  Since the
+       realm names are absolutes, let's stop that.
+
+       But only if a name has been specified.  If we are performing
+       a search on the prefix alone then the intention is to allow
+       the local domain or domain search lists to be expanded.  */
+
+    len = krb5int_buf_len(&buf);
+    if (len > 0 && qname[len - 1] != '.')
+        krb5int_buf_add(&buf, ".");
+
+    if (krb5int_buf_data(&buf) == NULL)
+        return 0;
+
+    if (srv_cache_lookup(context, qname, answers))
+        return 0;
+
+    query_srv(qname, &head, &ttl);
+    srv_cache_store(qname, head, ttl);
+    *answers = head;
     return 0;
 }
 #endif
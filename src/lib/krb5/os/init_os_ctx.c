@@ -446,6 +446,7 @@ krb5_os_init_context(krb5_context ctx, profile_t profile, krb5_flags flags)
     os_ctx->usec_offset = 0;
     os_ctx->os_flags = 0;
     os_ctx->default_ccname = 0;
+    os_ctx->tcp_pool = NULL;
 
     ctx->vtbl = 0;
     PLUGIN_DIR_INIT(&ctx->libkrb5_plugins);
@@ -543,6 +544,8 @@ krb5_os_free_context(krb5_context ctx)
         os_ctx->default_ccname = 0;
     }
 
+    k5_sendto_free_tcp_pool(ctx);
+
     os_ctx->magic = 0;
 
     if (ctx->profile) {
@@ -0,0 +1,261 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/metrics.c - Operation counters and snapshots */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * If the KRB5_METRICS environment variable names a file when the first
+ * (non-secure) context is created, the library counts calls, failures, and
+ * latencies of a few operations which commonly dominate the cost of a
+ * Kerberos exchange: KDC exchanges, credential cache stores and lookups,
+ * keytab lookups, and replay cache stores.  The LDAP KDB module also records
+ * its handle pool waits and principal searches here.  Latencies are kept in
+ * power-of-two histograms.
+ *
+ * A snapshot appends the counters to the metrics file and the binary trace
+ * rings (see trace.c) to the binary trace file.  Programs can write one with
+ * krb5int_snapshot_write().  If KRB5_SNAPSHOT_SIGNAL is set to a signal
+ * number whose disposition is the default, receiving that signal requests a
+ * snapshot; it is written by the next thread to record a metric or binary
+ * trace event, since little can safely be done in a signal handler.
+ */
+
+#include "k5-int.h"
+#include "os-proto.h"
+#ifdef POSIX_SIGNALS
+#include <signal.h>
+#endif
+
+static const char *const metric_names[K5_METRIC_MAX] = {
+    "sendto_kdc",
+    "cc_store",
+    "cc_retrieve",
+    "kt_get_entry",
+    "rc_store",
+    "ldap_pool_wait",
+    "ldap_search",
+};
+
+static k5_mutex_t metrics_mutex = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct k5_latency metrics[K5_METRIC_MAX];
+static char *metrics_path;
+static krb5_boolean metrics_configured;
+int krb5int_metrics_enabled;
+
+#ifdef POSIX_SIGNALS
+static volatile sig_atomic_t snapshot_pending;
+
+static void
+snapshot_handler(int signum)
+{
+    snapshot_pending = 1;
+}
+
+/* Request snapshots on signum, unless the application handles it. */
+static void
+install_snapshot_handler(int signum)
+{
+    struct sigaction sa, old;
+
+    if (signum <= 0 || sigaction(signum, NULL, &old) != 0 ||
+        old.sa_handler != SIG_DFL)
+        return;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = snapshot_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    (void) sigaction(signum, &sa, NULL);
+}
+#endif
+
+int
+krb5int_metrics_initialize(void)
+{
+    return k5_mutex_finish_init(&metrics_mutex);
+}
+
+void
+krb5int_metrics_finalize(void)
+{
+    free(metrics_path);
+    metrics_path = NULL;
+    krb5int_metrics_enabled = 0;
+    k5_mutex_destroy(&metrics_mutex);
+}
+
+/* Read the metrics configuration from the environment, once per process. */
+void
+krb5int_init_metrics(void)
+{
+    const char *path;
+#ifdef POSIX_SIGNALS
+    const char *sig;
+#endif
+
+    if (metrics_configured)
+        return;
+    if (k5_mutex_lock(&metrics_mutex) != 0)
+        return;
+    if (!metrics_configured) {
+        metrics_configured = TRUE;
+        path = getenv("KRB5_METRICS");
+        if (path != NULL && *path != '\0') {
+            metrics_path = strdup(path);
+            krb5int_metrics_enabled = (metrics_path != NULL);
+        }
+#ifdef POSIX_SIGNALS
+        sig = getenv("KRB5_SNAPSHOT_SIGNAL");
+        if (sig != NULL)
+            install_snapshot_handler(atoi(sig));
+#endif
+    }
+    k5_mutex_unlock(&metrics_mutex);
+}
+
+/* Return the current time in microseconds, for use as the start time of a
+ * measured operation. */
+krb5_ui_8
+krb5int_metric_now(void)
+{
+    struct timeval tv;
+
+    if (k5_getcurtime(&tv) != 0)
+        return 1;
+    return (krb5_ui_8) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void
+krb5int_latency_add(struct k5_latency *lat, krb5_ui_8 us, krb5_error_code ret)
+{
+    int i = 0;
+
+    while (i < K5_LATENCY_BUCKETS - 1 && us >= ((krb5_ui_8) 1 << i))
+        i++;
+    lat->count++;
+    if (ret)
+        lat->errors++;
+    lat->total_us += us;
+    if (us > lat->max_us)
+        lat->max_us = us;
+    lat->buckets[i]++;
+}
+
+void
+krb5int_latency_format(struct k5buf *buf, const char *name,
+                       const struct k5_latency *lat)
+{
+    int i;
+
+    krb5int_buf_add_fmt(buf, "%s count %lu errors %lu total_us %lu "
+                        "max_us %lu hist", name, lat->count, lat->errors,
+                        (unsigned long) lat->total_us,
+                        (unsigned long) lat->max_us);
+    for (i = 0; i < K5_LATENCY_BUCKETS; i++) {
+        if (lat->buckets[i] == 0)
+            continue;
+        if (i < K5_LATENCY_BUCKETS - 1)
+            krb5int_buf_add_fmt(buf, " <%lu:%lu", 1UL << i, lat->buckets[i]);
+        else
+            krb5int_buf_add_fmt(buf, " more:%lu", lat->buckets[i]);
+    }
+    krb5int_buf_add(buf, "\n");
+}
+
+void
+krb5int_metric_record(k5_metric_t metric, krb5_ui_8 start,
+                      krb5_error_code ret)
+{
+    krb5_ui_8 now = krb5int_metric_now();
+
+    if (k5_mutex_lock(&metrics_mutex) != 0)
+        return;
+    krb5int_latency_add(&metrics[metric], (now > start) ? now - start : 0,
+                        ret);
+    k5_mutex_unlock(&metrics_mutex);
+
+    krb5int_snapshot_check();
+}
+
+/* Write a snapshot if one has been requested by signal. */
+void
+krb5int_snapshot_check(void)
+{
+#ifdef POSIX_SIGNALS
+    if (snapshot_pending) {
+        snapshot_pending = 0;
+        (void) krb5int_snapshot_write();
+    }
+#endif
+}
+
+static krb5_error_code
+write_metrics(void)
+{
+    struct k5_latency copy[K5_METRIC_MAX];
+    struct k5buf buf;
+    krb5_error_code ret = 0;
+    ssize_t len;
+    int fd, i;
+
+    ret = k5_mutex_lock(&metrics_mutex);
+    if (ret)
+        return ret;
+    if (metrics_path == NULL) {
+        k5_mutex_unlock(&metrics_mutex);
+        return 0;
+    }
+    memcpy(copy, metrics, sizeof(copy));
+    fd = open(metrics_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd == -1)
+        ret = errno;
+    k5_mutex_unlock(&metrics_mutex);
+    if (fd == -1)
+        return ret;
+
+    krb5int_buf_init_dynamic(&buf);
+    krb5int_buf_add_fmt(&buf, "# pid %lu time %lu\n",
+                        (unsigned long) getpid(), (unsigned long) time(NULL));
+    for (i = 0; i < K5_METRIC_MAX; i++)
+        krb5int_latency_format(&buf, metric_names[i], &copy[i]);
+
+    len = krb5int_buf_len(&buf);
+    if (len < 0)
+        ret = ENOMEM;
+    else if (write(fd, krb5int_buf_data(&buf), len) != len)
+        ret = errno;
+    close(fd);
+    krb5int_free_buf(&buf);
+    return ret;
+}
+
+/* Append the current counters and binary trace rings to their files. */
+krb5_error_code
+krb5int_snapshot_write(void)
+{
+    krb5_error_code ret, ret2;
+
+    ret = write_metrics();
+    ret2 = krb5int_trace_snapshot();
+    return ret ? ret : ret2;
+}
@@ -100,6 +100,8 @@ krb5_error_code k5_sendto(krb5_context context, const krb5_data *message,
                                              void *),
                           void *msg_handler_data);
 
+void k5_sendto_free_tcp_pool(krb5_context context);
+
 krb5_error_code krb5int_get_fq_local_hostname(char *, size_t);
 
 /* The io vector is *not* const here, unlike writev()!  */
@@ -109,6 +111,17 @@ int k5_getcurtime(struct timeval *tvp);
 
 #include "k5-thread.h"
 extern k5_mutex_t krb5int_us_time_mutex;
+extern k5_mutex_t krb5int_kdc_health_mutex;
+
+int krb5int_trace_initialize(void);
+void krb5int_trace_finalize(void);
+int krb5int_metrics_initialize(void);
+void krb5int_metrics_finalize(void);
+
+#ifdef KRB5_DNS_LOOKUP
+int krb5int_srv_cache_initialize(void);
+void krb5int_srv_cache_finalize(void);
+#endif
 
 extern unsigned int krb5_max_skdc_timeout;
 extern unsigned int krb5_skdc_timeout_shift;
@@ -289,6 +289,7 @@ krb5_sendto_kdc(krb5_context context, const krb5_data *message,
     krb5_error_code retval, err;
     struct serverlist servers;
     int socktype1 = 0, socktype2 = 0, server_used;
+    krb5_ui_8 start;
 
     /*
      * find KDC location(s) for realm
@@ -336,9 +337,11 @@ krb5_sendto_kdc(krb5_context context, const krb5_data *message,
     if (retval)
         return retval;
 
+    start = k5_metric_start();
     retval = k5_sendto(context, message, &servers, socktype1, socktype2,
                        NULL, reply, NULL, NULL, &server_used,
                        check_for_svc_unavailable, &err);
+    k5_metric_end(K5_METRIC_SENDTO_KDC, start, retval);
     if (retval == KRB5_KDC_UNREACH) {
         if (err == KDC_ERR_SVC_UNAVAILABLE) {
             retval = KRB5KDC_ERR_SVC_UNAVAILABLE;
@@ -523,6 +526,9 @@ cm_select_or_poll(const struct select_state *in, struct select_state *out,
             return e;
         timeout = (in->end_time.tv_sec - now.tv_sec) * 1000 +
             (in->end_time.tv_usec - now.tv_usec) / 1000;
+        /* A negative timeout would wait forever. */
+        if (timeout < 0)
+            timeout = 0;
     }
     /* We don't need a separate copy of the selstate for poll, but use one
      * anyone for consistency with the select wrapper. */
@@ -607,6 +613,7 @@ add_connection(struct conn_state **conns, struct addrinfo *ai,
     memcpy(&state->addr, ai->ai_addr, ai->ai_addrlen);
     state->fd = INVALID_SOCKET;
     state->server_index = server_index;
+    state->message = message;
     SG_SET(&state->x.out.sgbuf[1], 0, 0);
     if (ai->ai_socktype == SOCK_STREAM) {
         /*
@@ -848,6 +855,8 @@ start_connection(krb5_context context, struct conn_state *state,
             state->state = READING;
         }
     }
+    (void)k5_getcurtime(&state->send_time);
+    state->nsends = 1;
     ssflags = SSF_READ | SSF_EXCEPTION;
     if (state->state == CONNECTING || state->state == WRITING)
         ssflags |= SSF_WRITE;
@@ -861,6 +870,163 @@ start_connection(krb5_context context, struct conn_state *state,
     return 0;
 }
 
+/*
+ * Idle TCP connections to KDCs kept open for reuse when the kdc_tcp_reuse
+ * libdefaults variable is true.  The pool belongs to a krb5_context, so like
+ * the rest of the context it needs no locking.  A connection on which we
+ * received a complete reply is put back in the pool and used for the next
+ * TCP request to the same address, saving a connection setup per exchange.
+ */
+#define TCP_POOL_SIZE           8
+#define TCP_POOL_IDLE_TIME      60      /* seconds */
+
+struct tcp_pool_entry {
+    SOCKET fd;
+    size_t addrlen;
+    struct sockaddr_storage addr;
+    time_t idle_since;
+};
+
+struct k5_tcp_pool {
+    krb5_boolean enabled;
+    size_t nentries;
+    struct tcp_pool_entry entries[TCP_POOL_SIZE];
+};
+
+/* Return the context's TCP pool if connection reuse is enabled, reading the
+ * profile the first time we are called. */
+static struct k5_tcp_pool *
+get_tcp_pool(krb5_context context)
+{
+    struct k5_tcp_pool *pool = context->os_context.tcp_pool;
+    int enabled;
+
+    if (pool == NULL) {
+        if (profile_get_boolean(context->profile, KRB5_CONF_LIBDEFAULTS,
+                                KRB5_CONF_KDC_TCP_REUSE, NULL, 0,
+                                &enabled) != 0)
+            enabled = 0;
+        pool = calloc(1, sizeof(*pool));
+        if (pool == NULL)
+            return NULL;
+        pool->enabled = enabled;
+        context->os_context.tcp_pool = pool;
+    }
+    return pool->enabled ? pool : NULL;
+}
+
+static void
+tcp_pool_remove(struct k5_tcp_pool *pool, size_t i)
+{
+    pool->entries[i] = pool->entries[--pool->nentries];
+}
+
+/* Return true if the connected socket fd has no pending data and has not been
+ * closed by the peer. */
+static krb5_boolean
+tcp_conn_idle(SOCKET fd)
+{
+    char c;
+
+    return recv(fd, &c, 1, MSG_PEEK) < 0 && SOCKET_ERRNO == EWOULDBLOCK;
+}
+
+/* Take an idle connection to conn's address out of pool and return its
+ * socket, or INVALID_SOCKET if there is none which still looks usable. */
+static SOCKET
+tcp_pool_get(struct k5_tcp_pool *pool, const struct conn_state *conn)
+{
+    struct tcp_pool_entry *ent;
+    time_t idle, now = time(NULL);
+    SOCKET fd;
+    size_t i = 0;
+
+    while (i < pool->nentries) {
+        ent = &pool->entries[i];
+        if (ent->addrlen != conn->addrlen ||
+            memcmp(&ent->addr, &conn->addr, conn->addrlen) != 0) {
+            i++;
+            continue;
+        }
+        fd = ent->fd;
+        idle = now - ent->idle_since;
+        tcp_pool_remove(pool, i);
+        if (idle < TCP_POOL_IDLE_TIME && tcp_conn_idle(fd))
+            return fd;
+        closesocket(fd);
+    }
+    return INVALID_SOCKET;
+}
+
+/* Move conn's socket into pool, closing the longest-idle connection if the
+ * pool is full. */
+static void
+tcp_pool_put(krb5_context context, struct k5_tcp_pool *pool,
+             struct conn_state *conn)
+{
+    struct tcp_pool_entry *ent;
+    size_t i, oldest = 0;
+
+    if (pool->nentries == TCP_POOL_SIZE) {
+        for (i = 1; i < pool->nentries; i++) {
+            if (pool->entries[i].idle_since <
+                pool->entries[oldest].idle_since)
+                oldest = i;
+        }
+        closesocket(pool->entries[oldest].fd);
+        tcp_pool_remove(pool, oldest);
+    }
+    TRACE_SENDTO_KDC_TCP_POOL(context, conn);
+    ent = &pool->entries[pool->nentries++];
+    ent->fd = conn->fd;
+    ent->addrlen = conn->addrlen;
+    memcpy(&ent->addr, &conn->addr, conn->addrlen);
+    ent->idle_since = time(NULL);
+    conn->fd = INVALID_SOCKET;
+}
+
+void
+k5_sendto_free_tcp_pool(krb5_context context)
+{
+    struct k5_tcp_pool *pool = context->os_context.tcp_pool;
+    size_t i;
+
+    if (pool == NULL)
+        return;
+    for (i = 0; i < pool->nentries; i++)
+        closesocket(pool->entries[i].fd);
+    free(pool);
+    context->os_context.tcp_pool = NULL;
+}
+
+/* Start conn using an idle connection from the context's TCP pool, if there
+ * is one.  Return true if we did. */
+static krb5_boolean
+reuse_tcp_conn(krb5_context context, struct conn_state *conn,
+               struct select_state *selstate)
+{
+    struct k5_tcp_pool *pool;
+    SOCKET fd;
+
+    pool = get_tcp_pool(context);
+    if (pool == NULL)
+        return FALSE;
+    fd = tcp_pool_get(pool, conn);
+    if (fd == INVALID_SOCKET)
+        return FALSE;
+    if (!cm_add_fd(selstate, fd, SSF_READ | SSF_WRITE | SSF_EXCEPTION)) {
+        closesocket(fd);
+        return FALSE;
+    }
+    TRACE_SENDTO_KDC_TCP_REUSE(context, conn);
+    conn->fd = fd;
+    conn->state = WRITING;
+    conn->reused = 1;
+    (void)k5_getcurtime(&conn->send_time);
+    conn->nsends = 1;
+    return TRUE;
+}
+
 /* Return 0 if we sent something, non-0 otherwise.
    If 0 is returned, the caller should delay waiting for a response.
    Otherwise, the caller should immediately move on to process the
@@ -876,8 +1042,12 @@ maybe_send(krb5_context context, struct conn_state *conn,
     dprint("maybe_send(@%p) state=%s type=%s\n", conn,
            state_strings[conn->state],
            conn->is_udp ? "udp" : "tcp");
-    if (conn->state == INITIALIZING)
+    if (conn->state == INITIALIZING) {
+        if (conn->socktype == SOCK_STREAM && callback_info == NULL &&
+            reuse_tcp_conn(context, conn, selstate))
+            return 0;
         return start_connection(context, conn, selstate, callback_info);
+    }
 
     /* Did we already shut down this channel?  */
     if (conn->state == FAILED) {
@@ -907,6 +1077,7 @@ maybe_send(krb5_context context, struct conn_state *conn,
         return -1;
     }
     /* Yay, it worked.  */
+    conn->nsends++;
     return 0;
 }
 
@@ -967,6 +1138,15 @@ service_tcp_fd(krb5_context context, struct conn_state *conn,
                 closesocket(conn->fd);
                 conn->fd = INVALID_SOCKET;
             }
+            if (conn->reused) {
+                /* The KDC may have closed the pooled connection while it was
+                 * idle; try once more with a new connection. */
+                conn->reused = 0;
+                conn->state = INITIALIZING;
+                conn->err = 0;
+                set_conn_state_msg_length(conn, conn->message);
+                (void)start_connection(context, conn, selstate, NULL);
+            }
             return e == 0;
         }
         if (ssflags & SSF_EXCEPTION) {
@@ -1086,9 +1266,9 @@ service_tcp_fd(krb5_context context, struct conn_state *conn,
             nread = SOCKET_READ(conn->fd,
                                 conn->x.in.bufsizebytes + conn->x.in.bufsizebytes_read,
                                 4 - conn->x.in.bufsizebytes_read);
-            if (nread < 0) {
+            if (nread <= 0) {
+                e = nread ? SOCKET_ERRNO : ECONNRESET;
                 TRACE_SENDTO_KDC_TCP_ERROR_RECV_LEN(context, conn, e);
-                e = SOCKET_ERRNO;
                 goto kill_conn;
             }
             conn->x.in.bufsizebytes_read += nread;
@@ -1140,6 +1320,8 @@ service_udp_fd(krb5_context context, struct conn_state *conn,
     return 1;
 }
 
+/* Service the connections in conns until one of them produces an acceptable
+ * reply or interval milliseconds have passed. */
 static krb5_boolean
 service_fds(krb5_context context, struct select_state *selstate, int interval,
             struct conn_state *conns, struct select_state *seltemp,
@@ -1156,7 +1338,12 @@ service_fds(krb5_context context, struct select_state *selstate, int interval,
     if (e)
         return 1;
     selstate->end_time = now;
-    selstate->end_time.tv_sec += interval;
+    selstate->end_time.tv_sec += interval / 1000;
+    selstate->end_time.tv_usec += (interval % 1000) * 1000;
+    if (selstate->end_time.tv_usec >= 1000000) {
+        selstate->end_time.tv_sec++;
+        selstate->end_time.tv_usec -= 1000000;
+    }
 
     e = 0;
     while (selstate->nfds > 0) {
@@ -1185,6 +1372,8 @@ service_fds(krb5_context context, struct select_state *selstate, int interval,
             if (state->service(context, state, selstate, ssflags)) {
                 int stop = 1;
 
+                state->replied = 1;
+
                 if (msg_handler != NULL) {
                     krb5_data reply;
 
@@ -1207,10 +1396,245 @@ service_fds(krb5_context context, struct select_state *selstate, int interval,
     return 0;
 }
 
+/*
+ * Process-wide record of how each KDC has answered recently.  k5_sendto uses
+ * it to contact servers with a known response time first (fastest first),
+ * to wait only as long as a known server normally takes before moving on to
+ * the next one, and to try servers which stopped answering last for a while.
+ * Servers are never skipped entirely, so a bad record costs at most the
+ * per-server wait.
+ */
+#define HEALTH_TABLE_SIZE       64
+#define HEALTH_MIN_WAIT         100     /* milliseconds */
+#define HEALTH_MAX_WAIT         1000    /* milliseconds */
+#define HEALTH_BACKOFF_BASE     10      /* seconds */
+#define HEALTH_BACKOFF_MAX      600     /* seconds */
+
+struct kdc_health {
+    char hostname[256];         /* Empty for address-only entries */
+    int port;
+    int socktype;
+    size_t addrlen;
+    struct sockaddr_storage addr;
+    long srtt;                  /* Smoothed response time (ms), or -1 */
+    long rttvar;                /* Response time variation (ms) */
+    int failures;               /* Consecutive unanswered exchanges */
+    time_t retry_time;          /* Try this server last until then */
+    unsigned long last_used;    /* 0 if unused; else for replacement */
+};
+
+k5_mutex_t krb5int_kdc_health_mutex = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct kdc_health health_table[HEALTH_TABLE_SIZE];
+static unsigned long health_clock;
+
+/* Position of a server in the order we will contact it. */
+struct server_order {
+    size_t index;               /* Index into the serverlist */
+    int rank;                   /* 0 known, 1 unknown, 2 recently failed */
+    long srtt;                  /* Smoothed response time for rank 0 */
+    int wait;                   /* First-pass wait in milliseconds */
+};
+
+static long
+timeval_diff_ms(const struct timeval *a, const struct timeval *b)
+{
+    return (a->tv_sec - b->tv_sec) * 1000L +
+        (a->tv_usec - b->tv_usec) / 1000L;
+}
+
+static krb5_boolean
+health_matches(const struct kdc_health *h, const struct server_entry *entry)
+{
+    if (h->socktype != entry->socktype)
+        return FALSE;
+    if (entry->hostname != NULL)
+        return h->port == entry->port && strcmp(h->hostname,
+                                                entry->hostname) == 0;
+    return h->hostname[0] == '\0' && h->addrlen == entry->addrlen &&
+        memcmp(&h->addr, &entry->addr, entry->addrlen) == 0;
+}
+
+/* Return the health record for entry, replacing the least recently used
+ * record if create is true and there is none.  The caller must hold
+ * krb5int_kdc_health_mutex. */
+static struct kdc_health *
+health_lookup(const struct server_entry *entry, krb5_boolean create)
+{
+    struct kdc_health *h, *oldest = &health_table[0];
+    size_t i;
+
+    if (entry->hostname != NULL &&
+        strlen(entry->hostname) >= sizeof(h->hostname))
+        return NULL;
+    for (i = 0; i < HEALTH_TABLE_SIZE; i++) {
+        h = &health_table[i];
+        if (h->last_used != 0 && health_matches(h, entry)) {
+            h->last_used = ++health_clock;
+            return h;
+        }
+        if (h->last_used < oldest->last_used)
+            oldest = h;
+    }
+    if (!create)
+        return NULL;
+
+    h = oldest;
+    memset(h, 0, sizeof(*h));
+    if (entry->hostname != NULL) {
+        strlcpy(h->hostname, entry->hostname, sizeof(h->hostname));
+        h->port = entry->port;
+    } else {
+        h->addrlen = entry->addrlen;
+        memcpy(&h->addr, &entry->addr, entry->addrlen);
+    }
+    h->socktype = entry->socktype;
+    h->srtt = -1;
+    h->last_used = ++health_clock;
+    return h;
+}
+
+static int
+compare_order(const void *a, const void *b)
+{
+    const struct server_order *x = a, *y = b;
+
+    if (x->rank != y->rank)
+        return x->rank - y->rank;
+    if (x->srtt != y->srtt)
+        return (x->srtt < y->srtt) ? -1 : 1;
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+/*
+ * Fill in order with the servers in the sequence we should contact them:
+ * servers which have been answering, fastest first; then servers we know
+ * nothing about (or which are being retried after failing), in their
+ * configured order; then servers which recently failed to answer.
+ */
+static void
+order_servers(const struct serverlist *servers, struct server_order *order)
+{
+    struct kdc_health *h;
+    krb5_boolean locked;
+    time_t now = time(NULL);
+    long wait;
+    size_t i;
+
+    locked = (k5_mutex_lock(&krb5int_kdc_health_mutex) == 0);
+    for (i = 0; i < servers->nservers; i++) {
+        order[i].index = i;
+        order[i].rank = 1;
+        order[i].srtt = -1;
+        order[i].wait = HEALTH_MAX_WAIT;
+        h = locked ? health_lookup(&servers->servers[i], FALSE) : NULL;
+        if (h == NULL)
+            continue;
+        if (h->failures > 0 && now < h->retry_time) {
+            order[i].rank = 2;
+        } else if (h->failures == 0 && h->srtt >= 0) {
+            /* Allow four deviations over the average, as TCP does. */
+            wait = h->srtt + 4 * h->rttvar;
+            order[i].rank = 0;
+            order[i].srtt = h->srtt;
+            order[i].wait = (wait < HEALTH_MIN_WAIT) ? HEALTH_MIN_WAIT :
+                (wait > HEALTH_MAX_WAIT) ? HEALTH_MAX_WAIT : wait;
+        }
+    }
+    if (locked)
+        k5_mutex_unlock(&krb5int_kdc_health_mutex);
+    qsort(order, servers->nservers, sizeof(*order), compare_order);
+}
+
+/*
+ * Record the outcome of an exchange in the health table.  winner is the
+ * connection whose reply was accepted, or NULL.  A server which was sent the
+ * request and never answered counts as a failure if it had at least the
+ * maximum first-pass wait to do so, or if all of its connections failed.
+ * Response times are only sampled from replies to unretransmitted requests,
+ * since a reply to a retransmission can't be matched to a send time.
+ */
+static void
+record_health(krb5_context context, const struct serverlist *servers,
+              struct conn_state *conns, struct conn_state *winner)
+{
+    struct conn_state *state, *first;
+    struct kdc_health *h;
+    struct timeval now;
+    krb5_boolean replied, all_failed;
+    long waited, rtt, backoff;
+    size_t s;
+    int i;
+
+    if (k5_getcurtime(&now) != 0)
+        return;
+    if (k5_mutex_lock(&krb5int_kdc_health_mutex) != 0)
+        return;
+    for (s = 0; s < servers->nservers; s++) {
+        first = NULL;
+        replied = FALSE;
+        all_failed = TRUE;
+        waited = 0;
+        for (state = conns; state != NULL; state = state->next) {
+            if (state->server_index != s || state->nsends == 0)
+                continue;
+            if (first == NULL)
+                first = state;
+            if (state->replied)
+                replied = TRUE;
+            if (state->state != FAILED)
+                all_failed = FALSE;
+            if (timeval_diff_ms(&now, &state->send_time) > waited)
+                waited = timeval_diff_ms(&now, &state->send_time);
+        }
+        if (first == NULL)
+            continue;
+
+        if (winner != NULL && winner->server_index == s) {
+            h = health_lookup(&servers->servers[s], TRUE);
+            if (h == NULL)
+                continue;
+            h->failures = 0;
+            if (winner->nsends != 1)
+                continue;
+            rtt = timeval_diff_ms(&now, &winner->send_time);
+            if (rtt < 0)
+                rtt = 0;
+            if (h->srtt < 0) {
+                h->srtt = rtt;
+                h->rttvar = rtt / 2;
+            } else {
+                h->rttvar += (labs(h->srtt - rtt) - h->rttvar) / 4;
+                h->srtt += (rtt - h->srtt) / 8;
+            }
+            TRACE_SENDTO_KDC_RTT(context, winner, rtt, h->srtt);
+        } else if (replied) {
+            h = health_lookup(&servers->servers[s], FALSE);
+            if (h != NULL)
+                h->failures = 0;
+        } else if (all_failed || waited >= HEALTH_MAX_WAIT) {
+            h = health_lookup(&servers->servers[s], TRUE);
+            if (h == NULL)
+                continue;
+            h->failures++;
+            backoff = HEALTH_BACKOFF_BASE;
+            for (i = 1; i < h->failures && backoff < HEALTH_BACKOFF_MAX; i++)
+                backoff *= 2;
+            if (backoff > HEALTH_BACKOFF_MAX)
+                backoff = HEALTH_BACKOFF_MAX;
+            h->retry_time = now.tv_sec + backoff;
+            TRACE_SENDTO_KDC_BACKOFF(context, first, h->failures,
+                                     (int)backoff);
+        }
+    }
+    k5_mutex_unlock(&krb5int_kdc_health_mutex);
+}
+
 /*
  * Current worst-case timeout behavior:
  *
- * First pass, 1s per udp or tcp server, plus 2s at end.
+ * First pass, 1s per udp or tcp server, plus 2s at end.  (Servers with a
+ * recently measured response time get less: four deviations over their
+ * average, but no less than 100ms.)
  * Second pass, 1s per udp server, plus 4s.
  * Third pass, 1s per udp server, plus 8s.
  * Fourth => 16s, etc.
@@ -1227,6 +1651,9 @@ service_fds(krb5_context context, struct select_state *selstate, int interval,
  *
  * Note that if you try to reach two ports (e.g., both 88 and 750) on
  * one server, it counts as two.
+ *
+ * Servers are contacted in the order chosen by order_servers(), so a server
+ * which is down costs this time only until it is recorded as failing.
  */
 
 krb5_error_code
@@ -1242,8 +1669,10 @@ k5_sendto(krb5_context context, const krb5_data *message,
     int pass, delay;
     krb5_error_code retval;
     struct conn_state *conns = NULL, *state, **tailptr, *next, *winner;
-    size_t s;
+    size_t i, s;
     struct select_state *sel_state = NULL, *seltemp;
+    struct server_order *order = NULL;
+    struct k5_tcp_pool *pool;
     char *udpbuf = NULL;
     krb5_boolean done = FALSE;
 
@@ -1260,9 +1689,17 @@ k5_sendto(krb5_context context, const krb5_data *message,
     seltemp = &sel_state[1];
     cm_init_selstate(sel_state);
 
+    order = calloc(servers->nservers + 1, sizeof(*order));
+    if (order == NULL) {
+        retval = ENOMEM;
+        goto cleanup;
+    }
+    order_servers(servers, order);
+
     /* First pass: resolve server hosts, communicate with resulting addresses
-     * of the preferred socktype, and wait 1s for an answer from each. */
-    for (s = 0; s < servers->nservers && !done; s++) {
+     * of the preferred socktype, and wait up to 1s for an answer from each. */
+    for (i = 0; i < servers->nservers && !done; i++) {
+        s = order[i].index;
         /* Find the current tail pointer. */
         for (tailptr = &conns; *tailptr != NULL; tailptr = &(*tailptr)->next);
         retval = resolve_server(context, servers, s, socktype1, socktype2,
@@ -1275,8 +1712,9 @@ k5_sendto(krb5_context context, const krb5_data *message,
                 continue;
             if (maybe_send(context, state, sel_state, callback_info))
                 continue;
-            done = service_fds(context, sel_state, 1, conns, seltemp,
-                               msg_handler, msg_handler_data, &winner);
+            done = service_fds(context, sel_state, order[i].wait, conns,
+                               seltemp, msg_handler, msg_handler_data,
+                               &winner);
         }
     }
 
@@ -1287,23 +1725,23 @@ k5_sendto(krb5_context context, const krb5_data *message,
             continue;
         if (maybe_send(context, state, sel_state, callback_info))
             continue;
-        done = service_fds(context, sel_state, 1, state, seltemp, msg_handler,
-                           msg_handler_data, &winner);
+        done = service_fds(context, sel_state, 1000, conns, seltemp,
+                           msg_handler, msg_handler_data, &winner);
     }
 
     /* Wait for two seconds at the end of the first pass. */
     if (!done) {
-        done = service_fds(context, sel_state, 2, conns, seltemp, msg_handler,
-                           msg_handler_data, &winner);
+        done = service_fds(context, sel_state, 2000, conns, seltemp,
+                           msg_handler, msg_handler_data, &winner);
     }
 
     /* Make remaining passes over all of the connections. */
-    delay = 4;
+    delay = 4000;
     for (pass = 1; pass < MAX_PASS && !done; pass++) {
         for (state = conns; state != NULL && !done; state = state->next) {
             if (maybe_send(context, state, sel_state, callback_info))
                 continue;
-            done = service_fds(context, sel_state, 1, conns, seltemp,
+            done = service_fds(context, sel_state, 1000, conns, seltemp,
                                msg_handler, msg_handler_data, &winner);
             if (sel_state->nfds == 0)
                 break;
@@ -1318,6 +1756,8 @@ k5_sendto(krb5_context context, const krb5_data *message,
         delay *= 2;
     }
 
+    record_health(context, servers, conns, done ? winner : NULL);
+
     if (sel_state->nfds == 0 || !done || winner == NULL) {
         retval = KRB5_KDC_UNREACH;
         goto cleanup;
@@ -1334,8 +1774,13 @@ k5_sendto(krb5_context context, const krb5_data *message,
         (void)getpeername(winner->fd, remoteaddr, remoteaddrlen);
 
 cleanup:
+    /* Keep TCP connections which carried a complete reply for reuse. */
+    pool = (callback_info == NULL) ? get_tcp_pool(context) : NULL;
     for (state = conns; state != NULL; state = next) {
         next = state->next;
+        if (pool != NULL && state->socktype == SOCK_STREAM &&
+            state->replied && state->fd != INVALID_SOCKET)
+            tcp_pool_put(context, pool, state);
         if (state->fd != INVALID_SOCKET)
             closesocket(state->fd);
         if (state->state == READING && state->x.in.buf != udpbuf)
@@ -1350,5 +1795,6 @@ cleanup:
     if (reply->data != udpbuf)
         free(udpbuf);
     free(sel_state);
+    free(order);
     return retval;
 }
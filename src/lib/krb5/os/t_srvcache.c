@@ -0,0 +1,199 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/t_srvcache.c - Test the DNS SRV answer cache */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program includes dnssrv.c with a stub resolver in place of
+ * dnsglue.c, and checks that SRV answers are cached for their TTL, that
+ * authoritative negative answers are cached, and that failed queries are
+ * not.
+ */
+
+#include "dnssrv.c"
+
+#ifdef KRB5_DNS_LOOKUP
+
+/* What the stub resolver does for the next query. */
+static enum { STUB_ANSWER, STUB_NO_RECORDS, STUB_SERVFAIL } stub_mode;
+static long stub_ttl;
+static int stub_queries;
+
+#define STUB_HOST "kdc.example.com"
+
+/* One SRV record: priority 0, weight 0, port 88, then the target, which
+ * the stub krb5int_dns_expand() copies verbatim. */
+static const unsigned char stub_rdata[] = {
+    0, 0, 0, 0, 0, 88,
+    'k', 'd', 'c', '.', 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm'
+};
+
+struct krb5int_dns_state {
+    int answered;
+    long min_ttl;
+    int no_records;
+};
+
+int
+krb5int_dns_init(struct krb5int_dns_state **dsp, char *host, int nclass,
+                 int ntype)
+{
+    struct krb5int_dns_state *ds;
+
+    *dsp = ds = calloc(1, sizeof(*ds));
+    if (ds == NULL)
+        return -1;
+    ds->min_ttl = -1;
+    stub_queries++;
+    if (stub_mode == STUB_NO_RECORDS) {
+        ds->no_records = 1;
+        return -1;
+    }
+    return (stub_mode == STUB_SERVFAIL) ? -1 : 0;
+}
+
+int
+krb5int_dns_nextans(struct krb5int_dns_state *ds, const unsigned char **pp,
+                    int *lenp)
+{
+    *pp = NULL;
+    *lenp = 0;
+    if (ds->answered)
+        return 0;
+    ds->answered = 1;
+    ds->min_ttl = stub_ttl;
+    *pp = stub_rdata;
+    *lenp = sizeof(stub_rdata);
+    return 0;
+}
+
+int
+krb5int_dns_expand(struct krb5int_dns_state *ds, const unsigned char *p,
+                   char *buf, int len)
+{
+    if (len <= (int)strlen(STUB_HOST))
+        return -1;
+    strlcpy(buf, STUB_HOST, len);
+    return strlen(STUB_HOST);
+}
+
+long
+krb5int_dns_min_ttl(struct krb5int_dns_state *ds)
+{
+    return ds->min_ttl;
+}
+
+int
+krb5int_dns_no_records(struct krb5int_dns_state *ds)
+{
+    return ds->no_records;
+}
+
+void
+krb5int_dns_fini(struct krb5int_dns_state *ds)
+{
+    free(ds);
+}
+
+static krb5_context ctx;
+
+/* Look up the KDCs of realm and check that the result has nanswers entries
+ * (zero or one) and took nqueries queries to the stub resolver. */
+static void
+check_lookup(const char *realm, int nanswers, int nqueries)
+{
+    struct srv_dns_entry *answers = NULL;
+    krb5_data rdata = string2data((char *)realm);
+
+    stub_queries = 0;
+    if (krb5int_make_srv_query_realm(ctx, &rdata, "_kerberos", "_udp",
+                                     &answers) != 0)
+        abort();
+    if (stub_queries != nqueries) {
+        fprintf(stderr, "%s: expected %d queries, got %d\n", realm,
+                nqueries, stub_queries);
+        exit(1);
+    }
+    if (nanswers == 0 && answers != NULL) {
+        fprintf(stderr, "%s: expected no answers\n", realm);
+        exit(1);
+    }
+    if (nanswers == 1 &&
+        (answers == NULL || answers->next != NULL || answers->port != 88 ||
+         strcmp(answers->host, STUB_HOST ".") != 0)) {
+        fprintf(stderr, "%s: wrong answers\n", realm);
+        exit(1);
+    }
+    krb5int_free_srv_dns_data(answers);
+}
+
+int
+main()
+{
+    if (krb5int_srv_cache_initialize() != 0)
+        abort();
+    if (krb5_init_context(&ctx) != 0)
+        abort();
+
+    /* A positive answer is used until its TTL expires. */
+    stub_mode = STUB_ANSWER;
+    stub_ttl = 2;
+    check_lookup("POSITIVE.TEST", 1, 1);
+    check_lookup("POSITIVE.TEST", 1, 0);
+    sleep(3);
+    check_lookup("POSITIVE.TEST", 1, 1);
+
+    /* An answer with a zero TTL isn't cached. */
+    stub_ttl = 0;
+    check_lookup("ZEROTTL.TEST", 1, 1);
+    check_lookup("ZEROTTL.TEST", 1, 1);
+
+    /* An authoritative negative answer is cached. */
+    stub_mode = STUB_NO_RECORDS;
+    check_lookup("MISSING.TEST", 0, 1);
+    check_lookup("MISSING.TEST", 0, 0);
+
+    /* A failed query isn't cached, so the next lookup gets the answer. */
+    stub_mode = STUB_SERVFAIL;
+    check_lookup("FAILING.TEST", 0, 1);
+    check_lookup("FAILING.TEST", 0, 1);
+    stub_mode = STUB_ANSWER;
+    stub_ttl = 300;
+    check_lookup("FAILING.TEST", 1, 1);
+    check_lookup("FAILING.TEST", 1, 0);
+
+    krb5_free_context(ctx);
+    krb5int_srv_cache_finalize();
+    return 0;
+}
+
+#else /* !KRB5_DNS_LOOKUP */
+
+int
+main()
+{
+    return 0;
+}
+
+#endif /* !KRB5_DNS_LOOKUP */
@@ -0,0 +1,283 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/t_trace.c - Test harness for binary tracing and metrics */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * Usage: t_trace [snapshotfile]
+ *
+ * With an argument, decode a binary trace snapshot file (written when
+ * KRB5_TRACE is set to "binary:path") to standard output.
+ *
+ * With no argument, check that trace points recorded in binary mode decode
+ * to the same messages as text mode produces, and that a metrics snapshot
+ * reflects the credential cache operations performed.
+ */
+
+#include "k5-int.h"
+
+#define BINFILE "t_trace.bin"
+#define METRICSFILE "t_trace.metrics"
+#define DECODEDFILE "t_trace.out"
+
+static void
+check(krb5_error_code code, const char *msg)
+{
+    if (code != 0) {
+        com_err("t_trace", code, "%s", msg);
+        exit(1);
+    }
+}
+
+/* Strip the "[pid] sec.usec: " or "[pid.ring] sec.usec: " prefix from a
+ * trace line and append the rest to buf. */
+static void
+add_message(struct k5buf *buf, const char *line)
+{
+    const char *p;
+
+    p = strchr(line, ']');
+    p = (p == NULL) ? NULL : strstr(p, ": ");
+    if (p == NULL) {
+        fprintf(stderr, "Malformed trace line: %s", line);
+        exit(1);
+    }
+    krb5int_buf_add(buf, p + 2);
+}
+
+static void KRB5_CALLCONV
+text_cb(krb5_context context, const struct krb5_trace_info *info, void *data)
+{
+    if (info != NULL)
+        add_message(data, info->message);
+}
+
+static void
+emit_trace_points(krb5_context context, krb5_ccache cc, krb5_keytab kt,
+                  krb5_principal princ)
+{
+    krb5_enctype etypes[] = { ENCTYPE_AES256_CTS_HMAC_SHA1_96,
+                              ENCTYPE_ARCFOUR_HMAC, 0 };
+    krb5_pa_data pa1 = { KV5M_PA_DATA, KRB5_PADATA_ENC_TIMESTAMP, 0, NULL };
+    krb5_pa_data pa2 = { KV5M_PA_DATA, KRB5_PADATA_FX_FAST, 0, NULL };
+    krb5_pa_data *padata[3];
+    krb5_data realm = string2data("KRBTEST.COM");
+
+    padata[0] = &pa1;
+    padata[1] = &pa2;
+    padata[2] = NULL;
+    TRACE_CC_INIT(context, cc, princ);
+    TRACE_CC_INIT(context, cc, NULL);
+    TRACE_KT_GET_ENTRY(context, kt, princ, 3, ENCTYPE_AES128_CTS_HMAC_SHA1_96,
+                       KRB5_KT_NOTFOUND);
+    TRACE_SENDTO_KDC(context, 123, &realm, 1, 0);
+    TRACE_SEND_TGS_ETYPES(context, etypes);
+    TRACE_PREAUTH_INPUT(context, padata);
+    TRACE_INIT_CREDS_SERVICE(context, "krbtgt/KRBTEST.COM");
+}
+
+/* Store and retrieve a credential, to be counted in the metrics. */
+static void
+exercise_ccache(krb5_context context, krb5_ccache cc, krb5_principal princ)
+{
+    krb5_creds creds, mcreds, out;
+
+    memset(&creds, 0, sizeof(creds));
+    creds.client = princ;
+    check(krb5_parse_name(context, "krbtgt/KRBTEST.COM@KRBTEST.COM",
+                          &creds.server), "parsing server name");
+    check(krb5_cc_initialize(context, cc, princ), "initializing ccache");
+    check(krb5_cc_store_cred(context, cc, &creds), "storing creds");
+    mcreds = creds;
+    check(krb5_cc_retrieve_cred(context, cc, 0, &mcreds, &out),
+          "retrieving creds");
+    krb5_free_cred_contents(context, &out);
+    krb5_free_principal(context, creds.server);
+}
+
+/* Check which histogram buckets durations fall into, and how a histogram is
+ * formatted. */
+static void
+check_latency(void)
+{
+    struct k5_latency lat;
+    struct k5buf buf;
+    const char *expected = "op count 6 errors 1 total_us 12582917 "
+        "max_us 8388608 hist <1:1 <2:1 <4:2 <4194304:1 more:1\n";
+
+    memset(&lat, 0, sizeof(lat));
+    krb5int_latency_add(&lat, 0, 0);
+    krb5int_latency_add(&lat, 1, 0);
+    krb5int_latency_add(&lat, 2, 0);
+    krb5int_latency_add(&lat, 3, KRB5_CC_NOTFOUND);
+    krb5int_latency_add(&lat, (1 << 22) - 1, 0);
+    krb5int_latency_add(&lat, 1 << 23, 0);
+    assert(lat.buckets[0] == 1 && lat.buckets[1] == 1 && lat.buckets[2] == 2);
+    assert(lat.buckets[22] == 1 && lat.buckets[K5_LATENCY_BUCKETS - 1] == 1);
+
+    krb5int_buf_init_dynamic(&buf);
+    krb5int_latency_format(&buf, "op", &lat);
+    if (krb5int_buf_data(&buf) == NULL ||
+        strcmp(krb5int_buf_data(&buf), expected) != 0) {
+        fprintf(stderr, "Wrong latency histogram: %s",
+                krb5int_buf_data(&buf));
+        exit(1);
+    }
+    krb5int_free_buf(&buf);
+}
+
+static void
+check_metrics(void)
+{
+    FILE *fp;
+    char line[1024];
+    int found_store = 0, found_retrieve = 0, found_ldap = 0;
+
+    fp = fopen(METRICSFILE, "r");
+    if (fp == NULL) {
+        perror(METRICSFILE);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "cc_store count 1 errors 0 ", 26) == 0)
+            found_store = 1;
+        if (strncmp(line, "cc_retrieve count 1 errors 0 ", 29) == 0)
+            found_retrieve = 1;
+        if (strncmp(line, "ldap_search count 0 ", 20) == 0)
+            found_ldap = 1;
+    }
+    fclose(fp);
+    if (!found_store || !found_retrieve) {
+        fprintf(stderr, "Metrics snapshot missing ccache counts\n");
+        exit(1);
+    }
+    if (!found_ldap) {
+        fprintf(stderr, "Metrics snapshot missing LDAP search counts\n");
+        exit(1);
+    }
+}
+
+static void
+self_test(void)
+{
+    krb5_context context;
+    krb5_ccache cc;
+    krb5_keytab kt;
+    krb5_principal princ;
+    struct k5buf text, decoded;
+    FILE *fp, *out;
+    char line[1024];
+
+    unlink(BINFILE);
+    unlink(METRICSFILE);
+    unlink(DECODEDFILE);
+    if (setenv("KRB5_METRICS", METRICSFILE, 1) != 0 ||
+        unsetenv("KRB5_TRACE") != 0) {
+        perror("setenv");
+        exit(1);
+    }
+
+    check(krb5_init_context(&context), "initializing context");
+    check(krb5_parse_name(context, "user@KRBTEST.COM", &princ),
+          "parsing principal");
+    check(krb5_cc_resolve(context, "MEMORY:t_trace", &cc), "resolving ccache");
+    check(krb5_kt_resolve(context, "MEMORY:t_trace", &kt), "resolving keytab");
+    exercise_ccache(context, cc, princ);
+
+    krb5int_buf_init_dynamic(&text);
+    check(krb5_set_trace_callback(context, text_cb, &text),
+          "setting trace callback");
+    emit_trace_points(context, cc, kt, princ);
+
+    check(krb5_set_trace_filename(context, "binary:" BINFILE),
+          "enabling binary tracing");
+    emit_trace_points(context, cc, kt, princ);
+    check(krb5int_snapshot_write(), "writing snapshot");
+    check(krb5_set_trace_callback(context, NULL, NULL),
+          "clearing trace callback");
+
+    fp = fopen(BINFILE, "rb");
+    if (fp == NULL) {
+        perror(BINFILE);
+        exit(1);
+    }
+    out = fopen(DECODEDFILE, "w+");
+    if (out == NULL) {
+        perror(DECODEDFILE);
+        exit(1);
+    }
+    check(krb5int_trace_decode(context, fp, out), "decoding snapshot");
+    rewind(out);
+    krb5int_buf_init_dynamic(&decoded);
+    while (fgets(line, sizeof(line), out) != NULL)
+        add_message(&decoded, line);
+    fclose(out);
+    fclose(fp);
+
+    if (krb5int_buf_data(&text) == NULL ||
+        krb5int_buf_data(&decoded) == NULL ||
+        strcmp(krb5int_buf_data(&text), krb5int_buf_data(&decoded)) != 0) {
+        fprintf(stderr, "Decoded trace differs from text trace:\n%s---\n%s",
+                krb5int_buf_data(&text), krb5int_buf_data(&decoded));
+        exit(1);
+    }
+    check_metrics();
+    check_latency();
+
+    krb5int_free_buf(&text);
+    krb5int_free_buf(&decoded);
+    krb5_cc_destroy(context, cc);
+    krb5_kt_close(context, kt);
+    krb5_free_principal(context, princ);
+    krb5_free_context(context);
+    unlink(BINFILE);
+    unlink(METRICSFILE);
+    unlink(DECODEDFILE);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context context;
+    FILE *fp;
+
+    if (argc == 1) {
+        self_test();
+        return 0;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s [snapshotfile]\n", argv[0]);
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    check(krb5_init_context(&context), "initializing context");
+    check(krb5int_trace_decode(context, fp, stdout), "decoding snapshot");
+    fclose(fp);
+    krb5_free_context(context);
+    return 0;
+}
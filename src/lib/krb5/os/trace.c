@@ -39,6 +39,7 @@
 
 #include "k5-int.h"
 #include "cm.h"
+#include "os-proto.h"
 
 #ifndef DISABLE_TRACING
 
@@ -202,7 +203,9 @@ trace_format(krb5_context context, const char *fmt, va_list ap)
                    (int) cksum->checksum_type, &data);
         } else if (strcmp(tmpbuf, "princ") == 0) {
             princ = va_arg(ap, krb5_principal);
-            if (krb5_unparse_name(context, princ, &str) == 0) {
+            if (princ == NULL) {
+                krb5int_buf_add(&buf, "(null)");
+            } else if (krb5_unparse_name(context, princ, &str) == 0) {
                 krb5int_buf_add(&buf, str);
                 krb5_free_unparsed_name(context, str);
             }
@@ -264,6 +267,1030 @@ subfmt(krb5_context context, struct k5buf *buf, const char *fmt, ...)
     va_end(ap);
 }
 
+/*
+ * Binary trace mode.  If the trace filename has the form "binary:path",
+ * trace points are not formatted when they are reached.  Instead, each one
+ * is recorded as a fixed-size record holding a timestamp, an event ID (a
+ * hash of the format string), and a compact encoding of its arguments, in a
+ * ring buffer owned by the calling thread.  The rings are appended to path
+ * whenever a snapshot is written (see metrics.c) and can be turned back
+ * into text later with krb5int_trace_decode().
+ *
+ * To keep recording cheap, some arguments are reduced: principals are copied
+ * without quoting, keys and hashed strings are recorded by length only,
+ * strings are truncated to 255 bytes, and arguments which do not fit in the
+ * record are dropped.
+ */
+
+#define TRACE_MAGIC "K5TRACE1"
+#define TRACE_BYTE_ORDER 0x01020304
+#define TRACE_RING_RECORDS 512
+#define TRACE_ARGS_SIZE 112
+#define TRACE_DICT_SIZE 256
+#define TRACE_MAX_SPECS 16
+
+/* Argument encodings: a tag byte followed by a payload. */
+#define ARG_INT 'i'             /* krb5_int64 */
+#define ARG_STR 's'             /* length byte and bytes */
+#define ARG_HEX 'x'             /* length byte and bytes, shown in hex */
+#define ARG_LEN 'n'             /* krb5_ui_4 length of an omitted value */
+#define ARG_ADDR 'a'            /* socktype byte, length byte, sockaddr */
+#define ARG_LIST 'l'            /* count byte and krb5_int32 values */
+#define ARG_TRUNCATED 0x80      /* Or'd into ARG_STR/ARG_HEX if truncated */
+
+/* Format words, parsed once per event type and cached in the dictionary. */
+enum trace_spec {
+    SPEC_INT, SPEC_LONG, SPEC_STR, SPEC_LENSTR, SPEC_HEXLENSTR,
+    SPEC_HASHLENSTR, SPEC_CONNSTATE, SPEC_DATA, SPEC_HEXDATA, SPEC_ERRNO,
+    SPEC_KERR, SPEC_KEYBLOCK, SPEC_KEY, SPEC_CKSUM, SPEC_PRINC, SPEC_PATYPES,
+    SPEC_ETYPE, SPEC_ETYPES, SPEC_CCACHE, SPEC_KEYTAB, SPEC_CREDS
+};
+
+static const struct {
+    const char *word;
+    enum trace_spec spec;
+} spec_words[] = {
+    { "int", SPEC_INT }, { "long", SPEC_LONG }, { "str", SPEC_STR },
+    { "lenstr", SPEC_LENSTR }, { "hexlenstr", SPEC_HEXLENSTR },
+    { "hashlenstr", SPEC_HASHLENSTR }, { "connstate", SPEC_CONNSTATE },
+    { "data", SPEC_DATA }, { "hexdata", SPEC_HEXDATA },
+    { "errno", SPEC_ERRNO }, { "kerr", SPEC_KERR },
+    { "keyblock", SPEC_KEYBLOCK }, { "key", SPEC_KEY },
+    { "cksum", SPEC_CKSUM }, { "princ", SPEC_PRINC },
+    { "patypes", SPEC_PATYPES }, { "etype", SPEC_ETYPE },
+    { "etypes", SPEC_ETYPES }, { "ccache", SPEC_CCACHE },
+    { "keytab", SPEC_KEYTAB }, { "creds", SPEC_CREDS }
+};
+
+struct trace_dict_entry {
+    krb5_ui_4 id;               /* Event ID, or 0 if the slot is free */
+    char *fmt;
+    unsigned char nspecs;
+    unsigned char specs[TRACE_MAX_SPECS];
+};
+
+struct trace_record {
+    krb5_ui_4 sec;
+    krb5_ui_4 usec;
+    krb5_ui_4 id;
+    krb5_ui_4 len;
+    unsigned char args[TRACE_ARGS_SIZE];
+};
+
+/*
+ * A ring is written only by the thread which owns it, without locking.  A
+ * snapshot taken while the owner is recording may contain one garbled
+ * record.  Rings are reused by later threads once their owner exits, and
+ * are freed at library finalization.
+ */
+struct trace_ring {
+    struct trace_ring *next;
+    unsigned int index;
+    krb5_boolean in_use;
+    krb5_ui_8 count;
+    struct trace_dict_entry dict[TRACE_DICT_SIZE];
+    struct trace_record records[TRACE_RING_RECORDS];
+};
+
+static k5_mutex_t trace_mutex = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct trace_ring *trace_rings;
+static unsigned int trace_nrings;
+static char *trace_binary_path;
+
+struct argbuf {
+    unsigned char *p;
+    size_t len;
+    size_t space;
+    krb5_boolean full;
+};
+
+/* Return a 32-bit FNV-1a hash of fmt, which is never zero. */
+static krb5_ui_4
+trace_event_id(const char *fmt)
+{
+    krb5_ui_4 h = 2166136261U;
+
+    for (; *fmt != '\0'; fmt++)
+        h = (h ^ (unsigned char)*fmt) * 16777619U;
+    return (h == 0) ? 1 : h;
+}
+
+static void
+release_ring(void *ptr)
+{
+    struct trace_ring *ring = ptr;
+
+    if (k5_mutex_lock(&trace_mutex) != 0)
+        return;
+    ring->in_use = FALSE;
+    k5_mutex_unlock(&trace_mutex);
+}
+
+/* Return the calling thread's ring, claiming or creating one if needed. */
+static struct trace_ring *
+get_ring(void)
+{
+    struct trace_ring *ring;
+
+    ring = k5_getspecific(K5_KEY_TRACE_RING);
+    if (ring != NULL)
+        return ring;
+
+    if (k5_mutex_lock(&trace_mutex) != 0)
+        return NULL;
+    for (ring = trace_rings; ring != NULL; ring = ring->next) {
+        if (!ring->in_use)
+            break;
+    }
+    if (ring == NULL) {
+        ring = calloc(1, sizeof(*ring));
+        if (ring != NULL) {
+            ring->index = trace_nrings++;
+            ring->next = trace_rings;
+            trace_rings = ring;
+        }
+    }
+    if (ring != NULL)
+        ring->in_use = TRUE;
+    k5_mutex_unlock(&trace_mutex);
+
+    if (ring != NULL && k5_setspecific(K5_KEY_TRACE_RING, ring) != 0) {
+        release_ring(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+/* Parse the format words of fmt into entry's spec list, skipping words
+ * which trace_format ignores. */
+static void
+parse_specs(struct trace_dict_entry *entry, const char *fmt)
+{
+    size_t len, i;
+
+    entry->nspecs = 0;
+    while (entry->nspecs < TRACE_MAX_SPECS) {
+        len = strcspn(fmt, "{");
+        if (fmt[len] == '\0')
+            break;
+        fmt += len + 1;
+        len = strcspn(fmt, "}");
+        if (fmt[len] == '\0')
+            break;
+        for (i = 0; i < sizeof(spec_words) / sizeof(*spec_words); i++) {
+            if (strlen(spec_words[i].word) == len &&
+                strncmp(spec_words[i].word, fmt, len) == 0) {
+                entry->specs[entry->nspecs++] = spec_words[i].spec;
+                break;
+            }
+        }
+        fmt += len + 1;
+    }
+}
+
+/*
+ * Return the entry for id in ring's dictionary, adding it with fmt's parsed
+ * format words if it is not already there.  If the dictionary is full or
+ * memory is short, parse fmt into *scratch and return that instead.
+ */
+static const struct trace_dict_entry *
+dict_lookup(struct trace_ring *ring, krb5_ui_4 id, const char *fmt,
+            struct trace_dict_entry *scratch)
+{
+    struct trace_dict_entry *entry;
+    size_t i;
+
+    for (i = 0; i < TRACE_DICT_SIZE; i++) {
+        entry = &ring->dict[(id + i) % TRACE_DICT_SIZE];
+        if (entry->id == id)
+            return entry;
+        if (entry->id == 0) {
+            entry->fmt = strdup(fmt);
+            if (entry->fmt == NULL)
+                break;
+            parse_specs(entry, fmt);
+            entry->id = id;
+            return entry;
+        }
+    }
+    parse_specs(scratch, fmt);
+    return scratch;
+}
+
+static void
+put_int(struct argbuf *b, krb5_int64 val)
+{
+    if (b->full || b->space - b->len < 1 + sizeof(val)) {
+        b->full = TRUE;
+        return;
+    }
+    b->p[b->len++] = ARG_INT;
+    memcpy(b->p + b->len, &val, sizeof(val));
+    b->len += sizeof(val);
+}
+
+static void
+put_len(struct argbuf *b, size_t len)
+{
+    krb5_ui_4 val = len;
+
+    if (b->full || b->space - b->len < 1 + sizeof(val)) {
+        b->full = TRUE;
+        return;
+    }
+    b->p[b->len++] = ARG_LEN;
+    memcpy(b->p + b->len, &val, sizeof(val));
+    b->len += sizeof(val);
+}
+
+static void
+put_bytes(struct argbuf *b, int tag, const void *data, size_t len)
+{
+    size_t n = len;
+
+    if (b->full || b->space - b->len < 3) {
+        b->full = TRUE;
+        return;
+    }
+    if (n > 255)
+        n = 255;
+    if (n > b->space - b->len - 2)
+        n = b->space - b->len - 2;
+    b->p[b->len++] = (n < len) ? (tag | ARG_TRUNCATED) : tag;
+    b->p[b->len++] = n;
+    memcpy(b->p + b->len, data, n);
+    b->len += n;
+}
+
+static void
+put_str(struct argbuf *b, const char *str)
+{
+    put_bytes(b, ARG_STR, str, strlen(str));
+}
+
+static void
+append_trunc(char *buf, size_t size, size_t *len, size_t *total,
+             const char *data, size_t n)
+{
+    size_t avail = size - *len;
+
+    memcpy(buf + *len, data, (n < avail) ? n : avail);
+    *len += (n < avail) ? n : avail;
+    *total += n;
+}
+
+/* Record princ as its components and realm, without quoting, or "(null)"
+ * if princ is NULL. */
+static void
+put_princ(struct argbuf *b, krb5_const_principal princ)
+{
+    char tmp[255];
+    size_t len = 0, total = 0;
+    krb5_int32 i;
+
+    if (princ == NULL) {
+        put_str(b, "(null)");
+        return;
+    }
+    for (i = 0; i < princ->length; i++) {
+        if (i > 0)
+            append_trunc(tmp, sizeof(tmp), &len, &total, "/", 1);
+        append_trunc(tmp, sizeof(tmp), &len, &total, princ->data[i].data,
+                     princ->data[i].length);
+    }
+    append_trunc(tmp, sizeof(tmp), &len, &total, "@", 1);
+    append_trunc(tmp, sizeof(tmp), &len, &total, princ->realm.data,
+                 princ->realm.length);
+    put_bytes(b, (total > len) ? (ARG_STR | ARG_TRUNCATED) : ARG_STR, tmp,
+              len);
+}
+
+static void
+put_addr(struct argbuf *b, struct conn_state *cs)
+{
+    size_t len = cs->addrlen;
+
+    if (len > sizeof(cs->addr) || len > 255)
+        len = 0;
+    if (b->full || b->space - b->len < 3 + len) {
+        b->full = TRUE;
+        return;
+    }
+    b->p[b->len++] = ARG_ADDR;
+    b->p[b->len++] = cs->socktype;
+    b->p[b->len++] = len;
+    memcpy(b->p + b->len, &cs->addr, len);
+    b->len += len;
+}
+
+/* Begin a list argument; return a pointer to its count byte. */
+static unsigned char *
+put_list_start(struct argbuf *b)
+{
+    if (b->full || b->space - b->len < 2) {
+        b->full = TRUE;
+        return NULL;
+    }
+    b->p[b->len++] = ARG_LIST;
+    b->p[b->len] = 0;
+    return &b->p[b->len++];
+}
+
+static void
+put_list_item(struct argbuf *b, unsigned char *countp, krb5_int32 val)
+{
+    if (countp == NULL || *countp == 255 ||
+        b->space - b->len < sizeof(val))
+        return;
+    memcpy(b->p + b->len, &val, sizeof(val));
+    b->len += sizeof(val);
+    (*countp)++;
+}
+
+/* Encode the arguments for the format words of entry into b. */
+static void
+encode_args(krb5_context context, struct argbuf *b,
+            const struct trace_dict_entry *entry, va_list ap)
+{
+    size_t i, len;
+    char tmpbuf[200];
+    const char *p;
+    const krb5_data *d;
+    const krb5_keyblock *keyblock;
+    krb5_key key;
+    const krb5_checksum *cksum;
+    krb5_pa_data **padata;
+    krb5_ccache ccache;
+    krb5_keytab keytab;
+    krb5_creds *creds;
+    krb5_enctype *etypes;
+    unsigned char *countp;
+
+    for (i = 0; i < entry->nspecs && !b->full; i++) {
+        switch (entry->specs[i]) {
+        case SPEC_INT:
+        case SPEC_ERRNO:
+            put_int(b, va_arg(ap, int));
+            break;
+        case SPEC_LONG:
+            put_int(b, va_arg(ap, long));
+            break;
+        case SPEC_KERR:
+            put_int(b, va_arg(ap, krb5_error_code));
+            break;
+        case SPEC_ETYPE:
+            put_int(b, va_arg(ap, krb5_enctype));
+            break;
+        case SPEC_STR:
+            p = va_arg(ap, const char *);
+            put_str(b, (p == NULL) ? "(null)" : p);
+            break;
+        case SPEC_LENSTR:
+        case SPEC_HEXLENSTR:
+        case SPEC_HASHLENSTR:
+            len = va_arg(ap, size_t);
+            p = va_arg(ap, const char *);
+            if (p == NULL && len != 0)
+                put_str(b, "(null)");
+            else if (entry->specs[i] == SPEC_LENSTR)
+                put_bytes(b, ARG_STR, p, len);
+            else if (entry->specs[i] == SPEC_HEXLENSTR)
+                put_bytes(b, ARG_HEX, p, len);
+            else
+                put_len(b, len);
+            break;
+        case SPEC_CONNSTATE:
+            put_addr(b, va_arg(ap, struct conn_state *));
+            break;
+        case SPEC_DATA:
+        case SPEC_HEXDATA:
+            d = va_arg(ap, krb5_data *);
+            if (d == NULL || (d->length != 0 && d->data == NULL))
+                put_str(b, "(null)");
+            else
+                put_bytes(b, (entry->specs[i] == SPEC_HEXDATA) ? ARG_HEX :
+                          ARG_STR, d->data, d->length);
+            break;
+        case SPEC_KEYBLOCK:
+        case SPEC_KEY:
+            if (entry->specs[i] == SPEC_KEY) {
+                key = va_arg(ap, krb5_key);
+                keyblock = (key == NULL) ? NULL : &key->keyblock;
+            } else {
+                keyblock = va_arg(ap, const krb5_keyblock *);
+            }
+            if (keyblock == NULL) {
+                put_str(b, "(null)");
+            } else {
+                put_int(b, keyblock->enctype);
+                put_len(b, keyblock->length);
+            }
+            break;
+        case SPEC_CKSUM:
+            cksum = va_arg(ap, const krb5_checksum *);
+            put_int(b, cksum->checksum_type);
+            put_bytes(b, ARG_HEX, cksum->contents, cksum->length);
+            break;
+        case SPEC_PRINC:
+            put_princ(b, va_arg(ap, krb5_principal));
+            break;
+        case SPEC_PATYPES:
+            padata = va_arg(ap, krb5_pa_data **);
+            countp = put_list_start(b);
+            for (; padata != NULL && *padata != NULL; padata++)
+                put_list_item(b, countp, (*padata)->pa_type);
+            break;
+        case SPEC_ETYPES:
+            etypes = va_arg(ap, krb5_enctype *);
+            countp = put_list_start(b);
+            for (; etypes != NULL && *etypes != 0; etypes++)
+                put_list_item(b, countp, *etypes);
+            break;
+        case SPEC_CCACHE:
+            ccache = va_arg(ap, krb5_ccache);
+            (void) snprintf(tmpbuf, sizeof(tmpbuf), "%s:%s",
+                            krb5_cc_get_type(context, ccache),
+                            krb5_cc_get_name(context, ccache));
+            put_str(b, tmpbuf);
+            break;
+        case SPEC_KEYTAB:
+            keytab = va_arg(ap, krb5_keytab);
+            if (krb5_kt_get_name(context, keytab, tmpbuf,
+                                 sizeof(tmpbuf)) != 0)
+                *tmpbuf = '\0';
+            put_str(b, tmpbuf);
+            break;
+        case SPEC_CREDS:
+            creds = va_arg(ap, krb5_creds *);
+            put_princ(b, (creds == NULL) ? NULL : creds->client);
+            put_princ(b, (creds == NULL) ? NULL : creds->server);
+            break;
+        }
+    }
+}
+
+static void
+trace_binary(krb5_context context, const char *fmt, va_list ap)
+{
+    struct trace_ring *ring;
+    struct trace_record *rec;
+    struct timeval tv;
+    struct argbuf b;
+    struct trace_dict_entry scratch;
+    const struct trace_dict_entry *entry;
+    krb5_ui_4 id;
+
+    ring = get_ring();
+    if (ring == NULL)
+        return;
+    id = trace_event_id(fmt);
+    entry = dict_lookup(ring, id, fmt, &scratch);
+    if (k5_getcurtime(&tv) != 0)
+        tv.tv_sec = tv.tv_usec = 0;
+
+    rec = &ring->records[ring->count % TRACE_RING_RECORDS];
+    rec->sec = tv.tv_sec;
+    rec->usec = tv.tv_usec;
+    rec->id = id;
+    b.p = rec->args;
+    b.len = 0;
+    b.space = sizeof(rec->args);
+    b.full = FALSE;
+    encode_args(context, &b, entry, ap);
+    rec->len = b.len;
+    ring->count++;
+
+    krb5int_snapshot_check();
+}
+
+static void KRB5_CALLCONV
+binary_trace_cb(krb5_context context, const struct krb5_trace_info *info,
+                void *data)
+{
+    /* Never called with a message; krb5int_trace records binary events
+     * directly.  There is no per-context data to destroy. */
+}
+
+static void
+add_ui4(struct k5buf *buf, krb5_ui_4 val)
+{
+    krb5int_buf_add_len(buf, (char *)&val, sizeof(val));
+}
+
+/*
+ * Append the dictionary and records of ring to buf, oldest record first.  The
+ * thread owning ring may add dictionary entries meanwhile, so collect the
+ * entries in one pass and write exactly those.  An entry's format is set
+ * before its ID, so an entry with a nonzero ID has a usable format.
+ */
+static void
+snapshot_ring(struct k5buf *buf, struct trace_ring *ring)
+{
+    krb5_ui_8 count = ring->count, start;
+    krb5_ui_4 ids[TRACE_DICT_SIZE], ndict = 0, i;
+    const char *fmts[TRACE_DICT_SIZE];
+
+    for (i = 0; i < TRACE_DICT_SIZE; i++) {
+        ids[ndict] = ring->dict[i].id;
+        fmts[ndict] = ring->dict[i].fmt;
+        if (ids[ndict] != 0 && fmts[ndict] != NULL)
+            ndict++;
+    }
+    add_ui4(buf, ring->index);
+    add_ui4(buf, ndict);
+    for (i = 0; i < ndict; i++) {
+        add_ui4(buf, ids[i]);
+        add_ui4(buf, strlen(fmts[i]));
+        krb5int_buf_add(buf, fmts[i]);
+    }
+    start = (count > TRACE_RING_RECORDS) ? count - TRACE_RING_RECORDS : 0;
+    add_ui4(buf, count - start);
+    for (; start < count; start++) {
+        krb5int_buf_add_len(buf, (char *)
+                            &ring->records[start % TRACE_RING_RECORDS],
+                            sizeof(struct trace_record));
+    }
+}
+
+/* Append the contents of all rings to the binary trace file, if binary
+ * tracing has been enabled. */
+krb5_error_code
+krb5int_trace_snapshot(void)
+{
+    struct k5buf buf;
+    struct trace_ring *ring;
+    krb5_error_code ret;
+    ssize_t len;
+    int fd;
+
+    ret = k5_mutex_lock(&trace_mutex);
+    if (ret)
+        return ret;
+    if (trace_binary_path == NULL) {
+        k5_mutex_unlock(&trace_mutex);
+        return 0;
+    }
+    krb5int_buf_init_dynamic(&buf);
+    krb5int_buf_add_len(&buf, TRACE_MAGIC, 8);
+    add_ui4(&buf, TRACE_BYTE_ORDER);
+    add_ui4(&buf, getpid());
+    add_ui4(&buf, trace_nrings);
+    for (ring = trace_rings; ring != NULL; ring = ring->next)
+        snapshot_ring(&buf, ring);
+    fd = open(trace_binary_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd == -1)
+        ret = errno;
+    k5_mutex_unlock(&trace_mutex);
+
+    len = krb5int_buf_len(&buf);
+    if (len < 0)
+        ret = ENOMEM;
+    else if (fd != -1 && write(fd, krb5int_buf_data(&buf), len) != len)
+        ret = errno;
+    if (fd != -1)
+        close(fd);
+    krb5int_free_buf(&buf);
+    return ret;
+}
+
+static krb5_error_code
+set_binary_trace(krb5_context context, const char *path)
+{
+    krb5_error_code ret;
+    char *copy;
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd == -1)
+        return errno;
+    close(fd);
+    copy = strdup(path);
+    if (copy == NULL)
+        return ENOMEM;
+    ret = k5_mutex_lock(&trace_mutex);
+    if (ret) {
+        free(copy);
+        return ret;
+    }
+    free(trace_binary_path);
+    trace_binary_path = copy;
+    k5_mutex_unlock(&trace_mutex);
+    return krb5_set_trace_callback(context, binary_trace_cb, NULL);
+}
+
+int
+krb5int_trace_initialize(void)
+{
+    int err;
+
+    err = k5_mutex_finish_init(&trace_mutex);
+    if (err)
+        return err;
+    return k5_key_register(K5_KEY_TRACE_RING, release_ring);
+}
+
+void
+krb5int_trace_finalize(void)
+{
+    struct trace_ring *ring, *next;
+    size_t i;
+
+    k5_key_delete(K5_KEY_TRACE_RING);
+    for (ring = trace_rings; ring != NULL; ring = next) {
+        next = ring->next;
+        for (i = 0; i < TRACE_DICT_SIZE; i++)
+            free(ring->dict[i].fmt);
+        free(ring);
+    }
+    trace_rings = NULL;
+    free(trace_binary_path);
+    trace_binary_path = NULL;
+    k5_mutex_destroy(&trace_mutex);
+}
+
+/* Decoding of binary trace snapshots. */
+
+struct argreader {
+    const unsigned char *p;
+    size_t len;
+    size_t pos;
+};
+
+struct trace_arg {
+    int tag;
+    krb5_boolean truncated;
+    krb5_int64 ival;
+    const unsigned char *data;
+    size_t len;
+    int socktype;
+};
+
+struct trace_event {
+    unsigned int ring;
+    size_t seq;
+    struct trace_record rec;
+};
+
+struct dict_entry {
+    krb5_ui_4 id;
+    char *fmt;
+};
+
+/* Read the next encoded argument from r into arg.  Return FALSE if there are
+ * no more (or the rest are malformed). */
+static krb5_boolean
+next_arg(struct argreader *r, struct trace_arg *arg)
+{
+    const unsigned char *p = r->p + r->pos;
+    size_t left = r->len - r->pos;
+    krb5_ui_4 val;
+
+    memset(arg, 0, sizeof(*arg));
+    if (left < 2)
+        return FALSE;
+    arg->tag = *p & ~ARG_TRUNCATED;
+    arg->truncated = (*p & ARG_TRUNCATED) != 0;
+    p++;
+    left--;
+    switch (arg->tag) {
+    case ARG_INT:
+        if (left < sizeof(arg->ival))
+            return FALSE;
+        memcpy(&arg->ival, p, sizeof(arg->ival));
+        r->pos += 1 + sizeof(arg->ival);
+        return TRUE;
+    case ARG_LEN:
+        if (left < sizeof(val))
+            return FALSE;
+        memcpy(&val, p, sizeof(val));
+        arg->len = val;
+        r->pos += 1 + sizeof(val);
+        return TRUE;
+    case ARG_STR:
+    case ARG_HEX:
+        if (left - 1 < p[0])
+            return FALSE;
+        arg->len = p[0];
+        arg->data = p + 1;
+        r->pos += 2 + arg->len;
+        return TRUE;
+    case ARG_ADDR:
+        if (left < 2 || left - 2 < p[1])
+            return FALSE;
+        arg->socktype = p[0];
+        arg->len = p[1];
+        arg->data = p + 2;
+        r->pos += 3 + arg->len;
+        return TRUE;
+    case ARG_LIST:
+        if ((left - 1) / 4 < p[0])
+            return FALSE;
+        arg->len = p[0];
+        arg->data = p + 1;
+        r->pos += 2 + arg->len * 4;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static krb5_int32
+list_item(const struct trace_arg *arg, size_t i)
+{
+    krb5_int32 val;
+
+    memcpy(&val, arg->data + i * 4, sizeof(val));
+    return val;
+}
+
+static void
+render_etype(struct k5buf *buf, krb5_enctype etype)
+{
+    char name[200];
+
+    if (krb5_enctype_to_name(etype, TRUE, name, sizeof(name)) == 0)
+        krb5int_buf_add(buf, name);
+    else
+        krb5int_buf_add_fmt(buf, "%d", (int) etype);
+}
+
+/* Render arg the way trace_format renders the corresponding format words,
+ * as far as the recorded information allows. */
+static void
+render_arg(struct k5buf *buf, const struct trace_arg *arg)
+{
+    char addrbuf[NI_MAXHOST], portbuf[NI_MAXSERV];
+    struct sockaddr_storage ss;
+    size_t i;
+
+    switch (arg->tag) {
+    case ARG_INT:
+        krb5int_buf_add_fmt(buf, "%ld", (long) arg->ival);
+        break;
+    case ARG_STR:
+        krb5int_buf_add_len(buf, (const char *) arg->data, arg->len);
+        break;
+    case ARG_HEX:
+        for (i = 0; i < arg->len; i++)
+            krb5int_buf_add_fmt(buf, "%02X", arg->data[i]);
+        break;
+    case ARG_LEN:
+        krb5int_buf_add_fmt(buf, "(%lu bytes)", (unsigned long) arg->len);
+        break;
+    case ARG_ADDR:
+        if (arg->socktype == SOCK_DGRAM)
+            krb5int_buf_add(buf, "dgram");
+        else if (arg->socktype == SOCK_STREAM)
+            krb5int_buf_add(buf, "stream");
+        else
+            krb5int_buf_add_fmt(buf, "socktype%d", arg->socktype);
+        memset(&ss, 0, sizeof(ss));
+        memcpy(&ss, arg->data, (arg->len < sizeof(ss)) ? arg->len :
+               sizeof(ss));
+        if (arg->len == 0 ||
+            getnameinfo((struct sockaddr *)&ss, arg->len, addrbuf,
+                        sizeof(addrbuf), portbuf, sizeof(portbuf),
+                        NI_NUMERICHOST|NI_NUMERICSERV) != 0)
+            krb5int_buf_add(buf, " (unknown address)");
+        else
+            krb5int_buf_add_fmt(buf, " %s:%s", addrbuf, portbuf);
+        break;
+    case ARG_LIST:
+        if (arg->len == 0)
+            krb5int_buf_add(buf, "(empty)");
+        for (i = 0; i < arg->len; i++) {
+            krb5int_buf_add_fmt(buf, "%d", (int) list_item(arg, i));
+            if (i + 1 < arg->len)
+                krb5int_buf_add(buf, ", ");
+        }
+        break;
+    }
+    if (arg->truncated)
+        krb5int_buf_add(buf, "...");
+}
+
+/* Produce the text of an event from its format string and encoded
+ * arguments. */
+static char *
+render_event(krb5_context context, const char *fmt, struct argreader *r)
+{
+    struct k5buf buf;
+    struct trace_arg arg, arg2;
+    char tmpbuf[200];
+    const char *msg;
+    size_t len, i;
+
+    krb5int_buf_init_dynamic(&buf);
+    while (TRUE) {
+        len = strcspn(fmt, "{");
+        krb5int_buf_add_len(&buf, fmt, len);
+        if (fmt[len] == '\0')
+            break;
+        fmt += len + 1;
+        len = strcspn(fmt, "}");
+        if (fmt[len] == '\0' || len > sizeof(tmpbuf) - 1)
+            break;
+        memcpy(tmpbuf, fmt, len);
+        tmpbuf[len] = '\0';
+        fmt += len + 1;
+
+        if (!next_arg(r, &arg)) {
+            /* The argument did not fit in the record. */
+            krb5int_buf_add(&buf, "...");
+        } else if (arg.tag == ARG_INT && strcmp(tmpbuf, "kerr") == 0) {
+            msg = krb5_get_error_message(context, arg.ival);
+            krb5int_buf_add_fmt(&buf, "%ld/%s", (long) arg.ival, msg);
+            krb5_free_error_message(context, msg);
+        } else if (arg.tag == ARG_INT && strcmp(tmpbuf, "errno") == 0) {
+            krb5int_buf_add_fmt(&buf, "%d/%s", (int) arg.ival,
+                                strerror(arg.ival));
+        } else if (arg.tag == ARG_INT && strcmp(tmpbuf, "etype") == 0) {
+            render_etype(&buf, arg.ival);
+        } else if (arg.tag == ARG_INT && (strcmp(tmpbuf, "keyblock") == 0 ||
+                                          strcmp(tmpbuf, "key") == 0)) {
+            render_etype(&buf, arg.ival);
+            krb5int_buf_add(&buf, "/");
+            if (next_arg(r, &arg2))
+                render_arg(&buf, &arg2);
+        } else if (arg.tag == ARG_INT && strcmp(tmpbuf, "cksum") == 0) {
+            krb5int_buf_add_fmt(&buf, "%d/", (int) arg.ival);
+            if (next_arg(r, &arg2))
+                render_arg(&buf, &arg2);
+        } else if (arg.tag == ARG_LIST && strcmp(tmpbuf, "etypes") == 0) {
+            if (arg.len == 0)
+                krb5int_buf_add(&buf, "(empty)");
+            for (i = 0; i < arg.len; i++) {
+                render_etype(&buf, list_item(&arg, i));
+                if (i + 1 < arg.len)
+                    krb5int_buf_add(&buf, ", ");
+            }
+        } else if (arg.tag == ARG_STR && strcmp(tmpbuf, "creds") == 0) {
+            render_arg(&buf, &arg);
+            krb5int_buf_add(&buf, " -> ");
+            if (next_arg(r, &arg2))
+                render_arg(&buf, &arg2);
+        } else {
+            render_arg(&buf, &arg);
+        }
+    }
+    return krb5int_buf_data(&buf);
+}
+
+static krb5_boolean
+read_ui4(struct argreader *r, krb5_ui_4 *val)
+{
+    if (r->len - r->pos < sizeof(*val))
+        return FALSE;
+    memcpy(val, r->p + r->pos, sizeof(*val));
+    r->pos += sizeof(*val);
+    return TRUE;
+}
+
+static int
+compare_events(const void *a, const void *b)
+{
+    const struct trace_event *ea = a, *eb = b;
+
+    if (ea->rec.sec != eb->rec.sec)
+        return (ea->rec.sec < eb->rec.sec) ? -1 : 1;
+    if (ea->rec.usec != eb->rec.usec)
+        return (ea->rec.usec < eb->rec.usec) ? -1 : 1;
+    return (ea->seq < eb->seq) ? -1 : (ea->seq > eb->seq);
+}
+
+/* Decode one snapshot from r and write its events to out in time order. */
+static krb5_error_code
+decode_snapshot(krb5_context context, struct argreader *r, FILE *out)
+{
+    krb5_error_code ret = EINVAL;
+    krb5_ui_4 order, pid, nrings, index, ndict, id, len, nrec, i, j;
+    struct dict_entry *dict = NULL, *newdict;
+    struct trace_event *events = NULL, *newevents, *ev;
+    struct argreader ar;
+    size_t ndictents = 0, nevents = 0, k;
+    const char *fmt;
+    char *msg;
+
+    if (r->len - r->pos < 8 || memcmp(r->p + r->pos, TRACE_MAGIC, 8) != 0)
+        return EINVAL;
+    r->pos += 8;
+    if (!read_ui4(r, &order) || order != TRACE_BYTE_ORDER ||
+        !read_ui4(r, &pid) || !read_ui4(r, &nrings))
+        return EINVAL;
+
+    for (i = 0; i < nrings; i++) {
+        if (!read_ui4(r, &index) || !read_ui4(r, &ndict))
+            goto cleanup;
+        for (j = 0; j < ndict; j++) {
+            if (!read_ui4(r, &id) || !read_ui4(r, &len) ||
+                r->len - r->pos < len)
+                goto cleanup;
+            newdict = realloc(dict, (ndictents + 1) * sizeof(*dict));
+            if (newdict == NULL)
+                goto nomem;
+            dict = newdict;
+            dict[ndictents].fmt = malloc(len + 1);
+            if (dict[ndictents].fmt == NULL)
+                goto nomem;
+            memcpy(dict[ndictents].fmt, r->p + r->pos, len);
+            dict[ndictents].fmt[len] = '\0';
+            dict[ndictents++].id = id;
+            r->pos += len;
+        }
+        if (!read_ui4(r, &nrec) ||
+            (r->len - r->pos) / sizeof(struct trace_record) < nrec)
+            goto cleanup;
+        newevents = realloc(events, (nevents + nrec) * sizeof(*events));
+        if (newevents == NULL && nevents + nrec > 0)
+            goto nomem;
+        events = newevents;
+        for (j = 0; j < nrec; j++) {
+            ev = &events[nevents];
+            ev->ring = index;
+            ev->seq = nevents++;
+            memcpy(&ev->rec, r->p + r->pos, sizeof(ev->rec));
+            r->pos += sizeof(ev->rec);
+        }
+    }
+
+    if (nevents > 0)
+        qsort(events, nevents, sizeof(*events), compare_events);
+    for (k = 0; k < nevents; k++) {
+        ev = &events[k];
+        fmt = NULL;
+        for (j = 0; j < ndictents && fmt == NULL; j++) {
+            if (dict[j].id == ev->rec.id)
+                fmt = dict[j].fmt;
+        }
+        if (fmt == NULL) {
+            if (asprintf(&msg, "Unknown trace event %08lX",
+                         (unsigned long) ev->rec.id) < 0)
+                msg = NULL;
+        } else {
+            ar.p = ev->rec.args;
+            ar.len = (ev->rec.len < TRACE_ARGS_SIZE) ? ev->rec.len :
+                TRACE_ARGS_SIZE;
+            ar.pos = 0;
+            msg = render_event(context, fmt, &ar);
+        }
+        if (msg == NULL)
+            goto nomem;
+        fprintf(out, "[%lu.%u] %lu.%06lu: %s\n", (unsigned long) pid,
+                ev->ring, (unsigned long) ev->rec.sec,
+                (unsigned long) ev->rec.usec, msg);
+        free(msg);
+    }
+    ret = 0;
+    goto cleanup;
+
+nomem:
+    ret = ENOMEM;
+cleanup:
+    for (k = 0; k < ndictents; k++)
+        free(dict[k].fmt);
+    free(dict);
+    free(events);
+    return ret;
+}
+
+/* Decode the binary trace snapshots in the file in and write them to out
+ * as text, one line per event. */
+krb5_error_code
+krb5int_trace_decode(krb5_context context, FILE *in, FILE *out)
+{
+    krb5_error_code ret = 0;
+    struct argreader r;
+    unsigned char *data = NULL, *newdata;
+    size_t len = 0, size = 0, n;
+
+    while (TRUE) {
+        if (len == size) {
+            size = (size == 0) ? 65536 : size * 2;
+            newdata = realloc(data, size);
+            if (newdata == NULL) {
+                free(data);
+                return ENOMEM;
+            }
+            data = newdata;
+        }
+        n = fread(data + len, 1, size - len, in);
+        if (n == 0)
+            break;
+        len += n;
+    }
+    if (ferror(in)) {
+        free(data);
+        return EIO;
+    }
+
+    r.p = data;
+    r.len = len;
+    r.pos = 0;
+    while (r.pos < r.len && ret == 0)
+        ret = decode_snapshot(context, &r, out);
+    free(data);
+    return ret;
+}
+
 void
 krb5int_init_trace(krb5_context context)
 {
@@ -284,6 +1311,12 @@ krb5int_trace(krb5_context context, const char *fmt, ...)
 
     if (context == NULL || context->trace_callback == NULL)
         return;
+    if (context->trace_callback == binary_trace_cb) {
+        va_start(ap, fmt);
+        trace_binary(context, fmt, ap);
+        va_end(ap);
+        return;
+    }
     va_start(ap, fmt);
     str = trace_format(context, fmt, ap);
     if (str == NULL)
@@ -333,6 +1366,9 @@ krb5_set_trace_filename(krb5_context context, const char *filename)
 {
     int *fd;
 
+    if (strncmp(filename, "binary:", 7) == 0)
+        return set_binary_trace(context, filename + 7);
+
     /* Create callback data containing a file descriptor. */
     fd = malloc(sizeof(*fd));
     if (fd == NULL)
@@ -348,6 +1384,29 @@ krb5_set_trace_filename(krb5_context context, const char *filename)
 
 #else /* DISABLE_TRACING */
 
+int
+krb5int_trace_initialize(void)
+{
+    return 0;
+}
+
+void
+krb5int_trace_finalize(void)
+{
+}
+
+krb5_error_code
+krb5int_trace_snapshot(void)
+{
+    return 0;
+}
+
+krb5_error_code
+krb5int_trace_decode(krb5_context context, FILE *in, FILE *out)
+{
+    return KRB5_TRACE_NOSUPP;
+}
+
 krb5_error_code KRB5_CALLCONV
 krb5_set_trace_callback(krb5_context context, krb5_trace_callback fn,
                         void *cb_data)
@@ -66,7 +66,12 @@ krb5_error_code KRB5_CALLCONV
 krb5_rc_store (krb5_context context, krb5_rcache id,
                krb5_donot_replay *dontreplay)
 {
-    return krb5_x((id)->ops->store,(context, id, dontreplay));
+    krb5_error_code ret;
+    krb5_ui_8 start = k5_metric_start();
+
+    ret = krb5_x((id)->ops->store,(context, id, dontreplay));
+    k5_metric_end(K5_METRIC_RC_STORE, start, ret);
+    return ret;
 }
 
 krb5_error_code KRB5_CALLCONV
@@ -935,8 +935,26 @@ cleanup:
     return retval;
 }
 
+/*
+ * Return the length of the literal prefix of the shell glob pattern, up to
+ * the first wildcard or quoting character.
+ */
+static size_t
+glob_prefix_len(const char *glob)
+{
+    return strcspn(glob, "*?[\\");
+}
+
+/*
+ * Iterate over the entries of dbc, invoking func on each.  If prefix is not
+ * NULL and the database is a btree, only visit the range of keys beginning
+ * with the first prefixlen bytes of prefix; btree keys are ordered, so this
+ * is a range scan instead of a full traversal.  Hash databases are always
+ * traversed in full.
+ */
 static krb5_error_code
-ctx_iterate(krb5_context context, krb5_db2_context *dbc,
+ctx_iterate(krb5_context context, krb5_db2_context *dbc, const char *prefix,
+            size_t prefixlen,
             krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
             krb5_pointer func_arg)
 {
@@ -950,8 +968,19 @@ ctx_iterate(krb5_context context, krb5_db2_context *dbc,
     if (retval)
         return retval;
 
-    dbret = dbc->db->seq(dbc->db, &key, &contents, R_FIRST);
+    if (prefixlen == 0 || dbc->db->type != DB_BTREE)
+        prefix = NULL;
+    if (prefix != NULL) {
+        key.data = (char *)prefix;
+        key.size = prefixlen;
+        dbret = dbc->db->seq(dbc->db, &key, &contents, R_CURSOR);
+    } else {
+        dbret = dbc->db->seq(dbc->db, &key, &contents, R_FIRST);
+    }
     while (dbret == 0) {
+        if (prefix != NULL && (key.size < prefixlen ||
+                               memcmp(key.data, prefix, prefixlen) != 0))
+            break;
         contdata.data = contents.data;
         contdata.length = contents.size;
         retval = krb5_decode_princ_entry(context, &contdata, &entry);
@@ -986,6 +1015,8 @@ ctx_iterate(krb5_context context, krb5_db2_context *dbc,
     return retval;
 }
 
+/* match_expr, if given, is a shell glob; use its literal prefix (if any) to
+ * narrow the iteration.  The caller filters the results. */
 krb5_error_code
 krb5_db2_iterate(krb5_context context, char *match_expr,
                  krb5_error_code(*func) (krb5_pointer, krb5_db_entry *),
@@ -993,7 +1024,8 @@ krb5_db2_iterate(krb5_context context, char *match_expr,
 {
     if (!inited(context))
         return KRB5_KDB_DBNOTINITED;
-    return ctx_iterate(context, context->dal_handle->db_context, func,
+    return ctx_iterate(context, context->dal_handle->db_context, match_expr,
+                       match_expr ? glob_prefix_len(match_expr) : 0, func,
                        func_arg);
 }
 
@@ -1277,7 +1309,8 @@ ctx_merge_nra(krb5_context context, krb5_db2_context *dbc_temp,
 
     nra.kcontext = context;
     nra.db_context = dbc_real;
-    return ctx_iterate(context, dbc_temp, krb5_db2_merge_nra_iterator, &nra);
+    return ctx_iterate(context, dbc_temp, NULL, 0, krb5_db2_merge_nra_iterator,
+                       &nra);
 }
 
 /*
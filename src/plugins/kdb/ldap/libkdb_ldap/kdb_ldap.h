@@ -244,7 +244,8 @@ krb5_error_code
 krb5_ldap_db_init(krb5_context, krb5_ldap_context *);
 
 krb5_error_code
-krb5_ldap_db_single_init(krb5_ldap_context *);
+krb5_ldap_open_handle(krb5_ldap_context *, krb5_ldap_server_info *,
+                      krb5_ldap_server_handle **);
 
 krb5_error_code
 krb5_ldap_rebind(krb5_ldap_context *, krb5_ldap_server_handle **);
@@ -141,46 +141,71 @@ krb5_ldap_bind(krb5_ldap_context *ldap_context,
     return st;
 }
 
-static krb5_error_code
-krb5_ldap_initialize(krb5_ldap_context *ldap_context,
-                     krb5_ldap_server_info *server_info)
+/*
+ * Open and bind a new connection to the server, without adding it to the
+ * server's handle pool.  The server info is not modified, so the handle lock
+ * need not be held.
+ */
+
+krb5_error_code
+krb5_ldap_open_handle(krb5_ldap_context *ldap_context,
+                      krb5_ldap_server_info *server_info,
+                      krb5_ldap_server_handle **handle_out)
 {
     krb5_error_code             st=0;
     krb5_ldap_server_handle     *ldap_server_handle=NULL;
 
+    *handle_out = NULL;
 
     ldap_server_handle = calloc(1, sizeof(krb5_ldap_server_handle));
-    if (ldap_server_handle == NULL) {
-        st = ENOMEM;
-        goto err_out;
-    }
+    if (ldap_server_handle == NULL)
+        return ENOMEM;
 
     /* ldap init */
     if ((st = ldap_initialize(&ldap_server_handle->ldap_handle, server_info->server_name)) != 0) {
         if (ldap_context->kcontext)
             krb5_set_error_message (ldap_context->kcontext, KRB5_KDB_ACCESS_ERROR, "%s",
                                     ldap_err2string(st));
-        st = KRB5_KDB_ACCESS_ERROR;
-        goto err_out;
+        free(ldap_server_handle);
+        return KRB5_KDB_ACCESS_ERROR;
     }
 
-    if ((st=krb5_ldap_bind(ldap_context, ldap_server_handle)) == 0) {
-        ldap_server_handle->server_info_update_pending = FALSE;
-        server_info->server_status = ON;
-        krb5_update_ldap_handle(ldap_server_handle, server_info);
-    } else {
+    if ((st=krb5_ldap_bind(ldap_context, ldap_server_handle)) != 0) {
         if (ldap_context->kcontext)
             krb5_set_error_message (ldap_context->kcontext,
                                     KRB5_KDB_ACCESS_ERROR, "%s",
                                     ldap_err2string(st));
-        st = KRB5_KDB_ACCESS_ERROR;
-        server_info->server_status = OFF;
-        time(&server_info->downtime);
-        /* ldap_unbind_s(ldap_server_handle->ldap_handle); */
+        ldap_unbind_ext_s(ldap_server_handle->ldap_handle, NULL, NULL);
         free(ldap_server_handle);
+        return KRB5_KDB_ACCESS_ERROR;
     }
 
-err_out:
+    ldap_server_handle->server_info_update_pending = FALSE;
+    ldap_server_handle->server_info = server_info;
+    *handle_out = ldap_server_handle;
+    return 0;
+}
+
+/*
+ * Open a new connection to the server and add it to the server's handle pool.
+ * Do not lock the mutex here. The caller should lock it
+ */
+
+static krb5_error_code
+krb5_ldap_initialize(krb5_ldap_context *ldap_context,
+                     krb5_ldap_server_info *server_info)
+{
+    krb5_error_code             st=0;
+    krb5_ldap_server_handle     *ldap_server_handle=NULL;
+
+    st = krb5_ldap_open_handle(ldap_context, server_info, &ldap_server_handle);
+    if (st == 0) {
+        server_info->server_status = ON;
+        krb5_update_ldap_handle(ldap_server_handle, server_info);
+    } else {
+        server_info->server_status = OFF;
+        time(&server_info->downtime);
+    }
     return st;
 }
 
@@ -215,8 +240,6 @@ krb5_ldap_db_init(krb5_context context, krb5_ldap_context *ldap_context)
         server_info = ldap_context->server_info_list[cnt];
 
         if (server_info->server_status == NOTSET) {
-            unsigned int conns=0;
-
             /*
              * Check if the server has to perform certificate-based authentication
              */
@@ -239,10 +262,11 @@ krb5_ldap_db_init(krb5_context context, krb5_ldap_context *ldap_context)
             server_info->modify_increment = 0;
 #endif /* LDAP_MOD_INCREMENT */
 
-            for (conns=0; conns < ldap_context->max_server_conns; ++conns) {
-                if ((st=krb5_ldap_initialize(ldap_context, server_info)) != 0)
-                    break;
-            } /* for (conn= ... */
+            /*
+             * Start with a single connection; the handle pool opens more
+             * (up to max_server_conns) only when requests find it empty.
+             */
+            st = krb5_ldap_initialize(ldap_context, server_info);
 
             if (server_info->server_status == ON)
                 break;  /* server init successful, so break */
@@ -262,43 +286,6 @@ err_out:
 }
 
 
-/*
- * get a single handle. Do not lock the mutex
- */
-
-krb5_error_code
-krb5_ldap_db_single_init(krb5_ldap_context *ldap_context)
-{
-    krb5_error_code             st=0;
-    int                         cnt=0;
-    krb5_ldap_server_info       *server_info=NULL;
-
-    while (ldap_context->server_info_list[cnt] != NULL) {
-        server_info = ldap_context->server_info_list[cnt];
-        if ((server_info->server_status == NOTSET || server_info->server_status == ON)) {
-            if (server_info->num_conns < ldap_context->max_server_conns-1) {
-                st = krb5_ldap_initialize(ldap_context, server_info);
-                if (st == LDAP_SUCCESS)
-                    goto cleanup;
-            }
-        }
-        ++cnt;
-    }
-
-    /* If we are here, try to connect to all the servers */
-
-    cnt = 0;
-    while (ldap_context->server_info_list[cnt] != NULL) {
-        server_info = ldap_context->server_info_list[cnt];
-        st = krb5_ldap_initialize(ldap_context, server_info);
-        if (st == LDAP_SUCCESS)
-            goto cleanup;
-        ++cnt;
-    }
-cleanup:
-    return (st);
-}
-
 krb5_error_code
 krb5_ldap_rebind(krb5_ldap_context *ldap_context,
                  krb5_ldap_server_handle **ldap_server_handle)
@@ -126,23 +126,115 @@ krb5_get_ldap_handle(krb5_ldap_context *ldap_context)
 }
 
 /*
- * This is called incase krb5_get_ldap_handle returns NULL.
- * Try getting a single connection (handle) and return the same by
- * calling krb5_get_ldap_handle function.
+ * Return a server which may be given another connection: one with fewer than
+ * max_server_conns connections, preferring servers not known to be down.  A
+ * down server is offered at most once per caller, as recorded in *tried_down.
+ * Return NULL if every server is at its limit.
  * Do not lock the mutex here. The caller should lock it
  */
 
-static krb5_ldap_server_handle *
-krb5_retry_get_ldap_handle(krb5_ldap_context *ldap_context,
-                           krb5_error_code *st)
+static krb5_ldap_server_info *
+krb5_ldap_server_with_room(krb5_ldap_context *ldap_context, int *tried_down)
 {
-    krb5_ldap_server_handle    *ldap_server_handle=NULL;
+    krb5_ldap_server_info      *server_info=NULL;
+    int                        cnt;
+
+    for (cnt = 0; ldap_context->server_info_list[cnt] != NULL; cnt++) {
+        server_info = ldap_context->server_info_list[cnt];
+        if (server_info->server_status != OFF &&
+            server_info->num_conns < ldap_context->max_server_conns)
+            return server_info;
+    }
+    /* Try reconnecting to the servers which are down, as a last resort. */
+    for (; *tried_down < cnt; (*tried_down)++) {
+        server_info = ldap_context->server_info_list[*tried_down];
+        if (server_info->server_status == OFF &&
+            server_info->num_conns < ldap_context->max_server_conns) {
+            (*tried_down)++;
+            return server_info;
+        }
+    }
+    return NULL;
+}
 
-    if ((*st=krb5_ldap_db_single_init(ldap_context)) != 0)
-        return NULL;
+/* Interval between checks for a returned handle, when every server has
+ * max_server_conns connections, and the maximum total wait. */
+#define POOL_WAIT_INTERVAL_NS   1000000         /* 1ms */
+#define POOL_WAIT_LIMIT         10              /* seconds */
 
-    ldap_server_handle = krb5_get_ldap_handle(ldap_context);
-    return ldap_server_handle;
+/*
+ * Take a handle from the pool.  If the pool is empty, open a new connection
+ * to a server with fewer than max_server_conns connections, or if there is
+ * none, wait for another thread to return a handle.  The connection is made
+ * with the mutex released, so that other threads can take and return handles
+ * meanwhile; its slot is reserved beforehand by counting it in num_conns.
+ * Do not lock the mutex here.
+ */
+
+static krb5_error_code
+krb5_get_or_open_ldap_handle(krb5_ldap_context *ldap_context,
+                             krb5_ldap_server_handle **ldap_server_handle)
+{
+    krb5_error_code            st=0, last_st=0;
+    krb5_ldap_server_info      *server_info=NULL;
+    krb5_ldap_server_handle    *handle=NULL;
+    int                        tried_down=0;
+    time_t                     deadline=time(NULL) + POOL_WAIT_LIMIT;
+    struct timespec            interval={0, POOL_WAIT_INTERVAL_NS};
+
+    *ldap_server_handle = NULL;
+
+    for (;;) {
+        st = HNDL_LOCK(ldap_context);
+        if (st)
+            return st;
+        handle = krb5_get_ldap_handle(ldap_context);
+        server_info = NULL;
+        if (handle == NULL) {
+            server_info = krb5_ldap_server_with_room(ldap_context,
+                                                     &tried_down);
+            if (server_info != NULL)
+                server_info->num_conns++;
+        }
+        HNDL_UNLOCK(ldap_context);
+
+        if (handle != NULL) {
+            *ldap_server_handle = handle;
+            return 0;
+        }
+
+        if (server_info == NULL) {
+            /* Every server has failed or has max_server_conns. */
+            if (last_st != 0)
+                return last_st;
+            if (time(NULL) >= deadline)
+                return KRB5_KDB_ACCESS_ERROR;
+            nanosleep(&interval, NULL);
+            continue;
+        }
+
+        last_st = krb5_ldap_open_handle(ldap_context, server_info, &handle);
+        st = HNDL_LOCK(ldap_context);
+        if (st) {
+            if (handle != NULL) {
+                ldap_unbind_ext_s(handle->ldap_handle, NULL, NULL);
+                free(handle);
+            }
+            return st;
+        }
+        if (last_st == 0) {
+            server_info->server_status = ON;
+        } else {
+            server_info->num_conns--;
+            server_info->server_status = OFF;
+            time(&server_info->downtime);
+        }
+        HNDL_UNLOCK(ldap_context);
+        if (last_st == 0) {
+            *ldap_server_handle = handle;
+            return 0;
+        }
+    }
 }
 
 /*
@@ -200,6 +292,7 @@ krb5_ldap_cleanup_handles(krb5_ldap_server_info *ldap_server_info)
         /* ldap_unbind_s(ldap_server_handle); */
         free (ldap_server_handle);
         ldap_server_handle = NULL;
+        ldap_server_info->num_conns--;
     }
     return 0;
 }
@@ -214,15 +307,10 @@ krb5_ldap_request_handle_from_pool(krb5_ldap_context *ldap_context,
                                    ldap_server_handle)
 {
     krb5_error_code            st=0;
+    krb5_ui_8                  start = k5_metric_start();
 
-    *ldap_server_handle = NULL;
-
-    st = HNDL_LOCK(ldap_context);
-    if (st)
-        return st;
-    if (((*ldap_server_handle)=krb5_get_ldap_handle(ldap_context)) == NULL)
-        (*ldap_server_handle)=krb5_retry_get_ldap_handle(ldap_context, &st);
-    HNDL_UNLOCK(ldap_context);
+    st = krb5_get_or_open_ldap_handle(ldap_context, ldap_server_handle);
+    k5_metric_end(K5_METRIC_LDAP_POOL_WAIT, start, st);
     return st;
 }
 
@@ -245,11 +333,9 @@ krb5_ldap_request_next_handle_from_pool(krb5_ldap_context *ldap_context,
     time(&(*ldap_server_handle)->server_info->downtime);
     krb5_put_ldap_handle(*ldap_server_handle);
     krb5_ldap_cleanup_handles((*ldap_server_handle)->server_info);
-
-    if (((*ldap_server_handle)=krb5_get_ldap_handle(ldap_context)) == NULL)
-        (*ldap_server_handle)=krb5_retry_get_ldap_handle(ldap_context, &st);
     HNDL_UNLOCK(ldap_context);
-    return st;
+
+    return krb5_get_or_open_ldap_handle(ldap_context, ldap_server_handle);
 }
 
 /*
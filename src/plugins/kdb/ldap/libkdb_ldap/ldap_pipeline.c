@@ -0,0 +1,98 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/ldap_pipeline.c - Concurrent subtree searches */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * These helpers let a principal lookup start a search on every subtree before
+ * waiting for any results, so that the directory works on all of them
+ * concurrently and the lookup costs one round trip instead of one per
+ * subtree.  A search which has been started is identified by its message ID;
+ * an entry of -1 in a msgids array means no search is outstanding.
+ */
+
+#include "ldap_main.h"
+#include "ldap_pipeline.h"
+
+/*
+ * Abandon the outstanding searches in msgids[0..n-1], skipping entries which
+ * are set to -1, and set all of the entries to -1.
+ */
+void
+krb5_ldap_abandon_searches(LDAP *ld, int *msgids, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        if (msgids[i] != -1)
+            ldap_abandon_ext(ld, msgids[i], NULL, NULL);
+        msgids[i] = -1;
+    }
+}
+
+/*
+ * Start a search on each of the ntrees subtrees without waiting for any
+ * results, recording the message IDs in msgids.  On failure, abandon the
+ * searches already started, leaving every entry of msgids set to -1.
+ */
+int
+krb5_ldap_start_searches(LDAP *ld, char **subtree, unsigned int ntrees,
+                         int scope, char *filter, char **attrs,
+                         struct timeval *tlimit, int *msgids)
+{
+    unsigned int i;
+    int st;
+
+    for (i = 0; i < ntrees; i++)
+        msgids[i] = -1;
+    for (i = 0; i < ntrees; i++) {
+        st = ldap_search_ext(ld, subtree[i], scope, filter, attrs, 0, NULL,
+                             NULL, tlimit, LDAP_NO_LIMIT, &msgids[i]);
+        if (st != LDAP_SUCCESS) {
+            msgids[i] = -1;
+            krb5_ldap_abandon_searches(ld, msgids, i);
+            return st;
+        }
+    }
+    return LDAP_SUCCESS;
+}
+
+/* Wait for the complete result of the search msgid and return its status. */
+int
+krb5_ldap_wait_for_search(LDAP *ld, int msgid, struct timeval *tlimit,
+                          LDAPMessage **result)
+{
+    int st;
+
+    *result = NULL;
+    st = ldap_result(ld, msgid, LDAP_MSG_ALL, tlimit, result);
+    if (st == 0)
+        return LDAP_TIMEOUT;
+    if (st == -1) {
+        if (ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &st) != LDAP_OPT_SUCCESS)
+            st = LDAP_OTHER;
+        return st;
+    }
+    return ldap_result2error(ld, *result, 0);
+}
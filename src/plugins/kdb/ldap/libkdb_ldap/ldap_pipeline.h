@@ -0,0 +1,42 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/ldap_pipeline.h - Concurrent subtree searches */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+#ifndef _LDAP_PIPELINE_H_
+#define _LDAP_PIPELINE_H_
+
+void
+krb5_ldap_abandon_searches(LDAP *ld, int *msgids, unsigned int n);
+
+int
+krb5_ldap_start_searches(LDAP *ld, char **subtree, unsigned int ntrees,
+                         int scope, char *filter, char **attrs,
+                         struct timeval *tlimit, int *msgids);
+
+int
+krb5_ldap_wait_for_search(LDAP *ld, int msgid, struct timeval *tlimit,
+                          LDAPMessage **result);
+
+#endif
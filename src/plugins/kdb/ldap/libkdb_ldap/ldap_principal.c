@@ -132,6 +132,47 @@ krb5_ldap_free_principal(krb5_context kcontext, krb5_db_entry *entry)
     free(entry);
 }
 
+/*
+ * Append to buf an LDAP substring assertion value matching a superset of the
+ * names matched by the shell glob.  "*" wildcards are kept so that the
+ * directory can use its substring indexes (a literal prefix such as
+ * "host/web*" becomes an initial-substring match); the value is truncated
+ * with a "*" at the first "?", "[", or quoted character, which have no LDAP
+ * equivalent.  The caller filters the results against the full glob.
+ */
+static void
+add_glob_filter_value(struct k5buf *buf, const char *glob)
+{
+    const char *p;
+    int star = 0;
+
+    for (p = glob; *p != '\0'; p++) {
+        switch (*p) {
+        case '?':
+        case '[':
+        case '\\':
+            if (!star)
+                krb5int_buf_add(buf, "*");
+            return;
+        case '*':
+            if (!star)
+                krb5int_buf_add(buf, "*");
+            star = 1;
+            continue;
+        case '(':
+            krb5int_buf_add(buf, "\\28");
+            break;
+        case ')':
+            krb5int_buf_add(buf, "\\29");
+            break;
+        default:
+            krb5int_buf_add_len(buf, p, 1);
+            break;
+        }
+        star = 0;
+    }
+}
+
 krb5_error_code
 krb5_ldap_iterate(krb5_context context, char *match_expr,
                   krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
@@ -140,6 +181,7 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     krb5_db_entry            entry;
     krb5_principal           principal;
     char                     **subtree=NULL, *princ_name=NULL, *realm=NULL, **values=NULL, *filter=NULL;
+    struct k5buf             filtbuf;
     unsigned int             tree=0, ntree=1, i=0;
     krb5_error_code          st=0, tempst=0;
     LDAP                     *ld=NULL;
@@ -154,6 +196,7 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
 
     memset(&entry, 0, sizeof(krb5_db_entry));
     SETUP_CONTEXT();
+    krb5int_buf_init_dynamic(&filtbuf);
 
     realm = ldap_context->lrparams->realm_name;
     if (realm == NULL) {
@@ -171,8 +214,10 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     if (match_expr == NULL)
         match_expr = default_match_expr;
 
-    if (asprintf(&filter, FILTER"%s))", match_expr) < 0)
-        filter = NULL;
+    krb5int_buf_add(&filtbuf, FILTER);
+    add_glob_filter_value(&filtbuf, match_expr);
+    krb5int_buf_add(&filtbuf, "))");
+    filter = krb5int_buf_data(&filtbuf);
     CHECK_NULL(filter);
 
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntree)) != 0)
@@ -213,8 +258,7 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     } /* end of for (tree= ... */
 
 cleanup:
-    if (filter)
-        free (filter);
+    krb5int_free_buf(&filtbuf);
 
     for (;ntree; --ntree)
         if (subtree[ntree-1])
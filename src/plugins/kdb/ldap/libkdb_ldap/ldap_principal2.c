@@ -40,6 +40,7 @@
 #include "ldap_tkt_policy.h"
 #include "ldap_pwd_policy.h"
 #include "ldap_err.h"
+#include "ldap_pipeline.h"
 #include <kadm5/admin.h>
 
 extern char* principal_attributes[];
@@ -87,8 +88,10 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     kdb5_dal_handle             *dal_handle=NULL;
     krb5_ldap_server_handle     *ldap_server_handle=NULL;
     krb5_principal              cprinc=NULL;
-    krb5_boolean                found=FALSE;
+    krb5_boolean                found=FALSE, pipelined=FALSE;
     krb5_db_entry               *entry = NULL;
+    int                         *msgids=NULL;
+    krb5_ui_8                   start=0;
 
     *entry_ptr = NULL;
 
@@ -132,10 +135,46 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntrees)) != 0)
         goto cleanup;
 
+    msgids = k5alloc(ntrees * sizeof(*msgids), &st);
+    if (msgids == NULL)
+        goto cleanup;
+
     GET_HANDLE();
+    start = k5_metric_start();
+
+    /*
+     * Issue the searches on all of the subtrees up front and then collect the
+     * results in subtree order, so the lookup costs one round trip however
+     * many subtrees there are.  If the searches can't be started, or the
+     * server goes away while we wait for a result, search the remaining
+     * subtrees one at a time with LDAP_SEARCH, which rebinds as necessary.
+     */
+    pipelined = (krb5_ldap_start_searches(ld, subtree, ntrees,
+                                          ldap_context->lrparams->search_scope,
+                                          filter, principal_attributes,
+                                          &timelimit, msgids) == LDAP_SUCCESS);
+
     for (tree=0; tree < ntrees && !found; ++tree) {
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
+        if (pipelined) {
+            st = krb5_ldap_wait_for_search(ld, msgids[tree], &timelimit,
+                                           &result);
+            msgids[tree] = -1;
+            if (st != LDAP_SUCCESS &&
+                translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+                ldap_msgfree(result);
+                result = NULL;
+                krb5_ldap_abandon_searches(ld, msgids, ntrees);
+                pipelined = FALSE;
+            } else if (st != LDAP_SUCCESS) {
+                st = set_ldap_error(context, st, OP_SEARCH);
+                goto cleanup;
+            }
+        }
+        if (!pipelined) {
+            LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope,
+                        filter, principal_attributes);
+        }
         for (ent=ldap_first_entry(ld, result); ent != NULL && !found; ent=ldap_next_entry(ld, ent)) {
 
             /* get the associated directory user information */
@@ -197,6 +236,15 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
 cleanup:
     ldap_msgfree(result);
     krb5_ldap_free_principal(context, entry);
+    k5_metric_end(K5_METRIC_LDAP_SEARCH, start,
+                  (st == KRB5_KDB_NOENTRY) ? 0 : st);
+
+    /* Don't leave searches for later subtrees running once we're done. */
+    if (msgids != NULL) {
+        if (pipelined)
+            krb5_ldap_abandon_searches(ld, msgids, ntrees);
+        free(msgids);
+    }
 
     if (filter)
         free (filter);
@@ -0,0 +1,188 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/t_pipeline.c - Test concurrent searches */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program includes ldap_pipeline.c with stub LDAP calls in place of the
+ * LDAP library, and checks which searches are abandoned when starting them
+ * fails part way, and how search results are turned into status codes.
+ */
+
+#include "ldap_pipeline.c"
+
+#define MAX_CALLS 16
+
+/* ldap_search_ext() fails on this call (counting from 0), or never if -1. */
+static int stub_fail_at = -1;
+static int stub_searches;
+
+/* Message IDs passed to ldap_abandon_ext(), in order. */
+static int stub_abandoned[MAX_CALLS];
+static int stub_nabandoned;
+
+/* What ldap_result(), ldap_get_option() and ldap_result2error() return. */
+static int stub_result, stub_result_code, stub_result_error;
+
+static void
+stub_reset(int fail_at)
+{
+    stub_fail_at = fail_at;
+    stub_searches = stub_nabandoned = 0;
+}
+
+int
+ldap_search_ext(LDAP *ld, LDAP_CONST char *base, int scope,
+                LDAP_CONST char *filter, char **attrs, int attrsonly,
+                LDAPControl **sctrls, LDAPControl **cctrls,
+                struct timeval *timeout, int sizelimit, int *msgidp)
+{
+    /* Leave junk in *msgidp on failure, as a library might. */
+    *msgidp = 100 + stub_searches;
+    if (stub_searches++ == stub_fail_at)
+        return LDAP_SERVER_DOWN;
+    return LDAP_SUCCESS;
+}
+
+int
+ldap_abandon_ext(LDAP *ld, int msgid, LDAPControl **sctrls,
+                 LDAPControl **cctrls)
+{
+    assert(stub_nabandoned < MAX_CALLS);
+    stub_abandoned[stub_nabandoned++] = msgid;
+    return LDAP_SUCCESS;
+}
+
+int
+ldap_result(LDAP *ld, int msgid, int all, struct timeval *timeout,
+            LDAPMessage **result)
+{
+    return stub_result;
+}
+
+int
+ldap_get_option(LDAP *ld, int option, void *outvalue)
+{
+    assert(option == LDAP_OPT_RESULT_CODE);
+    *(int *)outvalue = stub_result_code;
+    return LDAP_OPT_SUCCESS;
+}
+
+int
+ldap_result2error(LDAP *ld, LDAPMessage *r, int freeit)
+{
+    return stub_result_error;
+}
+
+static void
+check_all_unset(int *msgids, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        assert(msgids[i] == -1);
+}
+
+static void
+test_start(void)
+{
+    char *subtree[4] = { "ou=a", "ou=b", "ou=c", "ou=d" };
+    int msgids[4], st;
+
+    /* All of the searches start. */
+    stub_reset(-1);
+    st = krb5_ldap_start_searches(NULL, subtree, 4, LDAP_SCOPE_SUBTREE,
+                                  "(x=y)", NULL, NULL, msgids);
+    assert(st == LDAP_SUCCESS);
+    assert(msgids[0] == 100 && msgids[1] == 101 && msgids[2] == 102 &&
+           msgids[3] == 103);
+    assert(stub_nabandoned == 0);
+
+    /* The third search fails to start; only the first two are abandoned. */
+    stub_reset(2);
+    st = krb5_ldap_start_searches(NULL, subtree, 4, LDAP_SCOPE_SUBTREE,
+                                  "(x=y)", NULL, NULL, msgids);
+    assert(st == LDAP_SERVER_DOWN);
+    assert(stub_searches == 3);
+    assert(stub_nabandoned == 2);
+    assert(stub_abandoned[0] == 100 && stub_abandoned[1] == 101);
+    check_all_unset(msgids, 4);
+
+    /* The first search fails to start; nothing is abandoned. */
+    stub_reset(0);
+    st = krb5_ldap_start_searches(NULL, subtree, 4, LDAP_SCOPE_SUBTREE,
+                                  "(x=y)", NULL, NULL, msgids);
+    assert(st == LDAP_SERVER_DOWN);
+    assert(stub_searches == 1 && stub_nabandoned == 0);
+    check_all_unset(msgids, 4);
+}
+
+static void
+test_abandon(void)
+{
+    int msgids[4] = { 100, -1, 102, -1 };
+
+    /* Searches whose results have been read are skipped. */
+    stub_reset(-1);
+    krb5_ldap_abandon_searches(NULL, msgids, 4);
+    assert(stub_nabandoned == 2);
+    assert(stub_abandoned[0] == 100 && stub_abandoned[1] == 102);
+    check_all_unset(msgids, 4);
+
+    /* Abandoning again does nothing. */
+    krb5_ldap_abandon_searches(NULL, msgids, 4);
+    assert(stub_nabandoned == 2);
+}
+
+static void
+test_wait(void)
+{
+    LDAPMessage *result;
+
+    stub_result = 0;
+    assert(krb5_ldap_wait_for_search(NULL, 100, NULL, &result) ==
+           LDAP_TIMEOUT);
+
+    stub_result = -1;
+    stub_result_code = LDAP_SERVER_DOWN;
+    assert(krb5_ldap_wait_for_search(NULL, 100, NULL, &result) ==
+           LDAP_SERVER_DOWN);
+
+    stub_result = LDAP_RES_SEARCH_RESULT;
+    stub_result_error = LDAP_NO_SUCH_OBJECT;
+    assert(krb5_ldap_wait_for_search(NULL, 100, NULL, &result) ==
+           LDAP_NO_SUCH_OBJECT);
+    stub_result_error = LDAP_SUCCESS;
+    assert(krb5_ldap_wait_for_search(NULL, 100, NULL, &result) ==
+           LDAP_SUCCESS);
+}
+
+int
+main(void)
+{
+    test_start();
+    test_abandon();
+    test_wait();
+    return 0;
+}
@@ -0,0 +1,361 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/preauth/async_test/main.c - Test module for asynchronous preauth */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This is a test preauth module for the kdcpreauth offload and watch_fd
+ * callbacks, which let a module wait for an external server without blocking
+ * the KDC.  The client sends a token given with "kinit -X token=value".  The
+ * KDC asks a token server on 127.0.0.1 whether the token is valid, using the
+ * UDP port named by the client principal's "async_test" string attribute,
+ * which has the form "thread:port" or "socket:port".  In thread mode, the
+ * module makes a blocking request on a KDC helper thread; in socket mode, it
+ * sends the request from the KDC's thread and uses watch_fd to wait for the
+ * reply.  The server replies "ok" if it accepts the token.  The mechanism
+ * provides hardware authentication, so principals using it should require it.
+ */
+
+#include "k5-platform.h"
+#include <krb5/krb5.h>
+#include <krb5/preauth_plugin.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* This is not a standardized value. */
+#define KRB5_PADATA_ASYNC_TEST 153
+
+#define SERVER_TIMEOUT_MS 10000
+
+static krb5_preauthtype pa_types[] = { KRB5_PADATA_ASYNC_TEST, 0 };
+
+/* Client module data: the token supplied with -X token=value, if any. */
+struct client_data {
+    char *token;
+};
+
+static krb5_error_code
+client_init(krb5_context context, krb5_clpreauth_moddata *moddata_out)
+{
+    struct client_data *cd;
+
+    cd = calloc(1, sizeof(*cd));
+    if (cd == NULL)
+        return ENOMEM;
+    *moddata_out = (krb5_clpreauth_moddata)cd;
+    return 0;
+}
+
+static void
+client_fini(krb5_context context, krb5_clpreauth_moddata moddata)
+{
+    struct client_data *cd = (struct client_data *)moddata;
+
+    free(cd->token);
+    free(cd);
+}
+
+static int
+client_flags(krb5_context context, krb5_preauthtype pa_type)
+{
+    return PA_REAL;
+}
+
+static krb5_error_code
+client_gic_opt(krb5_context context, krb5_clpreauth_moddata moddata,
+               krb5_get_init_creds_opt *opt, const char *attr,
+               const char *value)
+{
+    struct client_data *cd = (struct client_data *)moddata;
+
+    if (strcmp(attr, "token") != 0)
+        return 0;
+    free(cd->token);
+    cd->token = strdup(value);
+    return (cd->token == NULL) ? ENOMEM : 0;
+}
+
+static krb5_error_code
+client_process(krb5_context context, krb5_clpreauth_moddata moddata,
+               krb5_clpreauth_modreq modreq, krb5_get_init_creds_opt *opt,
+               krb5_clpreauth_callbacks cb, krb5_clpreauth_rock rock,
+               krb5_kdc_req *request, krb5_data *encoded_request_body,
+               krb5_data *encoded_previous_request, krb5_pa_data *pa_data,
+               krb5_prompter_fct prompter, void *prompter_data,
+               krb5_pa_data ***out_pa_data)
+{
+    struct client_data *cd = (struct client_data *)moddata;
+    krb5_pa_data **list, *pa;
+
+    if (cd->token == NULL)
+        return ENOENT;
+
+    list = calloc(2, sizeof(*list));
+    pa = calloc(1, sizeof(*pa));
+    if (list == NULL || pa == NULL)
+        goto oom;
+    pa->magic = KV5M_PA_DATA;
+    pa->pa_type = KRB5_PADATA_ASYNC_TEST;
+    pa->length = strlen(cd->token);
+    pa->contents = (krb5_octet *)strdup(cd->token);
+    if (pa->contents == NULL)
+        goto oom;
+    list[0] = pa;
+    *out_pa_data = list;
+    return 0;
+
+oom:
+    free(pa);
+    free(list);
+    return ENOMEM;
+}
+
+/* State for one verify request, released by finish_verify(). */
+struct verify_state {
+    krb5_kdcpreauth_verify_respond_fn respond;
+    void *arg;
+    krb5_enc_tkt_part *enc_tkt_reply;
+    struct sockaddr_in addr;
+    char *token;
+    int fd;
+    char reply[16];
+    ssize_t replylen;
+};
+
+/* Get the token server port and mode from the client's string attribute. */
+static krb5_error_code
+get_server(krb5_context context, krb5_kdcpreauth_callbacks cb,
+           krb5_kdcpreauth_rock rock, int *threaded_out, int *port_out)
+{
+    krb5_error_code ret;
+    char *value, *sep;
+    int port;
+
+    *threaded_out = *port_out = 0;
+    if (cb->vers < 2)
+        return KRB5_PLUGIN_OP_NOTSUPP;
+    ret = cb->get_string(context, rock, "async_test", &value);
+    if (ret)
+        return ret;
+    if (value == NULL)
+        return ENOENT;
+    sep = strchr(value, ':');
+    port = (sep == NULL) ? 0 : atoi(sep + 1);
+    if (port <= 0 || port > 65535) {
+        cb->free_string(context, rock, value);
+        return EINVAL;
+    }
+    *threaded_out = (strncmp(value, "thread:", 7) == 0);
+    *port_out = port;
+    cb->free_string(context, rock, value);
+    return 0;
+}
+
+static void
+finish_verify(struct verify_state *st, krb5_error_code code)
+{
+    if (code == 0)
+        st->enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH | TKT_FLG_HW_AUTH;
+    (*st->respond)(st->arg, code, NULL, NULL, NULL);
+    if (st->fd != -1)
+        close(st->fd);
+    free(st->token);
+    free(st);
+}
+
+static krb5_error_code
+check_reply(struct verify_state *st)
+{
+    if (st->replylen == 2 && memcmp(st->reply, "ok", 2) == 0)
+        return 0;
+    return KRB5KDC_ERR_PREAUTH_FAILED;
+}
+
+/* Query the token server with a blocking socket, on a KDC helper thread. */
+static void
+query_work(krb5_context context, void *arg)
+{
+    struct verify_state *st = arg;
+    struct timeval tv;
+    int fd;
+
+    st->replylen = -1;
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1)
+        return;
+    tv.tv_sec = SERVER_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+        sendto(fd, st->token, strlen(st->token), 0,
+               (struct sockaddr *)&st->addr, sizeof(st->addr)) >= 0)
+        st->replylen = recv(fd, st->reply, sizeof(st->reply), 0);
+    close(fd);
+}
+
+static void
+query_done(krb5_context context, void *arg)
+{
+    struct verify_state *st = arg;
+
+    finish_verify(st, check_reply(st));
+}
+
+static void
+reply_ready(krb5_context context, int fd, int ready, void *arg)
+{
+    struct verify_state *st = arg;
+
+    st->replylen = ready ? recv(fd, st->reply, sizeof(st->reply), 0) : -1;
+    finish_verify(st, check_reply(st));
+}
+
+/* Send the token from the KDC's thread and wait for the reply with
+ * watch_fd. */
+static krb5_error_code
+query_async(krb5_context context, krb5_kdcpreauth_callbacks cb,
+            krb5_kdcpreauth_rock rock, struct verify_state *st)
+{
+    int flags;
+
+    st->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (st->fd == -1)
+        return errno;
+    flags = fcntl(st->fd, F_GETFL);
+    if (flags == -1 || fcntl(st->fd, F_SETFL, flags | O_NONBLOCK) == -1)
+        return errno;
+    if (sendto(st->fd, st->token, strlen(st->token), 0,
+               (struct sockaddr *)&st->addr, sizeof(st->addr)) < 0)
+        return errno;
+    return cb->watch_fd(context, rock, st->fd, KRB5_KDCPREAUTH_FD_READ,
+                        SERVER_TIMEOUT_MS, reply_ready, st);
+}
+
+static void
+server_edata(krb5_context context, krb5_kdc_req *request,
+             krb5_kdcpreauth_callbacks cb, krb5_kdcpreauth_rock rock,
+             krb5_kdcpreauth_moddata moddata, krb5_preauthtype pa_type,
+             krb5_kdcpreauth_edata_respond_fn respond, void *arg)
+{
+    int threaded, port;
+
+    /* Only offer the mechanism to principals configured for it. */
+    (*respond)(arg, get_server(context, cb, rock, &threaded, &port), NULL);
+}
+
+static void
+server_verify(krb5_context context, krb5_data *req_pkt, krb5_kdc_req *request,
+              krb5_enc_tkt_part *enc_tkt_reply, krb5_pa_data *data,
+              krb5_kdcpreauth_callbacks cb, krb5_kdcpreauth_rock rock,
+              krb5_kdcpreauth_moddata moddata,
+              krb5_kdcpreauth_verify_respond_fn respond, void *arg)
+{
+    krb5_error_code ret;
+    struct verify_state *st;
+    int threaded, port;
+
+    ret = get_server(context, cb, rock, &threaded, &port);
+    if (ret) {
+        (*respond)(arg, ret, NULL, NULL, NULL);
+        return;
+    }
+
+    st = calloc(1, sizeof(*st));
+    if (st == NULL) {
+        (*respond)(arg, ENOMEM, NULL, NULL, NULL);
+        return;
+    }
+    st->respond = respond;
+    st->arg = arg;
+    st->enc_tkt_reply = enc_tkt_reply;
+    st->fd = -1;
+    st->addr.sin_family = AF_INET;
+    st->addr.sin_port = htons(port);
+    st->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    st->token = malloc(data->length + 1);
+    if (st->token == NULL) {
+        finish_verify(st, ENOMEM);
+        return;
+    }
+    memcpy(st->token, data->contents, data->length);
+    st->token[data->length] = '\0';
+
+    if (threaded)
+        ret = cb->offload(context, rock, query_work, query_done, st);
+    else
+        ret = query_async(context, cb, rock, st);
+    if (ret)
+        finish_verify(st, ret);
+}
+
+static int
+server_flags(krb5_context context, krb5_preauthtype pa_type)
+{
+    return PA_HARDWARE;
+}
+
+krb5_error_code
+clpreauth_async_test_initvt(krb5_context context, int maj_ver, int min_ver,
+                            krb5_plugin_vtable vtable);
+krb5_error_code
+kdcpreauth_async_test_initvt(krb5_context context, int maj_ver, int min_ver,
+                             krb5_plugin_vtable vtable);
+
+krb5_error_code
+clpreauth_async_test_initvt(krb5_context context, int maj_ver, int min_ver,
+                            krb5_plugin_vtable vtable)
+{
+    krb5_clpreauth_vtable vt;
+
+    if (maj_ver != 1)
+        return KRB5_PLUGIN_VER_NOTSUPP;
+    vt = (krb5_clpreauth_vtable)vtable;
+    vt->name = "async_test";
+    vt->pa_type_list = pa_types;
+    vt->init = client_init;
+    vt->fini = client_fini;
+    vt->flags = client_flags;
+    vt->process = client_process;
+    vt->gic_opts = client_gic_opt;
+    return 0;
+}
+
+krb5_error_code
+kdcpreauth_async_test_initvt(krb5_context context, int maj_ver, int min_ver,
+                             krb5_plugin_vtable vtable)
+{
+    krb5_kdcpreauth_vtable vt;
+
+    if (maj_ver != 1)
+        return KRB5_PLUGIN_VER_NOTSUPP;
+    vt = (krb5_kdcpreauth_vtable)vtable;
+    vt->name = "async_test";
+    vt->pa_type_list = pa_types;
+    vt->flags = server_flags;
+    vt->edata = server_edata;
+    vt->verify = server_verify;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#!/usr/bin/python
+# Stand-in token server for the async_test preauth module.
+#
+# Usage: token_server.py port token heldfile
+#
+# Each UDP datagram received on 127.0.0.1:port is answered with "ok" if it
+# contains token, and with "no" otherwise.  A datagram beginning with "hold"
+# is checked (without the prefix) but not answered until a "release" datagram
+# arrives; heldfile is created when such a request is received, so that a test
+# can tell that the KDC is waiting for the server.
+
+import socket
+import sys
+
+port, token, heldfile = int(sys.argv[1]), sys.argv[2], sys.argv[3]
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.bind(('127.0.0.1', port))
+sys.stdout.write('token server ready\n')
+sys.stdout.flush()
+
+def answer(msg, addr):
+    if msg == token:
+        sock.sendto(b'ok', addr)
+    else:
+        sock.sendto(b'no', addr)
+
+held = []
+while True:
+    data, addr = sock.recvfrom(1024)
+    msg = data.decode('ascii', 'replace')
+    if msg == 'release':
+        for m, a in held:
+            answer(m, a)
+        held = []
+    elif msg.startswith('hold'):
+        held.append((msg[4:], addr))
+        open(heldfile, 'w').close()
+    else:
+        answer(msg, addr)
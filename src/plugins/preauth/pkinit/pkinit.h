@@ -78,7 +78,9 @@ extern int longhorn;	    /* XXX Talking to a Longhorn server? */
 #define KRB5_CONF_REALMS                        "realms"
 #define KRB5_CONF_PKINIT_ALLOW_UPN              "pkinit_allow_upn"
 #define KRB5_CONF_PKINIT_ANCHORS                "pkinit_anchors"
+#define KRB5_CONF_PKINIT_CERT_CACHE_LIFETIME    "pkinit_cert_cache_lifetime"
 #define KRB5_CONF_PKINIT_CERT_MATCH             "pkinit_cert_match"
+#define KRB5_CONF_PKINIT_DH_KEY_POOL            "pkinit_dh_key_pool"
 #define KRB5_CONF_PKINIT_DH_MIN_BITS            "pkinit_dh_min_bits"
 #define KRB5_CONF_PKINIT_EKU_CHECKING           "pkinit_eku_checking"
 #define KRB5_CONF_PKINIT_IDENTITIES             "pkinit_identities"
@@ -87,6 +89,7 @@ extern int longhorn;	    /* XXX Talking to a Longhorn server? */
 #define KRB5_CONF_PKINIT_KDC_OCSP               "pkinit_kdc_ocsp"
 #define KRB5_CONF_PKINIT_LONGHORN               "pkinit_longhorn"
 #define KRB5_CONF_PKINIT_MAPPING_FILE           "pkinit_mapping_file"
+#define KRB5_CONF_PKINIT_OFFLOAD_THREADS        "pkinit_offload_threads"
 #define KRB5_CONF_PKINIT_POOL                   "pkinit_pool"
 #define KRB5_CONF_PKINIT_REQUIRE_CRL_CHECKING   "pkinit_require_crl_checking"
 #define KRB5_CONF_PKINIT_REVOKE                 "pkinit_revoke"
@@ -163,6 +166,9 @@ typedef struct _pkinit_plg_opts {
     int dh_or_rsa;	    /* selects DH or RSA based pkinit */
     int require_crl_checking; /* require CRL for a CA (default is false) */
     int dh_min_bits;	    /* minimum DH modulus size allowed */
+    int offload_threads;    /* Use KDC helper threads if positive */
+    int dh_key_pool;	    /* pre-generated KDC DH keys per group */
+    int cert_cache_lifetime; /* seconds to trust a verified client chain */
 } pkinit_plg_opts;
 
 /*
@@ -253,6 +259,11 @@ struct _pkinit_kdc_req_context {
     krb5_auth_pack *rcv_auth_pack;
     krb5_auth_pack_draft9 *rcv_auth_pack9;
     krb5_preauthtype pa_type;
+    /* DH reply computed on an offload thread, if any */
+    unsigned char *server_key;
+    unsigned int server_key_len;
+    unsigned char *dh_signed_data;
+    unsigned int dh_signed_data_len;
 };
 typedef struct _pkinit_kdc_req_context *pkinit_kdc_req_context;
 
@@ -114,6 +114,23 @@ void pkinit_fini_plg_crypto(pkinit_plg_crypto_context);
 krb5_error_code pkinit_init_req_crypto(pkinit_req_crypto_context *);
 void pkinit_fini_req_crypto(pkinit_req_crypto_context);
 
+/* Prepare the crypto library for concurrent use by several threads. */
+krb5_error_code pkinit_init_crypto_threads(void);
+
+/*
+ * On the KDC, keep up to nkeys pre-generated DH keys for each well-known
+ * group which clients have used, refilled by a background thread.  Does
+ * nothing if nkeys is 0.
+ */
+krb5_error_code pkinit_init_dh_key_pool(pkinit_plg_crypto_context, int nkeys);
+
+/*
+ * On the KDC, remember successful verifications of client certificate chains
+ * for up to lifetime seconds.  Does nothing if lifetime is 0.
+ */
+krb5_error_code pkinit_init_cert_cache(pkinit_plg_crypto_context,
+                                       int lifetime);
+
 krb5_error_code pkinit_init_identity_crypto(pkinit_identity_crypto_context *);
 void pkinit_fini_identity_crypto(pkinit_identity_crypto_context);
 /**Create a pkinit ContentInfo*/
@@ -899,6 +899,27 @@ pkinit_fini_req_crypto(pkinit_req_crypto_context req_cryptoctx)
     PORT_FreeArena(req_cryptoctx->pool, PR_TRUE);
 }
 
+/* NSS needs no help to be used from several threads. */
+krb5_error_code
+pkinit_init_crypto_threads(void)
+{
+    return 0;
+}
+
+/* Not implemented for NSS; the KDC generates a key for each request. */
+krb5_error_code
+pkinit_init_dh_key_pool(pkinit_plg_crypto_context plg_cryptoctx, int nkeys)
+{
+    return 0;
+}
+
+/* Not implemented for NSS; the KDC verifies every client certificate. */
+krb5_error_code
+pkinit_init_cert_cache(pkinit_plg_crypto_context plg_cryptoctx, int lifetime)
+{
+    return 0;
+}
+
 /* Duplicate the memory from the SECItem into a malloc()d buffer. */
 static int
 secitem_to_buf_len(SECItem *item, unsigned char **out, unsigned int *len)
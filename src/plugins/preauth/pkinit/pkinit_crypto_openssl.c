@@ -39,6 +39,9 @@
 #include <arpa/inet.h>
 
 #include "k5-platform.h"
+#ifdef ENABLE_THREADS
+#include <pthread.h>
+#endif
 
 #include "pkinit_crypto_openssl.h"
 
@@ -50,12 +53,16 @@ static void pkinit_fini_pkinit_oids(pkinit_plg_crypto_context );
 static krb5_error_code pkinit_init_dh_params(pkinit_plg_crypto_context );
 static void pkinit_fini_dh_params(pkinit_plg_crypto_context );
 
+static void fini_dh_key_pool(struct dh_key_pool *pool);
+static void fini_cert_cache(struct cert_cache *cache);
+
 static krb5_error_code pkinit_init_certs(pkinit_identity_crypto_context ctx);
 static void pkinit_fini_certs(pkinit_identity_crypto_context ctx);
 
 static krb5_error_code pkinit_init_pkcs11(pkinit_identity_crypto_context ctx);
 static void pkinit_fini_pkcs11(pkinit_identity_crypto_context ctx);
 
+static DH *dh_group(pkinit_plg_crypto_context plgctx, int i);
 static krb5_error_code pkinit_encode_dh_params
 (BIGNUM *, BIGNUM *, BIGNUM *, unsigned char **, unsigned int *);
 static DH *pkinit_decode_dh_params
@@ -463,6 +470,8 @@ pkinit_fini_plg_crypto(pkinit_plg_crypto_context cryptoctx)
 
     if (cryptoctx == NULL)
         return;
+    fini_dh_key_pool(cryptoctx->dh_key_pool);
+    fini_cert_cache(cryptoctx->cert_cache);
     pkinit_fini_pkinit_oids(cryptoctx);
     pkinit_fini_dh_params(cryptoctx);
     free(cryptoctx);
@@ -551,6 +560,55 @@ pkinit_fini_req_crypto(pkinit_req_crypto_context req_cryptoctx)
     free(req_cryptoctx);
 }
 
+#if defined(ENABLE_THREADS) && OPENSSL_VERSION_NUMBER < 0x10100000L
+static pthread_mutex_t *openssl_locks;
+
+static void
+openssl_lock_cb(int mode, int n, const char *file, int line)
+{
+    if (mode & CRYPTO_LOCK)
+        pthread_mutex_lock(&openssl_locks[n]);
+    else
+        pthread_mutex_unlock(&openssl_locks[n]);
+}
+
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+static unsigned long
+openssl_thread_id_cb(void)
+{
+    return (unsigned long)pthread_self();
+}
+#endif
+
+/* Older versions of OpenSSL need locking callbacks to be used from more than
+ * one thread.  Leave alone any callbacks installed by the application. */
+krb5_error_code
+pkinit_init_crypto_threads(void)
+{
+    int i, n;
+
+    if (CRYPTO_get_locking_callback() != NULL)
+        return 0;
+    n = CRYPTO_num_locks();
+    openssl_locks = calloc(n, sizeof(*openssl_locks));
+    if (openssl_locks == NULL)
+        return ENOMEM;
+    for (i = 0; i < n; i++)
+        pthread_mutex_init(&openssl_locks[i], NULL);
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+    CRYPTO_set_id_callback(openssl_thread_id_cb);
+#endif
+    CRYPTO_set_locking_callback(openssl_lock_cb);
+    return 0;
+}
+#else
+krb5_error_code
+pkinit_init_crypto_threads(void)
+{
+    return 0;
+}
+#endif
+
 static krb5_error_code
 pkinit_init_pkinit_oids(pkinit_plg_crypto_context ctx)
 {
@@ -701,6 +759,10 @@ static krb5_error_code
 pkinit_init_dh_params(pkinit_plg_crypto_context plgctx)
 {
     krb5_error_code retval = ENOMEM;
+    DH *group;
+    unsigned char *der;
+    unsigned int der_len;
+    int i;
 
     plgctx->dh_1024 = DH_new();
     if (plgctx->dh_1024 == NULL)
@@ -735,6 +797,17 @@ pkinit_init_dh_params(pkinit_plg_crypto_context plgctx)
     BN_set_word(plgctx->dh_4096->g, DH_GENERATOR_2);
     BN_rshift1(plgctx->dh_4096->q, plgctx->dh_4096->p);
 
+    /* Remember how the groups are encoded, to recognize them in requests. */
+    for (i = 0; i < 3; i++) {
+        group = dh_group(plgctx, i);
+        retval = pkinit_encode_dh_params(group->p, group->g, group->q, &der,
+                                         &der_len);
+        if (retval)
+            goto cleanup;
+        plgctx->dh_params_der[i].data = (char *)der;
+        plgctx->dh_params_der[i].length = der_len;
+    }
+
     retval = 0;
 
 cleanup:
@@ -747,6 +820,13 @@ cleanup:
 static void
 pkinit_fini_dh_params(pkinit_plg_crypto_context plgctx)
 {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        free(plgctx->dh_params_der[i].data);
+        plgctx->dh_params_der[i].data = NULL;
+        plgctx->dh_params_der[i].length = 0;
+    }
     if (plgctx->dh_1024 != NULL)
         DH_free(plgctx->dh_1024);
     if (plgctx->dh_2048 != NULL)
@@ -757,6 +837,353 @@ pkinit_fini_dh_params(pkinit_plg_crypto_context plgctx)
     plgctx->dh_1024 = plgctx->dh_2048 = plgctx->dh_4096 = NULL;
 }
 
+/* Return well-known group i (0 to 2) of plgctx. */
+static DH *
+dh_group(pkinit_plg_crypto_context plgctx, int i)
+{
+    if (i == 0)
+        return plgctx->dh_1024;
+    return (i == 1) ? plgctx->dh_2048 : plgctx->dh_4096;
+}
+
+/* Return the index of the well-known group with the same prime as dh, or
+ * -1. */
+static int
+dh_group_index(pkinit_plg_crypto_context plgctx, DH *dh)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (BN_cmp(dh->p, dh_group(plgctx, i)->p) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Return a new DH object with the parameters of params and no key. */
+static DH *
+dup_dh_params(DH *params)
+{
+    DH *dh;
+
+    dh = DH_new();
+    if (dh == NULL)
+        return NULL;
+    dh->p = BN_dup(params->p);
+    dh->g = BN_dup(params->g);
+    dh->q = BN_dup(params->q);
+    if (dh->p == NULL || dh->g == NULL || dh->q == NULL) {
+        DH_free(dh);
+        return NULL;
+    }
+    return dh;
+}
+
+#ifdef ENABLE_THREADS
+
+/*
+ * Generating the KDC's DH key costs as much as computing the shared secret.
+ * If pkinit_dh_key_pool is set, a thread generates keys ahead of time for
+ * each well-known group which clients have used.  Each key is used for only
+ * one reply.  The thread is started when first needed, so that it runs in
+ * the process using it if the KDC forks worker processes.
+ */
+struct dh_key_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pkinit_plg_crypto_context plgctx;
+    int size;                   /* Keys to keep for each group */
+    DH **keys[3];
+    int nkeys[3];
+    int wanted[3];              /* Set once a client has used the group */
+    int started;
+    int shutdown;
+    pthread_t thread;
+};
+
+static void *
+dh_key_pool_thread(void *arg)
+{
+    struct dh_key_pool *pool = arg;
+    DH *dh;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->shutdown) {
+        for (i = 0; i < 3; i++) {
+            if (pool->wanted[i] && pool->nkeys[i] < pool->size)
+                break;
+        }
+        if (i == 3) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        dh = dup_dh_params(dh_group(pool->plgctx, i));
+        if (dh != NULL && !DH_generate_key(dh)) {
+            DH_free(dh);
+            dh = NULL;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (dh == NULL) {
+            /* Stop filling this group; requests will generate their own
+             * keys and report any errors. */
+            pool->wanted[i] = 0;
+            continue;
+        }
+        pool->keys[i][pool->nkeys[i]++] = dh;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+krb5_error_code
+pkinit_init_dh_key_pool(pkinit_plg_crypto_context plgctx, int nkeys)
+{
+    struct dh_key_pool *pool;
+    krb5_error_code ret;
+    int i;
+
+    if (nkeys <= 0 || plgctx->dh_key_pool != NULL)
+        return 0;
+    /* The refill thread uses OpenSSL alongside the KDC's thread. */
+    ret = pkinit_init_crypto_threads();
+    if (ret)
+        return ret;
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL)
+        return ENOMEM;
+    for (i = 0; i < 3; i++) {
+        pool->keys[i] = calloc(nkeys, sizeof(*pool->keys[i]));
+        if (pool->keys[i] == NULL) {
+            while (--i >= 0)
+                free(pool->keys[i]);
+            free(pool);
+            return ENOMEM;
+        }
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->plgctx = plgctx;
+    pool->size = nkeys;
+    plgctx->dh_key_pool = pool;
+    return 0;
+}
+
+/* Return a pre-generated key for well-known group i, or NULL if none is
+ * ready.  Ask for more keys for the group either way. */
+static DH *
+take_dh_key(pkinit_plg_crypto_context plgctx, int i)
+{
+    struct dh_key_pool *pool = plgctx->dh_key_pool;
+    DH *dh = NULL;
+
+    if (pool == NULL || i < 0)
+        return NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->started && !pool->shutdown) {
+        if (pthread_create(&pool->thread, NULL, dh_key_pool_thread,
+                           pool) == 0)
+            pool->started = 1;
+        else
+            pool->shutdown = 1;
+    }
+    if (pool->nkeys[i] > 0)
+        dh = pool->keys[i][--pool->nkeys[i]];
+    pool->wanted[i] = 1;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return dh;
+}
+
+static void
+fini_dh_key_pool(struct dh_key_pool *pool)
+{
+    int i, j;
+
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    if (pool->started)
+        pthread_join(pool->thread, NULL);
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < pool->nkeys[i]; j++)
+            DH_free(pool->keys[i][j]);
+        free(pool->keys[i]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    free(pool);
+}
+
+#else /* !ENABLE_THREADS */
+
+krb5_error_code
+pkinit_init_dh_key_pool(pkinit_plg_crypto_context plgctx, int nkeys)
+{
+    return 0;
+}
+
+static DH *
+take_dh_key(pkinit_plg_crypto_context plgctx, int i)
+{
+    return NULL;
+}
+
+static void
+fini_dh_key_pool(struct dh_key_pool *pool)
+{
+}
+
+#endif /* !ENABLE_THREADS */
+
+/*
+ * If pkinit_cert_cache_lifetime is set, the KDC remembers the chains of
+ * client certificates it has verified, keyed by the SHA-256 digest of the
+ * client certificate, for up to that many seconds.  A request signed by a
+ * remembered certificate skips chain building and verification, unless it
+ * carries its own CRLs or a certificate in the chain is no longer within its
+ * validity period.  The signature itself is always verified.  The trust
+ * anchors, intermediates and CRLs configured for the KDC do not change while
+ * it runs, so they cannot invalidate an entry.
+ */
+#define CERT_CACHE_SIZE 256
+
+struct cert_cache_entry {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    STACK_OF(X509) *chain;      /* Verified chain, client certificate first */
+    time_t expires;
+};
+
+struct cert_cache {
+    k5_mutex_t lock;
+    int lifetime;
+    struct cert_cache_entry entries[CERT_CACHE_SIZE];
+};
+
+krb5_error_code
+pkinit_init_cert_cache(pkinit_plg_crypto_context plgctx, int lifetime)
+{
+    struct cert_cache *cache;
+    krb5_error_code retval;
+
+    if (lifetime <= 0 || plgctx->cert_cache != NULL)
+        return 0;
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+        return ENOMEM;
+    retval = k5_mutex_init(&cache->lock);
+    if (retval) {
+        free(cache);
+        return retval;
+    }
+    cache->lifetime = lifetime;
+    plgctx->cert_cache = cache;
+    return 0;
+}
+
+static void
+fini_cert_cache(struct cert_cache *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < CERT_CACHE_SIZE; i++) {
+        if (cache->entries[i].chain != NULL)
+            sk_X509_pop_free(cache->entries[i].chain, X509_free);
+    }
+    k5_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/* Return true if every certificate in chain is within its validity period. */
+static int
+chain_is_current(STACK_OF(X509) *chain)
+{
+    X509 *cert;
+    int i;
+
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        cert = sk_X509_value(chain, i);
+        if (X509_cmp_current_time(X509_get_notBefore(cert)) >= 0 ||
+            X509_cmp_current_time(X509_get_notAfter(cert)) <= 0)
+            return 0;
+    }
+    return 1;
+}
+
+/* Return a copy of chain holding its own references to the certificates.
+ * With OpenSSL before 1.1, CRYPTO_add relies on the locking callbacks
+ * installed by pkinit_init_crypto_threads() whenever another thread (a KDC
+ * helper thread or the DH key pool thread) may be using OpenSSL. */
+static STACK_OF(X509) *
+copy_chain(STACK_OF(X509) *chain)
+{
+    STACK_OF(X509) *copy;
+    int i;
+
+    copy = sk_X509_dup(chain);
+    if (copy == NULL)
+        return NULL;
+    for (i = 0; i < sk_X509_num(copy); i++)
+        CRYPTO_add(&sk_X509_value(copy, i)->references, 1, CRYPTO_LOCK_X509);
+    return copy;
+}
+
+/* If the chain of cert was verified recently, return a copy of the verified
+ * chain.  Otherwise return NULL. */
+static STACK_OF(X509) *
+cert_cache_lookup(struct cert_cache *cache, X509 *cert)
+{
+    struct cert_cache_entry *ent;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned int len;
+    STACK_OF(X509) *chain = NULL;
+
+    if (cache == NULL || !X509_digest(cert, EVP_sha256(), digest, &len))
+        return NULL;
+    if (k5_mutex_lock(&cache->lock) != 0)
+        return NULL;
+    ent = &cache->entries[digest[0] % CERT_CACHE_SIZE];
+    if (ent->chain != NULL && time(NULL) < ent->expires &&
+        memcmp(ent->digest, digest, sizeof(digest)) == 0 &&
+        chain_is_current(ent->chain))
+        chain = copy_chain(ent->chain);
+    k5_mutex_unlock(&cache->lock);
+    return chain;
+}
+
+/* Remember that chain, which begins with cert, has been verified.  Takes
+ * ownership of chain. */
+static void
+cert_cache_add(struct cert_cache *cache, X509 *cert, STACK_OF(X509) *chain)
+{
+    struct cert_cache_entry *ent;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned int len;
+
+    if (cache == NULL || chain == NULL ||
+        !X509_digest(cert, EVP_sha256(), digest, &len) ||
+        k5_mutex_lock(&cache->lock) != 0) {
+        if (chain != NULL)
+            sk_X509_pop_free(chain, X509_free);
+        return;
+    }
+    ent = &cache->entries[digest[0] % CERT_CACHE_SIZE];
+    if (ent->chain != NULL)
+        sk_X509_pop_free(ent->chain, X509_free);
+    memcpy(ent->digest, digest, sizeof(digest));
+    ent->chain = chain;
+    ent->expires = time(NULL) + cache->lifetime;
+    k5_mutex_unlock(&cache->lock);
+}
+
 static krb5_error_code
 pkinit_init_certs(pkinit_identity_crypto_context ctx)
 {
@@ -1302,7 +1729,7 @@ cms_signeddata_verify(krb5_context context,
     CMS_ContentInfo *cms = NULL;
     BIO *out = NULL;
     int flags = CMS_NO_SIGNER_CERT_VERIFY;
-    int valid_oid = 0;
+    int valid_oid = 0, use_cache;
     unsigned int i = 0;
     unsigned int vflags = 0, size = 0;
     const unsigned char *p = signed_data;
@@ -1452,96 +1879,109 @@ cms_signeddata_verify(krb5_context context,
             }
         }
 
-        /* initialize x509 context with the received certificate and
-         * trusted and intermediate CA chains and CRLs
-         */
-        if (!X509_STORE_CTX_init(&cert_ctx, store, x, intermediateCAs))
-            goto cleanup;
+        /* Skip verifying the chain if it was verified recently. */
+        use_cache = (cms_msg_type == CMS_SIGN_CLIENT ||
+                     cms_msg_type == CMS_SIGN_DRAFT9) &&
+            plgctx->cert_cache != NULL && signerRevoked == NULL;
+        if (use_cache)
+            verified_chain = cert_cache_lookup(plgctx->cert_cache, x);
+        if (verified_chain != NULL) {
+            pkiDebug("signer certificate chain verified recently\n");
+        } else {
+            /* initialize x509 context with the received certificate and
+             * trusted and intermediate CA chains and CRLs
+             */
+            if (!X509_STORE_CTX_init(&cert_ctx, store, x, intermediateCAs))
+                goto cleanup;
 
-        X509_STORE_CTX_set0_crls(&cert_ctx, revoked);
+            X509_STORE_CTX_set0_crls(&cert_ctx, revoked);
 
-        /* add trusted CAs certificates for cert verification */
-        if (idctx->trustedCAs != NULL)
-            X509_STORE_CTX_trusted_stack(&cert_ctx, idctx->trustedCAs);
-        else {
-            pkiDebug("unable to find any trusted CAs\n");
-            goto cleanup;
-        }
+            /* add trusted CAs certificates for cert verification */
+            if (idctx->trustedCAs != NULL)
+                X509_STORE_CTX_trusted_stack(&cert_ctx, idctx->trustedCAs);
+            else {
+                pkiDebug("unable to find any trusted CAs\n");
+                goto cleanup;
+            }
 #ifdef DEBUG_CERTCHAIN
-        if (intermediateCAs != NULL) {
-            size = sk_X509_num(intermediateCAs);
-            pkiDebug("untrusted cert chain of size %d\n", size);
-            for (i = 0; i < size; i++) {
-                X509_NAME_oneline(X509_get_subject_name(
-                                      sk_X509_value(intermediateCAs, i)), buf, sizeof(buf));
-                pkiDebug("cert #%d: %s\n", i, buf);
+            if (intermediateCAs != NULL) {
+                size = sk_X509_num(intermediateCAs);
+                pkiDebug("untrusted cert chain of size %d\n", size);
+                for (i = 0; i < size; i++) {
+                    X509_NAME_oneline(X509_get_subject_name(
+                                          sk_X509_value(intermediateCAs, i)), buf, sizeof(buf));
+                    pkiDebug("cert #%d: %s\n", i, buf);
+                }
             }
-        }
-        if (idctx->trustedCAs != NULL) {
-            size = sk_X509_num(idctx->trustedCAs);
-            pkiDebug("trusted cert chain of size %d\n", size);
-            for (i = 0; i < size; i++) {
-                X509_NAME_oneline(X509_get_subject_name(
-                                      sk_X509_value(idctx->trustedCAs, i)), buf, sizeof(buf));
-                pkiDebug("cert #%d: %s\n", i, buf);
+            if (idctx->trustedCAs != NULL) {
+                size = sk_X509_num(idctx->trustedCAs);
+                pkiDebug("trusted cert chain of size %d\n", size);
+                for (i = 0; i < size; i++) {
+                    X509_NAME_oneline(X509_get_subject_name(
+                                          sk_X509_value(idctx->trustedCAs, i)), buf, sizeof(buf));
+                    pkiDebug("cert #%d: %s\n", i, buf);
+                }
             }
-        }
-        if (revoked != NULL) {
-            size = sk_X509_CRL_num(revoked);
-            pkiDebug("CRL chain of size %d\n", size);
-            for (i = 0; i < size; i++) {
-                X509_CRL *crl = sk_X509_CRL_value(revoked, i);
-                X509_NAME_oneline(X509_CRL_get_issuer(crl), buf, sizeof(buf));
-                pkiDebug("crls by CA #%d: %s\n", i , buf);
+            if (revoked != NULL) {
+                size = sk_X509_CRL_num(revoked);
+                pkiDebug("CRL chain of size %d\n", size);
+                for (i = 0; i < size; i++) {
+                    X509_CRL *crl = sk_X509_CRL_value(revoked, i);
+                    X509_NAME_oneline(X509_CRL_get_issuer(crl), buf, sizeof(buf));
+                    pkiDebug("crls by CA #%d: %s\n", i , buf);
+                }
             }
-        }
 #endif
 
-        i = X509_verify_cert(&cert_ctx);
-        if (i <= 0) {
-            int j = X509_STORE_CTX_get_error(&cert_ctx);
+            i = X509_verify_cert(&cert_ctx);
+            if (i <= 0) {
+                int j = X509_STORE_CTX_get_error(&cert_ctx);
 
-            reqctx->received_cert = X509_dup(cert_ctx.current_cert);
-            switch(j) {
-            case X509_V_ERR_CERT_REVOKED:
-                retval = KRB5KDC_ERR_REVOKED_CERTIFICATE;
-                break;
-            case X509_V_ERR_UNABLE_TO_GET_CRL:
-                retval = KRB5KDC_ERR_REVOCATION_STATUS_UNKNOWN;
-                break;
-            case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT:
-            case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY:
-                retval = KRB5KDC_ERR_CANT_VERIFY_CERTIFICATE;
-                break;
-            default:
-                retval = KRB5KDC_ERR_INVALID_CERTIFICATE;
-            }
-            if (reqctx->received_cert == NULL)
-                strlcpy(buf, "(none)", sizeof(buf));
-            else
-                X509_NAME_oneline(X509_get_subject_name(reqctx->received_cert),
-                                  buf, sizeof(buf));
-            pkiDebug("problem with cert DN = %s (error=%d) %s\n", buf, j,
-                     X509_verify_cert_error_string(j));
-            krb5_set_error_message(context, retval, "%s\n",
-                                   X509_verify_cert_error_string(j));
+                reqctx->received_cert = X509_dup(cert_ctx.current_cert);
+                switch(j) {
+                case X509_V_ERR_CERT_REVOKED:
+                    retval = KRB5KDC_ERR_REVOKED_CERTIFICATE;
+                    break;
+                case X509_V_ERR_UNABLE_TO_GET_CRL:
+                    retval = KRB5KDC_ERR_REVOCATION_STATUS_UNKNOWN;
+                    break;
+                case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT:
+                case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY:
+                    retval = KRB5KDC_ERR_CANT_VERIFY_CERTIFICATE;
+                    break;
+                default:
+                    retval = KRB5KDC_ERR_INVALID_CERTIFICATE;
+                }
+                if (reqctx->received_cert == NULL)
+                    strlcpy(buf, "(none)", sizeof(buf));
+                else
+                    X509_NAME_oneline(X509_get_subject_name(reqctx->received_cert),
+                                      buf, sizeof(buf));
+                pkiDebug("problem with cert DN = %s (error=%d) %s\n", buf, j,
+                         X509_verify_cert_error_string(j));
+                krb5_set_error_message(context, retval, "%s\n",
+                                       X509_verify_cert_error_string(j));
 #ifdef DEBUG_CERTCHAIN
-            size = sk_X509_num(signerCerts);
-            pkiDebug("received cert chain of size %d\n", size);
-            for (j = 0; j < size; j++) {
-                X509 *tmp_cert = sk_X509_value(signerCerts, j);
-                X509_NAME_oneline(X509_get_subject_name(tmp_cert), buf, sizeof(buf));
-                pkiDebug("cert #%d: %s\n", j, buf);
-            }
+                size = sk_X509_num(signerCerts);
+                pkiDebug("received cert chain of size %d\n", size);
+                for (j = 0; j < size; j++) {
+                    X509 *tmp_cert = sk_X509_value(signerCerts, j);
+                    X509_NAME_oneline(X509_get_subject_name(tmp_cert), buf, sizeof(buf));
+                    pkiDebug("cert #%d: %s\n", j, buf);
+                }
 #endif
-        } else {
-            /* retrieve verified certificate chain */
-            if (cms_msg_type == CMS_SIGN_CLIENT || cms_msg_type == CMS_SIGN_DRAFT9)
-                verified_chain = X509_STORE_CTX_get1_chain(&cert_ctx);
+            } else {
+                /* retrieve verified certificate chain */
+                if (cms_msg_type == CMS_SIGN_CLIENT || cms_msg_type == CMS_SIGN_DRAFT9)
+                    verified_chain = X509_STORE_CTX_get1_chain(&cert_ctx);
+                if (use_cache)
+                    cert_cache_add(plgctx->cert_cache, x,
+                                   X509_STORE_CTX_get1_chain(&cert_ctx));
+            }
+            X509_STORE_CTX_cleanup(&cert_ctx);
+            if (i <= 0)
+                goto cleanup;
         }
-        X509_STORE_CTX_cleanup(&cert_ctx);
-        if (i <= 0)
-            goto cleanup;
         out = BIO_new(BIO_s_mem());
         if (cms_msg_type == CMS_SIGN_DRAFT9)
             flags |= CMS_NOATTR;
@@ -2691,15 +3131,31 @@ server_check_dh(krb5_context context,
 {
     DH *dh = NULL;
     unsigned char *tmp = NULL;
-    int dh_prime_bits;
+    int dh_prime_bits, i;
     krb5_error_code retval = KRB5KDC_ERR_DH_KEY_PARAMETERS_NOT_ACCEPTED;
 
-    tmp = (unsigned char *)dh_params->data;
-    dh = DH_new();
-    dh = pkinit_decode_dh_params(&dh, &tmp, dh_params->length);
-    if (dh == NULL) {
-        pkiDebug("failed to decode dhparams\n");
-        goto cleanup;
+    /* Clients usually send one of the well-known groups, encoded just as we
+     * would encode it; recognize those without decoding them. */
+    for (i = 0; i < 3; i++) {
+        if (dh_params->length == cryptoctx->dh_params_der[i].length &&
+            memcmp(dh_params->data, cryptoctx->dh_params_der[i].data,
+                   dh_params->length) == 0)
+            break;
+    }
+    if (i < 3) {
+        dh = dup_dh_params(dh_group(cryptoctx, i));
+        if (dh == NULL) {
+            retval = ENOMEM;
+            goto cleanup;
+        }
+    } else {
+        tmp = (unsigned char *)dh_params->data;
+        dh = DH_new();
+        dh = pkinit_decode_dh_params(&dh, &tmp, dh_params->length);
+        if (dh == NULL) {
+            pkiDebug("failed to decode dhparams\n");
+            goto cleanup;
+        }
     }
 
     /* KDC SHOULD check to see if the key parameters satisfy its policy */
@@ -2709,6 +3165,10 @@ server_check_dh(krb5_context context,
                  dh_prime_bits, minbits);
         goto cleanup;
     }
+    if (i < 3) {
+        retval = 0;
+        goto cleanup;
+    }
 
     /* check dhparams is group 2 */
     if (pkinit_check_dh_params(cryptoctx->dh_1024->p,
@@ -2764,12 +3224,16 @@ server_process_dh(krb5_context context,
     /* get client's received DH parameters that we saved in server_check_dh */
     dh = cryptoctx->dh;
 
-    dh_server = DH_new();
-    if (dh_server == NULL)
-        goto cleanup;
-    dh_server->p = BN_dup(dh->p);
-    dh_server->g = BN_dup(dh->g);
-    dh_server->q = BN_dup(dh->q);
+    /* Use a pre-generated key if one is ready. */
+    dh_server = take_dh_key(plg_cryptoctx, dh_group_index(plg_cryptoctx, dh));
+    if (dh_server == NULL) {
+        dh_server = DH_new();
+        if (dh_server == NULL)
+            goto cleanup;
+        dh_server->p = BN_dup(dh->p);
+        dh_server->g = BN_dup(dh->g);
+        dh_server->q = BN_dup(dh->q);
+    }
 
     /* decode client's public key */
     p = data;
@@ -2781,7 +3245,7 @@ server_process_dh(krb5_context context,
         goto cleanup;
     ASN1_INTEGER_free(pub_key);
 
-    if (!DH_generate_key(dh_server))
+    if (dh_server->pub_key == NULL && !DH_generate_key(dh_server))
         goto cleanup;
 
     /* generate DH session key */
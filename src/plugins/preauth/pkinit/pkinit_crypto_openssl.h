@@ -90,6 +90,9 @@ struct _pkinit_plg_crypto_context {
     DH *dh_1024;
     DH *dh_2048;
     DH *dh_4096;
+    krb5_data dh_params_der[3];         /* Encodings of the groups above */
+    struct dh_key_pool *dh_key_pool;    /* Pre-generated KDC DH keys */
+    struct cert_cache *cert_cache;      /* Verified client cert chains */
     ASN1_OBJECT *id_pkinit_authData;
     ASN1_OBJECT *id_pkinit_authData9;
     ASN1_OBJECT *id_pkinit_DHKeyData;
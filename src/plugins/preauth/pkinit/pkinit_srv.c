@@ -276,17 +276,17 @@ out:
     return retval;
 }
 
-static void
-pkinit_server_verify_padata(krb5_context context,
-                            krb5_data *req_pkt,
-                            krb5_kdc_req * request,
-                            krb5_enc_tkt_part * enc_tkt_reply,
-                            krb5_pa_data * data,
-                            krb5_kdcpreauth_callbacks cb,
-                            krb5_kdcpreauth_rock rock,
-                            krb5_kdcpreauth_moddata moddata,
-                            krb5_kdcpreauth_verify_respond_fn respond,
-                            void *arg)
+/*
+ * Verify the PKINIT padata in data.  On success, return a request context
+ * for pkinit_server_return_padata() in *reqctx_out; on failure, possibly
+ * return e-data in *e_data_out.  This may run on a KDC helper thread, so it
+ * must not use the KDC callbacks or modify the request.
+ */
+static krb5_error_code
+verify_request(krb5_context context, krb5_data *req_pkt,
+               krb5_kdc_req *request, krb5_pa_data *data, krb5_data *der_req,
+               pkinit_kdc_context plgctx, pkinit_kdc_req_context *reqctx_out,
+               krb5_pa_data ***e_data_out)
 {
     krb5_error_code retval = 0;
     krb5_data authp_data = {0, 0, NULL}, krb5_authz = {0, 0, NULL};
@@ -294,34 +294,16 @@ pkinit_server_verify_padata(krb5_context context,
     krb5_pa_pk_as_req_draft9 *reqp9 = NULL;
     krb5_auth_pack *auth_pack = NULL;
     krb5_auth_pack_draft9 *auth_pack9 = NULL;
-    pkinit_kdc_context plgctx = NULL;
     pkinit_kdc_req_context reqctx = NULL;
     krb5_checksum cksum = {0, 0, 0, NULL};
-    krb5_data *der_req = NULL;
     int valid_eku = 0, valid_san = 0;
     krb5_kdc_req *tmp_as_req = NULL;
     krb5_data k5data;
     int is_signed = 1;
     krb5_pa_data **e_data = NULL;
-    krb5_kdcpreauth_modreq modreq = NULL;
 
-    pkiDebug("pkinit_verify_padata: entered!\n");
-    if (data == NULL || data->length <= 0 || data->contents == NULL) {
-        (*respond)(arg, 0, NULL, NULL, NULL);
-        return;
-    }
-
-
-    if (moddata == NULL) {
-        (*respond)(arg, EINVAL, NULL, NULL, NULL);
-        return;
-    }
-
-    plgctx = pkinit_find_realm_context(context, moddata, request->server);
-    if (plgctx == NULL) {
-        (*respond)(arg, 0, NULL, NULL, NULL);
-        return;
-    }
+    *reqctx_out = NULL;
+    *e_data_out = NULL;
 
 #ifdef DEBUG_ASN1
     print_buffer_bin(data->contents, data->length, "/tmp/kdc_as_req");
@@ -454,7 +436,6 @@ pkinit_server_verify_padata(krb5_context context,
                                      "value not supported."));
             goto cleanup;
         }
-        der_req = cb->request_body(context, rock);
         retval = krb5_c_make_checksum(context, CKSUMTYPE_NIST_SHA, NULL,
                                       0, der_req, &cksum);
         if (retval) {
@@ -526,9 +507,7 @@ pkinit_server_verify_padata(krb5_context context,
         break;
     }
 
-    /* remember to set the PREAUTH flag in the reply */
-    enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH;
-    modreq = (krb5_kdcpreauth_modreq)reqctx;
+    *reqctx_out = reqctx;
     reqctx = NULL;
 
 cleanup:
@@ -559,8 +538,198 @@ cleanup:
     if (auth_pack9 != NULL)
         free_krb5_auth_pack_draft9(context, &auth_pack9);
 
-    (*respond)(arg, retval, modreq, e_data, NULL);
+    *e_data_out = e_data;
+    return retval;
+}
+
+/*
+ * Perform the DH key agreement for an RFC 4556 request and sign the KDC's
+ * public value, saving the results in reqctx for
+ * pkinit_server_return_padata().
+ */
+static krb5_error_code
+precompute_dh_reply(krb5_context context, pkinit_kdc_context plgctx,
+                    pkinit_kdc_req_context reqctx, krb5_kdc_req *request)
+{
+    krb5_error_code retval;
+    krb5_subject_pk_info *client_pk = reqctx->rcv_auth_pack->clientPublicValue;
+    krb5_kdc_dh_key_info dhkey_info;
+    krb5_data *encoded_dhkey_info = NULL;
+    unsigned char *dh_pubkey = NULL;
+    unsigned int dh_pubkey_len = 0;
+
+    retval = server_process_dh(context, plgctx->cryptoctx, reqctx->cryptoctx,
+                               plgctx->idctx, (unsigned char *)
+                               client_pk->subjectPublicKey.data,
+                               client_pk->subjectPublicKey.length,
+                               &dh_pubkey, &dh_pubkey_len,
+                               &reqctx->server_key, &reqctx->server_key_len);
+    if (retval)
+        goto cleanup;
+
+    dhkey_info.subjectPublicKey.length = dh_pubkey_len;
+    dhkey_info.subjectPublicKey.data = (char *)dh_pubkey;
+    dhkey_info.nonce = request->nonce;
+    dhkey_info.dhKeyExpiration = 0;
+    retval = k5int_encode_krb5_kdc_dh_key_info(&dhkey_info,
+                                               &encoded_dhkey_info);
+    if (retval)
+        goto cleanup;
+
+    retval = cms_signeddata_create(context, plgctx->cryptoctx,
+                                   reqctx->cryptoctx, plgctx->idctx,
+                                   CMS_SIGN_SERVER, 1, (unsigned char *)
+                                   encoded_dhkey_info->data,
+                                   encoded_dhkey_info->length,
+                                   &reqctx->dh_signed_data,
+                                   &reqctx->dh_signed_data_len);
+
+cleanup:
+    if (retval) {
+        free(reqctx->server_key);
+        reqctx->server_key = NULL;
+        reqctx->server_key_len = 0;
+    }
+    free(dh_pubkey);
+    krb5_free_data(context, encoded_dhkey_info);
+    return retval;
+}
+
+/* State for a verification running on a KDC helper thread. */
+struct verify_state {
+    krb5_data *req_pkt;
+    krb5_kdc_req *request;
+    krb5_enc_tkt_part *enc_tkt_reply;
+    krb5_pa_data *data;
+    krb5_data *der_req;
+    pkinit_kdc_context plgctx;
+    krb5_kdcpreauth_verify_respond_fn respond;
+    void *arg;
+
+    /* Results of the verification */
+    krb5_error_code retval;
+    char *errmsg;
+    pkinit_kdc_req_context reqctx;
+    krb5_pa_data **e_data;
+};
+
+/* Verify the request on a KDC helper thread.  If it will use DH, also do
+ * the key agreement and reply signing here, as they are at least as
+ * costly. */
+static void
+verify_work(krb5_context context, void *arg)
+{
+    struct verify_state *state = arg;
+    pkinit_kdc_req_context reqctx;
+    const char *msg;
+
+    (void)krb5_set_default_realm(context, state->plgctx->realmname);
+    state->retval = verify_request(context, state->req_pkt, state->request,
+                                   state->data, state->der_req, state->plgctx,
+                                   &state->reqctx, &state->e_data);
+    if (state->retval) {
+        msg = krb5_get_error_message(context, state->retval);
+        state->errmsg = strdup(msg);
+        krb5_free_error_message(context, msg);
+        return;
+    }
+
+    /* If this fails, pkinit_server_return_padata() will try again and
+     * report the error. */
+    reqctx = state->reqctx;
+    if (reqctx->rcv_auth_pack != NULL &&
+        reqctx->rcv_auth_pack->clientPublicValue != NULL)
+        (void)precompute_dh_reply(context, state->plgctx, reqctx,
+                                  state->request);
+}
+
+/* Deliver the result of an offloaded verification on the KDC's thread. */
+static void
+verify_done(krb5_context context, void *arg)
+{
+    struct verify_state *state = arg;
+
+    if (state->retval == 0) {
+        /* remember to set the PREAUTH flag in the reply */
+        state->enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH;
+    } else if (state->errmsg != NULL) {
+        krb5_set_error_message(context, state->retval, "%s", state->errmsg);
+    }
+    (*state->respond)(state->arg, state->retval,
+                      (krb5_kdcpreauth_modreq)state->reqctx, state->e_data,
+                      NULL);
+    free(state->errmsg);
+    free(state);
+}
+
+static void
+pkinit_server_verify_padata(krb5_context context,
+                            krb5_data *req_pkt,
+                            krb5_kdc_req * request,
+                            krb5_enc_tkt_part * enc_tkt_reply,
+                            krb5_pa_data * data,
+                            krb5_kdcpreauth_callbacks cb,
+                            krb5_kdcpreauth_rock rock,
+                            krb5_kdcpreauth_moddata moddata,
+                            krb5_kdcpreauth_verify_respond_fn respond,
+                            void *arg)
+{
+    krb5_error_code retval;
+    pkinit_kdc_context plgctx = NULL;
+    pkinit_kdc_req_context reqctx = NULL;
+    krb5_pa_data **e_data = NULL;
+    krb5_data *der_req;
+    struct verify_state *state;
+
+    pkiDebug("pkinit_verify_padata: entered!\n");
+    if (data == NULL || data->length <= 0 || data->contents == NULL) {
+        (*respond)(arg, 0, NULL, NULL, NULL);
+        return;
+    }
+
+
+    if (moddata == NULL) {
+        (*respond)(arg, EINVAL, NULL, NULL, NULL);
+        return;
+    }
+
+    plgctx = pkinit_find_realm_context(context, moddata, request->server);
+    if (plgctx == NULL) {
+        (*respond)(arg, 0, NULL, NULL, NULL);
+        return;
+    }
+
+    der_req = cb->request_body(context, rock);
+
+    /* If possible, do the verification on a KDC helper thread so that the
+     * KDC can process other requests in the meantime. */
+    if (plgctx->opts->offload_threads > 0 && cb->vers >= 2) {
+        state = calloc(1, sizeof(*state));
+        if (state != NULL) {
+            state->req_pkt = req_pkt;
+            state->request = request;
+            state->enc_tkt_reply = enc_tkt_reply;
+            state->data = data;
+            state->der_req = der_req;
+            state->plgctx = plgctx;
+            state->respond = respond;
+            state->arg = arg;
+            if (cb->offload(context, rock, verify_work, verify_done,
+                            state) == 0)
+                return;
+            free(state);
+        }
+    }
+
+    retval = verify_request(context, req_pkt, request, data, der_req, plgctx,
+                            &reqctx, &e_data);
+    if (retval == 0) {
+        /* remember to set the PREAUTH flag in the reply */
+        enc_tkt_reply->flags |= TKT_FLG_PRE_AUTH;
+    }
+    (*respond)(arg, retval, (krb5_kdcpreauth_modreq)reqctx, e_data, NULL);
 }
+
 static krb5_error_code
 return_pkinit_kx(krb5_context context, krb5_kdc_req *request,
                  krb5_kdc_rep *reply, krb5_keyblock *encrypting_key,
@@ -791,18 +960,32 @@ pkinit_server_return_padata(krb5_context context,
     if (rep != NULL && (rep->choice == choice_pa_pk_as_rep_dhInfo ||
                         rep->choice == choice_pa_pk_as_rep_draft9_dhSignedData)) {
         pkiDebug("received DH key delivery AS REQ\n");
-        retval = server_process_dh(context, plgctx->cryptoctx,
-                                   reqctx->cryptoctx, plgctx->idctx, subjectPublicKey,
-                                   subjectPublicKey_len, &dh_pubkey, &dh_pubkey_len,
-                                   &server_key, &server_key_len);
-        if (retval) {
-            pkiDebug("failed to process/create dh paramters\n");
-            goto cleanup;
+        if (reqctx->dh_signed_data != NULL) {
+            /* The reply was computed on a KDC helper thread. */
+            server_key = reqctx->server_key;
+            server_key_len = reqctx->server_key_len;
+            reqctx->server_key = NULL;
+            rep->u.dh_Info.dhSignedData.data = (char *)reqctx->dh_signed_data;
+            rep->u.dh_Info.dhSignedData.length = reqctx->dh_signed_data_len;
+            reqctx->dh_signed_data = NULL;
+        } else {
+            retval = server_process_dh(context, plgctx->cryptoctx,
+                                       reqctx->cryptoctx, plgctx->idctx,
+                                       subjectPublicKey, subjectPublicKey_len,
+                                       &dh_pubkey, &dh_pubkey_len,
+                                       &server_key, &server_key_len);
+            if (retval) {
+                pkiDebug("failed to process/create dh paramters\n");
+                goto cleanup;
+            }
         }
     }
-    if ((rep9 != NULL &&
-         rep9->choice == choice_pa_pk_as_rep_draft9_dhSignedData) ||
-        (rep != NULL && rep->choice == choice_pa_pk_as_rep_dhInfo)) {
+    if (rep != NULL && rep->choice == choice_pa_pk_as_rep_dhInfo &&
+        rep->u.dh_Info.dhSignedData.data != NULL) {
+        pkiDebug("using DH reply signed on a KDC helper thread\n");
+    } else if ((rep9 != NULL &&
+                rep9->choice == choice_pa_pk_as_rep_draft9_dhSignedData) ||
+               (rep != NULL && rep->choice == choice_pa_pk_as_rep_dhInfo)) {
 
         /*
          * This is DH, so don't generate the key until after we
@@ -1195,6 +1378,18 @@ pkinit_init_kdc_profile(krb5_context context, pkinit_kdc_context plgctx)
         plgctx->opts->dh_min_bits = PKINIT_DEFAULT_DH_MIN_BITS;
     }
 
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_OFFLOAD_THREADS, 0,
+                              &plgctx->opts->offload_threads);
+
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_DH_KEY_POOL, 0,
+                              &plgctx->opts->dh_key_pool);
+
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_CERT_CACHE_LIFETIME, 0,
+                              &plgctx->opts->cert_cache_lifetime);
+
     pkinit_kdcdefault_boolean(context, plgctx->realmname,
                               KRB5_CONF_PKINIT_ALLOW_UPN,
                               0, &plgctx->opts->allow_upn);
@@ -1299,11 +1494,25 @@ pkinit_server_plugin_init_realm(krb5_context context, const char *realmname,
     if (retval)
         goto errout;
 
+    retval = pkinit_init_dh_key_pool(plgctx->cryptoctx,
+                                     plgctx->opts->dh_key_pool);
+    if (retval)
+        goto errout;
+
+    retval = pkinit_init_cert_cache(plgctx->cryptoctx,
+                                    plgctx->opts->cert_cache_lifetime);
+    if (retval)
+        goto errout;
+
     retval = pkinit_identity_initialize(context, plgctx->cryptoctx, NULL,
                                         plgctx->idopts, plgctx->idctx, 0, NULL);
     if (retval)
         goto errout;
 
+    /* A PKCS#11 token cannot be shared between threads. */
+    if (plgctx->idopts->idtype == IDTYPE_PKCS11)
+        plgctx->opts->offload_threads = 0;
+
     pkiDebug("%s: returning context at %p for realm '%s'\n",
              __FUNCTION__, plgctx, realmname);
     *pplgctx = plgctx;
@@ -1353,6 +1562,17 @@ pkinit_server_plugin_init(krb5_context context,
         goto errout;
     }
 
+    /* Verification on the KDC's helper threads uses OpenSSL alongside the
+     * KDC's thread. */
+    for (i = 0; realm_contexts[i] != NULL; i++) {
+        if (realm_contexts[i]->opts->offload_threads > 0) {
+            retval = pkinit_init_crypto_threads();
+            if (retval)
+                goto errout;
+            break;
+        }
+    }
+
     *moddata_out = (krb5_kdcpreauth_moddata)realm_contexts;
     retval = 0;
     pkiDebug("%s: returning context at %p\n", __FUNCTION__, realm_contexts);
@@ -1438,6 +1658,11 @@ pkinit_fini_kdc_req_context(krb5_context context, void *ctx)
     pkiDebug("%s: freeing   reqctx at %p\n", __FUNCTION__, reqctx);
 
     pkinit_fini_req_crypto(reqctx->cryptoctx);
+    if (reqctx->server_key != NULL) {
+        zap(reqctx->server_key, reqctx->server_key_len);
+        free(reqctx->server_key);
+    }
+    free(reqctx->dh_signed_data);
     if (reqctx->rcv_auth_pack != NULL)
         free_krb5_auth_pack(&reqctx->rcv_auth_pack);
     if (reqctx->rcv_auth_pack9 != NULL)
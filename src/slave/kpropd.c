@@ -240,20 +240,20 @@ static void resync_alarm(int sn)
 /* Use getaddrinfo to determine a wildcard listener address, preferring
  * IPv6 if available. */
 static int
-get_wildcard_addr(struct addrinfo **res)
+get_wildcard_addr(const char *service, int socktype, struct addrinfo **res)
 {
     struct addrinfo hints;
     int error;
 
     memset(&hints, 0, sizeof(hints));
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = socktype;
     hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG;
     hints.ai_family = AF_INET6;
-    error = getaddrinfo(NULL, port, &hints, res);
+    error = getaddrinfo(NULL, service, &hints, res);
     if (error == 0)
         return 0;
     hints.ai_family = AF_INET;
-    return getaddrinfo(NULL, port, &hints, res);
+    return getaddrinfo(NULL, service, &hints, res);
 }
 
 int do_standalone(iprop_role iproprole)
@@ -270,7 +270,7 @@ int do_standalone(iprop_role iproprole)
 
 retry:
 
-    error = get_wildcard_addr(&res);
+    error = get_wildcard_addr(port, SOCK_STREAM, &res);
     if (error != 0) {
         (void) fprintf(stderr, _("getaddrinfo: %s\n"), gai_strerror(error));
         exit(1);
@@ -599,6 +599,184 @@ full_resync(CLIENT *clnt)
     return (status == RPC_SUCCESS) ? &clnt_res : NULL;
 }
 
+/*
+ * Open a datagram socket on the kprop port to receive update notifications
+ * from the master, and look up the addresses of master in *master_out.
+ * krb5_prop is usually registered for TCP only, so if the kprop port isn't
+ * numeric or known as a UDP service, listen on IPROP_NOTIFY_PORT, as the
+ * master does.  Returns -1 if notifications can't be received, in which case
+ * we simply poll.
+ */
+static int
+open_notify_socket(const char *master, struct addrinfo **master_out)
+{
+    struct addrinfo hints, *res;
+    char portbuf[16];
+    const char *service = port;
+    int fd, val, error;
+
+    *master_out = NULL;
+
+    if (strspn(port, "0123456789") != strlen(port) &&
+        getservbyname(port, "udp") == NULL) {
+        (void) snprintf(portbuf, sizeof(portbuf), "%d", IPROP_NOTIFY_PORT);
+        service = portbuf;
+    }
+
+    error = get_wildcard_addr(service, SOCK_DGRAM, &res);
+    if (error != 0) {
+        com_err(progname, 0, _("getaddrinfo for notification port %s: %s; "
+                               "polling only"), service, gai_strerror(error));
+        syslog(LOG_ERR, _("getaddrinfo for notification port %s: %s; "
+                          "polling only"), service, gai_strerror(error));
+        return -1;
+    }
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        com_err(progname, errno,
+                _("while creating notification socket, polling only"));
+        syslog(LOG_ERR, _("creating notification socket: %s; polling only"),
+               error_message(errno));
+        freeaddrinfo(res);
+        return -1;
+    }
+    set_cloexec_fd(fd);
+#if defined(IPV6_V6ONLY)
+    val = 0;
+    if (res->ai_family == AF_INET6)
+        (void) setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &val, sizeof(val));
+#endif
+    if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        com_err(progname, errno,
+                _("while binding notification port %s, polling only"),
+                service);
+        syslog(LOG_ERR, _("binding notification port %s: %s; polling only"),
+               service, error_message(errno));
+        close(fd);
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    error = getaddrinfo(master, NULL, &hints, master_out);
+    if (error != 0) {
+        /* We can still recognize the address we make RPC calls to. */
+        syslog(LOG_WARNING, _("getaddrinfo for master %s: %s"), master,
+               gai_strerror(error));
+        *master_out = NULL;
+    }
+    return fd;
+}
+
+/* Store the address in sa into *out, mapping an IPv4 address to its
+ * IPv4-mapped IPv6 form.  Return false if sa is not IPv4 or IPv6. */
+static int
+addr_to_in6(struct sockaddr *sa, struct in6_addr *out)
+{
+    if (sa->sa_family == AF_INET6) {
+        *out = sa2sin6(sa)->sin6_addr;
+        return 1;
+    } else if (sa->sa_family == AF_INET) {
+        memset(out, 0, sizeof(*out));
+        out->s6_addr[10] = out->s6_addr[11] = 0xff;
+        memcpy(&out->s6_addr[12], &sa2sin(sa)->sin_addr, 4);
+        return 1;
+    }
+    return 0;
+}
+
+/* Return true if a and b hold the same host address.  An IPv4-mapped IPv6
+ * address, as received on a dual-stack socket, matches the IPv4 address it
+ * contains. */
+static int
+same_host(struct sockaddr *a, struct sockaddr *b)
+{
+    struct in6_addr a6, b6;
+
+    return addr_to_in6(a, &a6) && addr_to_in6(b, &b6) &&
+        IN6_ARE_ADDR_EQUAL(&a6, &b6);
+}
+
+/* Return true if from is the address of our RPC connection to the master or
+ * one of the master's addresses in master_ai. */
+static int
+notify_from_master(struct sockaddr *from, CLIENT *clnt,
+                   struct addrinfo *master_ai)
+{
+    struct sockaddr_in rpc_addr;
+    struct addrinfo *ai;
+
+    memset(&rpc_addr, 0, sizeof(rpc_addr));
+    if (clnt != NULL && clnt_control(clnt, CLGET_SERVER_ADDR,
+                                     (char *)&rpc_addr) &&
+        rpc_addr.sin_family == AF_INET &&
+        same_host(from, (struct sockaddr *)&rpc_addr))
+        return 1;
+    for (ai = master_ai; ai != NULL; ai = ai->ai_next) {
+        if (same_host(from, ai->ai_addr))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Wait up to timeout seconds, returning early if the master notifies us of
+ * a serial number other than last_sno.
+ */
+static void
+wait_for_update(int fd, unsigned int timeout, kdb_sno_t last_sno,
+                CLIENT *clnt, struct addrinfo *master_ai)
+{
+    fd_set rfds;
+    struct timeval tv;
+    struct sockaddr_storage from;
+    socklen_t fromlen;
+    unsigned char buf[IPROP_NOTIFY_LEN];
+    time_t now, end;
+    ssize_t len;
+    int ret;
+
+    if (fd < 0) {
+        (void) sleep(timeout);
+        return;
+    }
+
+    end = time(NULL) + timeout;
+    while ((now = time(NULL)) < end) {
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        tv.tv_sec = end - now;
+        tv.tv_usec = 0;
+        ret = select(fd + 1, &rfds, NULL, NULL, &tv);
+        if (ret < 0 && errno != EINTR) {
+            (void) sleep(end - now);
+            return;
+        }
+        if (ret <= 0)
+            continue;
+        fromlen = sizeof(from);
+        len = recvfrom(fd, buf, sizeof(buf), 0, ss2sa(&from), &fromlen);
+        if (len != IPROP_NOTIFY_LEN ||
+            load_32_be(buf) != IPROP_NOTIFY_MAGIC ||
+            load_32_be(buf + 4) == last_sno)
+            continue;
+        if (!notify_from_master(ss2sa(&from), clnt, master_ai)) {
+            if (debug)
+                fprintf(stderr, _("Ignoring update notification from a "
+                                  "host other than the master\n"));
+            continue;
+        }
+        if (debug)
+            fprintf(stderr, _("Update notification from master "
+                              "(sno=%lu)\n"),
+                    (unsigned long)load_32_be(buf + 4));
+        return;
+    }
+}
+
 /*
  * Routine to handle incremental update transfer(s) from master KDC
  */
@@ -616,6 +794,8 @@ krb5_error_code do_iprop(kdb_log_context *log_ctx)
     int reinit_cnt = 0;
     int ret;
     int frdone = 0;
+    int notify_fd;
+    struct addrinfo *master_ai = NULL;
 
     kdb_incr_result_t *incr_ret;
     static kdb_last_t mylast;
@@ -703,6 +883,8 @@ krb5_error_code do_iprop(kdb_log_context *log_ctx)
     }
     krb5_free_principal(kpropd_context, iprop_svc_principal);
 
+    notify_fd = open_notify_socket(params.admin_server, &master_ai);
+
 reinit:
     /*
      * Authentication, initialize rpcsec_gss handle etc.
@@ -934,8 +1116,8 @@ reinit:
 
         /*
          * Sleep for the specified poll interval (Default is 2 mts),
-         * or do a binary exponential backoff if we get an
-         * UPDATE_BUSY signal
+         * waking early if the master notifies us of an update, or do a
+         * binary exponential backoff if we get an UPDATE_BUSY signal
          */
         if (backoff_cnt > 0) {
             backoff_time = backoff_from_master(&backoff_cnt);
@@ -946,7 +1128,8 @@ reinit:
             (void) sleep(backoff_time);
         }
         else
-            (void) sleep(pollin);
+            wait_for_update(notify_fd, pollin, ulog->kdb_last_sno,
+                            handle->clnt, master_ai);
 
     }
 
@@ -957,6 +1140,10 @@ error:
     syslog(LOG_ERR, _("kpropd: ERROR returned by master KDC,"
                       " bailing.\n"));
 done:
+    if (notify_fd >= 0)
+        close(notify_fd);
+    if (master_ai != NULL)
+        freeaddrinfo(master_ai);
     if(iprop_svc_princstr)
         free(iprop_svc_princstr);
     if (master_svc_princstr)
@@ -413,7 +413,7 @@ print_update(kdb_hlog_t *ulog, uint32_t entry, unsigned int verbose)
         start_sno = ulog->kdb_first_sno - 1;
 
     for (i = start_sno; i < ulog->kdb_last_sno; i++) {
-        indx = i % ulog->kdb_num;
+        indx = i % ulog->kdb_nslots;
 
         indx_log = (kdb_ent_header_t *)INDEX(ulog, indx);
 
@@ -427,7 +427,7 @@ print_update(kdb_hlog_t *ulog, uint32_t entry, unsigned int verbose)
         }
 
         (void) memset(&upd, 0, sizeof (kdb_incr_update_t));
-        xdrmem_create(&xdrs, (char *)indx_log->entry_data,
+        xdrmem_create(&xdrs, ENTRY_DATA(ulog, indx_log),
                       indx_log->kdb_entry_size, XDR_DECODE);
         if (!xdr_kdb_incr_update_t(&xdrs, &upd)) {
             (void) printf(_("Entry data decode failure\n\n"));
@@ -577,7 +577,7 @@ main(int argc, char **argv)
                       ulog->kdb_state);
         break;
     }
-    (void) printf(_("\tEntry block size : %u\n"), ulog->kdb_block);
+    (void) printf(_("\tLog data size : %u\n"), ulog->kdb_data_size);
     (void) printf(_("\tNumber of entries : %u\n"), ulog->kdb_num);
 
     if (ulog->kdb_last_sno == 0)
@@ -0,0 +1,573 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/asn.1/krb5_asn1_perf.c - ASN.1 encoder/decoder benchmark */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program times the ASN.1 encoders and decoders on the sample
+ * structures from ktest.c.  For each type it measures:
+ *
+ *   encode        encoding the sample structure and freeing the result
+ *   decode        decoding the sample encoding and freeing the result
+ *   decode-arena  decoding into a fresh arena and freeing the arena (only
+ *                 for types with arena decoders)
+ *   fuzz          decoding the sample encoding with one byte altered per
+ *                 iteration, which mostly exercises the error paths
+ *
+ * and reports the average time and number of heap allocations per
+ * operation.  Allocations are only counted where malloc can be interposed
+ * (currently glibc).  Sample usages:
+ *
+ *     ./krb5_asn1_perf
+ *     ./krb5_asn1_perf -n 5000000 as_req ap_req
+ *
+ * It is run by "make perf" and is not part of "make check".
+ */
+
+#include "k5-int.h"
+#include "com_err.h"
+#include "utility.h"
+#include "ktest.h"
+#include <sys/time.h>
+
+krb5_context test_context;
+
+#ifdef __GLIBC__
+#define COUNT_ALLOCS
+
+/* Count heap allocations made by the library by interposing on the glibc
+ * allocator. */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static unsigned long alloc_count;
+
+void *
+malloc(size_t size)
+{
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+/*
+ * Each benchmarked type is described by a sample constructor and wrappers
+ * around its codec functions, so that the timing loops can be shared.
+ */
+struct bench_type {
+    const char *name;
+    void *(*make)(void);
+    void (*destroy)(void *);
+    krb5_error_code (*encode)(const void *, krb5_data **);
+    krb5_error_code (*decode)(const krb5_data *, void **);
+    void (*free_decoded)(void *);
+    krb5_error_code (*decode_arena)(k5_asn1_arena *, const krb5_data *,
+                                    void **);
+};
+
+#define CODEC_WRAPPERS(name, ctype, encoder, decoder, freefn)           \
+    static krb5_error_code                                              \
+    bench_encode_##name(const void *val, krb5_data **code)              \
+    {                                                                   \
+        return encoder((const ctype *)val, code);                       \
+    }                                                                   \
+    static krb5_error_code                                              \
+    bench_decode_##name(const krb5_data *code, void **val_out)          \
+    {                                                                   \
+        ctype *val = NULL;                                              \
+        krb5_error_code ret = decoder(code, &val);                      \
+        *val_out = val;                                                 \
+        return ret;                                                     \
+    }                                                                   \
+    static void                                                         \
+    bench_free_##name(void *val)                                        \
+    {                                                                   \
+        freefn(test_context, (ctype *)val);                             \
+    }
+
+#define ARENA_WRAPPER(name, ctype, decoder)                             \
+    static krb5_error_code                                              \
+    bench_arena_##name(k5_asn1_arena *arena, const krb5_data *code,     \
+                       void **val_out)                                  \
+    {                                                                   \
+        ctype *val = NULL;                                              \
+        krb5_error_code ret = decoder(arena, code, &val);               \
+        *val_out = val;                                                 \
+        return ret;                                                     \
+    }
+
+static void *
+make_as_req(void)
+{
+    krb5_kdc_req *req = ealloc(sizeof(*req));
+
+    ktest_make_sample_kdc_req(req);
+    req->msg_type = KRB5_AS_REQ;
+    req->kdc_options &= ~KDC_OPT_ENC_TKT_IN_SKEY;
+    return req;
+}
+
+static void *
+make_tgs_req(void)
+{
+    krb5_kdc_req *req = ealloc(sizeof(*req));
+
+    ktest_make_sample_kdc_req(req);
+    req->msg_type = KRB5_TGS_REQ;
+    req->kdc_options &= ~KDC_OPT_ENC_TKT_IN_SKEY;
+    return req;
+}
+
+static void
+destroy_kdc_req(void *val)
+{
+    ktest_empty_kdc_req(val);
+    free(val);
+}
+
+static void *
+make_as_rep(void)
+{
+    krb5_kdc_rep *rep = ealloc(sizeof(*rep));
+
+    ktest_make_sample_kdc_rep(rep);
+    rep->msg_type = KRB5_AS_REP;
+    return rep;
+}
+
+static void *
+make_tgs_rep(void)
+{
+    krb5_kdc_rep *rep = ealloc(sizeof(*rep));
+
+    ktest_make_sample_kdc_rep(rep);
+    rep->msg_type = KRB5_TGS_REP;
+    return rep;
+}
+
+static void
+destroy_kdc_rep(void *val)
+{
+    ktest_empty_kdc_rep(val);
+    free(val);
+}
+
+static void *
+make_ap_req(void)
+{
+    krb5_ap_req *req = ealloc(sizeof(*req));
+
+    ktest_make_sample_ap_req(req);
+    return req;
+}
+
+static void
+destroy_ap_req(void *val)
+{
+    ktest_empty_ap_req(val);
+    free(val);
+}
+
+static void *
+make_padata_sequence(void)
+{
+    krb5_pa_data **pa;
+
+    ktest_make_sample_pa_data_array(&pa);
+    return pa;
+}
+
+static void
+destroy_padata_sequence(void *val)
+{
+    krb5_pa_data **pa = val;
+
+    ktest_destroy_pa_data_array(&pa);
+}
+
+/* Name the element type so that const ctype * in CODEC_WRAPPERS becomes the
+ * krb5_pa_data *const * the padata encoder takes. */
+typedef krb5_pa_data *pa_data_ptr;
+
+CODEC_WRAPPERS(as_req, krb5_kdc_req, encode_krb5_as_req, decode_krb5_as_req,
+               krb5_free_kdc_req)
+CODEC_WRAPPERS(tgs_req, krb5_kdc_req, encode_krb5_tgs_req,
+               decode_krb5_tgs_req, krb5_free_kdc_req)
+CODEC_WRAPPERS(as_rep, krb5_kdc_rep, encode_krb5_as_rep, decode_krb5_as_rep,
+               krb5_free_kdc_rep)
+CODEC_WRAPPERS(tgs_rep, krb5_kdc_rep, encode_krb5_tgs_rep,
+               decode_krb5_tgs_rep, krb5_free_kdc_rep)
+CODEC_WRAPPERS(ap_req, krb5_ap_req, encode_krb5_ap_req, decode_krb5_ap_req,
+               krb5_free_ap_req)
+CODEC_WRAPPERS(padata_sequence, pa_data_ptr, encode_krb5_padata_sequence,
+               decode_krb5_padata_sequence, krb5_free_pa_data)
+ARENA_WRAPPER(as_req, krb5_kdc_req, decode_krb5_as_req_arena)
+ARENA_WRAPPER(tgs_req, krb5_kdc_req, decode_krb5_tgs_req_arena)
+ARENA_WRAPPER(ap_req, krb5_ap_req, decode_krb5_ap_req_arena)
+
+#ifndef DISABLE_PKINIT
+
+/* The PKINIT codecs are reached through the accessor. */
+static krb5_error_code
+enc_pa_pk_as_req(const krb5_pa_pk_as_req *val, krb5_data **code)
+{
+    return acc.encode_krb5_pa_pk_as_req(val, code);
+}
+
+static krb5_error_code
+dec_pa_pk_as_req(const krb5_data *code, krb5_pa_pk_as_req **val)
+{
+    return acc.decode_krb5_pa_pk_as_req(code, val);
+}
+
+static krb5_error_code
+enc_pa_pk_as_rep(const krb5_pa_pk_as_rep *val, krb5_data **code)
+{
+    return acc.encode_krb5_pa_pk_as_rep(val, code);
+}
+
+static krb5_error_code
+dec_pa_pk_as_rep(const krb5_data *code, krb5_pa_pk_as_rep **val)
+{
+    return acc.decode_krb5_pa_pk_as_rep(code, val);
+}
+
+static krb5_error_code
+enc_auth_pack(const krb5_auth_pack *val, krb5_data **code)
+{
+    return acc.encode_krb5_auth_pack(val, code);
+}
+
+static krb5_error_code
+dec_auth_pack(const krb5_data *code, krb5_auth_pack **val)
+{
+    return acc.decode_krb5_auth_pack(code, val);
+}
+
+static void
+free_pk_as_req(krb5_context context, krb5_pa_pk_as_req *val)
+{
+    if (val)
+        ktest_empty_pa_pk_as_req(val);
+    free(val);
+}
+
+static void
+free_pk_as_rep(krb5_context context, krb5_pa_pk_as_rep *val)
+{
+    if (val)
+        ktest_empty_pa_pk_as_rep(val);
+    free(val);
+}
+
+static void
+free_auth_pack(krb5_context context, krb5_auth_pack *val)
+{
+    if (val)
+        ktest_empty_auth_pack(val);
+    free(val);
+}
+
+static void *
+make_pa_pk_as_req(void)
+{
+    krb5_pa_pk_as_req *req = ealloc(sizeof(*req));
+
+    ktest_make_sample_pa_pk_as_req(req);
+    return req;
+}
+
+static void
+destroy_pa_pk_as_req(void *val)
+{
+    free_pk_as_req(test_context, val);
+}
+
+static void *
+make_pa_pk_as_rep(void)
+{
+    krb5_pa_pk_as_rep *rep = ealloc(sizeof(*rep));
+
+    ktest_make_sample_pa_pk_as_rep_dhInfo(rep);
+    return rep;
+}
+
+static void
+destroy_pa_pk_as_rep(void *val)
+{
+    free_pk_as_rep(test_context, val);
+}
+
+static void *
+make_auth_pack(void)
+{
+    krb5_auth_pack *pack = ealloc(sizeof(*pack));
+
+    ktest_make_sample_auth_pack(pack);
+    return pack;
+}
+
+static void
+destroy_auth_pack(void *val)
+{
+    free_auth_pack(test_context, val);
+}
+
+CODEC_WRAPPERS(pa_pk_as_req, krb5_pa_pk_as_req, enc_pa_pk_as_req,
+               dec_pa_pk_as_req, free_pk_as_req)
+CODEC_WRAPPERS(pa_pk_as_rep, krb5_pa_pk_as_rep, enc_pa_pk_as_rep,
+               dec_pa_pk_as_rep, free_pk_as_rep)
+CODEC_WRAPPERS(auth_pack, krb5_auth_pack, enc_auth_pack, dec_auth_pack,
+               free_auth_pack)
+
+#endif /* not DISABLE_PKINIT */
+
+#define BENCH(name, destroy, arena)                                     \
+    { #name, make_##name, destroy, bench_encode_##name,                 \
+            bench_decode_##name, bench_free_##name, arena }
+
+static const struct bench_type bench_types[] = {
+    BENCH(as_req, destroy_kdc_req, bench_arena_as_req),
+    BENCH(tgs_req, destroy_kdc_req, bench_arena_tgs_req),
+    BENCH(as_rep, destroy_kdc_rep, NULL),
+    BENCH(tgs_rep, destroy_kdc_rep, NULL),
+    BENCH(ap_req, destroy_ap_req, bench_arena_ap_req),
+    BENCH(padata_sequence, destroy_padata_sequence, NULL),
+#ifndef DISABLE_PKINIT
+    BENCH(pa_pk_as_req, destroy_pa_pk_as_req, NULL),
+    BENCH(pa_pk_as_rep, destroy_pa_pk_as_rep, NULL),
+    BENCH(auth_pack, destroy_auth_pack, NULL),
+#endif
+};
+
+static void
+check(krb5_error_code ret, const char *what, const char *name)
+{
+    if (ret) {
+        com_err("krb5_asn1_perf", ret, "while %s %s", what, name);
+        exit(1);
+    }
+}
+
+static double
+now_ns(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+/* State shared between the timing loop and the current operation. */
+struct run {
+    const struct bench_type *type;
+    void *sample;
+    krb5_data *encoding;
+    krb5_data scratch;
+    unsigned long accepted;
+    uint32_t lcg;
+};
+
+static void
+op_encode(struct run *r)
+{
+    krb5_data *code;
+
+    check(r->type->encode(r->sample, &code), "encoding", r->type->name);
+    krb5_free_data(test_context, code);
+}
+
+static void
+op_decode(struct run *r)
+{
+    void *val;
+
+    check(r->type->decode(r->encoding, &val), "decoding", r->type->name);
+    r->type->free_decoded(val);
+}
+
+static void
+op_decode_arena(struct run *r)
+{
+    k5_asn1_arena *arena;
+    void *val;
+
+    check(k5_asn1_arena_create(&arena), "creating arena for", r->type->name);
+    check(r->type->decode_arena(arena, r->encoding, &val), "decoding",
+          r->type->name);
+    k5_asn1_arena_free(arena);
+}
+
+/* Alter one byte of the encoding, chosen by a fixed pseudo-random sequence
+ * so that runs are comparable, then decode it.  The byte is restored
+ * afterwards so each iteration starts from the valid encoding. */
+static void
+op_fuzz(struct run *r)
+{
+    unsigned char *p = (unsigned char *)r->scratch.data;
+    unsigned char saved;
+    size_t pos;
+    void *val;
+
+    r->lcg = r->lcg * 1103515245 + 12345;
+    pos = (r->lcg >> 8) % r->scratch.length;
+    saved = p[pos];
+    p[pos] ^= ((r->lcg >> 24) & 0xff) | 1;
+    if (r->type->decode(&r->scratch, &val) == 0) {
+        r->accepted++;
+        r->type->free_decoded(val);
+    }
+    p[pos] = saved;
+}
+
+static void
+time_op(struct run *r, const char *opname, void (*op)(struct run *),
+        long iterations)
+{
+    double start, elapsed;
+    long i;
+#ifdef COUNT_ALLOCS
+    unsigned long allocs;
+#endif
+
+    /* Warm up, so that the first iteration's one-time costs do not count. */
+    op(r);
+    r->accepted = 0;
+
+#ifdef COUNT_ALLOCS
+    allocs = alloc_count;
+#endif
+    start = now_ns();
+    for (i = 0; i < iterations; i++)
+        op(r);
+    elapsed = now_ns() - start;
+
+    printf("%-16s %-13s %10.1f ns/op", r->type->name, opname,
+           elapsed / iterations);
+#ifdef COUNT_ALLOCS
+    printf(" %8.2f allocs/op", (double)(alloc_count - allocs) / iterations);
+#else
+    printf(" %8s allocs/op", "-");
+#endif
+    if (op == op_fuzz)
+        printf("  (%.1f%% accepted)", 100.0 * r->accepted / iterations);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void
+run_type(const struct bench_type *type, long iterations)
+{
+    struct run r;
+
+    memset(&r, 0, sizeof(r));
+    r.type = type;
+    r.sample = type->make();
+    check(type->encode(r.sample, &r.encoding), "encoding", type->name);
+    r.scratch.length = r.encoding->length;
+    r.scratch.data = ealloc(r.scratch.length);
+    memcpy(r.scratch.data, r.encoding->data, r.scratch.length);
+    r.lcg = 1;
+
+    time_op(&r, "encode", op_encode, iterations);
+    time_op(&r, "decode", op_decode, iterations);
+    if (type->decode_arena != NULL)
+        time_op(&r, "decode-arena", op_decode_arena, iterations);
+    time_op(&r, "fuzz", op_fuzz, iterations);
+
+    free(r.scratch.data);
+    krb5_free_data(test_context, r.encoding);
+    type->destroy(r.sample);
+}
+
+static int
+selected(const char *name, int argc, char **argv)
+{
+    int i;
+
+    if (argc == 0)
+        return 1;
+    for (i = 0; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_error_code ret;
+    long iterations = 1000000;
+    size_t i;
+    int optchar;
+
+    while ((optchar = getopt(argc, argv, "n:")) != -1) {
+        switch (optchar) {
+        case 'n':
+            iterations = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [type ...]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (iterations <= 0) {
+        fprintf(stderr, "krb5_asn1_perf: iteration count must be positive\n");
+        exit(1);
+    }
+
+    ret = krb5_init_context(&test_context);
+    if (ret) {
+        com_err("krb5_asn1_perf", ret, "while initializing krb5");
+        exit(1);
+    }
+    init_access("krb5_asn1_perf");
+
+    for (i = 0; i < sizeof(bench_types) / sizeof(*bench_types); i++) {
+        if (selected(bench_types[i].name, argc, argv))
+            run_type(&bench_types[i], iterations);
+    }
+
+    krb5_free_context(test_context);
+    return 0;
+}
@@ -127,6 +127,33 @@ main(argc, argv)
     }                                                                   \
     encoder_print_results(code, typestring, description);
 
+    /* Check that encoding into a caller-supplied buffer matches the
+     * allocating encoder, and fails cleanly if the buffer is short. */
+#define buffer_check(value,typestring,encoder,buf_encoder)              \
+    {                                                                   \
+        size_t blen, blen2;                                             \
+        unsigned char *bmem;                                            \
+        retval = encoder(&(value),&(code));                             \
+        if (retval == 0)                                                \
+            retval = buf_encoder(&(value), NULL, 0, &blen);             \
+        if (retval) {                                                   \
+            com_err("krb5_encode_test", retval, "while encoding %s",    \
+                    typestring);                                        \
+            exit(1);                                                    \
+        }                                                               \
+        bmem = ealloc(blen);                                            \
+        if (blen != code->length ||                                     \
+            buf_encoder(&(value), bmem, blen - 1, &blen2) !=            \
+            ASN1_OVERFLOW ||                                            \
+            buf_encoder(&(value), bmem, blen, &blen2) != 0 ||           \
+            blen2 != blen || memcmp(bmem, code->data, blen) != 0) {     \
+            printf("Error: buffer encoding of %s differs\n", typestring); \
+            exit(1);                                                    \
+        }                                                               \
+        free(bmem);                                                     \
+        ktest_destroy_data(&code);                                      \
+    }
+
     /****************************************************************/
     /* encode_krb5_authenticator */
     {
@@ -134,6 +161,8 @@ main(argc, argv)
         ktest_make_sample_authenticator(&authent);
 
         encode_run(authent, "authenticator", "", encode_krb5_authenticator);
+        buffer_check(authent, "authenticator", encode_krb5_authenticator,
+                     encode_krb5_authenticator_buf);
 
         ktest_destroy_checksum(&(authent.checksum));
         ktest_destroy_keyblock(&(authent.subkey));
@@ -177,6 +206,8 @@ main(argc, argv)
 
         encode_run(*tkt.enc_part2, "enc_tkt_part", "",
                    encode_krb5_enc_tkt_part);
+        buffer_check(*tkt.enc_part2, "enc_tkt_part", encode_krb5_enc_tkt_part,
+                     encode_krb5_enc_tkt_part_buf);
 
         tkt.enc_part2->times.starttime = 0;
         tkt.enc_part2->times.renew_till = 0;
@@ -206,6 +237,9 @@ main(argc, argv)
 
         encode_run(*kdcr.enc_part2, "enc_kdc_rep_part", "",
                    encode_krb5_enc_kdc_rep_part);
+        buffer_check(*kdcr.enc_part2, "enc_kdc_rep_part",
+                     encode_krb5_enc_kdc_rep_part,
+                     encode_krb5_enc_kdc_rep_part_buf);
 
         kdcr.enc_part2->key_exp = 0;
         kdcr.enc_part2->times.starttime = 0;
@@ -231,6 +265,8 @@ main(argc, argv)
 
         kdcr.msg_type = KRB5_AS_REP;
         encode_run(kdcr, "as_rep", "", encode_krb5_as_rep);
+        buffer_check(kdcr, "as_rep", encode_krb5_as_rep,
+                     encode_krb5_as_rep_buf);
 
         ktest_destroy_pa_data_array(&(kdcr.padata));
         encode_run(kdcr, "as_rep", "(optionals NULL)", encode_krb5_as_rep);
@@ -251,6 +287,8 @@ main(argc, argv)
 
         kdcr.msg_type = KRB5_TGS_REP;
         encode_run(kdcr, "tgs_rep", "", encode_krb5_tgs_rep);
+        buffer_check(kdcr, "tgs_rep", encode_krb5_tgs_rep,
+                     encode_krb5_tgs_rep_buf);
 
         ktest_destroy_pa_data_array(&(kdcr.padata));
         encode_run(kdcr, "tgs_rep", "(optionals NULL)", encode_krb5_tgs_rep);
@@ -265,6 +303,8 @@ main(argc, argv)
         krb5_ap_req apreq;
         ktest_make_sample_ap_req(&apreq);
         encode_run(apreq, "ap_req", "", encode_krb5_ap_req);
+        buffer_check(apreq, "ap_req", encode_krb5_ap_req,
+                     encode_krb5_ap_req_buf);
         ktest_empty_ap_req(&apreq);
     }
 
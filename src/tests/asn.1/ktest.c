@@ -1442,12 +1442,14 @@ ktest_empty_pa_pk_as_req(krb5_pa_pk_as_req *p)
     krb5_external_principal_identifier **pi;
 
     ktest_empty_data(&p->signedAuthPack);
-    for (pi = p->trustedCertifiers; *pi != NULL; pi++) {
-        ktest_empty_external_principal_identifier(*pi);
-        free(*pi);
+    if (p->trustedCertifiers != NULL) {
+        for (pi = p->trustedCertifiers; *pi != NULL; pi++) {
+            ktest_empty_external_principal_identifier(*pi);
+            free(*pi);
+        }
+        free(p->trustedCertifiers);
+        p->trustedCertifiers = NULL;
     }
-    free(p->trustedCertifiers);
-    p->trustedCertifiers = NULL;
     ktest_empty_data(&p->kdcPkId);
 }
 
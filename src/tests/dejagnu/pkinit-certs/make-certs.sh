@@ -0,0 +1,134 @@
+#!/bin/sh -e
+#
+# Regenerate the PKINIT test certificates from privkey.pem, which is the key
+# of every certificate here.  Run this in the pkinit-certs directory.
+#
+# user-revoked.pem is a second certificate for the test user, revoked by
+# crl.pem.  Its SHA-256 digest begins with the same byte as that of
+# user.pem, so that the two share a slot in the KDC's certificate cache.
+
+REALM=KRBTEST.COM
+DAYS=36500
+
+cat > openssl.cnf <<EOF
+[req]
+prompt = no
+distinguished_name = ca_name
+
+[ca]
+default_ca = test_ca
+
+[test_ca]
+database = index.txt
+certificate = ca.pem
+private_key = privkey.pem
+default_md = sha256
+default_crl_days = $DAYS
+
+[ca_name]
+C = US
+ST = Massachusetts
+L = Cambridge
+O = MIT
+OU = Insecure Pkinit Kerberos test CA
+CN = pkinit test suite CA; do not use otherwise
+
+[kdc_name]
+C = US
+ST = Massachusetts
+O = $REALM
+OU = KDC
+
+[user_name]
+C = US
+ST = Massachusetts
+O = $REALM
+CN = user
+
+[exts_ca]
+subjectKeyIdentifier = hash
+authorityKeyIdentifier = keyid:always,issuer:always
+basicConstraints = critical,CA:TRUE
+keyUsage = critical,digitalSignature,keyCertSign,cRLSign
+
+[exts_kdc]
+basicConstraints = critical,CA:FALSE
+keyUsage = digitalSignature,nonRepudiation,keyEncipherment,keyAgreement
+extendedKeyUsage = 1.3.6.1.5.2.3.5
+subjectKeyIdentifier = hash
+authorityKeyIdentifier = keyid,issuer
+subjectAltName = otherName:1.3.6.1.5.2.2;SEQUENCE:kdc_princ
+
+[kdc_princ]
+realm = EXP:0,GeneralString:$REALM
+principal_name = EXP:1,SEQUENCE:kdc_princ_name
+
+[kdc_princ_name]
+name_type = EXP:0,INTEGER:1
+name_string = EXP:1,SEQUENCE:kdc_princ_components
+
+[kdc_princ_components]
+princ0 = GeneralString:krbtgt
+princ1 = GeneralString:$REALM
+
+[exts_user]
+basicConstraints = critical,CA:FALSE
+keyUsage = digitalSignature,nonRepudiation,keyEncipherment,keyAgreement
+extendedKeyUsage = 1.3.6.1.5.2.3.4
+subjectKeyIdentifier = hash
+authorityKeyIdentifier = keyid,issuer
+subjectAltName = otherName:1.3.6.1.5.2.2;SEQUENCE:user_princ
+
+[user_princ]
+realm = EXP:0,GeneralString:$REALM
+principal_name = EXP:1,SEQUENCE:user_princ_name
+
+[user_princ_name]
+name_type = EXP:0,INTEGER:1
+name_string = EXP:1,SEQUENCE:user_princ_components
+
+[user_princ_components]
+princ0 = GeneralString:user
+EOF
+
+# Issue a certificate for the named section of openssl.cnf.
+issue() {
+    name=$1 serial=$2 out=$3
+    openssl req -config openssl.cnf -new -subj "$(subject $name)" \
+        -key privkey.pem -out tmp.csr
+    openssl x509 -req -in tmp.csr -CA ca.pem -CAkey privkey.pem \
+        -set_serial $serial -days $DAYS -sha256 -extfile openssl.cnf \
+        -extensions exts_$name -out $out
+    rm -f tmp.csr
+}
+
+# Print the first byte of the SHA-256 digest of a certificate, in hex.
+digest_byte() {
+    openssl x509 -in $1 -outform DER | openssl dgst -sha256 -r | cut -c1-2
+}
+
+# Print the distinguished name in section ${1}_name of openssl.cnf in the
+# form accepted by openssl req -subj.
+subject() {
+    sed -n "/^\[${1}_name\]/,/^$/s/^\([A-Z]*\) = \(.*\)/\/\1=\2/p" \
+        openssl.cnf | tr -d '\n'
+}
+
+openssl req -config openssl.cnf -new -x509 -key privkey.pem -set_serial 1 \
+    -days $DAYS -sha256 -extensions exts_ca -out ca.pem
+issue kdc 2 kdc.pem
+issue user 3 user.pem
+
+serial=4
+issue user $serial user-revoked.pem
+while [ "$(digest_byte user-revoked.pem)" != "$(digest_byte user.pem)" ]; do
+    serial=`expr $serial + 1`
+    issue user $serial user-revoked.pem
+done
+
+rm -f index.txt*
+touch index.txt
+openssl ca -config openssl.cnf -revoke user-revoked.pem
+openssl ca -config openssl.cnf -gencrl -out crl.pem
+
+rm -f openssl.cnf index.txt*
@@ -37,6 +37,20 @@ realm.klist('WELLKNOWN/ANONYMOUS@WELLKNOWN:ANONYMOUS')
 realm.run_as_client([kvno, realm.host_princ])
 realm.stop()
 
+# Run again with the DH key pool enabled, so that the refill thread uses
+# OpenSSL alongside the KDC's thread.
+pool_kdc_conf = {
+    'all': { 'realms' : { '$realm' : {
+                'pkinit_dh_key_pool' : '2' } } } }
+realm = K5Realm(krb5_conf=pkinit_krb5_conf, kdc_conf=pool_kdc_conf,
+                create_user=False)
+realm.addprinc('WELLKNOWN/ANONYMOUS')
+for i in range(5):
+    realm.kinit('@%s' % realm.realm, flags=['-n'])
+    realm.klist('WELLKNOWN/ANONYMOUS@WELLKNOWN:ANONYMOUS')
+realm.run_as_client([kvno, realm.host_princ])
+realm.stop()
+
 # Now try again with anonymous restricted; kvno should fail.
 realm = K5Realm(krb5_conf=pkinit_krb5_conf, kdc_conf=restrictive_kdc_conf,
                 create_user=False)
@@ -0,0 +1,34 @@
+#!/usr/bin/python
+from k5test import *
+import os
+
+# Use a tiny queue so that the writer thread falls behind, and make
+# callers wait for it so that the log is complete.
+conf = {'all': {'logging': {'async': 'true',
+                            'async_queue_size': '2',
+                            'async_overflow': 'block'}}}
+realm = K5Realm(krb5_conf=conf, start_kdc=False, create_host=False)
+realm.start_kdc(['-w', '2'])
+for i in range(10):
+    realm.kinit(realm.user_princ, password('user'))
+    realm.run_as_client([kvno, realm.admin_princ])
+realm.run_kadminl('getprinc user')
+realm.stop_kdc()
+realm.stop_kadmind()
+
+def count_lines(logname, substr):
+    f = open(os.path.join(realm.testdir, logname))
+    n = len([line for line in f if substr in line])
+    f.close()
+    return n
+
+if count_lines('kdc.log', 'AS_REQ ') != 10:
+    fail('Expected 10 AS_REQ lines in KDC log')
+if count_lines('kdc.log', 'TGS_REQ ') != 10:
+    fail('Expected 10 TGS_REQ lines in KDC log')
+if count_lines('kdc.log', 'commencing operation') != 2:
+    fail('Expected one startup line per KDC worker')
+if count_lines('kadmind5.log', 'starting') != 1:
+    fail('Expected kadmind startup line')
+
+success('Asynchronous logging')
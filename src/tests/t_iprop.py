@@ -0,0 +1,73 @@
+#!/usr/bin/python
+from k5test import *
+import re, select, time
+
+conf = {'all': {'realms': {'$realm': {
+                'iprop_enable': 'true',
+                'iprop_port': '$port4',
+                'iprop_slave_poll': '600'}}},
+        'master': {'realms': {'$realm': {
+                'iprop_master_ulogsize': '4000',
+                'iprop_logfile': '$testdir/db.ulog'}}},
+        'slave': {'realms': {'$realm': {
+                'iprop_logfile': '$testdir/slave-db.ulog'}}}}
+
+realm = K5Realm(kdc_conf=conf, create_user=False, start_kadmind=False)
+kiprop_princ = 'kiprop/' + hostname
+realm.addprinc(kiprop_princ)
+realm.extract_keytab(kiprop_princ, realm.keytab)
+realm.addprinc('before')
+
+# Bring the slave into sync with an iprop dump, so that no full resync
+# is needed.
+dumpfile = os.path.join(realm.testdir, 'dump')
+realm.run_as_master([kdb5_util, 'dump', '-i1', dumpfile])
+realm.run_as_slave([kdb5_util, 'load', '-i', dumpfile])
+realm.run_as_slave([kdb5_util, 'stash', '-P', 'master'])
+
+# Tell kadmind where to send update notifications.
+realm.env_master['KPROP_PORT'] = str(realm.portbase + 5)
+realm.start_kadmind()
+kpropd = realm.start_kpropd('in-sync', ['-s', realm.keytab])
+
+# Wait for kpropd to report incremental updates until princ is on the
+# slave.  A full resync means the updates fell out of the master's log.
+def wait_for_princ(princ, timeout):
+    start = time.time()
+    while time.time() - start < timeout:
+        ready, w, x = select.select([kpropd.stdout], [], [], timeout)
+        if not ready:
+            break
+        line = kpropd.stdout.readline()
+        output(line)
+        if 'Full resync' in line:
+            fail('Full resync while waiting for %s' % princ)
+        if 'Update transfer from master was OK' in line:
+            out = realm.run_as_slave([kadmin_local, '-q', 'getprinc ' + princ])
+            if ('Principal: %s@' % princ) in out:
+                return
+    fail('%s was not propagated after notification' % princ)
+
+# The slave polls only every ten minutes, so the update must arrive by
+# notification from the master.
+realm.addprinc('after')
+wait_for_princ('after', 10)
+
+# Load more principals at once than the update log used to hold.  The
+# update log keeps all of them, so the slave gets them incrementally.
+realm.run_as_master([kdb5_util, 'dump', dumpfile, 'before@' + realm.realm])
+lines = open(dumpfile).read().splitlines()
+princline = [l for l in lines if '\tbefore@' in l][0]
+f = open(dumpfile, 'w')
+f.write(lines[0] + '\n')
+for i in range(1, 3001):
+    f.write(princline.replace('\tbefore@', '\tu%05d@' % i) + '\n')
+f.close()
+realm.run_as_master([kdb5_util, 'load', '-update', dumpfile])
+out = realm.run_as_master([kproplog, '-h'])
+nentries = int(re.search(r'Number of entries : (\d+)', out).group(1))
+if nentries < 3000:
+    fail('Update log holds only %d entries' % nentries)
+wait_for_princ('u03000', 30)
+
+success('iprop update notification and large update batches')
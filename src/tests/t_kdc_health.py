@@ -0,0 +1,38 @@
+#!/usr/bin/python
+from k5test import *
+import socket
+
+# Bind a UDP socket which never answers, and list it ahead of the real
+# KDC.
+blackhole = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+blackhole.bind(('127.0.0.1', 0))
+bhport = blackhole.getsockname()[1]
+conf = {'all': {'realms': {'$realm': {
+                'kdc': ['127.0.0.1:%d' % bhport, '$hostname:$port0']}}}}
+realm = K5Realm(krb5_conf=conf, start_kadmind=False)
+realm.run_kadminl('addprinc -randkey svc1')
+realm.run_kadminl('addprinc -randkey svc2')
+
+# Get three service tickets in one process.  The first request should
+# time out against the unresponsive server and then succeed against
+# the real KDC; the later ones should go straight to the real KDC.
+tracefile = os.path.join(realm.testdir, 'trace')
+realm.env_client['KRB5_TRACE'] = tracefile
+realm.run_as_client([kvno, realm.host_princ, 'svc1', 'svc2'])
+del realm.env_client['KRB5_TRACE']
+trace = open(tracefile).read()
+blackhole.close()
+
+bhname = '127.0.0.1:%d' % bhport
+sends = [l for l in trace.splitlines()
+         if 'Sending initial UDP request to' in l]
+if len(sends) != 4 or bhname not in sends[0]:
+    fail('Expected one initial send to the unresponsive server.')
+if [l for l in sends[1:] if bhname in l]:
+    fail('Unresponsive server was contacted again.')
+if 'No answer from dgram %s' % bhname not in trace:
+    fail('Unresponsive server was not recorded as failing.')
+if 'Response time from' not in trace:
+    fail('KDC response time was not recorded.')
+
+success('KDC health tracking')
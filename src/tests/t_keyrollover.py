@@ -62,6 +62,21 @@ if 'vno 1, aes256' not in output or 'vno 1, des3' not in output:
 # Now present the DES3 ticket to the KDC and make sure it's rejected.
 realm.run_as_client([kvno, realm.host_princ], expected_code=1)
 
+# The KDC caches krbtgt keys.  Make sure it notices when the key at a
+# kvno it has already used is replaced, by checking a ticket for the
+# TGS principal against a keytab made from the database.
+realm.run_kadminl('cpw -randkey -e aes256-cts:normal krbtgt/%s' % realm.realm)
+realm.run_kadminl('modprinc -kvno 1 krbtgt/%s' % realm.realm)
+realm.kinit(realm.user_princ, password('user'))
+realm.run_as_client([kvno, realm.host_princ])
+realm.run_kadminl('cpw -randkey -e aes256-cts:normal krbtgt/%s' % realm.realm)
+realm.run_kadminl('modprinc -kvno 1 krbtgt/%s' % realm.realm)
+tgt_keytab = os.path.join(realm.testdir, 'krbtgt_keytab')
+realm.run_kadminl('ktadd -k %s -norandkey krbtgt/%s' %
+                  (tgt_keytab, realm.realm))
+realm.kinit(realm.user_princ, password('user'))
+realm.run_as_client([kvno, '-k', tgt_keytab, 'krbtgt/%s' % realm.realm])
+
 realm.stop()
 
 # Test a cross-realm TGT key rollover scenario where realm 1 mimics
@@ -0,0 +1,31 @@
+#!/usr/bin/python
+from k5test import *
+
+realm = K5Realm(create_host=False, start_kdc=False, start_kadmind=False)
+
+for name in ('host/web1', 'host/web2', 'host/wab1', 'host/web10', 'host/wc',
+             'http/web1', 'hostx'):
+    realm.addprinc(name)
+
+def check_list(glob, expected):
+    output = realm.run_kadminl('listprincs ' + glob)
+    got = sorted(line for line in output.splitlines()
+                 if line.endswith('@' + realm.realm))
+    want = sorted(n + '@' + realm.realm for n in expected)
+    if got != want:
+        fail('listprincs %s: got %s, expected %s' % (glob, got, want))
+
+# Literal prefixes are satisfied with a key range scan in the db2 module;
+# the results must be the same as a full scan.
+check_list('host/web*', ['host/web1', 'host/web2', 'host/web10'])
+check_list('host/web?', ['host/web1', 'host/web2'])
+check_list('host/w[ae]b1', ['host/web1', 'host/wab1'])
+check_list('host/web1', ['host/web1'])
+check_list('host/web1@' + realm.realm, ['host/web1'])
+check_list('host*', ['host/web1', 'host/web2', 'host/wab1', 'host/web10',
+                     'host/wc', 'hostx'])
+check_list('*/web1', ['host/web1', 'http/web1'])
+check_list('nosuch*', [])
+check_list('zzz*', [])
+
+success('Principal listing')
@@ -0,0 +1,86 @@
+#!/usr/bin/python
+from k5test import *
+
+# Skip this test if pkinit wasn't built.
+if not os.path.exists(os.path.join(plugins, 'preauth', 'pkinit.so')):
+    success('Warning: not testing pkinit because it is not built')
+    exit(0)
+
+certs = os.path.join(srctop, 'tests', 'dejagnu', 'pkinit-certs')
+ca_pem = os.path.join(certs, 'ca.pem')
+kdc_pem = os.path.join(certs, 'kdc.pem')
+user_pem = os.path.join(certs, 'user.pem')
+revoked_pem = os.path.join(certs, 'user-revoked.pem')
+crl_pem = os.path.join(certs, 'crl.pem')
+privkey_pem = os.path.join(certs, 'privkey.pem')
+user_identity = 'FILE:%s,%s' % (user_pem, privkey_pem)
+revoked_identity = 'FILE:%s,%s' % (revoked_pem, privkey_pem)
+
+pkinit_krb5_conf = {
+    'all' : {
+        'libdefaults' : {
+            'pkinit_anchors' : 'FILE:' + ca_pem
+        },
+        'realms' : {
+            '$realm' : {
+                'pkinit_anchors' : 'FILE:%s' % ca_pem,
+                'pkinit_identity' : 'FILE:%s,%s' % (kdc_pem, privkey_pem),
+            }
+        }
+    }
+}
+
+# Verify PKINIT requests on the KDC's helper threads.
+offload_kdc_conf = {
+    'all' : { 'realms' : { '$realm' : {
+                'pkinit_offload_threads' : '2' } } } }
+
+# Remember verified client certificate chains, and revoke
+# user-revoked.pem, whose digest puts it in the same cache slot as
+# user.pem.
+cache_kdc_conf = {
+    'all' : { 'realms' : { '$realm' : {
+                'pkinit_offload_threads' : '2',
+                'pkinit_cert_cache_lifetime' : '300',
+                'pkinit_revoke' : 'FILE:' + crl_pem } } } }
+
+def pkinit_kinit(realm, identity, flags=[], **keywords):
+    realm.kinit(realm.user_princ,
+                flags=['-X', 'X509_user_identity=%s' % identity] + flags,
+                **keywords)
+
+realm = K5Realm(krb5_conf=pkinit_krb5_conf, kdc_conf=offload_kdc_conf,
+                get_creds=False)
+realm.run_kadminl('modprinc +requires_preauth %s' % realm.user_princ)
+
+# Authenticate with Diffie-Hellman key agreement, then with RSA key
+# transport.
+pkinit_kinit(realm, user_identity)
+realm.klist(realm.user_princ)
+pkinit_kinit(realm, user_identity, ['-X', 'flag_RSA_PROTOCOL=yes'])
+realm.klist(realm.user_princ)
+realm.run_as_client([kvno, realm.host_princ])
+
+# A password still works when PKINIT is offered.
+realm.kinit(realm.user_princ, password('user'))
+realm.klist(realm.user_princ)
+realm.stop()
+
+realm = K5Realm(krb5_conf=pkinit_krb5_conf, kdc_conf=cache_kdc_conf,
+                get_creds=False)
+realm.run_kadminl('modprinc +requires_preauth %s' % realm.user_princ)
+
+# The second request is answered from the certificate cache.
+pkinit_kinit(realm, user_identity)
+pkinit_kinit(realm, user_identity, ['-X', 'flag_RSA_PROTOCOL=yes'])
+realm.klist(realm.user_princ)
+
+# A different certificate in the same cache slot is verified, and
+# rejected because it is revoked.  It does not displace the cached
+# entry for user.pem.
+pkinit_kinit(realm, revoked_identity, expected_code=1)
+pkinit_kinit(realm, revoked_identity, expected_code=1)
+pkinit_kinit(realm, user_identity)
+realm.klist(realm.user_princ)
+
+success('PKINIT')
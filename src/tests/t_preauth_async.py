@@ -0,0 +1,68 @@
+#!/usr/bin/python
+from k5test import *
+import socket
+import time
+
+# Exercise the kdcpreauth offload and watch_fd callbacks with the async_test
+# module, which checks a token with a stand-in token server.
+plugin = os.path.join(buildtop, 'plugins', 'preauth', 'async_test',
+                      'async_test.so')
+server_script = os.path.join(srctop, 'plugins', 'preauth', 'async_test',
+                             'token_server.py')
+conf = {
+    'all' : {
+        'plugins' : {
+            'clpreauth' : { 'module' : 'async_test:' + plugin },
+            'kdcpreauth' : { 'module' : 'async_test:' + plugin }
+        }
+    }
+}
+
+realm = K5Realm(krb5_conf=conf, create_host=False, get_creds=False)
+port = realm.portbase + 9
+heldfile = os.path.join(realm.testdir, 'held')
+realm.start_server([sys.executable, server_script, str(port), '1234',
+                    heldfile], 'token server ready')
+realm.run_kadminl('addprinc -pw pw +requires_hwauth tokenuser')
+
+def release_held():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.sendto(b'release', ('127.0.0.1', port))
+    s.close()
+
+def test_mode(mode):
+    realm.run_kadminl('setstr tokenuser async_test %s:%d' % (mode, port))
+
+    realm.kinit('tokenuser', 'pw', ['-X', 'token=1234'])
+    realm.klist('tokenuser@%s' % realm.realm)
+    realm.kinit('tokenuser', 'pw', ['-X', 'token=5678'], expected_code=1)
+
+    # While the token server holds a request, the KDC should keep answering
+    # other requests.  If it blocked, the second kinit would time out.
+    if os.path.exists(heldfile):
+        os.remove(heldfile)
+    held_ccache = os.path.join(realm.testdir, 'ccache.held')
+    proc = subprocess.Popen([kinit, '-c', held_ccache, '-X', 'token=hold1234',
+                             'tokenuser'], stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            env=realm.env_client)
+    proc.stdin.write('pw\n')
+    proc.stdin.close()
+    for i in range(100):
+        if os.path.exists(heldfile):
+            break
+        time.sleep(0.1)
+    else:
+        fail('Token server did not receive held request (%s mode)' % mode)
+    realm.kinit(realm.user_princ, password('user'))
+    if proc.poll() is not None:
+        fail('Held request finished before release (%s mode)' % mode)
+    release_held()
+    output = proc.stdout.read()
+    if proc.wait() != 0:
+        fail('Held request failed (%s mode): %s' % (mode, output))
+
+test_mode('thread')
+test_mode('socket')
+
+success('Asynchronous preauth helpers')
@@ -0,0 +1,23 @@
+#!/usr/bin/python
+from k5test import *
+
+# Make the client use TCP for KDC requests and keep its connections.
+conf = {'client': {'libdefaults': {'udp_preference_limit': '1',
+                                   'kdc_tcp_reuse': 'true'}}}
+realm = K5Realm(krb5_conf=conf, start_kadmind=False)
+realm.run_kadminl('addprinc -randkey svc1')
+realm.run_kadminl('addprinc -randkey svc2')
+
+# Get three service tickets in one process.  The first request should
+# open a connection which the KDC keeps open for the next two.
+tracefile = os.path.join(realm.testdir, 'trace')
+realm.env_client['KRB5_TRACE'] = tracefile
+realm.run_as_client([kvno, realm.host_princ, 'svc1', 'svc2'])
+del realm.env_client['KRB5_TRACE']
+trace = open(tracefile).read()
+if trace.count('Initiating TCP connection') != 1:
+    fail('Expected exactly one new TCP connection.')
+if trace.count('Reusing TCP connection') != 2:
+    fail('Expected two reused TCP connections.')
+
+success('KDC TCP connection reuse')
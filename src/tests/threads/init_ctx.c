@@ -46,6 +46,7 @@
 #define N_THREADS 4
 #define ITER_COUNT 40000
 static int init_krb5_first = 0;
+static int use_template = 0;
 
 struct resource_info {
     struct timeval start_time, end_time;
@@ -72,6 +73,7 @@ usage ()
     fprintf (stderr, "\t-i N\tset iteration count (default %d)\n",
              ITER_COUNT);
     fprintf (stderr, "\t-K\tinitialize a krb5_context for the duration\n");
+    fprintf (stderr, "\t-T\tcreate contexts from a context template\n");
     fprintf (stderr, "\t-P\tpause briefly after starting, to allow attaching dtrace/strace/etc\n");
     exit (1);
 }
@@ -94,7 +96,7 @@ numarg (char *arg)
     usage ();
 }
 
-static char optstring[] = "t:i:KP";
+static char optstring[] = "t:i:KPT";
 
 static void
 process_options (int argc, char *argv[])
@@ -132,6 +134,10 @@ process_options (int argc, char *argv[])
         case 'P':
             do_pause = 1;
             break;
+
+        case 'T':
+            use_template = 1;
+            break;
         }
     }
     if (argc != optind)
@@ -157,6 +163,8 @@ now (void)
     return tv;
 }
 
+static krb5_context_template tmpl;
+
 static void run_iterations (struct resource_info *r)
 {
     int i;
@@ -165,7 +173,10 @@ static void run_iterations (struct resource_info *r)
 
     r->start_time = now ();
     for (i = 0; i < iter_count; i++) {
-        err = krb5_init_context(&ctx);
+        if (use_template)
+            err = krb5_init_context_from_template(tmpl, &ctx);
+        else
+            err = krb5_init_context(&ctx);
         if (err) {
             com_err(prog, err, "initializing krb5 context");
             exit(1);
@@ -200,10 +211,14 @@ main (int argc, char *argv[])
      * Some places in the krb5 library cache data globally.
      * This option allows you to test the effect of that.
      */
-    if (init_krb5_first && krb5_init_context (&kctx) != 0) {
+    if ((init_krb5_first || use_template) && krb5_init_context (&kctx) != 0) {
         fprintf (stderr, "krb5_init_context error\n");
         exit (1);
     }
+    if (use_template && krb5_create_context_template (kctx, &tmpl) != 0) {
+        fprintf (stderr, "krb5_create_context_template error\n");
+        exit (1);
+    }
     tinfo = calloc (n_threads, sizeof (*tinfo));
     if (tinfo == NULL) {
         perror ("calloc");
@@ -246,7 +261,9 @@ main (int argc, char *argv[])
         perror ("getrusage");
         exit (1);
     }
-    if (init_krb5_first)
+    if (use_template)
+        krb5_free_context_template (tmpl);
+    if (init_krb5_first || use_template)
         krb5_free_context (kctx);
     foreach_thread (i) {
         printf ("Thread %2d: elapsed time %Lfs\n", i,
@@ -260,6 +277,8 @@ main (int argc, char *argv[])
      */
     printf ("Overall run time with %d threads = %Lfs, %Lfms per iteration.\n",
             n_threads, wallclock, 1000 * wallclock / iter_count);
+    printf ("Contexts created: %.0Lf per second.\n",
+            (long double) n_threads * iter_count / wallclock);
     user = tvsub (finish.ru_utime, start.ru_utime);
     sys = tvsub (finish.ru_stime, start.ru_stime);
     total = user + sys;
@@ -98,6 +98,7 @@ keyword arguments:
     - port1 is used in the default krb5.conf for kadmind
     - port2 is used in the default krb5.conf for kpasswd
     - port3 is the return value of realm.server_port()
+    - port5 is used by realm.start_kpropd()
 
 * kdc_conf={...}: kdc.conf options, expressed as a nested dictionary,
   to be merged with the default kdc.conf settings.  The top level keys
@@ -229,6 +230,11 @@ Scripts may use the following realm methods and attributes:
   stop_daemon() to stop the server, or used to read from the server's
   output.
 
+* realm.start_kpropd(sentinel, args=[]): Start a kpropd in debug mode
+  in the slave environment, listening on port5.  Wait until sentinel
+  appears in its output, and return a subprocess.Popen object as for
+  realm.start_server().
+
 * realm.start_in_inetd(args, port=None): Begin a t_inetd process which
   will spawn a server process within the server environment after
   accepting a client connection.  If port is not specified,
@@ -244,8 +250,9 @@ Scripts may use the following realm methods and attributes:
 * realm.stop_kdc(): Stop the krb5kdc process.  Errors if no KDC is
   running.
 
-* realm.start_kadmind(): Start a kadmind with the realm's master KDC
-  environment.  Errors if a kadmind is already running.
+* realm.start_kadmind(args=[]): Start a kadmind with the realm's
+  master KDC environment.  Errors if a kadmind is already running.  If
+  args is given, it contains a list of additional kadmind arguments.
 
 * realm.stop_kadmind(): Stop the kadmind process.  Errors if no
   kadmind is running.
@@ -838,6 +845,11 @@ class K5Realm(object):
     def start_server(self, args, sentinel):
         return _start_daemon(args, self.env_server, sentinel)
 
+    def start_kpropd(self, sentinel, args=[]):
+        global kpropd
+        args = [kpropd, '-d', '-P', str(self.portbase + 5)] + args
+        return _start_daemon(args, self.env_slave, sentinel)
+
     def start_in_inetd(self, args, port=None):
         if not port:
             port = self.server_port()
@@ -859,10 +871,10 @@ class K5Realm(object):
         stop_daemon(self._kdc_proc)
         self._kdc_proc = None
 
-    def start_kadmind(self):
+    def start_kadmind(self, args=[]):
         global krb5kdc
         assert(self._kadmind_proc is None)
-        self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W'],
+        self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W'] + args,
                                             self.env_master, 'starting...')
 
     def stop_kadmind(self):
@@ -342,6 +342,7 @@ errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
         return 0;
     }
     if (data->root) {
+        profile_discard_snapshot(data);
         profile_free_node(data->root);
         data->root = 0;
     }
@@ -391,6 +392,59 @@ errcode_t profile_update_file_data(prf_data_t data, char **ret_modspec)
     return retval ? retval : retval2;
 }
 
+/* Drop data's reference to its snapshot, so that the next lookup indexes the
+ * current tree.  Call with data->lock held. */
+void
+profile_discard_snapshot(prf_data_t data)
+{
+    if (data->snapshot != NULL && --data->snapshot->refcount == 0)
+        profile_free_snapshot(data->snapshot);
+    data->snapshot = NULL;
+}
+
+/*
+ * Bring data up to date and return a reference to its snapshot, which the
+ * caller can search without holding data->lock.  The snapshot is kept until
+ * the file is reread or the tree is modified through prof_set.c.  Release
+ * the result with profile_release_snapshot().
+ */
+errcode_t
+profile_get_snapshot(prf_data_t data, struct profile_snapshot **ret_snap)
+{
+    errcode_t retval;
+
+    *ret_snap = NULL;
+    retval = k5_mutex_lock(&data->lock);
+    if (retval)
+        return retval;
+    retval = profile_update_file_data_locked(data, NULL);
+    if (retval)
+        goto cleanup;
+    if (data->snapshot == NULL) {
+        retval = profile_make_snapshot(data->root, &data->snapshot);
+        if (retval)
+            goto cleanup;
+    }
+    data->snapshot->refcount++;
+    *ret_snap = data->snapshot;
+
+cleanup:
+    k5_mutex_unlock(&data->lock);
+    return retval;
+}
+
+void
+profile_release_snapshot(prf_data_t data, struct profile_snapshot *snap)
+{
+    if (snap == NULL)
+        return;
+    if (k5_mutex_lock(&data->lock) != 0)
+        return;
+    if (--snap->refcount == 0)
+        profile_free_snapshot(snap);
+    k5_mutex_unlock(&data->lock);
+}
+
 static int
 make_hard_link(const char *oldpath, const char *newpath)
 {
@@ -588,6 +642,7 @@ static void profile_free_file_data(prf_data_t data)
             }
         }
     }
+    profile_discard_snapshot(data);
     if (data->root)
         profile_free_node(data->root);
     data->magic = 0;
@@ -152,13 +152,57 @@ get_values_vt(profile_t profile, const char *const *names, char ***ret_values)
     return retval;
 }
 
+/*
+ * Append the values of the relation names to values, searching the files of
+ * profile in order using their snapshots.  As with profile_node_iterator(),
+ * unreadable files are skipped and a final section stops the search.  If
+ * first_only is set, stop after the first value found.
+ */
+static errcode_t
+get_values_snapshot(profile_t profile, const char *const *names,
+                    int first_only, struct profile_string_list *values)
+{
+    errcode_t               retval = 0;
+    prf_file_t              file;
+    struct profile_snapshot *snap;
+    const char              *const *vp;
+    int                     final;
+
+    if (profile->magic != PROF_MAGIC_PROFILE)
+        return PROF_MAGIC_PROFILE;
+    if (names == NULL || names[0] == NULL)
+        return PROF_BAD_NAMESET;
+
+    for (file = profile->first_file; file; file = file->next) {
+        if (file->magic != PROF_MAGIC_FILE)
+            return PROF_MAGIC_FILE;
+        if (file->data->magic != PROF_MAGIC_FILE_DATA)
+            return PROF_MAGIC_FILE_DATA;
+        retval = profile_get_snapshot(file->data, &snap);
+        if (retval == ENOENT || retval == EACCES)
+            continue;
+        if (retval)
+            return retval;
+        vp = profile_snapshot_lookup(snap, names, &final);
+        for (; vp != NULL && *vp != NULL; vp++) {
+            retval = add_to_list(values, *vp);
+            if (retval || first_only)
+                break;
+        }
+        profile_release_snapshot(file->data, snap);
+        if (retval)
+            return retval;
+        if (final || (first_only && values->num > 0))
+            break;
+    }
+    return 0;
+}
+
 errcode_t KRB5_CALLCONV
 profile_get_values(profile_t profile, const char *const *names,
                    char ***ret_values)
 {
     errcode_t               retval;
-    void                    *state;
-    char                    *value;
     struct profile_string_list values;
 
     *ret_values = NULL;
@@ -167,20 +211,12 @@ profile_get_values(profile_t profile, const char *const *names,
     if (profile->vt)
         return get_values_vt(profile, names, ret_values);
 
-    if ((retval = profile_node_iterator_create(profile, names,
-                                               PROFILE_ITER_RELATIONS_ONLY,
-                                               &state)))
-        return retval;
-
     if ((retval = init_list(&values)))
         return retval;
 
-    do {
-        if ((retval = profile_node_iterator(&state, 0, 0, &value)))
-            goto cleanup;
-        if (value)
-            add_to_list(&values, value);
-    } while (state);
+    retval = get_values_snapshot(profile, names, 0, &values);
+    if (retval)
+        goto cleanup;
 
     if (values.num == 0) {
         retval = PROF_NO_RELATION;
@@ -221,8 +257,7 @@ errcode_t profile_get_value(profile_t profile, const char **names,
                             char **ret_value)
 {
     errcode_t               retval;
-    void                    *state;
-    char                    *value;
+    struct profile_string_list values;
 
     *ret_value = NULL;
     if (!profile)
@@ -230,22 +265,20 @@ errcode_t profile_get_value(profile_t profile, const char **names,
     if (profile->vt)
         return get_value_vt(profile, names, ret_value);
 
-    retval = profile_iterator_create(profile, names,
-                                     PROFILE_ITER_RELATIONS_ONLY, &state);
-    if (retval)
+    if ((retval = init_list(&values)))
         return retval;
 
-    retval = profile_iterator(&state, NULL, &value);
-    if (retval)
-        goto cleanup;
-
-    if (value)
-        *ret_value = value;
-    else
+    retval = get_values_snapshot(profile, (const char *const *)names, 1,
+                                 &values);
+    if (retval == 0 && values.num == 0)
         retval = PROF_NO_RELATION;
+    if (retval == 0) {
+        /* Take ownership of the value, leaving an empty list to free. */
+        *ret_value = values.list[0];
+        values.list[0] = NULL;
+    }
 
-cleanup:
-    profile_iterator_free(&state);
+    end_list(&values, 0);
     return retval;
 }
 
@@ -304,6 +304,70 @@ copy_vtable_profile(profile_t profile, profile_t *ret_new_profile)
         (COUNT) = cll_counter;                          \
     }
 
+/*
+ * Copy a file-based profile by taking new references to the shared data of
+ * each of its files, avoiding the path expansion, shared tree search and stat
+ * done when reopening them; lookups check the files for changes as usual.
+ * Set *ret_new_profile to NULL if any file's data has been modified through
+ * this profile and so is not shared.
+ */
+static errcode_t
+copy_shared_files(profile_t old_profile, profile_t *ret_new_profile)
+{
+    profile_t profile;
+    prf_file_t file, new_file, next, *nextp;
+    errcode_t err;
+
+    *ret_new_profile = NULL;
+    profile = calloc(1, sizeof(struct _profile_t));
+    if (profile == NULL)
+        return ENOMEM;
+    profile->magic = PROF_MAGIC_PROFILE;
+
+    /* Allocate the file handles first, so the global lock isn't held
+     * across allocations. */
+    nextp = &profile->first_file;
+    for (file = old_profile->first_file; file; file = file->next) {
+        new_file = calloc(1, sizeof(struct _prf_file_t));
+        if (new_file == NULL) {
+            err = ENOMEM;
+            goto cleanup;
+        }
+        new_file->magic = PROF_MAGIC_FILE;
+        *nextp = new_file;
+        nextp = &new_file->next;
+    }
+
+    err = profile_lock_global();
+    if (err)
+        goto cleanup;
+    for (file = old_profile->first_file; file; file = file->next) {
+        if (!(file->data->flags & PROFILE_FILE_SHARED))
+            break;
+    }
+    if (file == NULL) {
+        new_file = profile->first_file;
+        for (file = old_profile->first_file; file; file = file->next) {
+            file->data->refcount++;
+            new_file->data = file->data;
+            new_file = new_file->next;
+        }
+        *ret_new_profile = profile;
+        profile = NULL;
+    }
+    profile_unlock_global();
+
+cleanup:
+    if (profile != NULL) {
+        for (new_file = profile->first_file; new_file; new_file = next) {
+            next = new_file->next;
+            free(new_file);
+        }
+        free(profile);
+    }
+    return err;
+}
+
 errcode_t KRB5_CALLCONV
 profile_copy(profile_t old_profile, profile_t *new_profile)
 {
@@ -315,6 +379,10 @@ profile_copy(profile_t old_profile, profile_t *new_profile)
     if (old_profile->vt)
         return copy_vtable_profile(old_profile, new_profile);
 
+    err = copy_shared_files(old_profile, new_profile);
+    if (err || *new_profile != NULL)
+        return err;
+
     /* The fields we care about are read-only after creation, so
        no locking is needed.  */
     COUNT_LINKED_LIST (size, prf_file_t, old_profile->first_file, next);
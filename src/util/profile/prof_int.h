@@ -36,6 +36,7 @@ struct _prf_data_t {
 	unsigned long	frac_ts;   /* fractional part of timestamp, if any */
 	int		flags;	/* r/w, dirty */
 	int		upd_serial; /* incremented when data changes */
+	struct profile_snapshot *snapshot; /* index of root, if built */
 
 	size_t		fslen;
 
@@ -60,6 +61,19 @@ struct _prf_data_t {
 };
 
 typedef struct _prf_data_t *prf_data_t;
+
+/*
+ * A snapshot is an immutable hash index of a file's parse tree, built
+ * on first lookup after the file is (re)read or modified and shared by
+ * every profile referencing the data.  Lookups in a snapshot need no lock;
+ * refcount is protected by the lock of the owning prf_data_t.
+ */
+struct snapshot_entry;
+struct profile_snapshot {
+	int		refcount;
+	unsigned int	nbuckets;
+	struct snapshot_entry **buckets;
+};
 prf_data_t profile_make_prf_data(const char *);
 
 struct _prf_file_t {
@@ -200,6 +214,16 @@ errcode_t profile_node_iterator
 errcode_t profile_remove_node
 	(struct profile_node *node);
 
+errcode_t profile_make_snapshot
+	(struct profile_node *root, struct profile_snapshot **ret_snap);
+
+void profile_free_snapshot
+	(struct profile_snapshot *snap);
+
+const char *const *profile_snapshot_lookup
+	(struct profile_snapshot *snap, const char *const *names,
+	 int *ret_final);
+
 errcode_t profile_set_relation_value
 	(struct profile_node *node, const char *new_value);
 
@@ -232,6 +256,15 @@ errcode_t profile_flush_file_data_to_file
 errcode_t profile_flush_file_data_to_buffer
 	(prf_data_t data, char **bufp);
 
+errcode_t profile_get_snapshot
+	(prf_data_t data, struct profile_snapshot **ret_snap);
+
+void profile_release_snapshot
+	(prf_data_t data, struct profile_snapshot *snap);
+
+void profile_discard_snapshot
+	(prf_data_t data);
+
 void profile_free_file
 	(prf_file_t profile);
 
@@ -128,8 +128,10 @@ profile_update_relation(profile_t profile, const char **names,
         else
             retval = profile_remove_node(node);
     }
-    if (retval == 0)
+    if (retval == 0) {
         profile->first_file->data->flags |= PROFILE_FILE_DIRTY;
+        profile_discard_snapshot(profile->first_file->data);
+    }
     k5_mutex_unlock(&profile->first_file->data->lock);
 
     return retval;
@@ -162,28 +164,36 @@ profile_clear_relation(profile_t profile, const char **names)
     if (names == 0 || names[0] == 0 || names[1] == 0)
         return PROF_BAD_NAMESET;
 
+    retval = k5_mutex_lock(&profile->first_file->data->lock);
+    if (retval)
+        return retval;
     section = profile->first_file->data->root;
     for (cpp = names; cpp[1]; cpp++) {
         state = 0;
         retval = profile_find_node(section, *cpp, 0, 1,
                                    &state, &section);
         if (retval)
-            return retval;
+            goto cleanup;
     }
 
     state = 0;
-    do {
-        retval = profile_find_node(section, *cpp, 0, 0, &state, &node);
-        if (retval)
-            return retval;
+    retval = profile_find_node(section, *cpp, 0, 0, &state, &node);
+    if (retval)
+        goto cleanup;
+    profile->first_file->data->flags |= PROFILE_FILE_DIRTY;
+    profile_discard_snapshot(profile->first_file->data);
+    for (;;) {
         retval = profile_remove_node(node);
+        if (retval || state == NULL)
+            break;
+        retval = profile_find_node(section, *cpp, 0, 0, &state, &node);
         if (retval)
-            return retval;
-    } while (state);
-
-    profile->first_file->data->flags |= PROFILE_FILE_DIRTY;
+            break;
+    }
 
-    return 0;
+cleanup:
+    k5_mutex_unlock(&profile->first_file->data->lock);
+    return retval;
 }
 
 /*
@@ -236,8 +246,10 @@ profile_rename_section(profile_t profile, const char **names,
         else
             retval = profile_remove_node(node);
     }
-    if (retval == 0)
+    if (retval == 0) {
         profile->first_file->data->flags |= PROFILE_FILE_DIRTY;
+        profile_discard_snapshot(profile->first_file->data);
+    }
     k5_mutex_unlock(&profile->first_file->data->lock);
     return retval;
 }
@@ -307,6 +319,7 @@ profile_add_relation(profile_t profile, const char **names,
     }
 
     profile->first_file->data->flags |= PROFILE_FILE_DIRTY;
+    profile_discard_snapshot(profile->first_file->data);
     k5_mutex_unlock(&profile->first_file->data->lock);
     return 0;
 }
@@ -707,3 +707,270 @@ errcode_t profile_rename_node(struct profile_node *node, const char *new_name)
     node->name = new_string;
     return 0;
 }
+
+/*
+ * Snapshots index a parse tree by the full name of each section and
+ * relation, so that profile_get_values() can find a relation without
+ * walking sibling lists.  Entry keys are the name components, each
+ * followed by a zero byte.  As in profile_node_iterator(), only the
+ * first of several sibling sections with the same name is reachable.
+ */
+struct snapshot_entry {
+    struct snapshot_entry *next;
+    unsigned int hash;
+    unsigned int section:1;     /* Entry names a section, not a relation */
+    unsigned int final:1;       /* A section on the path is marked final */
+    char *key;
+    size_t keylen;
+    char **values;              /* Null-terminated; relations only */
+    size_t nvalues, maxvalues;
+};
+
+struct snapshot_path {
+    const char **names;
+    size_t max;
+};
+
+/* FNV-1a over the name components and their terminators. */
+static unsigned int
+hash_path(const char *const *names, size_t n, int section)
+{
+    unsigned int h = 2166136261U;
+    const unsigned char *p;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        for (p = (const unsigned char *)names[i]; ; p++) {
+            h = (h ^ *p) * 16777619U;
+            if (*p == '\0')
+                break;
+        }
+    }
+    return section ? h ^ 1 : h;
+}
+
+static int
+key_matches(const struct snapshot_entry *e, const char *const *names,
+            size_t n)
+{
+    const char *p = e->key, *end = e->key + e->keylen;
+    size_t i, len;
+
+    for (i = 0; i < n; i++) {
+        len = strlen(names[i]) + 1;
+        if ((size_t)(end - p) < len || memcmp(p, names[i], len) != 0)
+            return 0;
+        p += len;
+    }
+    return p == end;
+}
+
+static struct snapshot_entry *
+find_entry(struct profile_snapshot *snap, const char *const *names, size_t n,
+           int section, unsigned int hash)
+{
+    struct snapshot_entry *e;
+
+    for (e = snap->buckets[hash & (snap->nbuckets - 1)]; e; e = e->next) {
+        if (e->hash == hash && e->section == section &&
+            key_matches(e, names, n))
+            return e;
+    }
+    return NULL;
+}
+
+static errcode_t
+add_entry(struct profile_snapshot *snap, const char *const *names, size_t n,
+          int section, int final, unsigned int hash,
+          struct snapshot_entry **ret_entry)
+{
+    struct snapshot_entry *e;
+    size_t i, len, keylen = 0;
+    unsigned int b;
+
+    for (i = 0; i < n; i++)
+        keylen += strlen(names[i]) + 1;
+    e = calloc(1, sizeof(*e));
+    if (e == NULL)
+        return ENOMEM;
+    e->key = malloc(keylen);
+    if (e->key == NULL) {
+        free(e);
+        return ENOMEM;
+    }
+    for (i = 0, keylen = 0; i < n; i++) {
+        len = strlen(names[i]) + 1;
+        memcpy(e->key + keylen, names[i], len);
+        keylen += len;
+    }
+    e->keylen = keylen;
+    e->hash = hash;
+    e->section = section;
+    e->final = final;
+    b = hash & (snap->nbuckets - 1);
+    e->next = snap->buckets[b];
+    snap->buckets[b] = e;
+    *ret_entry = e;
+    return 0;
+}
+
+static errcode_t
+add_value(struct snapshot_entry *e, const char *value)
+{
+    char **newvalues;
+    size_t newmax;
+
+    if (e->nvalues + 1 >= e->maxvalues) {
+        newmax = e->maxvalues ? e->maxvalues * 2 : 4;
+        newvalues = realloc(e->values, newmax * sizeof(*newvalues));
+        if (newvalues == NULL)
+            return ENOMEM;
+        e->values = newvalues;
+        e->maxvalues = newmax;
+    }
+    e->values[e->nvalues] = strdup(value);
+    if (e->values[e->nvalues] == NULL)
+        return ENOMEM;
+    e->values[++e->nvalues] = NULL;
+    return 0;
+}
+
+static size_t
+count_nodes(struct profile_node *node)
+{
+    struct profile_node *p;
+    size_t count = 1;
+
+    for (p = node->first_child; p; p = p->next)
+        count += count_nodes(p);
+    return count;
+}
+
+/* Index the children of section, whose name components are the first depth
+ * entries of path. */
+static errcode_t
+index_section(struct profile_snapshot *snap, struct profile_node *section,
+              struct snapshot_path *path, size_t depth, int final)
+{
+    struct profile_node *p;
+    struct snapshot_entry *e;
+    const char **newnames;
+    unsigned int hash;
+    errcode_t retval;
+    int is_section;
+
+    if (depth >= path->max) {
+        newnames = realloc(path->names, (path->max + 8) * sizeof(*newnames));
+        if (newnames == NULL)
+            return ENOMEM;
+        path->names = newnames;
+        path->max += 8;
+    }
+    for (p = section->first_child; p; p = p->next) {
+        /* The iterator skips deleted relations but not deleted sections. */
+        if (p->value && p->deleted)
+            continue;
+        is_section = (p->value == NULL);
+        path->names[depth] = p->name;
+        hash = hash_path(path->names, depth + 1, is_section);
+        e = find_entry(snap, path->names, depth + 1, is_section, hash);
+        if (is_section && e != NULL)
+            continue;
+        if (e == NULL) {
+            retval = add_entry(snap, path->names, depth + 1, is_section,
+                               final || (is_section && p->final), hash, &e);
+            if (retval)
+                return retval;
+        }
+        if (is_section)
+            retval = index_section(snap, p, path, depth + 1, e->final);
+        else
+            retval = add_value(e, p->value);
+        if (retval)
+            return retval;
+    }
+    return 0;
+}
+
+errcode_t
+profile_make_snapshot(struct profile_node *root,
+                      struct profile_snapshot **ret_snap)
+{
+    struct profile_snapshot *snap;
+    struct snapshot_path path;
+    size_t count;
+    errcode_t retval;
+
+    *ret_snap = NULL;
+    CHECK_MAGIC(root);
+    snap = malloc(sizeof(*snap));
+    if (snap == NULL)
+        return ENOMEM;
+    snap->refcount = 1;
+    count = count_nodes(root);
+    for (snap->nbuckets = 16; snap->nbuckets < count; snap->nbuckets *= 2);
+    snap->buckets = calloc(snap->nbuckets, sizeof(*snap->buckets));
+    if (snap->buckets == NULL) {
+        free(snap);
+        return ENOMEM;
+    }
+    path.names = NULL;
+    path.max = 0;
+    retval = index_section(snap, root, &path, 0, 0);
+    free(path.names);
+    if (retval) {
+        profile_free_snapshot(snap);
+        return retval;
+    }
+    *ret_snap = snap;
+    return 0;
+}
+
+void
+profile_free_snapshot(struct profile_snapshot *snap)
+{
+    struct snapshot_entry *e, *next;
+    unsigned int i;
+    size_t j;
+
+    if (snap == NULL)
+        return;
+    for (i = 0; i < snap->nbuckets; i++) {
+        for (e = snap->buckets[i]; e; e = next) {
+            next = e->next;
+            for (j = 0; j < e->nvalues; j++)
+                free(e->values[j]);
+            free(e->values);
+            free(e->key);
+            free(e);
+        }
+    }
+    free(snap->buckets);
+    free(snap);
+}
+
+/*
+ * Return the null-terminated list of values of the relation names in snap,
+ * or NULL if there are none.  Set *ret_final if a section on the path to the
+ * relation is marked final, meaning later files should not be searched.  As
+ * in profile_node_iterator(), this holds even if the path stops partway
+ * through this file, so each leading section is looked up in turn.
+ */
+const char *const *
+profile_snapshot_lookup(struct profile_snapshot *snap,
+                        const char *const *names, int *ret_final)
+{
+    struct snapshot_entry *e;
+    size_t i, n;
+
+    *ret_final = 0;
+    for (n = 0; names[n] != NULL; n++);
+    for (i = 1; i < n; i++) {
+        e = find_entry(snap, names, i, 1, hash_path(names, i, 1));
+        if (e == NULL)
+            return NULL;
+        *ret_final = e->final;
+    }
+    e = find_entry(snap, names, n, 0, hash_path(names, n, 0));
+    return (e == NULL) ? NULL : (const char *const *)e->values;
+}
@@ -0,0 +1,183 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* util/profile/test_final.c - Test final sections across profile files */
+/*
+ * Copyright (C) 2012 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Export of this software from the United States of America may
+ *   require a specific license from the United States Government.
+ *   It is the responsibility of any person or organization contemplating
+ *   export to obtain such a license before exporting.
+ *
+ * WITHIN THAT CONSTRAINT, permission to use, copy, modify, and
+ * distribute this software and its documentation for any purpose and
+ * without fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright notice and
+ * this permission notice appear in supporting documentation, and that
+ * the name of M.I.T. not be used in advertising or publicity pertaining
+ * to distribution of the software without specific, written prior
+ * permission.  Furthermore if you modify this software you must label
+ * your software as modified software and not distribute it in such a
+ * fashion that it might be confused with the original M.I.T. software.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is" without express
+ * or implied warranty.
+ */
+
+/*
+ * This program looks up relations in a profile made of two files, some of
+ * whose sections are marked final, and checks that profile_get_values()
+ * agrees with profile_iterator() and with the expected results.  It then
+ * modifies the profile and checks that lookups see the changes.
+ */
+
+#include "k5-platform.h"
+#include "profile.h"
+#include "prof_int.h"
+
+static const char file1[] =
+    "[libdefaults]*\n"
+    "\ta = 1\n"
+    "[realms]\n"
+    "\tR = {\n"
+    "\t\tkdc = k1\n"
+    "\t}*\n"
+    "[domain_realm]\n"
+    "\tx = X1\n";
+
+static const char file2[] =
+    "[libdefaults]\n"
+    "\ta = 2\n"
+    "\tb = 2\n"
+    "\tsub = {\n"
+    "\t\tv = 2\n"
+    "\t}\n"
+    "[realms]\n"
+    "\tR = {\n"
+    "\t\tkdc = k2\n"
+    "\t\tadmin = a2\n"
+    "\t}\n"
+    "\tS = {\n"
+    "\t\tkdc = s2\n"
+    "\t}\n"
+    "[domain_realm]\n"
+    "\tx = X2\n"
+    "[capaths]\n"
+    "\tc = 2\n";
+
+static void
+write_file(const char *filename, const char *contents)
+{
+    FILE *fp;
+
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    assert(fputs(contents, fp) != EOF);
+    assert(fclose(fp) == 0);
+}
+
+static void
+check_list(const char *what, const char *const *names, char **values,
+           const char *const *expected)
+{
+    size_t i;
+
+    for (i = 0; expected[i] != NULL; i++) {
+        if (values == NULL || values[i] == NULL ||
+            strcmp(values[i], expected[i]) != 0)
+            break;
+    }
+    if (expected[i] == NULL && (values == NULL || values[i] == NULL))
+        return;
+    fprintf(stderr, "%s: wrong values for", what);
+    for (i = 0; names[i] != NULL; i++)
+        fprintf(stderr, " %s", names[i]);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+/* Check that the values of names in pr are expected, both through
+ * profile_get_values() and through the iterator. */
+static void
+check(profile_t pr, const char *const *names, const char *const *expected)
+{
+    void *iter;
+    char **values, *value, *list[10];
+    size_t n = 0;
+    long ret;
+
+    ret = profile_get_values(pr, names, &values);
+    assert(ret == 0 || ret == PROF_NO_RELATION);
+    check_list("profile_get_values", names, (ret == 0) ? values : NULL,
+               expected);
+    if (ret == 0)
+        profile_free_list(values);
+
+    assert(profile_iterator_create(pr, names, PROFILE_ITER_RELATIONS_ONLY,
+                                   &iter) == 0);
+    for (;;) {
+        assert(profile_iterator(&iter, NULL, &value) == 0);
+        if (value == NULL)
+            break;
+        assert(n < sizeof(list) / sizeof(*list) - 1);
+        list[n++] = value;
+    }
+    list[n] = NULL;
+    check_list("profile_iterator", names, list, expected);
+    while (n > 0)
+        profile_release_string(list[--n]);
+}
+
+int
+main()
+{
+    profile_t pr;
+    const char *files[] = { "./final1.ini", "./final2.ini", NULL };
+    const char *ld_a[] = { "libdefaults", "a", NULL };
+    const char *ld_b[] = { "libdefaults", "b", NULL };
+    const char *ld_sub_v[] = { "libdefaults", "sub", "v", NULL };
+    const char *r_kdc[] = { "realms", "R", "kdc", NULL };
+    const char *r_admin[] = { "realms", "R", "admin", NULL };
+    const char *s_kdc[] = { "realms", "S", "kdc", NULL };
+    const char *dr_x[] = { "domain_realm", "x", NULL };
+    const char *dr_y[] = { "domain_realm", "y", NULL };
+    const char *ca_c[] = { "capaths", "c", NULL };
+    const char *none[] = { NULL };
+    const char *one[] = { "1", NULL };
+    const char *k1[] = { "k1", NULL };
+    const char *s2[] = { "s2", NULL };
+    const char *two[] = { "2", NULL };
+    const char *x1x2[] = { "X1", "X2", NULL };
+    const char *x3x2[] = { "X3", "X2", NULL };
+    const char *x2[] = { "X2", NULL };
+    const char *y1[] = { "Y1", NULL };
+
+    write_file(files[0], file1);
+    write_file(files[1], file2);
+    assert(profile_init(files, &pr) == 0);
+
+    /* A final section hides the same section in the second file, even
+     * where the first file lacks the relation or a subsection on the
+     * way to it. */
+    check(pr, ld_a, one);
+    check(pr, ld_b, none);
+    check(pr, ld_sub_v, none);
+    check(pr, r_kdc, k1);
+    check(pr, r_admin, none);
+
+    /* Sections not marked final are searched in both files. */
+    check(pr, s_kdc, s2);
+    check(pr, dr_x, x1x2);
+    check(pr, ca_c, two);
+
+    /* Modifications to the first file are seen by later lookups. */
+    assert(profile_add_relation(pr, dr_y, "Y1") == 0);
+    check(pr, dr_y, y1);
+    assert(profile_update_relation(pr, dr_x, "X1", "X3") == 0);
+    check(pr, dr_x, x3x2);
+    assert(profile_clear_relation(pr, dr_x) == 0);
+    check(pr, dr_x, x2);
+
+    profile_abandon(pr);
+    return 0;
+}